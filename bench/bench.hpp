@@ -0,0 +1,212 @@
+#ifndef modb_bench_helpers
+#define modb_bench_helpers
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <cmath>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Generated by the build from `git describe` so results of different versions can be told apart. */
+#if __has_include("modb_version.hpp")
+#include "modb_version.hpp"
+#endif
+#ifndef MODB_BENCH_VERSION
+#define MODB_BENCH_VERSION      "unknown"
+#endif
+
+/*
+ * bench_now - current time in seconds from a monotonic clock.
+ *  returns: seconds as a double
+ *  on error: this function does not error
+ * */
+inline double bench_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * bench_remove_database - remove the `.modb` file at `path` and every file the backend keeps next to it: the
+ *                         write-ahead log, the log's compaction files, the blob file and the index file.
+ *  returns: nothing
+ *  on error: this function does not error; files that do not exist are skipped
+ * */
+inline void bench_remove_database(const std::string &path)
+{
+    std::string wal = path + NCC_PTR wal_file_extension;
+
+    remove(path.c_str());
+    remove(wal.c_str());
+    remove((wal + NCC_PTR wal_compact_extension).c_str());
+    remove((wal + NCC_PTR wal_next_extension).c_str());
+    remove((path + NCC_PTR pod_blob_file_extension).c_str());
+    remove((path + NCC_PTR pod_index_file_extension).c_str());
+}
+
+/* One line of a benchmark run, kept for `bench_write_json`; the percentiles are only set for latency results. */
+typedef struct BenchResult
+{
+    std::string name;
+    uint64_t    ops = 0;
+    double      seconds = 0;
+
+    bool        latency = false;
+    uint64_t    p50_ns = 0;
+    uint64_t    p99_ns = 0;
+    uint64_t    p999_ns = 0;
+    uint64_t    max_ns = 0;
+} _BenchResult;
+
+inline std::vector<_BenchResult> &bench_results()
+{
+    static std::vector<_BenchResult> results;
+    return results;
+}
+
+/*
+ * bench_report - print the throughput of a benchmark run.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+inline void bench_report(const char *name, uint64_t ops, double seconds)
+{
+    printf("%-40s %12llu ops %10.3f ms %14.0f ops/sec\n", name, (unsigned long long) ops, seconds * 1e3, seconds > 0 ? ops / seconds : 0.0);
+
+    _BenchResult result;
+    result.name = name;
+    result.ops = ops;
+    result.seconds = seconds;
+    bench_results().push_back(result);
+}
+
+/* Latency histogram with log-linear buckets: exact below 32 ns, then 32 buckets per power of two (about 3% wide). */
+#define BENCH_HISTOGRAM_BUCKETS     (32 + 59 * 32)
+
+typedef struct BenchHistogram
+{
+    uint64_t    counts[BENCH_HISTOGRAM_BUCKETS] = {0};
+    uint64_t    total = 0;
+    uint64_t    largest = 0;
+
+    static uint32_t bucket_of(uint64_t ns)
+    {
+        if(ns < 32) return (uint32_t) ns;
+
+        uint32_t exponent = 63 - __builtin_clzll(ns);
+        return 32 + (exponent - 5) * 32 + (uint32_t) ((ns >> (exponent - 5)) - 32);
+    }
+
+    static uint64_t lowest_in(uint32_t bucket)
+    {
+        if(bucket < 32) return bucket;
+
+        uint32_t exponent = (bucket - 32) / 32 + 5;
+        return (uint64_t) (32 + (bucket - 32) % 32) << (exponent - 5);
+    }
+
+    void record(uint64_t ns)
+    {
+        counts[bucket_of(ns)]++;
+        total++;
+        if(ns > largest) largest = ns;
+    }
+
+    /*
+     * percentile - smallest latency at least `fraction` of the samples are at or below.
+     *  returns: the latency in nanoseconds (the bottom of its bucket), 0 without samples
+     *  on error: this function does not error
+     * */
+    uint64_t percentile(double fraction)
+    {
+        uint64_t wanted = (uint64_t) (fraction * total + 0.5), seen = 0;
+        if(wanted == 0) wanted = 1;
+
+        for(uint32_t bucket = 0; bucket < BENCH_HISTOGRAM_BUCKETS; bucket++)
+        {
+            seen += counts[bucket];
+            if(seen >= wanted) return lowest_in(bucket);
+        }
+        return largest;
+    }
+} _BenchHistogram;
+
+/*
+ * bench_report_latency - print the latency percentiles of a benchmark run.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+inline void bench_report_latency(const char *name, _BenchHistogram &histogram)
+{
+    printf("%-40s %12llu ops  p50 %8.3f us  p99 %8.3f us  p999 %8.3f us  max %8.3f us\n", name, (unsigned long long) histogram.total,
+           histogram.percentile(0.5) / 1e3, histogram.percentile(0.99) / 1e3, histogram.percentile(0.999) / 1e3, histogram.largest / 1e3);
+
+    _BenchResult result;
+    result.name = name;
+    result.ops = histogram.total;
+    result.latency = true;
+    result.p50_ns = histogram.percentile(0.5);
+    result.p99_ns = histogram.percentile(0.99);
+    result.p999_ns = histogram.percentile(0.999);
+    result.max_ns = histogram.largest;
+    bench_results().push_back(result);
+}
+
+/*
+ * bench_json_string - write `text` to `file` as a JSON string.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+inline void bench_json_string(FILE *file, const std::string &text)
+{
+    fputc('"', file);
+    for(unsigned char c: text)
+    {
+        if(c == '"' || c == '\\') fprintf(file, "\\%c", c);
+        else if(c < 0x20) fprintf(file, "\\u%04x", c);
+        else fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+/*
+ * bench_write_json - write every result reported so far to `path` as one JSON object, so runs of different versions can be compared.
+ *  returns: true if the file was written else false
+ *  on error: this function does not error
+ * */
+inline bool bench_write_json(const char *path, const char *suite)
+{
+    FILE *file = fopen(path, "wb");
+    if(!file) return false;
+
+    fprintf(file, "{\n  \"version\": ");
+    bench_json_string(file, MODB_BENCH_VERSION);
+    fprintf(file, ",\n  \"suite\": ");
+    bench_json_string(file, suite);
+    fprintf(file, ",\n  \"compiler\": ");
+    bench_json_string(file, __VERSION__);
+    fprintf(file, ",\n  \"timestamp\": %lld,\n  \"results\": [", (long long) time(nullptr));
+
+    std::vector<_BenchResult> &results = bench_results();
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        _BenchResult &result = results[i];
+
+        fprintf(file, "%s\n    {\"name\": ", i ? "," : "");
+        bench_json_string(file, result.name);
+        fprintf(file, ", \"ops\": %llu", (unsigned long long) result.ops);
+
+        if(result.latency)
+            fprintf(file, ", \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}", (unsigned long long) result.p50_ns,
+                    (unsigned long long) result.p99_ns, (unsigned long long) result.p999_ns, (unsigned long long) result.max_ns);
+        else
+            fprintf(file, ", \"seconds\": %.9f, \"ops_per_sec\": %.3f}", result.seconds, result.seconds > 0 ? result.ops / result.seconds : 0.0);
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+#endif
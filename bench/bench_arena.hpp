@@ -0,0 +1,280 @@
+#ifndef bench_arena
+#define bench_arena
+
+/* Requests the server benchmark keeps outstanding at once. */
+#define BENCH_ARENA_IN_FLIGHT   256
+
+/* Threads whose allocations are not counted, e.g. the client side of the server benchmark. */
+static thread_local bool bench_thread_uncounted = false;
+
+#ifdef BENCH_COUNT_HEAP
+#include <new>
+
+/* Every heap allocation made by a thread that is not excluded. `malloc` and the rest of the C allocator are replaced
+ * (under AddressSanitizer, which replaces them itself, they are hooked instead), and every form of `operator new`
+ * allocates through them, so nothing in the program allocates without being counted. Only the allocation test
+ * (tests/arena_allocations.cpp) defines `BENCH_COUNT_HEAP`; it costs every allocation of the program an atomic add.
+ * */
+static std::atomic<uint64_t> bench_heap_calls{0};
+
+inline void bench_count_allocation()
+{
+    if(!bench_thread_uncounted) bench_heap_calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifdef __SANITIZE_ADDRESS__
+/* Called by the sanitizer for every allocation it makes. */
+extern "C" void __sanitizer_malloc_hook(const volatile void *, size_t) { bench_count_allocation(); }
+#else
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *allocated, size_t size);
+    void *__libc_memalign(size_t align, size_t size);
+    void __libc_free(void *allocated);
+
+    void *malloc(size_t size) noexcept { bench_count_allocation(); return __libc_malloc(size); }
+    void *calloc(size_t count, size_t size) noexcept { bench_count_allocation(); return __libc_calloc(count, size); }
+    void *realloc(void *allocated, size_t size) noexcept { bench_count_allocation(); return __libc_realloc(allocated, size); }
+    void *memalign(size_t align, size_t size) noexcept { bench_count_allocation(); return __libc_memalign(align, size); }
+    void *aligned_alloc(size_t align, size_t size) noexcept { bench_count_allocation(); return __libc_memalign(align, size); }
+    void free(void *allocated) noexcept { __libc_free(allocated); }
+
+    int posix_memalign(void **allocated, size_t align, size_t size) noexcept
+    {
+        if(align % sizeof(void *) != 0 || (align & (align - 1)) != 0) return EINVAL;
+
+        bench_count_allocation();
+        *allocated = __libc_memalign(align, size);
+        return *allocated ? 0 : ENOMEM;
+    }
+}
+#endif
+
+/* Every form of `operator new` and `operator delete` is replaced, so nothing allocated by one allocator is freed by the other. */
+inline void *bench_heap_new(size_t size, size_t align)
+{
+    if(align <= alignof(std::max_align_t)) return malloc(size ? size : 1);
+
+    void *allocated;
+    return posix_memalign(&allocated, align, size ? size : 1) == 0 ? allocated : nullptr;
+}
+
+inline void *bench_heap_new_or_throw(size_t size, size_t align)
+{
+    void *allocated = bench_heap_new(size, align);
+    if(!allocated) throw std::bad_alloc();
+    return allocated;
+}
+
+void *operator new(size_t size) { return bench_heap_new_or_throw(size, 0); }
+void *operator new[](size_t size) { return bench_heap_new_or_throw(size, 0); }
+void *operator new(size_t size, std::align_val_t align) { return bench_heap_new_or_throw(size, (size_t) align); }
+void *operator new[](size_t size, std::align_val_t align) { return bench_heap_new_or_throw(size, (size_t) align); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return bench_heap_new(size, 0); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return bench_heap_new(size, 0); }
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return bench_heap_new(size, (size_t) align); }
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept { return bench_heap_new(size, (size_t) align); }
+
+/* GCC takes the `free` below for a mismatch once it is inlined next to a `new`; here the two are the pair. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *allocated) noexcept { free(allocated); }
+void operator delete[](void *allocated) noexcept { free(allocated); }
+void operator delete(void *allocated, size_t) noexcept { free(allocated); }
+void operator delete[](void *allocated, size_t) noexcept { free(allocated); }
+void operator delete(void *allocated, std::align_val_t) noexcept { free(allocated); }
+void operator delete[](void *allocated, std::align_val_t) noexcept { free(allocated); }
+void operator delete(void *allocated, size_t, std::align_val_t) noexcept { free(allocated); }
+void operator delete[](void *allocated, size_t, std::align_val_t) noexcept { free(allocated); }
+void operator delete(void *allocated, const std::nothrow_t &) noexcept { free(allocated); }
+void operator delete[](void *allocated, const std::nothrow_t &) noexcept { free(allocated); }
+void operator delete(void *allocated, std::align_val_t, const std::nothrow_t &) noexcept { free(allocated); }
+void operator delete[](void *allocated, std::align_val_t, const std::nothrow_t &) noexcept { free(allocated); }
+#pragma GCC diagnostic pop
+#endif
+
+/*
+ * bench_allocations - heap allocations made so far by `ModbBuffer` and `ModbArena`, or every heap allocation (`malloc`
+ *                     and `operator new` alike) where `BENCH_COUNT_HEAP` is defined.
+ *  returns: the count
+ *  on error: this function does not error
+ * */
+inline uint64_t bench_allocations()
+{
+#ifdef BENCH_COUNT_HEAP
+    return bench_heap_calls.load();
+#else
+    return ModbBuffer::heap_allocations() + ModbArena::heap_allocations();
+#endif
+}
+
+/*
+ * bench_commit_image - build the file image `CreateDB::commit_new_database` writes, on the heap or in `arena`.
+ *  returns: size of the image
+ *  on error: this function does not error
+ * */
+inline size_t bench_commit_image(ModbArena *arena)
+{
+    _ModbEntryView entry;
+    entry.ip_address = "127.0.0.1";
+    entry.host = "bench_host.net";
+    entry.port = "8080";
+    entry.name = "bench_database_with_a_longer_name";
+    entry.folder = "../MY_MODB";
+
+    size_t size;
+    {
+        ModbWriterV2 writer(arena);
+        writer.add_entry(entry);
+        size = writer.finish().size();
+    }
+    if(arena) arena->reset();
+
+    return size;
+}
+
+/*
+ * bench_commit_allocations - time `commits` commit images built on the heap, or in `arena`, after one to warm up.
+ *  returns: the allocations they made
+ *  on error: this function does not error
+ * */
+inline uint64_t bench_commit_allocations(ModbArena *arena, uint32_t commits, double &took)
+{
+    bench_commit_image(arena);
+
+    uint64_t before = bench_allocations();
+    double start = bench_now();
+    for(uint32_t i = 0; i < commits; i++) bench_commit_image(arena);
+    took = bench_now() - start;
+
+    return bench_allocations() - before;
+}
+
+/*
+ * bench_server_allocations - count the allocations a server in this process makes for `count` pipelined requests
+ *                            (`BENCH_ARENA_IN_FLIGHT` at a time) once it is warmed up; only the server's threads
+ *                            are counted.
+ *  returns: the allocations, with how long the requests took in `took` and how many failed in `failed`
+ *  on error: this function will error if the server cannot be set up
+ * */
+inline uint64_t bench_server_allocations(const char *folder, uint32_t count, double &took, uint32_t &failed)
+{
+    std::string path = std::string(folder) + "/modb_arena_bench.modb";
+    std::string wal = path + ".wal";
+    remove(wal.c_str());
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8198";
+        entry.name = "arena_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    bench_thread_uncounted = true;
+
+    DatabaseConnect connect(UC_PTR path.c_str());
+    database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+    std::thread server([&connect]() { connect.SS_start(true); });
+
+    TransportClient client;
+    for(int tries = 0; !client.connect_tcp("127.0.0.1", "8198") && tries < 500; tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    database_assert(client.is_connected(), "\nCould not connect to the benchmark server.\n")
+
+    /* 64 entries, each with a SDWORD POD and a byte stream POD whose name is too long for small-string storage. */
+    const char *stream_name = "a_byte_stream_with_a_long_name";
+    std::vector<unsigned char> result;
+    for(uint32_t id = 0; id < 64; id++)
+    {
+        std::vector<unsigned char> pod = engine_payload(id, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+        std::vector<unsigned char> stream = engine_payload(id, nullptr, {CS_CREATING_POD_WITH_TYPE_BYTE_STREAM, (unsigned char) strlen(stream_name)});
+        stream.insert(stream.end(), stream_name, stream_name + strlen(stream_name));
+
+        client.request(CS_REQUEST_CREATE_NEW_DB_ENTRY, engine_payload(id, nullptr, {}).data(), 4, result);
+        client.request(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), result);
+        client.request(CS_REQUEST_CREATE_NEW_POD, stream.data(), stream.size(), result);
+    }
+
+    std::vector<std::vector<unsigned char>> requests;
+    std::vector<unsigned char> opcodes;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t id = i % 64;
+        std::vector<unsigned char> value(200, (unsigned char) i);
+        value.insert(value.begin(), CS_STORING_BYTE_STREAM);
+
+        switch(i % 4)
+        {
+            case 0: requests.push_back(bench_batch_store_payload(id, i)); opcodes.push_back(CS_REQUEST_TO_STORE_IN); break;
+            case 1: requests.push_back(engine_payload(id, "value", {})); opcodes.push_back(CS_REQUEST_READ_POD); break;
+            case 2: requests.push_back(engine_payload(id, stream_name, value)); opcodes.push_back(CS_REQUEST_TO_STORE_IN); break;
+            default: requests.push_back(engine_payload(id, stream_name, {})); opcodes.push_back(CS_REQUEST_READ_POD); break;
+        }
+    }
+
+    failed = 0;
+    /* At most `BENCH_ARENA_IN_FLIGHT` requests are outstanding, so the buffers in circulation have a peak to grow to. */
+    auto run_round = [&]() {
+        for(uint32_t first = 0; first < count; first += BENCH_ARENA_IN_FLIGHT)
+        {
+            uint32_t last = std::min<uint32_t>(count, first + BENCH_ARENA_IN_FLIGHT);
+            for(uint32_t i = first; i < last; i++)
+                client.send_request(opcodes[i], requests[i].data(), requests[i].size());
+
+            unsigned char response;
+            for(uint32_t i = first; i < last; i++)
+                if(!client.read_response(response, result) || response != SS_RESPONSE_OK) failed++;
+        }
+    };
+
+    /* Warm up the connection, request and response buffers until every buffer in circulation has grown, then measure. */
+    for(int round = 0; round < 3; round++) run_round();
+    uint64_t before = bench_allocations();
+    double start = bench_now();
+    run_round();
+    took = bench_now() - start;
+    uint64_t allocations = bench_allocations() - before;
+
+    connect.SS_stop();
+    server.join();
+    bench_thread_uncounted = false;
+
+    bench_remove_database(path);
+    return allocations;
+}
+
+/*
+ * run_arena_bench - count the allocations `commits` commits make with and without an arena, then the allocations
+ *                   a server in this process makes for `count` pipelined requests once it is warmed up. Only the
+ *                   library's own buffers are counted here; tests/arena_allocations.cpp counts every heap allocation.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_arena_bench(const char *folder, uint32_t commits, uint32_t count)
+{
+    double took;
+    uint64_t allocations = bench_commit_allocations(nullptr, commits, took);
+    bench_report("arena/commit[heap]", commits, took);
+    printf("    (%.2f allocations per commit)\n", (double) allocations / commits);
+
+    ModbArena arena;
+    allocations = bench_commit_allocations(&arena, commits, took);
+    bench_report("arena/commit[arena]", commits, took);
+    printf("    (%.2f allocations per commit)\n", (double) allocations / commits);
+
+    uint32_t failed;
+    allocations = bench_server_allocations(folder, count, took, failed);
+    bench_report("arena/server_requests[steady state]", count, took);
+    printf("    (%llu server-side allocations, %.4f per request)\n", (unsigned long long) allocations, (double) allocations / count);
+    if(failed) printf("    (%u requests failed)\n", failed);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef bench_batch
+#define bench_batch
+
+/*
+ * bench_batch_store_payload - payload storing `value` into the SDWORD POD "value" of entry `entry_id`.
+ *  returns: the payload
+ *  on error: this function does not error
+ * */
+inline std::vector<unsigned char> bench_batch_store_payload(uint32_t entry_id, uint32_t value)
+{
+    std::vector<unsigned char> store = {CS_STORING_SDWORD, 0, 0, 0, 0};
+    modb_put_u32(&store[1], value);
+
+    return engine_payload(entry_id, "value", store);
+}
+
+/*
+ * run_batch_bench - against a server running in this process, time `count` stores sent one request at a time,
+ *                   in batches of `batch_size` (waiting for each reply) and as pipelined batches.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_batch_bench(const char *folder, uint32_t count, uint32_t batch_size)
+{
+    std::string path = std::string(folder) + "/modb_batch_bench.modb";
+    std::string wal = path + ".wal";
+    remove(wal.c_str());
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8199";
+        entry.name = "batch_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    DatabaseConnect connect(UC_PTR path.c_str());
+    database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+    std::thread server([&connect]() { connect.SS_start(true); });
+
+    TransportClient client;
+    for(int tries = 0; !client.connect_tcp("127.0.0.1", "8199") && tries < 500; tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    database_assert(client.is_connected(), "\nCould not connect to the benchmark server.\n")
+
+    std::vector<unsigned char> result, statuses;
+    std::vector<std::vector<unsigned char>> results;
+    unsigned char response;
+    uint32_t failed = 0;
+
+    /* One entry per batch slot, each with a SDWORD POD to store into. */
+    BatchBuilder setup;
+    for(uint32_t id = 0; id < batch_size; id++)
+    {
+        std::vector<unsigned char> create = engine_payload(id, nullptr, {});
+        std::vector<unsigned char> pod = engine_payload(id, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+
+        setup.add(CS_REQUEST_CREATE_NEW_DB_ENTRY, create.data(), create.size());
+        setup.add(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size());
+    }
+    client.request(CS_REQUEST_BATCH, setup.data(), setup.size(), result);
+
+    double start = bench_now();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        std::vector<unsigned char> store = bench_batch_store_payload(i % batch_size, i);
+        if(client.request(CS_REQUEST_TO_STORE_IN, store.data(), store.size(), result) != SS_RESPONSE_OK) failed++;
+    }
+    bench_report("batch/store[1 per request]", count, bench_now() - start);
+    printf("    (%u round trips)\n", count);
+
+    /* The same stores, `batch_size` per frame. */
+    std::vector<BatchBuilder> batches((count + batch_size - 1) / batch_size);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        std::vector<unsigned char> store = bench_batch_store_payload(i % batch_size, i);
+        batches[i / batch_size].add(CS_REQUEST_TO_STORE_IN, store.data(), store.size());
+    }
+
+    auto check_batch = [&]() {
+        if(response != SS_RESPONSE_OK || !batch_decode_response(result, statuses, results)) { failed++; return; }
+        for(unsigned char status: statuses) if(status != SS_RESPONSE_OK) failed++;
+    };
+
+    start = bench_now();
+    for(auto &batch: batches)
+    {
+        response = client.request(CS_REQUEST_BATCH, batch.data(), batch.size(), result);
+        check_batch();
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "batch/store[%u per batch]", batch_size);
+    bench_report(name, count, bench_now() - start);
+    printf("    (%zu round trips, %zu saved)\n", batches.size(), count - batches.size());
+
+    /* Every batch sent before the first reply is read. */
+    start = bench_now();
+    for(auto &batch: batches)
+        client.send_request(CS_REQUEST_BATCH, batch.data(), batch.size());
+    for(size_t i = 0; i < batches.size(); i++)
+    {
+        if(!client.read_response(response, result)) { failed++; break; }
+        check_batch();
+    }
+    snprintf(name, sizeof(name), "batch/store[%u per batch, pipelined]", batch_size);
+    bench_report(name, count, bench_now() - start);
+    printf("    (1 round trip, %u saved)\n", count - 1);
+
+    if(failed) printf("    (%u requests failed)\n", failed);
+
+    connect.SS_stop();
+    server.join();
+
+    bench_remove_database(path);
+}
+
+#endif
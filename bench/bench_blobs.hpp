@@ -0,0 +1,116 @@
+#ifndef bench_blobs
+#define bench_blobs
+
+/* Byte `at` of the value the blob benchmark streams; not all the same, so a chunk read from the wrong place shows. */
+inline unsigned char bench_blob_byte(uint64_t at) { return (unsigned char) ((at * 131) ^ (at >> 20)); }
+
+/* Peak resident memory of this process so far, in MiB. */
+inline double bench_peak_rss_mb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+/*
+ * run_blobs_bench - against a server in this process, stream a `megabytes` MiB value into a BYTE_STREAM POD over the
+ *                   Unix socket, then read it back over the Unix socket and TCP (sent with `sendfile`) and over shared
+ *                   memory (read into the response), checking every byte; the peak memory of the process is shown
+ *                   before and after, and does not grow with the value.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_blobs_bench(const char *folder, uint32_t megabytes)
+{
+    std::string path = std::string(folder) + "/modb_blobs_bench.modb";
+    std::string wal = path + ".wal";
+    std::string blob = path + NCC_PTR pod_blob_file_extension;
+    remove(wal.c_str());
+    remove(blob.c_str());
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8193";
+        entry.name = "blobs_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    DatabaseConnect connect(UC_PTR path.c_str());
+    database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+    std::thread server([&connect]() { connect.SS_start(true); });
+
+    _DatabaseClientSide shm, unix_socket, tcp;
+    for(_DatabaseClientSide *client: {&shm, &unix_socket, &tcp})
+    {
+        client->CS_DB_IP_ADDR = "127.0.0.1";
+        client->CS_DB_NAME = "blobs_bench";
+        client->CS_MODB_FOLDER = client == &tcp ? "/nonexistent" : folder;
+        memcpy(client->CS_DB_PORT, "8193", 4);
+    }
+
+    modb_status reached = modb_status::MODB_NO_SERVER;
+    for(int tries = 0; tries < 500 && (reached = shm.connect(true)) != modb_status::MODB_OK; tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    database_assert(reached == modb_status::MODB_OK && unix_socket.connect(false) == modb_status::MODB_OK && tcp.connect(false) == modb_status::MODB_OK,
+        "\nCould not connect to the benchmark server.\n")
+
+    uint64_t size = (uint64_t) megabytes * 1024 * 1024;
+    uint32_t failed = 0;
+    double peak_before = bench_peak_rss_mb();
+
+    unix_socket.create_entry(0);
+    unix_socket.create_pod<PodByteStream>(0, "blob");
+
+    {
+        uint64_t offset = 0;
+        double start = bench_now();
+        unsigned char response = unix_socket.write_stream(0, "blob", size, [&offset](unsigned char *chunk, uint32_t chunk_size) {
+            for(uint32_t i = 0; i < chunk_size; i++) chunk[i] = bench_blob_byte(offset + i);
+            offset += chunk_size;
+            return true;
+        });
+        double took = bench_now() - start;
+
+        if(response != SS_RESPONSE_OK) { printf("    (streaming the value in failed: 0x%02X)\n", response); failed++; }
+        bench_report("blobs/write[unix, MiB]", megabytes, took);
+    }
+
+    /* Published reads cannot hold a value this size; they point at the stream instead. */
+    std::vector<uint8_t> whole;
+    if(unix_socket.read<PodByteStream>(0, "blob", whole) != SS_RESPONSE_USE_STREAM) failed++;
+
+    for(_DatabaseClientSide *client: {&unix_socket, &tcp, &shm})
+    {
+        uint64_t offset = 0, wrong = 0;
+        double start = bench_now();
+        unsigned char response = client->read_stream(0, "blob", [&offset, &wrong](const unsigned char *chunk, uint32_t chunk_size) {
+            for(uint32_t i = 0; i < chunk_size; i++) wrong += chunk[i] != bench_blob_byte(offset + i);
+            offset += chunk_size;
+            return true;
+        });
+        double took = bench_now() - start;
+
+        if(response != SS_RESPONSE_OK || offset != size || wrong) { printf("    (read 0x%02X, %llu of %llu bytes, %llu wrong)\n", response,
+            (unsigned long long) offset, (unsigned long long) size, (unsigned long long) wrong); failed++; }
+
+        const char *name = client == &shm ? "blobs/read[shared memory, MiB]" : client == &tcp ? "blobs/read[tcp sendfile, MiB]" : "blobs/read[unix sendfile, MiB]";
+        bench_report(name, megabytes, took);
+    }
+
+    printf("    (peak memory %.1f MiB before, %.1f MiB after moving %u MiB each way)\n", peak_before, bench_peak_rss_mb(), megabytes);
+
+    connect.SS_stop();
+    server.join();
+
+    if(failed) printf("    (%u checks failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
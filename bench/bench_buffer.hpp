@@ -0,0 +1,134 @@
+#ifndef bench_buffer
+#define bench_buffer
+
+/* Field values every benchmark entry is built from. */
+static const unsigned char *bench_entry_fields[4] = {
+    UC_PTR "127.0.0.1", UC_PTR "bench_host.net", UC_PTR "bench_database_with_a_longer_name", UC_PTR "../MY_MODB"
+};
+
+/*
+ * legacy_copy_string - copy a string the way `CreateDB::new_name` used to: one `reallocate_UC_ptr` per byte.
+ *  returns: the copy
+ *  on error: this function will error if there was a memory allocation error
+ * */
+unsigned char *legacy_copy_string(const unsigned char *src, uint64_t &allocations)
+{
+    unsigned char *dst = UC_PTR calloc(1, sizeof(*dst));
+    allocations++;
+
+    size_t index = 0;
+    while(src[index] != '\0')
+    {
+        dst[index] = src[index];
+        index++;
+
+        dst = reallocate_UC_ptr(dst, index + 1);
+        allocations++;
+    }
+    dst[index] = 0;
+
+    return dst;
+}
+
+/*
+ * legacy_append - grow `dst` with `reallocate_UC_ptr` and copy `size` bytes onto its end.
+ *  returns: nothing
+ *  on error: this function will error if there was a memory allocation error
+ * */
+void legacy_append(unsigned char *&dst, size_t &dst_size, const void *src, size_t size, uint64_t &allocations)
+{
+    dst = reallocate_UC_ptr(dst, dst_size + size);
+    allocations++;
+
+    memcpy(&dst[dst_size], src, size);
+    dst_size += size;
+}
+
+/*
+ * run_buffer_bench - build a `.modb` image of `entries` entries with per-byte `reallocate_UC_ptr` calls and with `ModbBuffer`.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+void run_buffer_bench(uint32_t entries)
+{
+    const unsigned char header[5] = {'U', 'N', 'I', 'X', 0};
+    const unsigned char port[5] = {'8', '0', '8', '0', 0};
+    const unsigned char tags[5] = {0xD1, 0xD2, 0xD3, 0xD4, 0xD5};
+    const unsigned char nul = 0;
+
+    /* How `CreateDB` built entries before `ModbBuffer`. */
+    uint64_t legacy_allocations = 0;
+    unsigned char *legacy_image = nullptr;
+    size_t legacy_size = 0;
+
+    double start = bench_now();
+    for(uint32_t i = 0; i < entries; i++)
+    {
+        unsigned char *ip = legacy_copy_string(bench_entry_fields[0], legacy_allocations);
+        unsigned char *host = legacy_copy_string(bench_entry_fields[1], legacy_allocations);
+        unsigned char *name = legacy_copy_string(bench_entry_fields[2], legacy_allocations);
+
+        unsigned char *entry = nullptr;
+        size_t entry_size = 0;
+        legacy_append(entry, entry_size, header, 5, legacy_allocations);
+        legacy_append(entry, entry_size, &tags[0], 1, legacy_allocations);
+        legacy_append(entry, entry_size, ip, strlen(NCC_PTR ip) + 1, legacy_allocations);
+        legacy_append(entry, entry_size, &tags[1], 1, legacy_allocations);
+        legacy_append(entry, entry_size, host, strlen(NCC_PTR host) + 1, legacy_allocations);
+        legacy_append(entry, entry_size, port, 5, legacy_allocations);
+        legacy_append(entry, entry_size, &tags[2], 1, legacy_allocations);
+        legacy_append(entry, entry_size, name, strlen(NCC_PTR name) + 1, legacy_allocations);
+        legacy_append(entry, entry_size, &tags[3], 1, legacy_allocations);
+        legacy_append(entry, entry_size, bench_entry_fields[3], strlen(NCC_PTR bench_entry_fields[3]), legacy_allocations);
+        legacy_append(entry, entry_size, &tags[4], 1, legacy_allocations);
+
+        legacy_append(legacy_image, legacy_size, entry, entry_size, legacy_allocations);
+
+        free(ip);
+        free(host);
+        free(name);
+        free(entry);
+    }
+    double legacy_took = bench_now() - start;
+    free(legacy_image);
+
+    /* How `CreateDB` builds entries now. */
+    uint64_t allocations_before = ModbBuffer::heap_allocations();
+    ModbBuffer image;
+
+    start = bench_now();
+    for(uint32_t i = 0; i < entries; i++)
+    {
+        ModbBuffer ip, host, name;
+        ip.append_cstr(bench_entry_fields[0]);
+        host.append_cstr(bench_entry_fields[1]);
+        name.append_cstr(bench_entry_fields[2]);
+
+        ModbBuffer entry;
+        entry.append(header, 5);
+        entry.push_back(tags[0]);
+        entry.append(ip.data(), ip.size());
+        entry.push_back(nul);
+        entry.push_back(tags[1]);
+        entry.append(host.data(), host.size());
+        entry.push_back(nul);
+        entry.append(port, 5);
+        entry.push_back(tags[2]);
+        entry.append(name.data(), name.size());
+        entry.push_back(nul);
+        entry.push_back(tags[3]);
+        entry.append_cstr(bench_entry_fields[3]);
+        entry.push_back(tags[4]);
+
+        image.append(entry.data(), entry.size());
+    }
+    double buffer_took = bench_now() - start;
+    uint64_t buffer_allocations = ModbBuffer::heap_allocations() - allocations_before;
+
+    bench_report("buffer/build_modb[reallocate_UC_ptr]", entries, legacy_took);
+    printf("    %llu allocator calls, %zu bytes\n", (unsigned long long) legacy_allocations, legacy_size);
+    bench_report("buffer/build_modb[ModbBuffer]", entries, buffer_took);
+    printf("    %llu allocator calls, %zu bytes\n", (unsigned long long) buffer_allocations, image.size());
+}
+
+#endif
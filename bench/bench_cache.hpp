@@ -0,0 +1,184 @@
+#ifndef bench_cache
+#define bench_cache
+
+/* Zipfian ranks over [0, count), as YCSB draws them (Gray et al., "Quickly generating billion-record synthetic
+ * databases"); rank 0 is the most popular. `scrambled` spreads the popular ranks over the whole range, so the hot
+ * entries are not all in the first pages of the file.
+ * */
+typedef struct BenchZipf
+{
+    uint64_t    count;
+    double      theta, alpha, zeta_n, eta;
+
+    BenchZipf(uint64_t items, double skew) : count(items), theta(skew)
+    {
+        zeta_n = 0;
+        for(uint64_t i = 1; i <= count; i++) zeta_n += 1.0 / pow((double) i, theta);
+
+        double zeta_2 = 1.0 + 1.0 / pow(2.0, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - pow(2.0 / count, 1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+    }
+
+    uint64_t next(uint64_t &seed)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        double u = (seed >> 11) * (1.0 / 9007199254740992.0);
+
+        double uz = u * zeta_n;
+        if(uz < 1.0) return 0;
+        if(uz < 1.0 + pow(0.5, theta)) return 1;
+
+        uint64_t rank = (uint64_t) (count * pow(eta * u - eta + 1.0, alpha));
+        return rank < count ? rank : count - 1;
+    }
+
+    uint64_t scrambled(uint64_t &seed) { return (next(seed) * 0x9E3779B97F4A7C15ull >> 16) % count; }
+} _BenchZipf;
+
+/*
+ * bench_cache_lookups - look up `lookups` names drawn by `pick` through `cache` on `threads` threads, each with its
+ *                       own `ModbPagedFileV2` over the shared cache.
+ *  returns: how many were found with the right name
+ *  on error: this function does not error
+ * */
+inline uint64_t bench_cache_lookups(ModbPageCache &cache, const std::vector<std::string> &names, uint32_t threads, uint64_t lookups,
+                                    std::function<uint64_t(uint64_t &)> pick)
+{
+    std::atomic<uint64_t> found{0};
+    std::vector<std::thread> workers;
+
+    for(uint32_t t = 0; t < threads; t++)
+        workers.emplace_back([&, t]() {
+            ModbPagedFileV2 file;
+            if(!file.open(cache)) return;
+
+            _ModbEntryView entry;
+            std::string storage;
+            uint64_t seed = 0x2545F4914F6CDD1Dull + t * 0x9E3779B97F4A7C15ull, mine = 0;
+
+            for(uint64_t i = t; i < lookups; i += threads)
+            {
+                const std::string &name = names[pick(seed)];
+                long index = file.find_entry(name);
+                mine += index >= 0 && file.entry(index, entry, storage) && entry.name == name;
+            }
+            found += mine;
+        });
+
+    for(std::thread &worker: workers) worker.join();
+    return found.load();
+}
+
+/*
+ * run_cache_bench - write a `file_megabytes` MiB modb binary file and read it through a page cache a tenth of its
+ *                   size: Zipfian (0.99) and uniform lookups by name on 1 and 4 threads, then connecting to Zipfian
+ *                   picked databases with one cache shared between the connects and with each connect's own.
+ *  returns: nothing
+ *  on error: this function will error if the file cannot be written
+ * */
+void run_cache_bench(const char *folder, uint32_t file_megabytes, uint64_t lookups, uint32_t connects)
+{
+    std::string path = std::string(folder) + "/modb_cache_bench.modb";
+    std::string wal = path + ".wal";
+    remove(wal.c_str());
+
+    /* About 250 bytes of file per database: its sections, directory row and name index buckets. */
+    uint32_t count = (uint32_t) ((uint64_t) file_megabytes * 1024 * 1024 / 250);
+    std::vector<std::string> names(count);
+    {
+        ModbWriterV2 writer;
+        std::string tenant_folder;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            names[i] = "database_" + std::to_string(i);
+            tenant_folder = std::string(folder) + "/tenants/" + std::to_string(i % 997) + "/" + names[i] + "/data/current/segments/primary";
+
+            _ModbEntryView entry;
+            entry.ip_address = "127.0.0.1";
+            entry.host = "bench_host.net";
+            entry.port = "8080";
+            entry.name = names[i];
+            entry.folder = tenant_folder;
+            writer.add_entry(entry);
+        }
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    struct stat info;
+    stat(path.c_str(), &info);
+    size_t capacity = (size_t) info.st_size / 10;
+    printf("    (%u databases, %.1f MiB file, %.1f MiB cache)\n", count, info.st_size / 1048576.0, capacity / 1048576.0);
+
+    _BenchZipf zipf(count, 0.99);
+    uint64_t failed = 0;
+    char name[96];
+
+    for(int skewed = 1; skewed >= 0; skewed--)
+        for(uint32_t threads: {1u, 4u})
+        {
+            ModbPageCache cache(capacity);
+            cache.refresh(path.c_str());
+
+            auto pick = [&zipf, skewed, count](uint64_t &seed) -> uint64_t {
+                if(skewed) return zipf.scrambled(seed);
+
+                seed ^= seed << 13;
+                seed ^= seed >> 7;
+                seed ^= seed << 17;
+                return seed % count;
+            };
+
+            /* Warm the cache up first, so the run measures the steady state. */
+            bench_cache_lookups(cache, names, 1, lookups / 4, pick);
+            _PageCacheStats warm = cache.stats();
+
+            double start = bench_now();
+            failed += lookups - bench_cache_lookups(cache, names, threads, lookups, pick);
+            double took = bench_now() - start;
+
+            _PageCacheStats stats = cache.stats();
+            uint64_t hits = stats.hits - warm.hits, misses = stats.misses - warm.misses;
+
+            snprintf(name, sizeof(name), "cache/lookup[%s, %u thread%s]", skewed ? "zipf 0.99" : "uniform", threads, threads > 1 ? "s" : "");
+            bench_report(name, lookups, took);
+            printf("    (%.1f%% of %llu page reads hit, %llu evictions, %llu read around the cache)\n", hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+                (unsigned long long) (hits + misses), (unsigned long long) (stats.evictions - warm.evictions), (unsigned long long) (stats.bypassed - warm.bypassed));
+        }
+
+    /* What `DatabaseConnect` reads of the file, one cache shared by every connect vs. a small one each. */
+    for(int shared = 1; shared >= 0; shared--)
+    {
+        ModbPageCache cache(capacity);
+        uint64_t seed = 0x9E3779B97F4A7C15ull, hits = 0, misses = 0;
+
+        double start;
+        {
+            _BenchQuiet quiet;
+            start = bench_now();
+            for(uint32_t i = 0; i < connects; i++)
+            {
+                DatabaseConnect connect(UC_PTR path.c_str(), UC_PTR names[zipf.scrambled(seed)].c_str(), shared ? &cache : nullptr);
+                if(connect.status() != modb_status::MODB_OK) failed++;
+
+                _PageCacheStats stats = connect.page_cache_stats();
+                if(!shared) { hits += stats.hits; misses += stats.misses; }
+            }
+        }
+        double took = bench_now() - start;
+
+        if(shared) { hits = cache.stats().hits; misses = cache.stats().misses; }
+
+        bench_report(shared ? "cache/connect[zipf 0.99, shared cache]" : "cache/connect[zipf 0.99, own cache]", connects, took);
+        printf("    (%.1f%% of %llu page reads hit)\n", hits + misses ? 100.0 * hits / (hits + misses) : 0.0, (unsigned long long) (hits + misses));
+    }
+
+    if(failed) printf("    (%llu lookups or connects failed)\n", (unsigned long long) failed);
+
+    bench_remove_database(path);
+}
+
+#endif
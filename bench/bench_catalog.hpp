@@ -0,0 +1,65 @@
+#ifndef bench_catalog
+#define bench_catalog
+
+/*
+ * run_catalog_bench - write a v2 modb binary file with `count` databases, then time looking each one up by name
+ *                     (name index vs. scanning the directory) and connecting to the last one by name.
+ *  returns: nothing
+ *  on error: this function will error if the file cannot be written
+ * */
+void run_catalog_bench(const char *folder, uint32_t count)
+{
+    std::string path = std::string(folder) + "/modb_catalog_bench.modb";
+    std::string wal = path + ".wal";
+    std::vector<std::string> names;
+
+    {
+        ModbWriterV2 writer;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            names.push_back("database_" + std::to_string(i));
+
+            _ModbEntryView entry;
+            entry.ip_address = "127.0.0.1";
+            entry.host = "bench_host.net";
+            entry.port = "8080";
+            entry.name = names.back();
+            entry.folder = folder;
+            writer.add_entry(entry);
+        }
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+    remove(wal.c_str());
+
+    ModbMapping file;
+    file.map_file(UC_PTR path.c_str());
+
+    ModbFileV2 catalog;
+    catalog.open(file.data(), file.size());
+
+    uint64_t found = 0;
+    double start = bench_now();
+    for(auto &name: names)
+        found += catalog.find_entry(name) >= 0;
+    bench_report("catalog/find_by_name[index]", found, bench_now() - start);
+
+    /* The same lookups done the way a v1 reader has to, capped so the run stays short. */
+    uint32_t scanned = count < 1000 ? count : 1000;
+    found = 0;
+    start = bench_now();
+    for(uint32_t i = 0; i < scanned; i++)
+        for(size_t index = 0; index < catalog.entry_count(); index++)
+            if(catalog.section(index, MODB_V2_SECTION_DB_NAME) == names[count - 1 - i]) { found++; break; }
+    bench_report("catalog/find_by_name[scan]", found, bench_now() - start);
+
+    start = bench_now();
+    {
+        DatabaseConnect connect(UC_PTR path.c_str(), UC_PTR names.back().c_str());
+    }
+    bench_report("catalog/connect_by_name", 1, bench_now() - start);
+
+    bench_remove_database(path);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef bench_client
+#define bench_client
+
+/*
+ * bench_client_latency - time `count` one-at-a-time SDWORD stores and reads through `client`, one histogram each.
+ *  returns: number of requests that failed
+ *  on error: this function does not error
+ * */
+inline uint32_t bench_client_latency(const char *name, _DatabaseClientSide &client, uint32_t count)
+{
+    _BenchHistogram stores, reads;
+    uint32_t failed = 0, value = 0;
+
+    for(uint32_t i = 0; i < count / 10; i++) client.read<PodSDWord>(i % 64, "value", value);
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if(client.store<PodSDWord>(i % 64, "value", i) != SS_RESPONSE_OK) failed++;
+        auto stored = std::chrono::steady_clock::now();
+        if(client.read<PodSDWord>(i % 64, "value", value) != SS_RESPONSE_OK || value != i) failed++;
+        auto read = std::chrono::steady_clock::now();
+
+        stores.record(std::chrono::duration_cast<std::chrono::nanoseconds>(stored - start).count());
+        reads.record(std::chrono::duration_cast<std::chrono::nanoseconds>(read - stored).count());
+    }
+
+    std::string label = std::string("client/store[") + name + "]";
+    bench_report_latency(label.c_str(), stores);
+    label = std::string("client/read[") + name + "]";
+    bench_report_latency(label.c_str(), reads);
+
+    return failed;
+}
+
+/*
+ * run_client_bench - against a server in this process, measure the latency of `count` requests made through
+ *                    `DatabaseClientSide` over shared memory, the Unix socket and TCP.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_client_bench(const char *folder, uint32_t count)
+{
+    std::string path = std::string(folder) + "/modb_client_bench.modb";
+    std::string wal = path + ".wal";
+    remove(wal.c_str());
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8194";
+        entry.name = "client_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    DatabaseConnect connect(UC_PTR path.c_str());
+    database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+    std::thread server([&connect]() { connect.SS_start(true); });
+
+    /* Filled in the way `DatabaseConnect` fills in the client-side of a `CLIENT_SIDE` program. A folder without
+     * the server's socket in it makes the client fall back to TCP.
+     * */
+    _DatabaseClientSide shm, unix_socket, tcp;
+    for(_DatabaseClientSide *client: {&shm, &unix_socket, &tcp})
+    {
+        client->CS_DB_IP_ADDR = "127.0.0.1";
+        client->CS_DB_NAME = "client_bench";
+        client->CS_MODB_FOLDER = client == &tcp ? "/nonexistent" : folder;
+        memcpy(client->CS_DB_PORT, "8194", 4);
+    }
+
+    modb_status reached = modb_status::MODB_NO_SERVER;
+    for(int tries = 0; tries < 500 && (reached = shm.connect(true)) != modb_status::MODB_OK; tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    database_assert(reached == modb_status::MODB_OK && unix_socket.connect(false) == modb_status::MODB_OK && tcp.connect(false) == modb_status::MODB_OK,
+        "\nCould not connect to the benchmark server.\n")
+    database_assert(shm.CS_TRANSPORT.is_shared_memory(), "\nThe benchmark server did not offer shared memory.\n")
+
+    for(uint32_t id = 0; id < 64; id++)
+    {
+        shm.create_entry(id);
+        shm.create_pod<PodSDWord>(id, "value");
+    }
+
+    uint32_t failed = bench_client_latency("shared memory", shm, count);
+    failed += bench_client_latency("unix", unix_socket, count);
+    failed += bench_client_latency("tcp", tcp, count);
+
+    connect.SS_stop();
+    server.join();
+
+    if(shm.server_state() != static_cast<unsigned char> (SS_STATUS::SS_CLOSED))
+        printf("    (client saw state 0x%X after the server closed)\n", shm.server_state());
+    if(failed) printf("    (%u requests failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef bench_codecs
+#define bench_codecs
+
+/*
+ * bench_codec_values - `count` elements of a stream of each kind the codecs are made for, as they go over the wire:
+ *                      DWORD timestamps about a microsecond apart, WORD readings that wander, and lines of a text log.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+inline void bench_codec_values(uint32_t count, std::vector<unsigned char> &dwords, std::vector<unsigned char> &words, std::vector<unsigned char> &bytes)
+{
+    uint32_t seed = 0x9E3779B9, timestamp = 1700000000;
+    uint16_t reading = 20000;
+
+    dwords.resize((size_t) count * 4);
+    words.resize((size_t) count * 2);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        timestamp += 1000 + (seed >> 27);
+        reading = (uint16_t) (reading + (int) (seed >> 28) - 8);
+
+        modb_put_u32(&dwords[(size_t) i * 4], timestamp);
+        modb_put_u16(&words[(size_t) i * 2], reading);
+    }
+
+    static const char *statuses[] = {"ok", "ok", "ok", "retry", "timeout"};
+    char line[96];
+    bytes.clear();
+    for(uint32_t i = 0; bytes.size() < (size_t) count * 4; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        int length = snprintf(line, sizeof(line), "request=%u entry=%u status=%s latency=%uus\n", i, seed >> 22, statuses[seed % 5], (seed >> 8) % 900);
+        bytes.insert(bytes.end(), line, line + length);
+    }
+    bytes.resize((size_t) count * 4);
+}
+
+/*
+ * bench_codec_round - time `passes` encodes and decodes of `value` with `codec`, checking the value comes back.
+ *  returns: true if it did else false
+ *  on error: this function does not error
+ * */
+inline bool bench_codec_round(const char *kind, unsigned char codec, unsigned char store_type, const std::vector<unsigned char> &value, uint32_t passes)
+{
+    std::vector<unsigned char> encoded, decoded;
+    double megabytes = value.size() / (1024.0 * 1024.0);
+    char name[96];
+
+    double start = bench_now();
+    for(uint32_t i = 0; i < passes; i++)
+    {
+        encoded.clear();
+        if(!pod_codec_encode(codec, store_type, value.data(), (uint32_t) value.size(), encoded)) return false;
+    }
+    double took = bench_now() - start;
+    snprintf(name, sizeof(name), "codecs/encode[%s %s, MiB]", pod_codec_table[codec].name, kind);
+    bench_report(name, (uint64_t) (megabytes * passes), took);
+
+    start = bench_now();
+    for(uint32_t i = 0; i < passes; i++)
+        if(pod_codec_decode(&encoded[1], (uint32_t) encoded.size() - 1, decoded) != store_type) return false;
+    took = bench_now() - start;
+    snprintf(name, sizeof(name), "codecs/decode[%s %s, MiB]", pod_codec_table[codec].name, kind);
+    bench_report(name, (uint64_t) (megabytes * passes), took);
+
+    printf("    (%s %s: %.2f MiB to %.2f MiB, %.2fx)\n", pod_codec_table[codec].name, kind, megabytes,
+        encoded.size() / (1024.0 * 1024.0), (double) value.size() / encoded.size());
+    return decoded == value;
+}
+
+/*
+ * run_codecs_bench - time each codec on `count` element streams of the kinds it is made for, then against a server in
+ *                    this process store `pods` streams of each kind with the codecs off and on, comparing the size of
+ *                    the write-ahead log before and after compacting it and the time to replay it, and checking the
+ *                    values after a restart.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_codecs_bench(const char *folder, uint32_t count, uint32_t passes, uint32_t pods)
+{
+    std::vector<unsigned char> dwords, words, bytes;
+    bench_codec_values(count, dwords, words, bytes);
+    uint32_t failed = 0;
+
+    if(!bench_codec_round("dword", POD_CODEC_DELTA_BITPACK, CS_STORING_DWORD_STREAM, dwords, passes)) failed++;
+    if(!bench_codec_round("word", POD_CODEC_DELTA_BITPACK, CS_STORING_WORD_STREAM, words, passes)) failed++;
+    if(!bench_codec_round("bytes", POD_CODEC_LZ, CS_STORING_BYTE_STREAM, bytes, passes)) failed++;
+
+    std::string path = std::string(folder) + "/modb_codecs_bench.modb";
+    std::string wal = path + ".wal";
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8200";
+        entry.name = "codecs_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    /* Each POD gets a 16 KiB slice of the streams above. */
+    const uint32_t elements = 4096;
+    std::vector<uint32_t> dword_value(elements);
+    std::vector<uint16_t> word_value(elements);
+    std::vector<uint8_t> byte_value(elements * 4);
+    auto slice = [&](uint32_t pod) {
+        uint32_t first = pod * 97 % (count - elements);
+        for(uint32_t i = 0; i < elements; i++)
+        {
+            dword_value[i] = modb_get_u32(&dwords[(size_t) (first + i) * 4]);
+            word_value[i] = modb_get_u16(&words[(size_t) (first + i) * 2]);
+        }
+        byte_value.assign(bytes.begin() + (size_t) first * 4, bytes.begin() + (size_t) (first + elements) * 4);
+    };
+
+    for(unsigned char codec: {(unsigned char) POD_CODEC_NONE, (unsigned char) POD_CODEC_AUTO})
+    {
+        const char *setting = codec == POD_CODEC_NONE ? "none" : "auto";
+        remove(wal.c_str());
+
+        auto start_server = [&](DatabaseConnect &connect, std::thread &server, _DatabaseClientSide &client) {
+            database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+            for(unsigned char type: {CS_CREATING_POD_WITH_TYPE_BYTE_STREAM, CS_CREATING_POD_WITH_TYPE_WORD_STREAM, CS_CREATING_POD_WITH_TYPE_DWORD_STREAM})
+                connect.SS_set_codec(type, codec);
+            server = std::thread([&connect]() { connect.SS_start(true); });
+
+            client.CS_DB_IP_ADDR = "127.0.0.1";
+            client.CS_DB_NAME = "codecs_bench";
+            client.CS_MODB_FOLDER = folder;
+            memcpy(client.CS_DB_PORT, "8200", 4);
+
+            modb_status reached = modb_status::MODB_NO_SERVER;
+            for(int tries = 0; tries < 500 && (reached = client.connect(true)) != modb_status::MODB_OK; tries++)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            database_assert(reached == modb_status::MODB_OK, "\nCould not connect to the benchmark server.\n")
+        };
+
+        uint64_t log_size = 0, compacted_size = 0;
+        {
+            DatabaseConnect connect(UC_PTR path.c_str());
+            std::thread server;
+            _DatabaseClientSide client;
+            start_server(connect, server, client);
+
+            char name[96];
+            double start = bench_now();
+            for(uint32_t id = 0; id < pods; id++)
+            {
+                slice(id);
+                if(client.create_entry(id) != SS_RESPONSE_OK ||
+                   client.create_pod<PodDWordStream>(id, "timestamps") != SS_RESPONSE_OK || client.store<PodDWordStream>(id, "timestamps", dword_value) != SS_RESPONSE_OK ||
+                   client.create_pod<PodWordStream>(id, "readings") != SS_RESPONSE_OK || client.store<PodWordStream>(id, "readings", word_value) != SS_RESPONSE_OK ||
+                   client.create_pod<PodByteStream>(id, "log") != SS_RESPONSE_OK || client.store<PodByteStream>(id, "log", byte_value) != SS_RESPONSE_OK) failed++;
+            }
+            snprintf(name, sizeof(name), "codecs/store[%s, 3 streams]", setting);
+            bench_report(name, pods, bench_now() - start);
+
+            /* The snapshot compaction writes encodes the values again; the replay below reads them from it. */
+            struct stat info;
+            log_size = stat(wal.c_str(), &info) == 0 ? (uint64_t) info.st_size : 0;
+
+            uint64_t runs = connect.SS_compaction_stats().runs;
+            connect.SS_compact();
+            for(int tries = 0; tries < 1000 && connect.SS_compaction_stats().runs == runs; tries++)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+            compacted_size = stat(wal.c_str(), &info) == 0 ? (uint64_t) info.st_size : 0;
+            connect.SS_stop();
+            server.join();
+        }
+
+        printf("    (codecs %s: write-ahead log of %.2f MiB for %.2f MiB of values, %.2f MiB once compacted)\n", setting,
+            log_size / (1024.0 * 1024.0), (double) pods * elements * 10 / (1024.0 * 1024.0), compacted_size / (1024.0 * 1024.0));
+
+        /* Replays (and decodes) the log, then checks what came back. */
+        {
+            _BenchQuiet quiet;
+            double start = bench_now();
+            DatabaseConnect connect(UC_PTR path.c_str());
+            double took = bench_now() - start;
+
+            std::thread server;
+            _DatabaseClientSide client;
+            start_server(connect, server, client);
+
+            std::vector<uint32_t> dwords_back;
+            std::vector<uint16_t> words_back;
+            std::vector<uint8_t> bytes_back;
+            for(uint32_t id = 0; id < pods; id++)
+            {
+                slice(id);
+                if(client.read<PodDWordStream>(id, "timestamps", dwords_back) != SS_RESPONSE_OK || dwords_back != dword_value ||
+                   client.read<PodWordStream>(id, "readings", words_back) != SS_RESPONSE_OK || words_back != word_value ||
+                   client.read<PodByteStream>(id, "log", bytes_back) != SS_RESPONSE_OK || bytes_back != byte_value) failed++;
+            }
+
+            connect.SS_stop();
+            server.join();
+
+            char name[96];
+            snprintf(name, sizeof(name), "codecs/replay[%s, 3 streams]", setting);
+            bench_report(name, pods, took);
+        }
+    }
+
+    if(failed) printf("    (%u checks failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
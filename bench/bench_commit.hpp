@@ -0,0 +1,120 @@
+#ifndef bench_commit
+#define bench_commit
+
+/*
+ * bench_commit_database - set up a `Database` like `bench_create_database` and commit it through `queue`, or with
+ *                         `commit_db` if there is none.
+ *  returns: the future of the commit (already ready for `commit_db`)
+ *  on error: this function does not error
+ * */
+inline std::future<modb_status> bench_commit_database(database_method method, const std::string &path, const std::string &name, ModbCommitQueue *queue)
+{
+    Database db(method, UC_PTR path.c_str());
+
+    db.set_new_db_name(UC_PTR name.c_str());
+    db.set_new_db_ip_addr(UC_PTR "127.0.0.1");
+    db.set_new_db_host(UC_PTR "bench_host.net");
+    db.set_new_db_port(UC_PTR "8080");
+    return queue ? db.commit_async(nullptr, queue) : modb_commit_ready(db.commit_db());
+}
+
+/*
+ * run_commit_bench - time `commits` durable commits each of a new `.modb` file and of a database appended to one
+ *                    file's write-ahead log: one at a time with `commit_db`, then all handed to `commit_async` at once,
+ *                    through io_uring and through the fallback threads; and check the appended databases replay.
+ *  returns: nothing
+ *  on error: this function will error if a file cannot be written
+ * */
+void run_commit_bench(const char *folder, uint32_t commits)
+{
+    std::string path = std::string(folder) + "/modb_commit_bench.modb";
+    std::string wal = path + ".wal";
+    uint32_t failed = 0;
+
+    auto new_file = [&folder](uint32_t i) { return std::string(folder) + "/modb_commit_bench_" + std::to_string(i) + ".modb"; };
+
+    /* `ring` and `threads` are the two ways the queue can run; without io_uring both use the threads. */
+    ModbCommitQueue ring(true), threads(false);
+    struct { const char *kind; ModbCommitQueue *queue; } ways[] = {
+        {"sync", nullptr},
+        {ring.using_ring() ? "async, io_uring" : "async, io_uring unavailable", &ring},
+        {"async, threads", &threads}
+    };
+
+    for(auto &way: ways)
+    {
+        char name[96];
+        _CommitQueueStats before = way.queue ? way.queue->stats() : _CommitQueueStats();
+
+        /* `database_method::DB_CREATE`: a file of its own for each commit. */
+        double start;
+        {
+            _BenchQuiet quiet;
+            std::vector<std::future<modb_status>> pending;
+            start = bench_now();
+            for(uint32_t i = 0; i < commits; i++)
+                pending.push_back(bench_commit_database(database_method::DB_CREATE, new_file(i), "bench_database", way.queue));
+            for(std::future<modb_status> &commit: pending)
+                if(commit.get() != modb_status::MODB_OK) failed++;
+        }
+        snprintf(name, sizeof(name), "commit/new file[%s]", way.kind);
+        bench_report(name, commits, bench_now() - start);
+
+        for(uint32_t i = 0; i < commits; i++)
+        {
+            struct stat info;
+            if(stat(new_file(i).c_str(), &info) != 0 || info.st_size == 0) failed++;
+            remove(new_file(i).c_str());
+        }
+
+        /* `database_method::DB_NEW`: every commit appends to the same write-ahead log. */
+        {
+            ModbWriterV2 writer;
+            _ModbEntryView entry;
+            entry.ip_address = "127.0.0.1";
+            entry.host = "bench_host.net";
+            entry.port = "8080";
+            entry.name = "database_0";
+            entry.folder = folder;
+            writer.add_entry(entry);
+
+            remove(wal.c_str());
+            database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+        }
+        {
+            _BenchQuiet quiet;
+            std::vector<std::future<modb_status>> pending;
+            start = bench_now();
+            for(uint32_t i = 0; i < commits; i++)
+                pending.push_back(bench_commit_database(database_method::DB_NEW, path, "appended_" + std::to_string(i), way.queue));
+            for(std::future<modb_status> &commit: pending)
+                if(commit.get() != modb_status::MODB_OK) failed++;
+        }
+        snprintf(name, sizeof(name), "commit/log append[%s]", way.kind);
+        bench_report(name, commits, bench_now() - start);
+
+        if(way.queue)
+        {
+            _CommitQueueStats stats = way.queue->stats();
+            uint64_t batches = stats.batches - before.batches;
+            printf("    (%llu commits in %llu batches, %llu syncs)\n", (unsigned long long) (stats.commits - before.commits),
+                (unsigned long long) batches, (unsigned long long) (stats.syncs - before.syncs));
+        }
+
+        /* Every appended database comes back from the log. */
+        {
+            _BenchQuiet quiet;
+            for(uint32_t i = 0; i < commits; i += commits > 10 ? commits / 10 : 1)
+            {
+                DatabaseConnect connect(UC_PTR path.c_str(), UC_PTR ("appended_" + std::to_string(i)).c_str());
+                if(connect.status() != modb_status::MODB_OK) failed++;
+            }
+        }
+    }
+
+    if(failed) printf("    (%u commits or checks failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef bench_compaction
+#define bench_compaction
+
+/*
+ * bench_compaction_blob - the BYTE_STREAM value entry `entry_id` holds after `round`.
+ *  returns: the value
+ *  on error: this function does not error
+ * */
+inline std::vector<unsigned char> bench_compaction_blob(uint32_t entry_id, uint32_t round)
+{
+    std::vector<unsigned char> blob(64);
+    for(size_t i = 0; i < blob.size(); i++) blob[i] = (unsigned char) (entry_id * 31 + round * 7 + i);
+    return blob;
+}
+
+/*
+ * run_compaction_bench - against a server in this process that compacts once its log is `min_log_size` bytes and
+ *                        half garbage, time `rounds` of stores over `entries` entries (a SDWORD and a 64 byte stream each,
+ *                        every 8th entry deleted and made again), then restart it and check every value came back.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_compaction_bench(const char *folder, uint32_t entries, uint32_t rounds, uint64_t min_log_size)
+{
+    std::string path = std::string(folder) + "/modb_compaction_bench.modb";
+    std::string wal = path + ".wal";
+    remove(wal.c_str());
+    remove((wal + NCC_PTR wal_compact_extension).c_str());
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8195";
+        entry.name = "compaction_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    auto start_server = [&](DatabaseConnect &connect, std::thread &server, _DatabaseClientSide &client) {
+        database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+        connect.SS_set_compaction(min_log_size, 0.5);
+        server = std::thread([&connect]() { connect.SS_start(true); });
+
+        client.CS_DB_IP_ADDR = "127.0.0.1";
+        client.CS_DB_NAME = "compaction_bench";
+        client.CS_MODB_FOLDER = folder;
+        memcpy(client.CS_DB_PORT, "8195", 4);
+
+        modb_status reached = modb_status::MODB_NO_SERVER;
+        for(int tries = 0; tries < 500 && (reached = client.connect(true)) != modb_status::MODB_OK; tries++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        database_assert(reached == modb_status::MODB_OK, "\nCould not connect to the benchmark server.\n")
+    };
+
+    /* Round the values of each entry were last stored in. */
+    std::vector<uint32_t> stored(entries, 0);
+    uint32_t failed = 0;
+    _CompactionStats stats;
+
+    {
+        DatabaseConnect connect(UC_PTR path.c_str());
+        std::thread server;
+        _DatabaseClientSide client;
+        start_server(connect, server, client);
+
+        for(uint32_t id = 0; id < entries; id++)
+            if(client.create_entry(id) != SS_RESPONSE_OK || client.create_pod<PodSDWord>(id, "value") != SS_RESPONSE_OK ||
+               client.create_pod<PodByteStream>(id, "blob") != SS_RESPONSE_OK) failed++;
+
+        _BenchHistogram latency;
+        double start = bench_now();
+        for(uint32_t round = 1; round <= rounds; round++)
+        {
+            for(uint32_t id = 0; id < entries; id++)
+            {
+                auto before = std::chrono::steady_clock::now();
+
+                if(id % 8 == round % 8)
+                {
+                    if(client.delete_entry(id) != SS_RESPONSE_OK || client.create_entry(id) != SS_RESPONSE_OK ||
+                       client.create_pod<PodSDWord>(id, "value") != SS_RESPONSE_OK || client.create_pod<PodByteStream>(id, "blob") != SS_RESPONSE_OK)
+                        failed++;
+                }
+
+                if(client.store<PodSDWord>(id, "value", id ^ round) != SS_RESPONSE_OK ||
+                   client.store<PodByteStream>(id, "blob", bench_compaction_blob(id, round)) != SS_RESPONSE_OK)
+                    failed++;
+                stored[id] = round;
+
+                latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count());
+            }
+        }
+        double took = bench_now() - start;
+
+        bench_report("compaction/churn", latency.total, took);
+        bench_report_latency("compaction/churn_latency", latency);
+
+        /* Whatever is left since the last automatic run. */
+        uint64_t runs = connect.SS_compaction_stats().runs;
+        connect.SS_compact();
+        for(int tries = 0; tries < 1000 && connect.SS_compaction_stats().runs == runs; tries++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        stats = connect.SS_compaction_stats();
+        connect.SS_stop();
+        server.join();
+    }
+
+    printf("    (%llu compactions, %llu failed, %.1f MiB reclaimed, %.3f ms per compaction, last one %.3f ms at %.0f%% garbage)\n",
+           (unsigned long long) stats.runs, (unsigned long long) stats.failed_runs, stats.bytes_reclaimed / 1048576.0,
+           stats.runs ? stats.total_duration_ms / stats.runs : 0.0, stats.last_duration_ms, stats.last_garbage_ratio * 100);
+
+    struct stat log_info;
+    if(stat(wal.c_str(), &log_info) == 0) printf("    (%.1f KiB left in the write-ahead log)\n", log_info.st_size / 1024.0);
+
+    /* Everything has to come back from the compacted log. */
+    {
+        double start = bench_now();
+        DatabaseConnect connect(UC_PTR path.c_str());
+        bench_report("compaction/replay", entries, bench_now() - start);
+
+        std::thread server;
+        _DatabaseClientSide client;
+        start_server(connect, server, client);
+
+        uint32_t wrong = 0, value = 0;
+        std::vector<unsigned char> blob;
+        for(uint32_t id = 0; id < entries; id++)
+        {
+            if(client.read<PodSDWord>(id, "value", value) != SS_RESPONSE_OK || value != (id ^ stored[id])) wrong++;
+            else if(client.read<PodByteStream>(id, "blob", blob) != SS_RESPONSE_OK || blob != bench_compaction_blob(id, stored[id])) wrong++;
+        }
+
+        connect.SS_stop();
+        server.join();
+
+        if(wrong) printf("    (%u entries did not come back as stored)\n", wrong);
+    }
+
+    if(failed) printf("    (%u requests failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef bench_connect
+#define bench_connect
+
+/*
+ * write_modb_file - write a v1 modb binary file of roughly `target_size` bytes made of repeated entries.
+ *  returns: number of entries written
+ *  on error: this function will error if the file cannot be written
+ * */
+size_t write_modb_file(const char *path, const char *folder, size_t target_size)
+{
+    std::vector<unsigned char> entry = {'U', 'N', 'I', 'X', 0, static_cast<unsigned char> (modb_sections::MODB_IP_ADDRESS)};
+    const char *fields[] = {"127.0.0.1", "bench_host.net", "8080", "bench_database"};
+
+    entry.insert(entry.end(), fields[0], fields[0] + strlen(fields[0]) + 1);
+    entry.push_back(static_cast<unsigned char> (modb_sections::MODB_PORT_AND_HOST));
+    entry.insert(entry.end(), fields[1], fields[1] + strlen(fields[1]) + 1);
+    entry.insert(entry.end(), fields[2], fields[2] + strlen(fields[2]) + 1);
+    entry.push_back(static_cast<unsigned char> (modb_sections::MODB_DB_NAME));
+    entry.insert(entry.end(), fields[3], fields[3] + strlen(fields[3]) + 1);
+    entry.push_back(static_cast<unsigned char> (modb_sections::MODB_PATH));
+    entry.insert(entry.end(), folder, folder + strlen(folder));
+    entry.push_back(static_cast<unsigned char> (modb_sections::MODB_END));
+
+    /* Write in large chunks so generating the 1 GB file does not dominate the run. */
+    std::vector<unsigned char> chunk;
+    while(chunk.size() + entry.size() <= (1 << 20) && chunk.size() < target_size)
+        chunk.insert(chunk.end(), entry.begin(), entry.end());
+
+    FILE *file = fopen(path, "wb");
+    database_assert(file, "\nCould not create %s.\n", path)
+
+    size_t written = 0;
+    while(written < target_size)
+    {
+        size_t part = chunk.size();
+        if(written + part > target_size) part = ((target_size - written + entry.size() - 1) / entry.size()) * entry.size();
+
+        fwrite(chunk.data(), sizeof(unsigned char), part, file);
+        written += part;
+    }
+    fclose(file);
+
+    return written / entry.size();
+}
+
+/*
+ * run_connect_bench - for modb binary files of each size in `sizes`, time a v1 scan, `DatabaseConnect` startup
+ *                     on the v1 file, the migration to v2 and startup on the migrated file.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+void run_connect_bench(const char *folder, std::vector<size_t> sizes)
+{
+    std::string path = std::string(folder) + "/modb_bench.modb";
+    std::string wal = path + ".wal";
+
+    for(size_t size: sizes)
+    {
+        remove(wal.c_str());
+        size_t entries = write_modb_file(path.c_str(), folder, size);
+        char name[64];
+
+        double start = bench_now();
+        {
+            ModbMapping v1_file;
+            v1_file.map_file(UC_PTR path.c_str());
+
+            _ModbEntryView entry;
+            size_t at = 0;
+            while(at + bytes_to_skip < v1_file.size())
+                at = modb_parse_entry(v1_file.data(), v1_file.size(), at + bytes_to_skip, entry);
+        }
+        snprintf(name, sizeof(name), "connect/v1_scan[%zu KB]", size / 1024);
+        bench_report(name, entries, bench_now() - start);
+
+        start = bench_now();
+        {
+            DatabaseConnect connect(UC_PTR path.c_str());
+        }
+        snprintf(name, sizeof(name), "connect/startup_v1[%zu KB]", size / 1024);
+        bench_report(name, entries, bench_now() - start);
+
+        start = bench_now();
+        modb_migrate_to_v2(UC_PTR path.c_str());
+        snprintf(name, sizeof(name), "connect/migrate_v2[%zu KB]", size / 1024);
+        bench_report(name, entries, bench_now() - start);
+
+        start = bench_now();
+        {
+            DatabaseConnect connect(UC_PTR path.c_str());
+        }
+        snprintf(name, sizeof(name), "connect/startup_v2[%zu KB]", size / 1024);
+        bench_report(name, entries, bench_now() - start);
+    }
+
+    bench_remove_database(path);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef bench_create
+#define bench_create
+
+/* Keeps `std::cout` quiet while it lives; `CreateDB` and `DatabaseConnect` announce every commit and connection. */
+typedef struct BenchQuiet
+{
+    std::streambuf *kept = std::cout.rdbuf(nullptr);
+
+    ~BenchQuiet()
+    {
+        std::cout.rdbuf(kept);
+        std::cout.clear();
+    }
+} _BenchQuiet;
+
+/*
+ * bench_create_database - set up a `Database` the way a program would and commit it.
+ *  returns: the `modb_status` of the commit
+ *  on error: this function does not error
+ * */
+inline modb_status bench_create_database(database_method method, const std::string &path, const std::string &name)
+{
+    Database db(method, UC_PTR path.c_str());
+
+    db.set_new_db_name(UC_PTR name.c_str());
+    db.set_new_db_ip_addr(UC_PTR "127.0.0.1");
+    db.set_new_db_host(UC_PTR "bench_host.net");
+    db.set_new_db_port(UC_PTR "8080");
+    return db.commit_db();
+}
+
+/*
+ * run_create_bench - time `commits` commits of a new `.modb` file, then for each size in `entry_counts` `commits`
+ *                    commits of one more database into a file that already holds that many, and connecting to it afterwards.
+ *  returns: nothing
+ *  on error: this function will error if a file cannot be written
+ * */
+void run_create_bench(const char *folder, uint32_t commits, std::vector<uint32_t> entry_counts)
+{
+    std::string path = std::string(folder) + "/modb_create_bench.modb";
+    std::string wal = path + ".wal";
+    uint32_t failed = 0;
+
+    /* `database_method::DB_CREATE`: the whole file is written each time. */
+    {
+        double start;
+        {
+            _BenchQuiet quiet;
+            start = bench_now();
+            for(uint32_t i = 0; i < commits; i++)
+                if(bench_create_database(database_method::DB_CREATE, path, "bench_database") != modb_status::MODB_OK) failed++;
+        }
+        bench_report("create/commit[new file]", commits, bench_now() - start);
+    }
+
+    /* `database_method::DB_NEW`: each database is appended to the write-ahead log, however many the file already holds. */
+    for(uint32_t count: entry_counts)
+    {
+        remove(wal.c_str());
+        {
+            ModbWriterV2 writer;
+            for(uint32_t i = 0; i < count; i++)
+            {
+                std::string name = "database_" + std::to_string(i);
+
+                _ModbEntryView entry;
+                entry.ip_address = "127.0.0.1";
+                entry.host = "bench_host.net";
+                entry.port = "8080";
+                entry.name = name;
+                entry.folder = folder;
+                writer.add_entry(entry);
+            }
+
+            database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+        }
+
+        char name[96];
+        double start;
+        {
+            _BenchQuiet quiet;
+            start = bench_now();
+            for(uint32_t i = 0; i < commits; i++)
+                if(bench_create_database(database_method::DB_NEW, path, "appended_" + std::to_string(i)) != modb_status::MODB_OK) failed++;
+        }
+        snprintf(name, sizeof(name), "create/commit[onto %u entries]", count);
+        bench_report(name, commits, bench_now() - start);
+
+        /* Parses the file and replays the databases just committed. */
+        {
+            _BenchQuiet quiet;
+            start = bench_now();
+            DatabaseConnect connect(UC_PTR path.c_str(), UC_PTR "database_0");
+            if(connect.status() != modb_status::MODB_OK) failed++;
+        }
+        snprintf(name, sizeof(name), "create/connect[%u + %u entries]", count, commits);
+        bench_report(name, 1, bench_now() - start);
+    }
+
+    if(failed) printf("    (%u commits or connections failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
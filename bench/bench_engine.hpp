@@ -0,0 +1,109 @@
+#ifndef bench_engine
+#define bench_engine
+
+/*
+ * engine_payload - build a `CS_REQUEST_*` payload: [4: entry ID][1: name length][name][extra].
+ *  returns: the payload
+ *  on error: this function does not error
+ * */
+inline std::vector<unsigned char> engine_payload(uint32_t entry_id, const char *name, std::vector<unsigned char> extra)
+{
+    std::vector<unsigned char> payload(4);
+    modb_put_u32(payload.data(), entry_id);
+
+    if(name)
+    {
+        payload.push_back((unsigned char) strlen(name));
+        payload.insert(payload.end(), name, name + strlen(name));
+    }
+    payload.insert(payload.end(), extra.begin(), extra.end());
+
+    return payload;
+}
+
+/*
+ * bench_engine_op - time `count` requests of one opcode, with `make` producing the payload for entry `i`.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+template<typename Make>
+void bench_engine_op(StorageEngine &engine, const char *name, unsigned char opcode, uint32_t count, Make make)
+{
+    std::vector<std::vector<unsigned char>> payloads(count);
+    for(uint32_t i = 0; i < count; i++) payloads[i] = make(i);
+
+    std::vector<unsigned char> response;
+    uint32_t failed = 0;
+
+    double start = bench_now();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        response.clear();
+        if(engine.perform(opcode, payloads[i].data(), payloads[i].size(), response) != SS_RESPONSE_OK) failed++;
+    }
+    double took = bench_now() - start;
+
+    bench_report(name, count, took);
+    if(failed) printf("    (%u requests failed)\n", failed);
+}
+
+/*
+ * run_engine_bench - ops/sec for every `CS_REQUEST_*` opcode the storage engine handles.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+void run_engine_bench(uint32_t count)
+{
+    StorageEngine engine;
+    std::vector<unsigned char> stream(64, 0x5A);
+
+    bench_engine_op(engine, "engine/create_new_db_entry", CS_REQUEST_CREATE_NEW_DB_ENTRY, count,
+        [](uint32_t i) { return engine_payload(i, nullptr, {}); });
+
+    bench_engine_op(engine, "engine/create_new_pod", CS_REQUEST_CREATE_NEW_POD, count,
+        [](uint32_t i) {
+            std::vector<unsigned char> payload = engine_payload(i, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5});
+            payload.insert(payload.end(), {'c', 'o', 'u', 'n', 't'});
+            return payload;
+        });
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        engine.create_pod(i, CS_CREATING_POD_WITH_TYPE_SBYTE, UC_PTR "flag", 4);
+        engine.create_pod(i, CS_CREATING_POD_WITH_TYPE_SWORD, UC_PTR "word", 4);
+        engine.create_pod(i, CS_CREATING_POD_WITH_TYPE_BYTE_STREAM, UC_PTR "blob", 4);
+        engine.create_pod(i, CS_CREATING_POD_WITH_TYPE_WORD_STREAM, UC_PTR "words", 5);
+        engine.create_pod(i, CS_CREATING_POD_WITH_TYPE_DWORD_STREAM, UC_PTR "dwords", 6);
+    }
+
+    bench_engine_op(engine, "engine/store_sbyte", CS_REQUEST_TO_STORE_IN, count,
+        [](uint32_t i) { return engine_payload(i, "flag", {CS_STORING_SBYTE, (unsigned char) i}); });
+    bench_engine_op(engine, "engine/store_sword", CS_REQUEST_TO_STORE_IN, count,
+        [](uint32_t i) { return engine_payload(i, "word", {CS_STORING_SWORD, 1, 2}); });
+    bench_engine_op(engine, "engine/store_sdword", CS_REQUEST_TO_STORE_IN, count,
+        [](uint32_t i) { return engine_payload(i, "count", {CS_STORING_SDWORD, 1, 2, 3, 4}); });
+
+    std::vector<unsigned char> byte_stream = {CS_STORING_BYTE_STREAM};
+    byte_stream.insert(byte_stream.end(), stream.begin(), stream.end());
+    bench_engine_op(engine, "engine/store_byte_stream[64B]", CS_REQUEST_TO_STORE_IN, count,
+        [&](uint32_t i) { return engine_payload(i, "blob", byte_stream); });
+
+    byte_stream[0] = CS_STORING_WORD_STREAM;
+    bench_engine_op(engine, "engine/store_word_stream[32]", CS_REQUEST_TO_STORE_IN, count,
+        [&](uint32_t i) { return engine_payload(i, "words", byte_stream); });
+
+    byte_stream[0] = CS_STORING_DWORD_STREAM;
+    bench_engine_op(engine, "engine/store_dword_stream[16]", CS_REQUEST_TO_STORE_IN, count,
+        [&](uint32_t i) { return engine_payload(i, "dwords", byte_stream); });
+
+    bench_engine_op(engine, "engine/read_pod", CS_REQUEST_READ_POD, count,
+        [](uint32_t i) { return engine_payload(i, "count", {}); });
+
+    bench_engine_op(engine, "engine/delete_pod", CS_REQUEST_DELETE_POD, count,
+        [](uint32_t i) { return engine_payload(i, "count", {}); });
+
+    bench_engine_op(engine, "engine/delete_db_entry", CS_REQUEST_DELETE_DB_ENTRY, count,
+        [](uint32_t i) { return engine_payload(i, nullptr, {}); });
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef bench_faults
+#define bench_faults
+
+/* Requests a server gets wrong on purpose; every one of them must be answered with an error, none may be `SS_RESPONSE_OK`. */
+#define BENCH_FAULT_KINDS   9
+
+/*
+ * bench_fault_request - build the `kind`th kind of bad request (see `BENCH_FAULT_KINDS`) aimed at entry `entry_id`.
+ *  returns: the opcode, `payload` is set to its payload
+ *  on error: this function does not error
+ * */
+inline unsigned char bench_fault_request(uint32_t kind, uint32_t entry_id, std::vector<unsigned char> &payload)
+{
+    switch(kind)
+    {
+        /* Opcode the server does not know. */
+        case 0: payload = engine_payload(entry_id, nullptr, {}); return 0x42;
+        /* Shorter than an entry ID. */
+        case 1: payload = {1, 2}; return CS_REQUEST_TO_STORE_IN;
+        /* Name length runs past the end of the payload. */
+        case 2: payload = engine_payload(entry_id, nullptr, {200, 'v'}); return CS_REQUEST_READ_POD;
+        /* SWORD stored into the SDWORD POD. */
+        case 3: payload = engine_payload(entry_id, "value", {CS_STORING_SWORD, 1, 2}); return CS_REQUEST_TO_STORE_IN;
+        /* Entry that does not exist. */
+        case 4: payload = engine_payload(entry_id + 1000000, "value", {}); return CS_REQUEST_READ_POD;
+        /* POD that does not exist. */
+        case 5: payload = engine_payload(entry_id, "missing", {}); return CS_REQUEST_DELETE_POD;
+        /* POD type that does not exist. */
+        case 6: payload = engine_payload(entry_id, nullptr, {0x00, 1, 'x'}); return CS_REQUEST_CREATE_NEW_POD;
+        /* Batch whose sub-request runs past the end of the batch. */
+        case 7: payload = {1, 0, 0, 0, CS_REQUEST_READ_POD, 0xFF, 0xFF, 0, 0}; return CS_REQUEST_BATCH;
+        /* Query on a POD that is not a WORD/DWORD stream. */
+        default: payload = engine_payload(entry_id, "value", {CS_QUERY_SUM}); return CS_REQUEST_QUERY_POD;
+    }
+}
+
+/*
+ * bench_fault_raw_frame - connect and send `size` raw bytes of `frame`, then hang up.
+ *  returns: true if the bytes were sent else false
+ *  on error: this function does not error
+ * */
+inline bool bench_fault_raw_frame(const char *port, const unsigned char *frame, size_t size)
+{
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) atoi(port));
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) return false;
+
+    bool sent = connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0 && send(fd, frame, size, MSG_NOSIGNAL) == (ssize_t) size;
+    close(fd);
+
+    return sent;
+}
+
+/*
+ * run_faults_bench - check that setup mistakes come back as a `modb_status`, then drive `faults` bad requests (and a few
+ *                    broken connections) at a server in this process and compare its throughput on `count` good
+ *                    requests before, alongside and after them.
+ *  returns: true if every setup mistake was reported, every bad request answered with an error and every good
+ *           request answered `SS_RESPONSE_OK`, else false (tests/faults.cpp fails on it)
+ *  on error: this function will error if the server cannot be set up
+ * */
+bool run_faults_bench(const char *folder, uint32_t faults, uint32_t count)
+{
+    std::string path = std::string(folder) + "/modb_faults_bench.modb";
+    std::string wal = path + ".wal";
+    remove(wal.c_str());
+
+    /* Setup mistakes; each used to end the process. */
+    uint32_t reported = 0, checked = 0;
+    {
+        std::string missing = std::string(folder) + "/modb_faults_missing.modb";
+        DatabaseConnect connect(UC_PTR missing.c_str());
+        reported += connect.status() == modb_status::MODB_FILE_NOT_FOUND; checked++;
+        reported += connect.SS_start(true) == modb_status::MODB_NOT_READY; checked++;
+
+        Database new_entry(database_method::DB_NEW, UC_PTR missing.c_str());
+        reported += new_entry.status() == modb_status::MODB_FILE_NOT_FOUND; checked++;
+        reported += new_entry.commit_db() == modb_status::MODB_FILE_NOT_FOUND; checked++;
+
+        Database no_folder(database_method::DB_CREATE, UC_PTR "modb_faults.modb");
+        reported += no_folder.status() == modb_status::MODB_INVALID_ARGUMENT; checked++;
+
+        Database bad_port(database_method::DB_CREATE, UC_PTR path.c_str());
+        reported += bad_port.set_new_db_port(UC_PTR "80a0") == modb_status::MODB_INVALID_ARGUMENT; checked++;
+        reported += bad_port.commit_db() == modb_status::MODB_INVALID_ARGUMENT; checked++;
+    }
+    printf("faults/setup: %u of %u setup mistakes reported as a status\n", reported, checked);
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8197";
+        entry.name = "faults_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    DatabaseConnect connect(UC_PTR path.c_str());
+    database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+    std::thread server([&connect]() { connect.SS_start(true); });
+
+    TransportClient client, faulty;
+    for(int tries = 0; !client.connect_tcp("127.0.0.1", "8197") && tries < 500; tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    database_assert(client.is_connected() && faulty.connect_tcp("127.0.0.1", "8197"), "\nCould not connect to the benchmark server.\n")
+
+    /* 64 entries, each with a SDWORD POD; good requests alternate between storing into and reading it. */
+    std::vector<unsigned char> result;
+    for(uint32_t id = 0; id < 64; id++)
+    {
+        std::vector<unsigned char> pod = engine_payload(id, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+        client.request(CS_REQUEST_CREATE_NEW_DB_ENTRY, engine_payload(id, nullptr, {}).data(), 4, result);
+        client.request(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), result);
+    }
+
+    std::vector<std::vector<unsigned char>> good(count);
+    std::vector<unsigned char> good_opcodes(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        good[i] = i % 2 ? engine_payload(i % 64, "value", {}) : bench_batch_store_payload(i % 64, i);
+        good_opcodes[i] = i % 2 ? CS_REQUEST_READ_POD : CS_REQUEST_TO_STORE_IN;
+    }
+
+    const uint32_t window = 10000;
+    std::vector<std::vector<unsigned char>> bad(window);
+    std::vector<unsigned char> bad_opcodes(window);
+    for(uint32_t i = 0; i < window; i++) bad_opcodes[i] = bench_fault_request(i % BENCH_FAULT_KINDS, i % 64, bad[i]);
+
+    uint32_t failed = 0, accepted = 0, lost = 0;
+    unsigned char response;
+
+    auto run_good = [&](const char *name) {
+        double start = bench_now();
+        for(uint32_t i = 0; i < count; i++)
+            client.send_request(good_opcodes[i], good[i].data(), good[i].size());
+        for(uint32_t i = 0; i < count; i++)
+            if(!client.read_response(response, result) || response != SS_RESPONSE_OK) failed++;
+        bench_report(name, count, bench_now() - start);
+    };
+
+    /* Bad requests go out in windows on their own connection; `good_every` good requests ride along on the other. */
+    auto run_bad = [&](const char *name, uint32_t good_every) {
+        uint32_t good_sent = 0;
+        double start = bench_now();
+        for(uint32_t sent = 0; sent < faults; sent += window)
+        {
+            uint32_t size = faults - sent < window ? faults - sent : window;
+            uint32_t good_size = 0;
+
+            for(uint32_t i = 0; i < size; i++)
+            {
+                faulty.send_request(bad_opcodes[i], bad[i].data(), bad[i].size());
+                if(good_every && i % good_every == 0)
+                {
+                    uint32_t at = good_sent++ % count;
+                    client.send_request(good_opcodes[at], good[at].data(), good[at].size());
+                    good_size++;
+                }
+            }
+
+            for(uint32_t i = 0; i < size; i++)
+            {
+                if(!faulty.read_response(response, result)) { lost++; continue; }
+                if(response == SS_RESPONSE_OK) accepted++;
+            }
+            for(uint32_t i = 0; i < good_size; i++)
+                if(!client.read_response(response, result) || response != SS_RESPONSE_OK) failed++;
+        }
+        bench_report(name, faults, bench_now() - start);
+        if(good_every) printf("    (%u good requests answered alongside)\n", good_sent);
+    };
+
+    run_good("faults/good_requests[before]");
+
+    run_bad("faults/bad_requests", 0);
+    run_bad("faults/bad_requests[1 good per 10 bad]", 10);
+
+    /* Frames the transport must drop the connection for: too large, and cut off by the client hanging up. */
+    unsigned char too_large[SS_FRAME_HEADER_SIZE];
+    modb_put_u32(too_large, SS_FRAME_MAX_PAYLOAD + 1);
+    too_large[4] = CS_REQUEST_READ_POD;
+
+    unsigned char cut_off[SS_FRAME_HEADER_SIZE + 2] = {100, 0, 0, 0, CS_REQUEST_TO_STORE_IN, 1, 2};
+
+    uint32_t broken = 0;
+    for(uint32_t i = 0; i < 100; i++)
+    {
+        broken += bench_fault_raw_frame("8197", too_large, sizeof(too_large));
+        broken += bench_fault_raw_frame("8197", cut_off, sizeof(cut_off));
+    }
+    printf("faults/broken_connections: %u\n", broken);
+
+    /* The server still answers a new connection after all of that. */
+    TransportClient after;
+    bool answering = after.connect_tcp("127.0.0.1", "8197") && after.request(good_opcodes[1], good[1].data(), good[1].size(), result) == SS_RESPONSE_OK;
+    if(!answering) printf("    (the server stopped answering new connections)\n");
+
+    run_good("faults/good_requests[after]");
+
+    if(accepted) printf("    (%u bad requests were answered with SS_RESPONSE_OK)\n", accepted);
+    if(lost) printf("    (%u bad requests got no answer)\n", lost);
+    if(failed) printf("    (%u good requests failed)\n", failed);
+
+    connect.SS_stop();
+    server.join();
+
+    bench_remove_database(path);
+
+    return reported == checked && accepted == 0 && lost == 0 && failed == 0 && answering;
+}
+
+#endif
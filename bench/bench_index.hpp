@@ -0,0 +1,113 @@
+#ifndef bench_index
+#define bench_index
+
+/*
+ * bench_index_payload - build the payload of a `CS_REQUEST_LOOKUP_POD` on `name` for `low` through `high`.
+ *  returns: the payload
+ *  on error: this function does not error
+ * */
+inline std::vector<unsigned char> bench_index_payload(const char *name, uint32_t low, uint32_t high)
+{
+    std::vector<unsigned char> payload(1, (unsigned char) strlen(name));
+    payload.insert(payload.end(), name, name + strlen(name));
+    payload.push_back(low == high ? CS_QUERY_FILTER_EQUAL : CS_QUERY_FILTER_RANGE);
+
+    size_t at = payload.size();
+    payload.resize(at + (low == high ? 4 : 8));
+    modb_put_u32(&payload[at], low);
+    if(low != high) modb_put_u32(&payload[at + 4], high);
+
+    return payload;
+}
+
+/*
+ * run_index_bench - over `entries` entries with a SDWORD POD each, time `scans` equality and range lookups going over
+ *                   every entry, then `lookups` through a hash and a sorted index, and what keeping an index costs a store.
+ *  returns: nothing
+ *  on error: this function does not error; lookups that disagree with the scan are reported
+ * */
+void run_index_bench(uint32_t entries, uint32_t scans, uint32_t lookups)
+{
+    /* Every value is held by 10 entries, whichever round of stores put it there; range lookups cover 100 values. */
+    const uint32_t values = entries / 10 ? entries / 10 : 1;
+    const uint32_t range = 100;
+
+    WorkerPool pool;
+    std::vector<unsigned char> payload, response;
+    std::vector<unsigned char> pod = engine_payload(0, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+
+    for(uint32_t id = 0; id < entries; id++)
+    {
+        payload = engine_payload(id, nullptr, {});
+        pool.perform(CS_REQUEST_CREATE_NEW_DB_ENTRY, payload.data(), 4, response);
+
+        modb_put_u32(pod.data(), id);
+        pool.perform(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), response);
+    }
+
+    uint32_t round = 0;
+    auto run_stores = [&](const char *name) {
+        double start = bench_now();
+        for(uint32_t id = 0; id < entries; id++)
+        {
+            payload = bench_batch_store_payload(id, (uint32_t) (((uint64_t) id * 7919 + round) % values));
+            pool.perform(CS_REQUEST_TO_STORE_IN, payload.data(), payload.size(), response);
+        }
+        bench_report(name, entries, bench_now() - start);
+        round++;
+    };
+
+    /* Matches per lookup `i`, as found by the scans; the indexes must find the same. */
+    std::vector<uint32_t> expected(2 * scans, 0);
+    uint32_t mismatched = 0;
+
+    auto run_lookups = [&](const char *name, uint32_t count, bool ranges, bool record) {
+        uint64_t found = 0;
+        double start = bench_now();
+        for(uint32_t i = 0; i < count; i++)
+        {
+            uint32_t low = (uint32_t) ((uint64_t) (i % scans) * 104729 % values);
+            payload = bench_index_payload("value", low, ranges ? low + range - 1 : low);
+
+            response.clear();
+            if(pool.perform(CS_REQUEST_LOOKUP_POD, payload.data(), payload.size(), response) != SS_RESPONSE_OK) { mismatched++; continue; }
+
+            uint32_t matches = modb_get_u32(response.data());
+            uint32_t &want = expected[i % scans + (ranges ? scans : 0)];
+            if(record) want = matches;
+            else if(want != matches) mismatched++;
+
+            found += matches;
+        }
+        bench_report(name, count, bench_now() - start);
+        printf("    (%.1f entries found per lookup)\n", (double) found / count);
+    };
+
+    auto change_index = [&](const char *name, unsigned char opcode, unsigned char kind) {
+        payload = {kind, 5, 'v', 'a', 'l', 'u', 'e'};
+        if(opcode == CS_REQUEST_DROP_INDEX) payload.erase(payload.begin());
+
+        double start = bench_now();
+        if(pool.perform(opcode, payload.data(), payload.size(), response) != SS_RESPONSE_OK) mismatched++;
+        bench_report(name, entries, bench_now() - start);
+    };
+
+    run_stores("index/store[no index]");
+
+    run_lookups("index/lookup_equal[scan]", scans, false, true);
+    run_lookups("index/lookup_range[scan]", scans, true, true);
+
+    change_index("index/create[hash]", CS_REQUEST_CREATE_INDEX, CS_INDEX_HASH);
+    run_lookups("index/lookup_equal[hash]", lookups, false, false);
+    run_stores("index/store[hash]");
+    change_index("index/drop[hash]", CS_REQUEST_DROP_INDEX, 0);
+
+    change_index("index/create[sorted]", CS_REQUEST_CREATE_INDEX, CS_INDEX_SORTED);
+    run_lookups("index/lookup_equal[sorted]", lookups, false, false);
+    run_lookups("index/lookup_range[sorted]", lookups, true, false);
+    run_stores("index/store[sorted]");
+
+    if(mismatched) printf("    (%u lookups disagreed with the scan)\n", mismatched);
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef bench_kernels
+#define bench_kernels
+
+/*
+ * bench_kernel - time `rounds` runs of `kernel` over a stream of `size` values and report values/sec.
+ *  returns: whatever the last run returned, for checking against the other kernel levels
+ *  on error: this function does not error
+ * */
+template<typename Kernel>
+uint64_t bench_kernel(const char *level, const char *kernel_name, size_t size, uint32_t rounds, Kernel kernel)
+{
+    uint64_t result = 0;
+
+    double start = bench_now();
+    for(uint32_t i = 0; i < rounds; i++) result = kernel();
+    double took = bench_now() - start;
+
+    char name[64];
+    snprintf(name, sizeof(name), "kernels/%s[%s]", kernel_name, level);
+    bench_report(name, (uint64_t) size * rounds, took);
+
+    return result;
+}
+
+/*
+ * run_kernels_bench - time every stream kernel at every level this CPU supports over `size` WORD and DWORD values,
+ *                     then a `CS_REQUEST_QUERY_POD` through the storage engine.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+void run_kernels_bench(size_t size, uint32_t rounds)
+{
+    std::vector<uint16_t> words(size);
+    std::vector<uint32_t> dwords(size);
+    std::vector<uint32_t> matches(size);
+    std::vector<uint16_t> swapped_words(size);
+    std::vector<uint32_t> swapped_dwords(size);
+
+    uint32_t seed = 0x12345678;
+    for(size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        words[i] = (uint16_t) (seed >> 16);
+        dwords[i] = seed;
+    }
+
+    /* Roughly 1% of the values fall in each filter range. */
+    const uint16_t word_low = 1000, word_high = 1000 + 655;
+    const uint32_t dword_low = 1u << 30, dword_high = (1u << 30) + 42949672;
+
+    uint64_t expected[8] = {0};
+
+    for(int level = STREAM_KERNELS_SCALAR; level <= STREAM_KERNELS_AVX2; level++)
+    {
+        if(!stream_kernels_supported(level)) continue;
+
+        const _StreamKernels &k = stream_kernels_for(level);
+        uint64_t results[8];
+
+        results[0] = bench_kernel(k.name, "sum_u16", size, rounds, [&]() { return k.sum_u16(words.data(), size); });
+        results[1] = bench_kernel(k.name, "sum_u32", size, rounds, [&]() { return k.sum_u32(dwords.data(), size); });
+        results[2] = bench_kernel(k.name, "min_max_u16", size, rounds, [&]() {
+            uint16_t min = words[0], max = words[0];
+            k.min_max_u16(words.data(), size, min, max);
+            return ((uint64_t) min << 32) | max;
+        });
+        results[3] = bench_kernel(k.name, "min_max_u32", size, rounds, [&]() {
+            uint32_t min = dwords[0], max = dwords[0];
+            k.min_max_u32(dwords.data(), size, min, max);
+            return ((uint64_t) min << 32) | max;
+        });
+        results[4] = bench_kernel(k.name, "filter_range_u16", size, rounds, [&]() {
+            return (uint64_t) k.filter_range_u16(words.data(), size, word_low, word_high, matches.data());
+        });
+        results[5] = bench_kernel(k.name, "filter_range_u32", size, rounds, [&]() {
+            return (uint64_t) k.filter_range_u32(dwords.data(), size, dword_low, dword_high, matches.data());
+        });
+        results[6] = bench_kernel(k.name, "bswap_u16", size, rounds, [&]() {
+            k.bswap_u16(words.data(), size, swapped_words.data());
+            return (uint64_t) swapped_words[size - 1];
+        });
+        results[7] = bench_kernel(k.name, "bswap_u32", size, rounds, [&]() {
+            k.bswap_u32(dwords.data(), size, swapped_dwords.data());
+            return (uint64_t) swapped_dwords[size - 1];
+        });
+
+        if(level == STREAM_KERNELS_SCALAR) memcpy(expected, results, sizeof(expected));
+        else if(memcmp(expected, results, sizeof(expected)) != 0)
+            printf("    (%s results differ from the scalar kernels)\n", k.name);
+    }
+
+    /* The same sum, but asked for through the storage engine. */
+    StorageEngine engine;
+    std::vector<unsigned char> response;
+    engine.perform(CS_REQUEST_CREATE_NEW_DB_ENTRY, engine_payload(0, nullptr, {}).data(), 4, response);
+
+    std::vector<unsigned char> pod = engine_payload(0, nullptr, {CS_CREATING_POD_WITH_TYPE_DWORD_STREAM, 6, 's', 't', 'r', 'e', 'a', 'm'});
+    engine.perform(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), response);
+
+    std::vector<unsigned char> store = engine_payload(0, "stream", {CS_STORING_DWORD_STREAM});
+    size_t at = store.size();
+    store.resize(at + size * 4);
+    for(size_t i = 0; i < size; i++) modb_put_u32(&store[at + i * 4], dwords[i]);
+    engine.perform(CS_REQUEST_TO_STORE_IN, store.data(), store.size(), response);
+
+    std::vector<unsigned char> query = engine_payload(0, "stream", {CS_QUERY_SUM});
+    bench_kernel(stream_kernels_best().name, "engine_query_sum_u32", size, rounds, [&]() {
+        response.clear();
+        engine.perform(CS_REQUEST_QUERY_POD, query.data(), query.size(), response);
+        return (uint64_t) response.size();
+    });
+}
+
+#endif
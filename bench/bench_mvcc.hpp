@@ -0,0 +1,125 @@
+#ifndef bench_mvcc
+#define bench_mvcc
+
+/*
+ * run_mvcc_bench - over `entries` entries with a SDWORD POD each, time `reads` reads of the published versions
+ *                  from another thread with the workers idle, then while they are kept busy with stores; and for
+ *                  comparison, how long a read queued on the workers behind those stores takes.
+ *  returns: nothing
+ *  on error: this function does not error; reads that fail or see a value that was never stored are reported
+ * */
+void run_mvcc_bench(uint32_t entries, uint32_t reads)
+{
+    WorkerPool pool;
+    std::vector<unsigned char> payload, response;
+
+    /* Every value stored into entry `id` has `id` in its high half. */
+    for(uint32_t id = 0; id < entries; id++)
+    {
+        payload = engine_payload(id, nullptr, {});
+        pool.perform(CS_REQUEST_CREATE_NEW_DB_ENTRY, payload.data(), 4, response);
+
+        payload = engine_payload(id, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+        pool.perform(CS_REQUEST_CREATE_NEW_POD, payload.data(), payload.size(), response);
+
+        payload = engine_payload(id, "value", {CS_STORING_SDWORD, 0, 0, (unsigned char) id, (unsigned char) (id >> 8)});
+        pool.perform(CS_REQUEST_TO_STORE_IN, payload.data(), payload.size(), response);
+    }
+
+    pool.start(0);
+
+    std::atomic<uint32_t> wrong{0};
+    auto run_reads = [&](_BenchHistogram &latency) {
+        std::vector<unsigned char> read_payload, read_response;
+        for(uint32_t i = 0; i < reads; i++)
+        {
+            uint32_t id = (uint32_t) (((uint64_t) i * 2654435761u) % entries);
+            read_payload = engine_payload(id, "value", {});
+            read_response.clear();
+
+            auto before = std::chrono::steady_clock::now();
+            unsigned char result = pool.read(read_payload.data(), (uint32_t) read_payload.size(), read_response);
+            latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count());
+
+            if(result != SS_RESPONSE_OK || read_response.size() != 5 || (modb_get_u32(&read_response[1]) >> 16) != (id & 0xFFFF)) wrong++;
+        }
+    };
+
+    {
+        _BenchHistogram latency;
+        double start = bench_now();
+        std::thread reader([&]() { run_reads(latency); });
+        reader.join();
+
+        bench_report("mvcc/read[no stores]", reads, bench_now() - start);
+        bench_report_latency("mvcc/read_latency[no stores]", latency);
+    }
+
+    /* Stores keep every worker's queue about half full until the readers are done; every 64th request is a read
+     * queued behind them, timed from when it was submitted to when it came back.
+     * */
+    std::atomic<bool> reading{true};
+    _BenchHistogram latency, queued_latency;
+    uint64_t stores = 0;
+    uint32_t in_flight = 0, sequence = 0;
+    std::unordered_map<_WorkerRequest *, std::chrono::steady_clock::time_point> queued_reads;
+
+    auto on_finished = [&](_WorkerRequest *request) {
+        auto queued = queued_reads.find(request);
+        if(queued != queued_reads.end())
+        {
+            queued_latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - queued->second).count());
+            queued_reads.erase(queued);
+        }
+        else if(request->result == SS_RESPONSE_OK) stores++;
+
+        in_flight--;
+        pool.recycle(request);
+    };
+
+    double start = bench_now();
+    std::thread reader([&]() { run_reads(latency); reading.store(false); });
+
+    uint32_t in_flight_limit = (uint32_t) pool.worker_count() * WORKER_POOL_QUEUE_SIZE / 2;
+    while(reading.load(std::memory_order_relaxed))
+    {
+        while(in_flight < in_flight_limit)
+        {
+            _WorkerRequest *request = pool.acquire();
+            uint32_t id = (uint32_t) (((uint64_t) sequence * 40503u) % entries);
+
+            if(++sequence % 64 == 0)
+            {
+                request->opcode = CS_REQUEST_READ_POD;
+                request->payload = engine_payload(id, "value", {});
+                queued_reads[request] = std::chrono::steady_clock::now();
+            }
+            else
+            {
+                request->opcode = CS_REQUEST_TO_STORE_IN;
+                request->payload = engine_payload(id, "value", {CS_STORING_SDWORD, (unsigned char) sequence, (unsigned char) (sequence >> 8),
+                                                                (unsigned char) id, (unsigned char) (id >> 8)});
+            }
+
+            if(!pool.submit(request)) { queued_reads.erase(request); pool.recycle(request); break; }
+            in_flight++;
+        }
+
+        if(pool.drain(on_finished) == 0) std::this_thread::yield();
+    }
+    double took = bench_now() - start;
+    reader.join();
+
+    while(in_flight > 0)
+        if(pool.drain(on_finished) == 0) std::this_thread::yield();
+    pool.stop();
+
+    bench_report("mvcc/read[under stores]", reads, took);
+    bench_report_latency("mvcc/read_latency[under stores]", latency);
+    bench_report("mvcc/store[with readers]", stores, took);
+    bench_report_latency("mvcc/queued_read_latency[under stores]", queued_latency);
+
+    if(wrong) printf("    (%u reads failed or saw a value never stored)\n", wrong.load());
+}
+
+#endif
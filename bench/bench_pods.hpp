@@ -0,0 +1,190 @@
+#ifndef bench_pods
+#define bench_pods
+
+/* The column store/read the storage engine used before `pod_types.hpp`: a switch on the type, then a per-element
+ * size check, kept here only to compare against the `PodColumns` handler tables. */
+typedef struct LegacyPodColumns
+{
+    std::vector<uint8_t>                sbyte_column;
+    std::vector<std::vector<uint8_t>>   byte_stream_column;
+    std::vector<uint16_t>               sword_column;
+    std::vector<std::vector<uint16_t>>  word_stream_column;
+    std::vector<uint32_t>               sdword_column;
+    std::vector<std::vector<uint32_t>>  dword_stream_column;
+} _LegacyPodColumns;
+
+static const unsigned char legacy_pod_element_size[POD_COLUMN_COUNT] = {1, 1, 2, 2, 4, 4};
+#define legacy_pod_is_stream(column)    ((column) & 1)
+
+unsigned char legacy_pod_store(_LegacyPodColumns &c, _PodSlot pod, const unsigned char *value, uint32_t value_size)
+{
+    unsigned char element_size = legacy_pod_element_size[pod.column];
+    if(legacy_pod_is_stream(pod.column) ? (value_size % element_size != 0) : (value_size != element_size))
+        return SS_RESPONSE_BAD_REQUEST;
+
+    uint32_t count = value_size / element_size;
+
+    switch(pod.column)
+    {
+        case POD_COLUMN_SBYTE: c.sbyte_column[pod.slot] = value[0]; break;
+        case POD_COLUMN_SWORD: c.sword_column[pod.slot] = modb_get_u16(value); break;
+        case POD_COLUMN_SDWORD: c.sdword_column[pod.slot] = modb_get_u32(value); break;
+        case POD_COLUMN_BYTE_STREAM: c.byte_stream_column[pod.slot].assign(value, value + value_size); break;
+        case POD_COLUMN_WORD_STREAM: {
+            std::vector<uint16_t> &stream = c.word_stream_column[pod.slot];
+            stream.resize(count);
+            for(uint32_t i = 0; i < count; i++) stream[i] = modb_get_u16(&value[i * 2]);
+            break;
+        }
+        default: {
+            std::vector<uint32_t> &stream = c.dword_stream_column[pod.slot];
+            stream.resize(count);
+            for(uint32_t i = 0; i < count; i++) stream[i] = modb_get_u32(&value[i * 4]);
+            break;
+        }
+    }
+
+    return SS_RESPONSE_OK;
+}
+
+void legacy_pod_read(_LegacyPodColumns &c, _PodSlot pod, std::vector<unsigned char> &response)
+{
+    response.push_back(CS_STORING_SBYTE + pod.column);
+    size_t at = response.size();
+
+    switch(pod.column)
+    {
+        case POD_COLUMN_SBYTE: response.push_back(c.sbyte_column[pod.slot]); break;
+        case POD_COLUMN_SWORD: response.resize(at + 2); modb_put_u16(&response[at], c.sword_column[pod.slot]); break;
+        case POD_COLUMN_SDWORD: response.resize(at + 4); modb_put_u32(&response[at], c.sdword_column[pod.slot]); break;
+        case POD_COLUMN_BYTE_STREAM: {
+            std::vector<uint8_t> &stream = c.byte_stream_column[pod.slot];
+            response.insert(response.end(), stream.begin(), stream.end());
+            break;
+        }
+        case POD_COLUMN_WORD_STREAM: {
+            std::vector<uint16_t> &stream = c.word_stream_column[pod.slot];
+            response.resize(at + stream.size() * 2);
+            for(size_t i = 0; i < stream.size(); i++) modb_put_u16(&response[at + i * 2], stream[i]);
+            break;
+        }
+        default: {
+            std::vector<uint32_t> &stream = c.dword_stream_column[pod.slot];
+            response.resize(at + stream.size() * 4);
+            for(size_t i = 0; i < stream.size(); i++) modb_put_u32(&response[at + i * 4], stream[i]);
+            break;
+        }
+    }
+}
+
+/*
+ * run_pods_bench - time `count` stores and reads over a random mix of every POD type, dispatched by the old switches
+ *                  and by the `PodColumns` handler tables, then the same mix through `StorageEngine::perform`.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+void run_pods_bench(uint32_t count)
+{
+    const uint32_t slots = 1024;
+
+    /* One POD per slot per type; every request picks a random one, so the branch predictor cannot learn the type. */
+    _LegacyPodColumns legacy;
+    legacy.sbyte_column.resize(slots);
+    legacy.byte_stream_column.resize(slots);
+    legacy.sword_column.resize(slots);
+    legacy.word_stream_column.resize(slots);
+    legacy.sdword_column.resize(slots);
+    legacy.dword_stream_column.resize(slots);
+
+    PodColumns columns;
+    for(unsigned char column = 0; column < POD_COLUMN_COUNT; column++)
+        for(uint32_t i = 0; i < slots; i++) columns.allocate(column);
+
+    /* Single values are one element, streams are 8 elements. */
+    std::vector<_PodSlot> pods(count);
+    std::vector<uint32_t> sizes(count);
+    std::vector<unsigned char> value(32);
+    for(size_t i = 0; i < value.size(); i++) value[i] = (unsigned char) (i * 7);
+
+    uint32_t seed = 0x9E3779B9;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        pods[i].column = (seed >> 16) % POD_COLUMN_COUNT;
+        pods[i].slot = (seed >> 4) % slots;
+        sizes[i] = legacy_pod_element_size[pods[i].column] * (legacy_pod_is_stream(pods[i].column) ? 8 : 1);
+    }
+
+    std::vector<unsigned char> response;
+    response.reserve(64);
+    uint64_t legacy_bytes = 0, table_bytes = 0;
+
+    double start = bench_now();
+    for(uint32_t i = 0; i < count; i++) legacy_pod_store(legacy, pods[i], value.data(), sizes[i]);
+    bench_report("pods/store[switch]", count, bench_now() - start);
+
+    start = bench_now();
+    for(uint32_t i = 0; i < count; i++) columns.store(pods[i], value.data(), sizes[i]);
+    bench_report("pods/store[table]", count, bench_now() - start);
+
+    start = bench_now();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        response.clear();
+        legacy_pod_read(legacy, pods[i], response);
+        legacy_bytes += response.size() + response.back();
+    }
+    bench_report("pods/read[switch]", count, bench_now() - start);
+
+    start = bench_now();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        response.clear();
+        columns.read(pods[i], response);
+        table_bytes += response.size() + response.back();
+    }
+    bench_report("pods/read[table]", count, bench_now() - start);
+
+    if(legacy_bytes != table_bytes) printf("    (switch and table reads differ)\n");
+
+    /* The same mix as whole requests: one entry with a POD of every type. */
+    StorageEngine engine;
+    const char *names[POD_COLUMN_COUNT] = {"sbyte", "byte_stream", "sword", "word_stream", "sdword", "dword_stream"};
+    engine.perform(CS_REQUEST_CREATE_NEW_DB_ENTRY, engine_payload(0, nullptr, {}).data(), 4, response);
+
+    std::vector<std::vector<unsigned char>> stores(POD_COLUMN_COUNT), reads(POD_COLUMN_COUNT);
+    for(unsigned char column = 0; column < POD_COLUMN_COUNT; column++)
+    {
+        std::vector<unsigned char> pod = engine_payload(0, nullptr, {(unsigned char) (CS_CREATING_POD_WITH_TYPE_SBYTE + column), (unsigned char) strlen(names[column])});
+        pod.insert(pod.end(), names[column], names[column] + strlen(names[column]));
+        engine.perform(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), response);
+
+        uint32_t size = legacy_pod_element_size[column] * (legacy_pod_is_stream(column) ? 8 : 1);
+        stores[column] = engine_payload(0, names[column], {(unsigned char) (CS_STORING_SBYTE + column)});
+        stores[column].insert(stores[column].end(), value.begin(), value.begin() + size);
+        reads[column] = engine_payload(0, names[column], {});
+    }
+
+    uint32_t failed = 0;
+    start = bench_now();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        std::vector<unsigned char> &store = stores[pods[i].column];
+        response.clear();
+        if(engine.perform(CS_REQUEST_TO_STORE_IN, store.data(), store.size(), response) != SS_RESPONSE_OK) failed++;
+    }
+    bench_report("pods/engine_store[mixed types]", count, bench_now() - start);
+
+    start = bench_now();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        std::vector<unsigned char> &read = reads[pods[i].column];
+        response.clear();
+        if(engine.perform(CS_REQUEST_READ_POD, read.data(), read.size(), response) != SS_RESPONSE_OK) failed++;
+    }
+    bench_report("pods/engine_read[mixed types]", count, bench_now() - start);
+
+    if(failed) printf("    (%u requests failed)\n", failed);
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef bench_sessions
+#define bench_sessions
+
+/*
+ * run_sessions_bench - time `count` one-at-a-time reads against a server in this process over TCP, the Unix socket,
+ *                      and a shared-memory session, then check the session is told the server closed.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_sessions_bench(const char *folder, uint32_t count)
+{
+    std::string path = std::string(folder) + "/modb_sessions_bench.modb";
+    std::string wal = path + ".wal";
+    std::string socket_path = std::string(folder) + NCC_PTR unix_socket_name;
+    remove(wal.c_str());
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8196";
+        entry.name = "sessions_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    DatabaseConnect connect(UC_PTR path.c_str());
+    database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+    std::thread server([&connect]() { connect.SS_start(true); });
+
+    TransportClient tcp, unix_socket, shm;
+    for(int tries = 0; !tcp.connect_tcp("127.0.0.1", "8196") && tries < 500; tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    database_assert(tcp.is_connected() && unix_socket.connect_unix(socket_path.c_str()) && shm.connect_unix(socket_path.c_str()),
+        "\nCould not connect to the benchmark server.\n")
+    database_assert(shm.open_session(true), "\nCould not open a shared-memory session.\n")
+
+    std::vector<unsigned char> result;
+    std::vector<unsigned char> pod = engine_payload(0, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+    tcp.request(CS_REQUEST_CREATE_NEW_DB_ENTRY, engine_payload(0, nullptr, {}).data(), 4, result);
+    tcp.request(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), result);
+
+    std::vector<unsigned char> read = engine_payload(0, "value", {});
+    uint32_t failed = 0;
+
+    /* Round trips one at a time, so each one is the latency of a single request. */
+    auto run_round = [&](const char *name, TransportClient &client, unsigned char opcode, const std::vector<unsigned char> &payload) {
+        for(uint32_t i = 0; i < count / 10; i++) client.request(opcode, payload.data(), payload.size(), result);
+
+        double start = bench_now();
+        for(uint32_t i = 0; i < count; i++)
+            if(client.request(opcode, payload.data(), payload.size(), result) != SS_RESPONSE_OK) failed++;
+        double took = bench_now() - start;
+
+        bench_report(name, count, took);
+        printf("    (%.3f us per round trip)\n", took * 1e6 / count);
+    };
+
+    /* Answered on the event loop, then handed to a worker. */
+    run_round("sessions/status[tcp]", tcp, CS_REQUEST_SERVER_STATUS, {});
+    run_round("sessions/status[unix]", unix_socket, CS_REQUEST_SERVER_STATUS, {});
+    run_round("sessions/status[shared memory]", shm, CS_REQUEST_SERVER_STATUS, {});
+
+    run_round("sessions/read_pod[tcp]", tcp, CS_REQUEST_READ_POD, read);
+    run_round("sessions/read_pod[unix]", unix_socket, CS_REQUEST_READ_POD, read);
+    run_round("sessions/read_pod[shared memory]", shm, CS_REQUEST_READ_POD, read);
+
+    /* The state is carried in the session; no status file is read. */
+    if(shm.server_state() != static_cast<unsigned char> (SS_STATUS::SS_LISTENING))
+        printf("    (session reports state 0x%X while listening)\n", shm.server_state());
+
+    connect.SS_stop();
+    server.join();
+
+    if(shm.server_state() != static_cast<unsigned char> (SS_STATUS::SS_CLOSED))
+        printf("    (session reports state 0x%X after the server closed)\n", shm.server_state());
+    if(failed) printf("    (%u requests failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef bench_stats
+#define bench_stats
+
+/*
+ * run_stats_bench - time what recording a request costs on its own, then `count` one-at-a-time reads over a
+ *                   shared-memory session and stores over the Unix socket against a server in this process, with stats
+ *                   off and on (`rounds` times each, best taken), and dump the stats of the last run to a file.
+ *  returns: nothing
+ *  on error: this function will error if the server cannot be set up
+ * */
+void run_stats_bench(const char *folder, uint32_t count, uint32_t rounds)
+{
+    /* What the event loop adds to a request read off one ring and answered in place: its counters, and every sampled
+     * time the clock and a histogram for the request, for reading it and for publishing its response.
+     * */
+    double record_ns;
+    {
+        _ModbThreadStats thread_stats;
+        uint32_t ticks[3] = {0}, records = count * 100;
+
+        double start = bench_now();
+        for(uint32_t i = 0; i < records; i++)
+        {
+            uint64_t reading = modb_stats_sampled(ticks[0]) ? modb_stats_now() : 0;
+            thread_stats.count_read(SS_FRAME_HEADER_SIZE + 9);
+            if(reading) thread_stats.phases[MODB_PHASE_READING].record(modb_stats_now() - reading);
+
+            uint64_t arrived = modb_stats_sampled(ticks[1]) ? modb_stats_now() : 0;
+            thread_stats.count_request(CS_REQUEST_READ_POD, true);
+            if(arrived)
+            {
+                uint64_t took = modb_stats_now() - arrived;
+                thread_stats.phases[MODB_PHASE_PERFORMING].record(took);
+                thread_stats.service[modb_stats_opcode_slot(CS_REQUEST_READ_POD)].record(took);
+                thread_stats.latency[modb_stats_opcode_slot(CS_REQUEST_READ_POD)].record(took);
+            }
+
+            uint64_t publishing = modb_stats_sampled(ticks[2]) ? modb_stats_now() : 0;
+            thread_stats.count_written(SS_FRAME_HEADER_SIZE + 5);
+            if(publishing) thread_stats.phases[MODB_PHASE_PUBLISHING].record(modb_stats_now() - publishing);
+        }
+        double took = bench_now() - start;
+
+        record_ns = took * 1e9 / records;
+        bench_report("stats/record", records, took);
+        printf("    (%.2f ns per request)\n", record_ns);
+    }
+
+    std::string path = std::string(folder) + "/modb_stats_bench.modb";
+    std::string wal = path + ".wal";
+    std::string socket_path = std::string(folder) + NCC_PTR unix_socket_name;
+    std::string dump_path = std::string(folder) + "/modb_stats_bench.txt";
+
+    {
+        ModbWriterV2 writer;
+        _ModbEntryView entry;
+        entry.ip_address = "127.0.0.1";
+        entry.host = "bench_host.net";
+        entry.port = "8197";
+        entry.name = "stats_bench";
+        entry.folder = folder;
+        writer.add_entry(entry);
+
+        database_assert(writer.write_file(UC_PTR path.c_str()), "\nCould not create %s.\n", path.c_str())
+    }
+
+    std::vector<unsigned char> result;
+    std::vector<unsigned char> read = engine_payload(0, "value", {});
+    std::vector<unsigned char> store = engine_payload(0, "value", {CS_STORING_SDWORD, 1, 2, 3, 4});
+    std::vector<unsigned char> pod = engine_payload(0, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+    uint32_t failed = 0;
+
+    /* Seconds per read and per store of the best round, for each setting. */
+    double best_read[2] = {1e9, 1e9}, best_store[2] = {1e9, 1e9};
+
+    for(uint32_t round = 0; round < rounds * 2; round++)
+    {
+        bool recording = round % 2 == 1;
+        remove(wal.c_str());
+
+        DatabaseConnect connect(UC_PTR path.c_str());
+        database_assert(connect.status() == modb_status::MODB_OK, "\nCould not connect to %s.\n", path.c_str())
+        connect.SS_set_stats(recording);
+        std::thread server([&connect]() { connect.SS_start(true); });
+
+        TransportClient unix_socket, shm;
+        for(int tries = 0; !unix_socket.connect_unix(socket_path.c_str()) && tries < 500; tries++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        database_assert(unix_socket.is_connected() && shm.connect_unix(socket_path.c_str()) && shm.open_session(true),
+            "\nCould not connect to the benchmark server.\n")
+
+        unix_socket.request(CS_REQUEST_CREATE_NEW_DB_ENTRY, engine_payload(0, nullptr, {}).data(), 4, result);
+        unix_socket.request(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), result);
+
+        auto run_requests = [&](TransportClient &client, unsigned char opcode, const std::vector<unsigned char> &payload, uint32_t times) {
+            for(uint32_t i = 0; i < times / 10; i++) client.request(opcode, payload.data(), payload.size(), result);
+
+            double start = bench_now();
+            for(uint32_t i = 0; i < times; i++)
+                if(client.request(opcode, payload.data(), payload.size(), result) != SS_RESPONSE_OK) failed++;
+            return (bench_now() - start) / times;
+        };
+
+        best_read[recording] = std::min(best_read[recording], run_requests(shm, CS_REQUEST_READ_POD, read, count));
+        best_store[recording] = std::min(best_store[recording], run_requests(unix_socket, CS_REQUEST_TO_STORE_IN, store, count / 10));
+
+        /* The last round records; its stats are what gets shown. */
+        if(round == rounds * 2 - 1)
+        {
+            if(unix_socket.request(CS_REQUEST_SERVER_STATS, nullptr, 0, result) != SS_RESPONSE_OK || result.empty()) failed++;
+            if(!connect.SS_dump_stats(dump_path.c_str())) printf("    (could not write %s)\n", dump_path.c_str());
+        }
+
+        connect.SS_stop();
+        server.join();
+    }
+
+    bench_report("stats/read_pod[shared memory, off]", count, best_read[0] * count);
+    bench_report("stats/read_pod[shared memory, on]", count, best_read[1] * count);
+    printf("    (%.3f us -> %.3f us per round trip, %+.2f%%)\n", best_read[0] * 1e6, best_read[1] * 1e6, (best_read[1] / best_read[0] - 1) * 100);
+
+    /* Round trips on a shared core move around by more than recording costs, so the share is worked out from the cost itself too. */
+    printf("    (recording is %.2f%% of the round trip)\n", record_ns / (best_read[0] * 1e9) * 100);
+
+    bench_report("stats/store[unix, off]", count / 10, best_store[0] * (count / 10));
+    bench_report("stats/store[unix, on]", count / 10, best_store[1] * (count / 10));
+    printf("    (%.3f us -> %.3f us per round trip, %+.2f%%)\n", best_store[0] * 1e6, best_store[1] * 1e6, (best_store[1] / best_store[0] - 1) * 100);
+
+    /* What the server told about itself over `CS_REQUEST_SERVER_STATS`. */
+    std::string text(result.begin(), result.end());
+    size_t at = 0;
+    while(at < text.size())
+    {
+        size_t end = text.find('\n', at);
+        if(end == std::string::npos) end = text.size();
+
+        std::string line = text.substr(at, end - at);
+        if(line.rfind("phase.", 0) == 0 || line.rfind("latency.", 0) == 0 || line.rfind("service.", 0) == 0)
+            printf("    %s\n", line.c_str());
+        at = end + 1;
+    }
+    printf("    (full stats in %s)\n", dump_path.c_str());
+
+    if(failed) printf("    (%u requests failed)\n", failed);
+
+    bench_remove_database(path);
+}
+
+#endif
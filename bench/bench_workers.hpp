@@ -0,0 +1,68 @@
+#ifndef bench_workers
+#define bench_workers
+
+/*
+ * run_workers_bench - time `count` stores spread over `entries` DB entries through the worker pool,
+ *                     for 1, 2, 4, ... workers up to one per core.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+void run_workers_bench(uint32_t count, uint32_t entries)
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    if(cores == 0) cores = 1;
+
+    std::vector<unsigned> worker_counts;
+    for(unsigned workers = 1; workers < cores; workers <<= 1) worker_counts.push_back(workers);
+    worker_counts.push_back(cores);
+
+    for(unsigned workers: worker_counts)
+    {
+        WorkerPool pool;
+        std::vector<unsigned char> response;
+
+        for(uint32_t id = 0; id < entries; id++)
+        {
+            pool.perform(CS_REQUEST_CREATE_NEW_DB_ENTRY, engine_payload(id, nullptr, {}).data(), 4, response);
+
+            std::vector<unsigned char> pod = engine_payload(id, nullptr, {CS_CREATING_POD_WITH_TYPE_SDWORD, 5, 'v', 'a', 'l', 'u', 'e'});
+            pool.perform(CS_REQUEST_CREATE_NEW_POD, pod.data(), pod.size(), response);
+        }
+
+        /* Built up front so the run measures the pool, not the allocator. */
+        std::vector<_WorkerRequest *> requests(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            requests[i] = new _WorkerRequest;
+            requests[i]->opcode = CS_REQUEST_TO_STORE_IN;
+            requests[i]->payload = engine_payload(i % entries, "value", {CS_STORING_SDWORD, (unsigned char) i, 0, 0, 0});
+        }
+
+        uint32_t finished = 0, failed = 0;
+        auto on_finished = [&](_WorkerRequest *request) {
+            if(request->result != SS_RESPONSE_OK) failed++;
+            finished++;
+            delete request;
+        };
+
+        pool.start(workers);
+
+        double start = bench_now();
+        for(uint32_t i = 0; i < count; i++)
+            while(!pool.submit(requests[i]))
+                if(pool.drain(on_finished) == 0) std::this_thread::yield();
+
+        while(finished < count)
+            if(pool.drain(on_finished) == 0) std::this_thread::yield();
+        double took = bench_now() - start;
+
+        pool.stop();
+
+        char name[64];
+        snprintf(name, sizeof(name), "workers/store[%u worker%s]", workers, workers == 1 ? "" : "s");
+        bench_report(name, count, took);
+        if(failed) printf("    (%u requests failed)\n", failed);
+    }
+}
+
+#endif
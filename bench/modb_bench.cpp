@@ -0,0 +1,117 @@
+#include <iostream>
+#define SERVER_SIDE
+#include "../db_backend/database.hpp"
+#include "bench.hpp"
+#include "bench_engine.hpp"
+#include "bench_connect.hpp"
+#include "bench_buffer.hpp"
+#include "bench_catalog.hpp"
+#include "bench_workers.hpp"
+#include "bench_batch.hpp"
+#include "bench_kernels.hpp"
+#include "bench_arena.hpp"
+#include "bench_pods.hpp"
+#include "bench_faults.hpp"
+#include "bench_sessions.hpp"
+#include "bench_client.hpp"
+#include "bench_index.hpp"
+#include "bench_compaction.hpp"
+#include "bench_mvcc.hpp"
+#include "bench_stats.hpp"
+#include "bench_create.hpp"
+#include "bench_blobs.hpp"
+#include "bench_codecs.hpp"
+#include "bench_cache.hpp"
+#include "bench_commit.hpp"
+
+/* MODB benchmarks.
+ *  Build: cmake -S . -B build && cmake --build build --target modb_bench
+ *         (or g++ -std=c++17 -O2 -o modb_bench bench/modb_bench.cpp -lpthread)
+ *  Run:   ./modb_bench [benchmark name, or all] [scratch folder, defaults to /tmp] [--json results.json]
+ * */
+int main(int args, char *argv[])
+{
+    const char *positional[2] = {nullptr, nullptr};
+    const char *json_path = nullptr;
+    int given = 0;
+
+    for(int i = 1; i < args; i++)
+    {
+        if(strcmp(argv[i], "--json") == 0 && i + 1 < args) { json_path = argv[++i]; continue; }
+        if(given < 2) positional[given++] = argv[i];
+    }
+
+    const char *only = positional[0] && strcmp(positional[0], "all") != 0 ? positional[0] : nullptr;
+    const char *folder = positional[1] ? positional[1] : "/tmp";
+
+    if(!only || strcmp(only, "engine") == 0)
+        run_engine_bench(1000000);
+
+    if(!only || strcmp(only, "create") == 0)
+        run_create_bench(folder, 200, {1, 1000, 100000});
+
+    if(!only || strcmp(only, "connect") == 0)
+        run_connect_bench(folder, {1024, 1024 * 1024, 1024 * 1024 * 1024});
+
+    if(!only || strcmp(only, "buffer") == 0)
+        run_buffer_bench(10000);
+
+    if(!only || strcmp(only, "catalog") == 0)
+        run_catalog_bench(folder, 100000);
+
+    if(!only || strcmp(only, "workers") == 0)
+        run_workers_bench(1000000, 4096);
+
+    if(!only || strcmp(only, "batch") == 0)
+        run_batch_bench(folder, 10000, 1000);
+
+    if(!only || strcmp(only, "kernels") == 0)
+        run_kernels_bench(1 << 20, 200);
+
+    if(!only || strcmp(only, "arena") == 0)
+        run_arena_bench(folder, 100000, 10000);
+
+    if(!only || strcmp(only, "pods") == 0)
+        run_pods_bench(5000000);
+
+    if(!only || strcmp(only, "faults") == 0)
+        run_faults_bench(folder, 1000000, 100000);
+
+    if(!only || strcmp(only, "sessions") == 0)
+        run_sessions_bench(folder, 100000);
+
+    if(!only || strcmp(only, "client") == 0)
+        run_client_bench(folder, 100000);
+
+    if(!only || strcmp(only, "index") == 0)
+        run_index_bench(1000000, 20, 10000);
+
+    if(!only || strcmp(only, "compaction") == 0)
+        run_compaction_bench(folder, 2048, 24, 1 << 20);
+
+    if(!only || strcmp(only, "mvcc") == 0)
+        run_mvcc_bench(100000, 2000000);
+
+    if(!only || strcmp(only, "stats") == 0)
+        run_stats_bench(folder, 50000, 8);
+
+    if(!only || strcmp(only, "blobs") == 0)
+        run_blobs_bench(folder, 512);
+
+    if(!only || strcmp(only, "codecs") == 0)
+        run_codecs_bench(folder, 1 << 22, 20, 1000);
+
+    if(!only || strcmp(only, "cache") == 0)
+        run_cache_bench(folder, 256, 1000000, 2000);
+
+    if(!only || strcmp(only, "commit") == 0)
+        run_commit_bench(folder, 500);
+
+    if(json_path && !bench_write_json(json_path, only ? only : "all"))
+    {
+        printf("Could not write %s.\n", json_path);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+# Run at build time by the `modb_version` target: writes OUTPUT with the `git describe` of SOURCE_DIR as
+# MODB_BENCH_VERSION. The file is only rewritten when the version changed, so an unchanged tree rebuilds nothing.
+execute_process(
+    COMMAND git describe --always --dirty
+    WORKING_DIRECTORY ${SOURCE_DIR}
+    OUTPUT_VARIABLE MODB_VERSION
+    OUTPUT_STRIP_TRAILING_WHITESPACE
+    ERROR_QUIET)
+if(NOT MODB_VERSION)
+    set(MODB_VERSION "unknown")
+endif()
+
+set(MODB_VERSION_HEADER "#ifndef modb_version\n#define modb_version\n\n#define MODB_BENCH_VERSION      \"${MODB_VERSION}\"\n\n#endif\n")
+
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} MODB_VERSION_OLD)
+endif()
+if(NOT MODB_VERSION_OLD STREQUAL MODB_VERSION_HEADER)
+    file(WRITE ${OUTPUT} "${MODB_VERSION_HEADER}")
+endif()
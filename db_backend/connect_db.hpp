@@ -24,6 +24,17 @@ enum class SS_STATUS: unsigned char
 #define CS_REQUEST_CREATE_NEW_POD               0xF2 // requires DB-entry ID as well the type of data and the name for the Piece Of Data (POD)
 #define CS_REQUEST_DELETE_POD                   0xF3 // requires DB-entry ID as well as the name for the Piece Of Data (POD)
 #define CS_REQUEST_TO_STORE_IN                  0xF4 // requires DB-entry ID as well as the name for the POD and the value to be assigned
+#define CS_REQUEST_READ_POD                     0xF5 // requires DB-entry ID as well as the name for the POD, server-side responds with the type and value
+#define CS_REQUEST_BATCH                        0xF6 // requires a list of sub-requests (see `request_batch.hpp`), server-side responds with a status for each
+#define CS_REQUEST_QUERY_POD                    0xF7 // requires DB-entry ID, the name of a WORD/DWORD stream POD and a `CS_QUERY_*`, server-side responds with the result
+#define CS_REQUEST_CREATE_INDEX                 0xF8 // requires a `CS_INDEX_*` and a POD name, server-side indexes the SBYTE/SWORD/SDWORD PODs with that name in every entry
+#define CS_REQUEST_DROP_INDEX                   0xF9 // requires the POD name of an index made with `CS_REQUEST_CREATE_INDEX`
+#define CS_REQUEST_LOOKUP_POD                   0xFA // requires a POD name and `CS_QUERY_FILTER_EQUAL`/`CS_QUERY_FILTER_RANGE`, server-side responds with [4: count][4 byte ID of each entry whose POD matches]
+#define CS_REQUEST_SERVER_STATS                 0xFB // requires nothing, server-side responds with its counters and latency histograms as text (see `modb_stats.hpp`)
+#define CS_REQUEST_OPEN_SESSION                 0xFC // requires 1 byte of `CS_SESSION_*` flags, server-side responds with the session (see `ServerTransport::open_session`)
+#define CS_REQUEST_SESSION_DOORBELL             0xFD // requires nothing and gets no response; wakes the server-side up for the shared-memory session of the connection
+#define CS_REQUEST_SERVER_STATUS                0xFE // requires nothing, server-side responds with its current `SS_STATUS`
+#define CS_REQUEST_STREAM_POD                   0xFF // requires DB-entry ID, the name of a BYTE_STREAM POD and a `CS_STREAM_*`, server-side moves its value a chunk at a time (see `pod_blobs.hpp`)
 #define CS_CREATING_POD_WITH_TYPE_SBYTE         0xD1 // goes with `CS_REQUEST_CREATE_NEW_POD`, tells server-side to create a DB POD expecting a single byte (SBYTE)
 #define CS_CREATING_POD_WITH_TYPE_BYTE_STREAM   0xD2 // goes with `CS_REQUEST_CREATE_NEW_POD`, tells server-side to create a DB POD expecting a stream of bytes
 #define CS_CREATING_POD_WITH_TYPE_SWORD         0xD3 // goes with `CS_REQUEST_CREATE_NEW_POD`, tells server-side to create a DB POD expecting a single word (SWORD)
@@ -36,28 +47,63 @@ enum class SS_STATUS: unsigned char
 #define CS_STORING_WORD_STREAM                  0xDD // goes with `CS_REQUEST_TO_STORE_IN`, tells server-side a stream of word is being assigned (enables it to do accurate checks as well)
 #define CS_STORING_SDWORD                       0xDE // goes with `CS_REQUEST_TO_STORE_IN`, tells server-side a single dword is being assigned (enables it to do accurate checks as well)
 #define CS_STORING_DWORD_STREAM                 0xDF // goes with `CS_REQUEST_TO_STORE_IN`, tells server-side a stream of dwords is being assigned (enables it to do accurate checks as well)
+#define CS_STORING_ENCODED                      0xE0 // goes with `CS_REQUEST_TO_STORE_IN`, a stream value compressed with one of the codecs in `pod_codecs.hpp` (how the write-ahead log keeps them)
+#define CS_QUERY_SUM                            0xC1 // goes with `CS_REQUEST_QUERY_POD`, server-side responds with the sum of the stream as 8 bytes
+#define CS_QUERY_MIN                            0xC2 // goes with `CS_REQUEST_QUERY_POD`, server-side responds with the smallest value as 4 bytes (nothing if the stream is empty)
+#define CS_QUERY_MAX                            0xC3 // goes with `CS_REQUEST_QUERY_POD`, server-side responds with the largest value as 4 bytes (nothing if the stream is empty)
+#define CS_QUERY_FILTER_EQUAL                   0xC4 // goes with `CS_REQUEST_QUERY_POD`, requires a 4 byte value, server-side responds with [4: count][4 byte index of each equal value]
+#define CS_QUERY_FILTER_RANGE                   0xC5 // goes with `CS_REQUEST_QUERY_POD`, requires a 4 byte low and high bound, server-side responds with [4: count][4 byte index of each value in the range]
+#define CS_QUERY_BIG_ENDIAN                     0xC6 // goes with `CS_REQUEST_QUERY_POD`, server-side responds with the stream converted to big-endian
+#define CS_INDEX_HASH                           0xB1 // goes with `CS_REQUEST_CREATE_INDEX`, a hash index; equality lookups only
+#define CS_INDEX_SORTED                         0xB2 // goes with `CS_REQUEST_CREATE_INDEX`, an ordered index; equality and range lookups
+#define CS_STREAM_INFO                          0xA1 // goes with `CS_REQUEST_STREAM_POD`, server-side responds with the size of the value as 8 bytes
+#define CS_STREAM_READ                          0xA2 // goes with `CS_REQUEST_STREAM_POD`, requires an 8 byte offset and a 4 byte length, server-side responds with that part of the value (less past its end)
+#define CS_STREAM_BEGIN                         0xA3 // goes with `CS_REQUEST_STREAM_POD`, requires the 8 byte size of a new value, server-side sets aside room for it in the blob file
+#define CS_STREAM_WRITE                         0xA4 // goes with `CS_REQUEST_STREAM_POD`, requires an 8 byte offset followed by bytes of the new value to put there
+#define CS_STREAM_COMMIT                        0xA5 // goes with `CS_REQUEST_STREAM_POD`, makes the new value the value of the POD
+#define CS_STREAM_ATTACH                        0xA6 // how a commit is written to the write-ahead log, [8: offset][8: capacity][8: size] of the extent; not accepted from clients
+
+/* Requests that never change the storage engine, so they are not written to the write-ahead log. */
+#define cs_request_is_read_only(opcode)         ((opcode) == CS_REQUEST_READ_POD || (opcode) == CS_REQUEST_QUERY_POD || (opcode) == CS_REQUEST_LOOKUP_POD)
+
+/* Requests about a POD name in every entry rather than one entry; every shard performs them (see `WorkerPool`).
+ * Index declarations are kept in the `.idx` file next to the `.modb` (see `pod_index.hpp`), not in the write-ahead log.
+ * */
+#define cs_request_is_broadcast(opcode)         ((opcode) >= CS_REQUEST_CREATE_INDEX && (opcode) <= CS_REQUEST_LOOKUP_POD)
 
 
 #define server_status_name      UC_PTR "/server_status"
 #define client_status_name      UC_PTR "/client_status"
 
+#include "modb_stats.hpp"
+#include "shm_ring.hpp"
+#include "server_transport.hpp"
+#include "request_batch.hpp"
+#include "stream_kernels.hpp"
+#include "pod_types.hpp"
+#include "pod_codecs.hpp"
+#include "pod_index.hpp"
+#include "pod_versions.hpp"
+#include "pod_blobs.hpp"
+#include "storage_engine.hpp"
+#include "worker_pool.hpp"
+#include "wal_compaction.hpp"
+
 typedef struct DatabaseServerSide
 {
+    /* The text fields below point straight into the mapped modb binary file (see `DatabaseConnect`). */
+
     /* DB IP Address. */
-    unsigned char       *SS_DB_IP_ADDR = nullptr;
-    /* Reallocation for IP addr pointer. */
-    void DB_SS_UCPTR_REALLOC_IP_ADDR(size_t new_size) { SS_DB_IP_ADDR = reallocate_UC_ptr(SS_DB_IP_ADDR, new_size); }
+    std::string_view    SS_DB_IP_ADDR;
 
     /* DB Host. */
-    unsigned char       *SS_DB_HOST = nullptr;
-    void DB_SS_UCPTR_REALLOC_HOST(size_t new_size) { SS_DB_HOST = reallocate_UC_ptr(SS_DB_HOST, new_size); }
+    std::string_view    SS_DB_HOST;
 
     /* DB Port. */
     unsigned char       SS_DB_PORT[5] = {0, 0, 0, 0, '\0'};
 
     /* DB Name. */
-    unsigned char       *SS_DB_NAME = nullptr;
-    void DB_SS_UCPTR_REALLOC_DB_NAME(size_t new_size) { SS_DB_NAME = reallocate_UC_ptr(SS_DB_NAME, new_size); }
+    std::string_view    SS_DB_NAME;
 
     /* Has a client connected to the SS? */
     bool                CS_HAS_CONNECTED = false;
@@ -66,145 +112,1065 @@ typedef struct DatabaseServerSide
     bool                SS_IS_LISTENING = false;
 
     /* Server-side "server_status" file. */
-    unsigned char       *server_status_path = nullptr;
+    ModbBuffer          server_status_path;
     FILE                *server_status = NULL;
     unsigned char       status = static_cast<unsigned char> (SS_STATUS::SS_WAITING);
     
     /* Client-side "client_status" file. */
-    unsigned char       *client_status_path = nullptr;
+    ModbBuffer          client_status_path;
     FILE                *client_status = NULL;
 
-    /* MODB folder for user. */
-    unsigned char       *SS_MODB_FOLDER = nullptr;
-    void DB_SS_UCPTR_REALLOC_MODB_FOLDER(size_t new_size) { SS_MODB_FOLDER = reallocate_UC_ptr(SS_MODB_FOLDER, new_size); }
+    /* Milliseconds `start` serves for without any activity before it returns (on Linux the event loop's idle
+     * timeout, elsewhere how long `wait_for_client_connection` blocks for); -1 never gives up.
+     * */
+    int                 SS_CLIENT_WAIT_TIMEOUT = -1;
+    bool                SS_CLIENT_WAIT_TIMED_OUT = false;
+
+    /* inotify descriptor watching the MODB folder for `client_status` (-1 if not open). */
+    int                 SS_CLIENT_NOTIFY_FD = -1;
+
+    /* MODB folder for user. */
+    std::string_view    SS_MODB_FOLDER;
+
+    /* DB entries and PODs served by this server, sharded over the worker threads by entry ID. */
+    WorkerPool          SS_WORKERS;
+
+    /* Worker threads `start` runs; 0 runs one per core. */
+    unsigned            SS_WORKER_COUNT = 0;
+
+    /* Write-ahead log every storage engine change is appended to before it is acknowledged. */
+    WriteAheadLog       SS_WAL;
+
+    /* Compacts the write-ahead log and the `.modb` file in the background once enough of the log is garbage (see `wal_compaction.hpp`). */
+    WalCompactor        SS_COMPACTOR;
+
+    /* Set by `request_compaction` to compact on the next pass of the event loop, garbage or not. */
+    std::atomic<bool>   SS_COMPACT_REQUESTED{false};
+
+    /* Counters and latency histograms of the event loop (slot 0) and each worker (see `modb_stats.hpp`). */
+    ModbStats           SS_STATS;
+
+    /* Blob file large BYTE_STREAM values are kept in, and the extents a commit of the log is about to free (see `pod_blobs.hpp`).
+     * Declared before `SS_TRANSPORT`, whose connections let go of the extents they were sending when it goes away.
+     * */
+    PodBlobFile         SS_BLOBS;
+    std::vector<_PodBlobExtent> SS_BLOBS_RETIRED;
+
+    /* Codec each POD type is persisted with (see `pod_codecs.hpp`); the shards keep a copy. */
+    _PodCodecPolicy     SS_CODECS;
+
+    /* Secondary indexes declared on POD names, and the `.idx` file they are kept in (see `pod_index.hpp`). */
+    std::vector<_PodIndexDecl> SS_INDEXES;
+    ModbBuffer          SS_INDEX_PATH;
+
+#if defined(__linux__)
+    /* TCP listener on `SS_DB_IP_ADDR`:`SS_DB_PORT` and Unix listener on `<SS_MODB_FOLDER>/modb.sock`. */
+    ServerTransport     SS_TRANSPORT;
+#endif
+
+    /*
+     * client_status_ready - check if the client has written to `client_status`.
+     *  returns: true if `client_status` exists and has data in it, `client_status` is left open for reading
+     *  on error: this function does not error
+     * */
+    bool client_status_ready()
+    {
+        client_status = fopen(client_status_path.c_str(), "rb");
+        if(!client_status) return false;
+
+        fseek(client_status, 0, SEEK_END);
+        if(!(ftell(client_status) > 0)) { fclose(client_status); client_status = NULL; return false; }
+
+        fseek(client_status, 0, SEEK_SET);
+        return true;
+    }
+
+    /*
+     * open_client_notifier - start watching the MODB folder for writes to `client_status`.
+     *  returns: nothing
+     *  on error: this function does not error; if the watch cannot be created the event loop only serves socket and
+     *            shared-memory clients
+     * */
+    void open_client_notifier()
+    {
+#if defined(__linux__)
+        if(SS_CLIENT_NOTIFY_FD != -1) return;
+
+        SS_CLIENT_NOTIFY_FD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(SS_CLIENT_NOTIFY_FD == -1) return;
+
+        /* `IN_CLOSE_WRITE` fires once the client is done writing, `IN_MOVED_TO` covers clients
+         * that write a temporary file and rename it over `client_status`.
+         * */
+        ModbBuffer folder;
+        folder.append(SS_MODB_FOLDER.data(), SS_MODB_FOLDER.size());
+
+        if(inotify_add_watch(SS_CLIENT_NOTIFY_FD, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+        {
+            close(SS_CLIENT_NOTIFY_FD);
+            SS_CLIENT_NOTIFY_FD = -1;
+        }
+#endif
+    }
+
+    /*
+     * client_notifier_fired - drain pending folder events and check if any of them were for `client_status`.
+     *  returns: true if `client_status` was written to or moved into the MODB folder else false
+     *  on error: this function does not error
+     * */
+    bool client_notifier_fired()
+    {
+#if defined(__linux__)
+        alignas(struct inotify_event) char events[4096];
+        bool fired = false;
+
+        ssize_t len;
+        while((len = read(SS_CLIENT_NOTIFY_FD, events, sizeof(events))) > 0)
+        {
+            for(char *ev = events; ev < events + len; )
+            {
+                struct inotify_event *event = (struct inotify_event *) ev;
+
+                if(event->len > 0 && strcmp(event->name, NCC_PTR client_status_name + 1) == 0)
+                    fired = true;
+
+                ev += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        return fired;
+#else
+        return false;
+#endif
+    }
+
+#if !defined(__linux__)
+    /*
+     * wait_for_client_connection - block until the client writes `client_status`, or `SS_CLIENT_WAIT_TIMEOUT` runs out.
+     *  returns: true if the client wrote data to `client_status` else false
+     *  on error: this function does not error
+     *
+     *  Note: on timeout `SS_CLIENT_WAIT_TIMED_OUT` is set to true.
+     *  Note: only used where there is no event loop; on Linux `client_status` writes are noticed by the event loop
+     *        through the folder watch (see `open_client_notifier`).
+     * */
+    bool wait_for_client_connection()
+    {
+        SS_CLIENT_WAIT_TIMED_OUT = false;
+        if(client_status_ready()) return true;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SS_CLIENT_WAIT_TIMEOUT);
+
+        while(true)
+        {
+            int wait_ms = -1;
+            if(SS_CLIENT_WAIT_TIMEOUT >= 0)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if(left <= 0) { SS_CLIENT_WAIT_TIMED_OUT = true; return false; }
+                wait_ms = (int) left;
+            }
+
+            /* No folder watch here, check back periodically instead of spinning. */
+            std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms < 0 || wait_ms > 10 ? 10 : wait_ms));
+            if(client_status_ready()) return true;
+        }
+    }
+#endif
+
+    /*
+     * set_status - move the server to `new_status`, in `server_status` for file-based clients and in-band for sessions.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_status(SS_STATUS new_status)
+    {
+        status = static_cast<unsigned char> (new_status);
+
+        if(server_status)
+        {
+            rewind(server_status);
+            fwrite(&status, sizeof(unsigned char), 1, server_status);
+            fflush(server_status);
+        }
+
+#if defined(__linux__)
+        SS_TRANSPORT.publish_state(status);
+#endif
+    }
+
+    /*
+     * perform_on_shard - perform a storage engine request on the shard that owns its entry, logging it if it changed anything.
+     *  returns: a `SS_RESPONSE_*` code, any result is appended to `response`
+     *  on error: this function does not error; bad requests are reported through the returned code
+     *
+     *  Note: runs on the worker owning `shard` once the pool is started.
+     * */
+    unsigned char perform_on_shard(StorageEngine &shard, unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        unsigned char result = shard.perform(opcode, payload, payload_size, response);
+
+        /* Of the chunked requests only a commit changes anything, and it is logged as the extent it attached. */
+        if(opcode == CS_REQUEST_STREAM_POD)
+        {
+            const std::vector<unsigned char> &record = shard.stream_record();
+            if(result == SS_RESPONSE_OK && !record.empty() && SS_WAL.is_open())
+                SS_WAL.append_engine_op(opcode, record.data(), (uint32_t) record.size());
+
+            return result;
+        }
+
+        /* Logged now, made durable in one go before the responses are sent (see `open_transport`); stream values compressed. */
+        if(!cs_request_is_read_only(opcode) && !cs_request_is_broadcast(opcode) && result == SS_RESPONSE_OK && SS_WAL.is_open())
+        {
+            const std::vector<unsigned char> *encoded = opcode == CS_REQUEST_TO_STORE_IN ? shard.encode_store(payload, payload_size) : nullptr;
+
+            if(encoded) SS_WAL.append_engine_op(opcode, encoded->data(), (uint32_t) encoded->size());
+            else SS_WAL.append_engine_op(opcode, payload, payload_size);
+        }
+
+        return result;
+    }
+
+    /*
+     * declare_index - record an index created or dropped by a successful request in `SS_INDEXES` and the `.idx` file.
+     *  returns: nothing
+     *  on error: this function does not error; a payload too short for the name it declares is ignored, and if the file
+     *            cannot be written the index lasts until the server stops
+     * */
+    void declare_index(unsigned char opcode, const unsigned char *payload, uint32_t payload_size)
+    {
+        if(opcode == CS_REQUEST_CREATE_INDEX)
+        {
+            if(payload_size < 2 || payload_size < 2 + (uint32_t) payload[1]) return;
+            SS_INDEXES.push_back({std::string(NCC_PTR &payload[2], payload[1]), payload[0]});
+        }
+        else if(opcode == CS_REQUEST_DROP_INDEX)
+        {
+            if(payload_size < 1 || payload_size < 1 + (uint32_t) payload[0]) return;
+            std::string_view name(NCC_PTR &payload[1], payload[0]);
+            for(auto decl = SS_INDEXES.begin(); decl != SS_INDEXES.end(); ++decl)
+                if(decl->name == name) { SS_INDEXES.erase(decl); break; }
+        }
+        else
+            return;
+
+        if(!SS_INDEX_PATH.empty() && !pod_index_file_write(UC_PTR SS_INDEX_PATH.c_str(), SS_INDEXES))
+            std::cout << "MODB Notice:\n\tCould not write " << SS_INDEX_PATH.c_str() << ", the index change will not outlast the server." << std::endl;
+    }
+
+    /*
+     * stats_report - append the stats of every server thread, then what compaction has done, to `out` (see `ModbStats::report`).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void stats_report(std::string &out)
+    {
+        SS_STATS.report(out);
+
+        _CompactionStats compaction = SS_COMPACTOR.compaction_stats();
+        char line[256];
+        snprintf(line, sizeof(line), "compaction runs=%llu failed=%llu bytes_reclaimed=%llu total_ms=%.3f last_ms=%.3f\n",
+                 (unsigned long long) compaction.runs, (unsigned long long) compaction.failed_runs, (unsigned long long) compaction.bytes_reclaimed,
+                 compaction.total_duration_ms, compaction.last_duration_ms);
+        out += line;
+    }
+
+    /*
+     * handle_request - perform a single `CS_REQUEST_*` request.
+     *  returns: a `SS_RESPONSE_*` code, any result is appended to `response`
+     *  on error: this function does not error; bad requests are reported through the returned code
+     * */
+    unsigned char handle_request(unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        switch(opcode)
+        {
+            case CS_REQUEST_SERVER_STATUS: {
+                response.push_back(status);
+                return SS_RESPONSE_OK;
+            }
+            case CS_REQUEST_SERVER_STATS: {
+                std::string text;
+                stats_report(text);
+
+                response.insert(response.end(), text.begin(), text.end());
+                return SS_RESPONSE_OK;
+            }
+            case CS_REQUEST_CREATE_NEW_DB_ENTRY:
+            case CS_REQUEST_DELETE_DB_ENTRY:
+            case CS_REQUEST_CREATE_NEW_POD:
+            case CS_REQUEST_DELETE_POD:
+            case CS_REQUEST_TO_STORE_IN:
+            case CS_REQUEST_QUERY_POD:
+            case CS_REQUEST_STREAM_POD: return SS_WORKERS.perform(opcode, payload, payload_size, response);
+            case CS_REQUEST_READ_POD: return SS_WORKERS.read(payload, payload_size, response);
+            case CS_REQUEST_CREATE_INDEX:
+            case CS_REQUEST_DROP_INDEX:
+            case CS_REQUEST_LOOKUP_POD: {
+                unsigned char result = SS_WORKERS.perform(opcode, payload, payload_size, response);
+                if(result == SS_RESPONSE_OK) declare_index(opcode, payload, payload_size);
+                return result;
+            }
+            case CS_REQUEST_BATCH: {
+                _RequestBatch batch;
+                if(!batch.parse(payload, payload_size)) return SS_RESPONSE_BAD_REQUEST;
+
+                for(uint32_t i = 0; i < batch.ops.size(); i++)
+                {
+                    _BatchOp &op = batch.ops[i];
+                    batch.statuses[i] = batch_op_allowed(op.opcode)
+                        ? SS_WORKERS.perform(op.opcode, &batch.payload[op.offset], op.size, batch.results[i])
+                        : SS_RESPONSE_UNKNOWN_REQUEST;
+                }
+
+                batch.encode_response(response);
+                return SS_RESPONSE_OK;
+            }
+            default: break;
+        }
+
+        return SS_RESPONSE_UNKNOWN_REQUEST;
+    }
+
+    /*
+     * open_transport - start listening for socket connections.
+     *  returns: `MODB_OK`, or `MODB_SETUP_FAILED` if the event loop could not be set up or another server answers on the Unix socket
+     *  on error: this function does not error; any other listener that cannot be opened is reported and skipped
+     * */
+    modb_status open_transport()
+    {
+#if defined(__linux__)
+        database_check(SS_TRANSPORT.is_ready(), modb_status::MODB_SETUP_FAILED, "\nError setting up the server-side event loop.\n")
+
+        /* Storage engine requests go to the worker owning their entry, but for reads its published versions can answer; everything else is answered on the event loop. */
+        SS_WORKERS.set_on_complete([this]() { SS_TRANSPORT.wake(); });
+
+        SS_TRANSPORT.set_on_wake([this]() {
+            drain_workers();
+            tend_compaction();
+        });
+        SS_TRANSPORT.set_dispatcher([this](unsigned char opcode, const unsigned char *payload, uint32_t payload_size, uint64_t ticket) {
+            if(opcode == CS_REQUEST_BATCH) return dispatch_batch(payload, payload_size, ticket);
+            if(cs_request_is_broadcast(opcode)) return dispatch_broadcast(opcode, payload, payload_size, ticket);
+            if(!batch_op_allowed(opcode) && opcode != CS_REQUEST_STREAM_POD) return false;
+
+            /* Reads are answered here from the published versions, unless an earlier request of the connection is still
+             * being performed and the read has to see what it did.
+             * */
+            if(opcode == CS_REQUEST_READ_POD && SS_TRANSPORT.caught_up(ticket)) return false;
+
+            _WorkerRequest *request = SS_WORKERS.acquire();
+            request->ticket = ticket;
+            request->opcode = opcode;
+            request->payload.assign(payload, payload + payload_size);
+
+            submit_to_workers(request);
+            return true;
+        });
+
+        SS_TRANSPORT.set_handler([this](unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response) {
+            status = static_cast<unsigned char> (SS_STATUS::SS_PERFORMING_COMMAND);
+            unsigned char result = handle_request(opcode, payload, payload_size, response);
+            status = static_cast<unsigned char> (SS_STATUS::SS_LISTENING);
+
+            return result;
+        });
+
+        /* Group commit: every change performed during one pass of the event loop shares a single fsync.
+         * Blob extents those changes detached are only freed once the commit made the changes durable.
+         * */
+        SS_TRANSPORT.set_before_flush([this]() {
+            SS_BLOBS.take_retired(SS_BLOBS_RETIRED);
+            if(SS_WAL.has_pending()) SS_WAL.commit();
+            SS_BLOBS.recycle(SS_BLOBS_RETIRED);
+        });
+
+        /* Nothing records before the event loop and workers start, so the stats count from this start on. */
+        SS_STATS.reset();
+        bool recording = SS_STATS.is_enabled();
+        SS_TRANSPORT.set_stats(recording ? SS_STATS.thread(0) : nullptr);
+        SS_WORKERS.set_stats(recording ? &SS_STATS : nullptr);
+
+        ModbBuffer ip_address;
+        ip_address.append(SS_DB_IP_ADDR.data(), SS_DB_IP_ADDR.size());
+
+        if(!SS_TRANSPORT.listen_tcp(ip_address.c_str(), NCC_PTR SS_DB_PORT))
+            std::cout << "Could not listen on " << SS_DB_IP_ADDR << ":" << SS_DB_PORT << " (" << strerror(errno) << ")." << std::endl;
+
+        ModbBuffer socket_path;
+        socket_path.append(SS_MODB_FOLDER.data(), SS_MODB_FOLDER.size());
+        socket_path.append_cstr(unix_socket_name);
+
+        if(!SS_TRANSPORT.listen_unix(socket_path.c_str()))
+        {
+            database_check(errno != EADDRINUSE, modb_status::MODB_SETUP_FAILED, "\nAnother server is already answering on %s.\n", socket_path.c_str())
+            std::cout << "Could not listen on " << socket_path.c_str() << " (" << strerror(errno) << ")." << std::endl;
+        }
+        else
+            SS_TRANSPORT.set_session_folder(SS_MODB_FOLDER);
+#endif
+        return modb_status::MODB_OK;
+    }
+
+    /*
+     * submit_to_workers - queue a request on its worker, passing finished requests back while that worker is backed up.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void submit_to_workers(_WorkerRequest *request)
+    {
+        while(!SS_WORKERS.submit(request))
+            if(drain_workers() == 0) std::this_thread::yield();
+    }
+
+    /*
+     * dispatch_batch - split a `CS_REQUEST_BATCH` into one part per worker owning any of its entries and queue the parts.
+     *  returns: true if the batch was handed to the workers, false to answer it on the event loop (malformed or nothing to perform)
+     *  on error: this function does not error
+     * */
+    bool dispatch_batch(const unsigned char *payload, uint32_t payload_size, uint64_t ticket)
+    {
+        std::shared_ptr<_RequestBatch> batch = std::make_shared<_RequestBatch>();
+        if(!batch->parse(payload, payload_size)) return false;
+
+        std::vector<_WorkerRequest *> parts(SS_WORKERS.worker_count(), nullptr);
+        for(uint32_t i = 0; i < batch->ops.size(); i++)
+        {
+            _BatchOp &op = batch->ops[i];
+            if(!batch_op_allowed(op.opcode)) { batch->statuses[i] = SS_RESPONSE_UNKNOWN_REQUEST; continue; }
+
+            uint32_t worker = SS_WORKERS.worker_of(&batch->payload[op.offset], op.size);
+            if(!parts[worker])
+            {
+                parts[worker] = SS_WORKERS.acquire();
+                parts[worker]->ticket = ticket;
+                parts[worker]->opcode = CS_REQUEST_BATCH;
+                parts[worker]->batch = batch;
+                parts[worker]->batch_worker = worker;
+                batch->parts_left++;
+            }
+            parts[worker]->batch_ops.push_back(i);
+        }
+
+        if(batch->parts_left == 0) return false;
+
+        for(_WorkerRequest *part: parts)
+            if(part) submit_to_workers(part);
+
+        return true;
+    }
+
+    /*
+     * dispatch_broadcast - queue a request every shard performs (see `cs_request_is_broadcast`) on every worker.
+     *  returns: true if the request was handed to the workers, false to answer it on the event loop (the pool is not running)
+     *  on error: this function does not error
+     * */
+    bool dispatch_broadcast(unsigned char opcode, const unsigned char *payload, uint32_t payload_size, uint64_t ticket)
+    {
+        if(SS_WORKERS.worker_count() == 0) return false;
+
+        std::shared_ptr<_WorkerBroadcast> broadcast = std::make_shared<_WorkerBroadcast>();
+        broadcast->opcode = opcode;
+        broadcast->payload.assign(payload, payload + payload_size);
+        broadcast->parts_left = (uint32_t) SS_WORKERS.worker_count();
+
+        for(uint32_t worker = 0; worker < SS_WORKERS.worker_count(); worker++)
+        {
+            _WorkerRequest *part = SS_WORKERS.acquire();
+            part->ticket = ticket;
+            part->opcode = opcode;
+            part->broadcast = broadcast;
+            part->batch_worker = worker;
+
+            submit_to_workers(part);
+        }
+
+        return true;
+    }
+
+    /*
+     * begin_compaction - switch the write-ahead log over (see `WalCompactor::begin`) and queue a snapshot of every shard on its worker.
+     *  returns: nothing
+     *  on error: this function does not error; if the log cannot switch over nothing is compacted
+     * */
+    void begin_compaction()
+    {
+        if(!SS_COMPACTOR.begin(SS_WAL, WORKER_POOL_SHARDS, SS_WORKERS.live_size())) return;
+
+        std::shared_ptr<_WorkerBroadcast> snapshot = std::make_shared<_WorkerBroadcast>();
+        snapshot->parts_left = WORKER_POOL_SHARDS;
+        snapshot->job = [this](StorageEngine &shard, uint32_t index) { shard.snapshot(SS_COMPACTOR.snapshot_of(index)); };
+
+        /* One part per shard, so requests queued behind the snapshot only wait for one shard at a time. */
+        for(uint32_t shard = 0; shard < WORKER_POOL_SHARDS; shard++)
+        {
+            _WorkerRequest *part = SS_WORKERS.acquire();
+            part->broadcast = snapshot;
+            part->shard = shard;
+            part->batch_worker = SS_WORKERS.worker_of_shard(shard);
+
+            submit_to_workers(part);
+        }
+    }
+
+    /*
+     * report_compaction - tell how the compaction that was just collected went.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void report_compaction()
+    {
+        _CompactionStats stats = SS_COMPACTOR.compaction_stats();
+
+        if(SS_COMPACTOR.last_run_swapped())
+            std::cout << "MODB Notice:\n\tCompacted " << SS_COMPACTOR.path() << ": " << stats.last_bytes_reclaimed << " bytes reclaimed in "
+                      << stats.last_duration_ms << "ms (" << (int) (stats.last_garbage_ratio * 100) << "% garbage)." << std::endl;
+        else if(SS_COMPACTOR.is_stuck())
+            std::cout << "MODB Notice:\n\tCould not compact " << SS_COMPACTOR.path() << " nor go back to it; changes stay in its .compact file until the server restarts." << std::endl;
+        else
+            std::cout << "MODB Notice:\n\tCould not compact " << SS_COMPACTOR.path() << ", it was left as it was." << std::endl;
+    }
+
+    /*
+     * tend_compaction - collect a compaction that finished, and begin one if it was asked for or enough of the log is garbage.
+     *  returns: nothing
+     *  on error: this function does not error
+     *
+     *  Note: runs on every pass of the event loop, so it only looks at the shards once the log has grown.
+     * */
+    void tend_compaction()
+    {
+        if(SS_COMPACTOR.collect()) report_compaction();
+        if(!SS_WAL.is_open() || SS_WORKERS.worker_count() == 0 || SS_COMPACTOR.is_running()) return;
+
+        bool requested = SS_COMPACT_REQUESTED.load(std::memory_order_relaxed) && SS_COMPACT_REQUESTED.exchange(false);
+        if(requested || SS_COMPACTOR.due(SS_WAL.log_size(), [this]() { return SS_WORKERS.live_size(); }))
+            begin_compaction();
+    }
+
+    /*
+     * request_compaction - compact on the next pass of the event loop, however much of the log is garbage; safe to call from another thread.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void request_compaction()
+    {
+        SS_COMPACT_REQUESTED.store(true);
+#if defined(__linux__)
+        SS_TRANSPORT.wake();
+#endif
+    }
+
+    /*
+     * drain_workers - pass every request the workers finished back to its connection; a batch goes back once all its parts are done.
+     *  returns: number of requests passed back
+     *  on error: this function does not error
+     * */
+    size_t drain_workers()
+    {
+#if defined(__linux__)
+        return SS_WORKERS.drain([this](_WorkerRequest *request) {
+            if(request->batch)
+            {
+                if(--request->batch->parts_left == 0)
+                {
+                    std::vector<unsigned char> response;
+                    request->batch->encode_response(response);
+                    SS_TRANSPORT.complete(request->ticket, SS_RESPONSE_OK, response);
+                }
+            }
+            else if(request->broadcast && request->broadcast->job)
+            {
+                /* A shard of a compaction's snapshot; the rest of the compaction runs on its own thread once every shard is in. */
+                if(--request->broadcast->parts_left == 0)
+                    SS_COMPACTOR.run_in_background(SS_WAL, [this]() { SS_TRANSPORT.wake(); });
+            }
+            else if(request->broadcast)
+            {
+                _WorkerBroadcast &broadcast = *request->broadcast;
+
+                size_t at = broadcast.response.size();
+                broadcast.response.insert(broadcast.response.end(), request->response.begin(), request->response.end());
+                StorageEngine::merge_results(broadcast.opcode, broadcast.response, 0, at);
+                if(request->result != SS_RESPONSE_OK) broadcast.result = request->result;
+
+                if(--broadcast.parts_left == 0)
+                {
+                    if(broadcast.result != SS_RESPONSE_OK) broadcast.response.clear();
+                    else declare_index(broadcast.opcode, broadcast.payload.data(), (uint32_t) broadcast.payload.size());
+
+                    SS_TRANSPORT.complete(request->ticket, broadcast.result, broadcast.response);
+                }
+            }
+            else if(request->file.fd != -1)
+            {
+                uint64_t extent = request->file.extent;
+                SS_TRANSPORT.complete_file(request->ticket, request->result, request->response, request->file.fd, request->file.offset,
+                                           request->file.size, [this, extent]() { SS_BLOBS.unpin(extent); });
+            }
+            else
+                SS_TRANSPORT.complete(request->ticket, request->result, request->response);
+
+            SS_WORKERS.recycle(request);
+        });
+#else
+        return 0;
+#endif
+    }
+
+    /*
+     * stop - make a running `start` return; safe to call from another thread.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void stop()
+    {
+#if defined(__linux__)
+        SS_TRANSPORT.stop();
+#endif
+    }
+
+    /*
+     * listen - start listening on the server side; if `cont_run` is true, `listen` will handle everything for the programmer.
+     *  returns: `MODB_OK` once done serving, or `MODB_SETUP_FAILED` if the status file or event loop could not be set up
+     *  on error: this function does not error directly
+     * */
+    modb_status start(bool cont_run)
+    {
+        SS_IS_LISTENING = true;
+
+        /* Prompt to the user that the SS is listening at IP using port. 
+         * EX: "Server is listening on 127.0.0.1 using port 8080.""
+         * */
+        std::cout << "\n\nServer is listening on " << SS_DB_IP_ADDR << " using port " << SS_DB_PORT << "\n" << std::endl;
+
+        /* The file `server_status` will be read by the client-side.
+         * The file `client_status` will be read by the server-side.
+         * */
+        size_t folder_size = SS_MODB_FOLDER.size();
+
+        server_status_path.clear();
+        server_status_path.append(SS_MODB_FOLDER.data(), folder_size);
+        server_status_path.append_cstr(server_status_name);
+
+        client_status_path.clear();
+        client_status_path.append(SS_MODB_FOLDER.data(), folder_size);
+        client_status_path.append_cstr(client_status_name);
+
+        server_status = fopen(server_status_path.c_str(), "wb");
+        database_check(server_status, modb_status::MODB_SETUP_FAILED, "\nError opening up %s for server-side.\n", server_status_path.c_str())
+        fwrite(&status, sizeof(unsigned char), 1, server_status);
+        fflush(server_status);
+
+        modb_status opened = open_transport();
+        if(opened != modb_status::MODB_OK) return opened;
+
+        /* If the programmer wants to handle things themselves, just return. */
+        if(!cont_run) return modb_status::MODB_OK;
+
+#if defined(__linux__)
+        /* Socket clients and `client_status` writes are both served from one event loop. */
+        open_client_notifier();
+        SS_TRANSPORT.watch_fd(SS_CLIENT_NOTIFY_FD, [this]() {
+            if(client_notifier_fired() && client_status_ready())
+            {
+                std::cout << "Client connection!" << std::endl;
+                fclose(client_status);
+                client_status = NULL;
+            }
+        });
+
+        set_status(SS_STATUS::SS_LISTENING);
+        SS_WORKERS.start(SS_WORKER_COUNT);
+        SS_TRANSPORT.run(SS_CLIENT_WAIT_TIMEOUT);
+        set_status(SS_STATUS::SS_CLOSED);
+
+        SS_WORKERS.stop();
+        drain_workers();
+        if(SS_COMPACTOR.wait()) report_compaction();
+        return modb_status::MODB_OK;
+#else
+        while(!wait_for_client_connection())
+        {
+            if(SS_CLIENT_WAIT_TIMED_OUT)
+            {
+                std::cout << "No client connection within " << SS_CLIENT_WAIT_TIMEOUT << "ms." << std::endl;
+                return modb_status::MODB_OK;
+            }
+
+            std::cout << "It appears there has been a connection, but the client sent no initial data." << std::endl;
+        }
+
+        std::cout << "Client connection!" << std::endl;
+        return modb_status::MODB_OK;
+#endif
+    }
+
+    DatabaseServerSide()
+    {
+        SS_WORKERS.set_handler([this](StorageEngine &shard, unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response) {
+            return perform_on_shard(shard, opcode, payload, payload_size, response);
+        });
+    }
+
+    ~DatabaseServerSide()
+    {
+        /* Its thread wakes `SS_TRANSPORT` up when done, which goes away first. */
+        SS_COMPACTOR.wait();
+
+        if(server_status) fclose(server_status);
+        if(client_status) fclose(client_status);
+
+#if defined(__linux__)
+        if(SS_CLIENT_NOTIFY_FD != -1) close(SS_CLIENT_NOTIFY_FD);
+#endif
+    }
+} _DatabaseServerSide;
+
+typedef struct DatabaseClientSide
+{
+    /* The text fields below point straight into the mapped modb binary file (see `DatabaseConnect`). */
+
+    /* DB IP Address. */
+    std::string_view    CS_DB_IP_ADDR;
+
+    /* DB Port. */
+    unsigned char       CS_DB_PORT[5] = {0, 0, 0, 0, '\0'};
+
+    /* DB Name. */
+    std::string_view    CS_DB_NAME;
+
+    /* MODB folder for user; the server's Unix socket and session files live in it. */
+    std::string_view    CS_MODB_FOLDER;
+
+#if defined(__linux__)
+    /* Session with the server: shared-memory rings when the server is on this host, else a socket. */
+    TransportClient     CS_TRANSPORT;
+#endif
+
+    /* Payload of the request being built; reused so steady requests do not allocate. */
+    std::vector<unsigned char> CS_REQUEST;
+
+    /* Result of the last request that has one the caller did not ask for. */
+    std::vector<unsigned char> CS_RESULT;
+
+    /*
+     * connect - open a session with the server: over the Unix socket in the MODB folder (moving onto shared memory
+     *           if `shared_memory` is true), falling back to TCP on `CS_DB_IP_ADDR`:`CS_DB_PORT`.
+     *  returns: `MODB_OK`, or `MODB_NO_SERVER` if the server could not be reached
+     *  on error: this function does not error
+     * */
+    modb_status connect(bool shared_memory)
+    {
+#if defined(__linux__)
+        ModbBuffer socket_path;
+        socket_path.append(CS_MODB_FOLDER.data(), CS_MODB_FOLDER.size());
+        socket_path.append_cstr(unix_socket_name);
+
+        if(CS_TRANSPORT.connect_unix(socket_path.c_str()))
+        {
+            /* A server that cannot offer shared memory (or whose session file cannot be mapped) still serves the
+             * session on the socket.
+             * */
+            bool opened = (shared_memory && CS_TRANSPORT.open_session(true)) || CS_TRANSPORT.open_session(false);
+            database_check(opened, modb_status::MODB_NO_SERVER,
+                "\nThe server of %.*s at %s did not open a session.\n", (int) CS_DB_NAME.size(), CS_DB_NAME.data(), socket_path.c_str())
+
+            return modb_status::MODB_OK;
+        }
+
+        ModbBuffer ip_address;
+        ip_address.append(CS_DB_IP_ADDR.data(), CS_DB_IP_ADDR.size());
+
+        database_check(CS_TRANSPORT.connect_tcp(ip_address.c_str(), NCC_PTR CS_DB_PORT), modb_status::MODB_NO_SERVER,
+            "\nCould not reach the server of %.*s at %s or %s:%s.\n", (int) CS_DB_NAME.size(), CS_DB_NAME.data(), socket_path.c_str(), ip_address.c_str(), CS_DB_PORT)
+
+        database_check(CS_TRANSPORT.open_session(false), modb_status::MODB_NO_SERVER,
+            "\nThe server of %.*s at %s:%s did not open a session.\n", (int) CS_DB_NAME.size(), CS_DB_NAME.data(), ip_address.c_str(), CS_DB_PORT)
+        return modb_status::MODB_OK;
+#else
+        database_fail(modb_status::MODB_NO_SERVER, "\nThe client-side needs Linux to reach the server.\n")
+#endif
+    }
+
+    /*
+     * begin_request - start the payload of a request on entry `entry_id`, followed by the POD name `name` if there is one.
+     *  returns: false if `name` is longer than a POD name can be else true
+     *  on error: this function does not error
+     * */
+    bool begin_request(uint32_t entry_id, std::string_view name, bool has_name)
+    {
+        if(name.size() > 0xFF) return false;
+
+        CS_REQUEST.resize(4);
+        modb_put_u32(CS_REQUEST.data(), entry_id);
+
+        if(has_name)
+        {
+            CS_REQUEST.push_back((unsigned char) name.size());
+            CS_REQUEST.insert(CS_REQUEST.end(), name.begin(), name.end());
+        }
+
+        return true;
+    }
+
+    /*
+     * request - send a `CS_REQUEST_*` request and wait for its response.
+     *  returns: the `SS_RESPONSE_*` code (`SS_RESPONSE_NOT_SUPPORTED` if the session broke), any result is put in `result`
+     *  on error: this function does not error
+     * */
+    unsigned char request(unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &result)
+    {
+#if defined(__linux__)
+        return CS_TRANSPORT.request(opcode, payload, payload_size, result);
+#else
+        return SS_RESPONSE_NOT_SUPPORTED;
+#endif
+    }
+
+    unsigned char send_built(unsigned char opcode, std::vector<unsigned char> &result)
+    {
+        return request(opcode, CS_REQUEST.data(), (uint32_t) CS_REQUEST.size(), result);
+    }
+
+    /*
+     * create_entry/delete_entry - create or delete DB entry `entry_id`.
+     *  returns: the `SS_RESPONSE_*` code
+     *  on error: this function does not error
+     * */
+    unsigned char create_entry(uint32_t entry_id)
+    {
+        begin_request(entry_id, {}, false);
+        return send_built(CS_REQUEST_CREATE_NEW_DB_ENTRY, CS_RESULT);
+    }
+
+    unsigned char delete_entry(uint32_t entry_id)
+    {
+        begin_request(entry_id, {}, false);
+        return send_built(CS_REQUEST_DELETE_DB_ENTRY, CS_RESULT);
+    }
+
+    /*
+     * create_pod - create the POD `name` in entry `entry_id`, holding values of type `P` (e.g. `PodSDWord`).
+     *  returns: the `SS_RESPONSE_*` code, `SS_RESPONSE_BAD_REQUEST` if `name` is too long
+     *  on error: this function does not error
+     * */
+    template<typename P> unsigned char create_pod(uint32_t entry_id, std::string_view name)
+    {
+        if(!begin_request(entry_id, {}, false) || name.size() > 0xFF) return SS_RESPONSE_BAD_REQUEST;
+
+        CS_REQUEST.push_back(P::create_code);
+        CS_REQUEST.push_back((unsigned char) name.size());
+        CS_REQUEST.insert(CS_REQUEST.end(), name.begin(), name.end());
+        return send_built(CS_REQUEST_CREATE_NEW_POD, CS_RESULT);
+    }
 
-    DatabaseServerSide()
+    unsigned char delete_pod(uint32_t entry_id, std::string_view name)
+    {
+        if(!begin_request(entry_id, name, true)) return SS_RESPONSE_BAD_REQUEST;
+        return send_built(CS_REQUEST_DELETE_POD, CS_RESULT);
+    }
+
+    /*
+     * store - store `value` into the POD `name` of type `P` in entry `entry_id`.
+     *  returns: the `SS_RESPONSE_*` code, `SS_RESPONSE_BAD_REQUEST` if `name` is too long
+     *  on error: this function does not error
+     * */
+    template<typename P> unsigned char store(uint32_t entry_id, std::string_view name, const typename P::slot_type &value)
     {
-        SS_DB_IP_ADDR = UC_PTR calloc(1, sizeof(*SS_DB_IP_ADDR));
-        SS_DB_HOST = UC_PTR calloc(1, sizeof(*SS_DB_HOST));
-        SS_DB_NAME = UC_PTR calloc(1, sizeof(*SS_DB_NAME));
-        SS_MODB_FOLDER = UC_PTR calloc(1, sizeof(*SS_MODB_FOLDER));
-        server_status_path = UC_PTR calloc(1, sizeof(*server_status_path));
-        client_status_path = UC_PTR calloc(1, sizeof(*client_status_path));
+        if(!begin_request(entry_id, name, true)) return SS_RESPONSE_BAD_REQUEST;
 
-        database_assert(SS_DB_IP_ADDR && SS_DB_HOST &&
-                        SS_DB_NAME && SS_MODB_FOLDER &&
-                        server_status_path && client_status_path,
-            "\nError allocating initial memory for a, or multiple, variables residing in `_DatabaseServerSide`.\n")
+        CS_REQUEST.push_back(P::store_code);
+        P::encode(value, CS_REQUEST);
+        return send_built(CS_REQUEST_TO_STORE_IN, CS_RESULT);
     }
 
-    bool wait_for_client_connection()
+    /*
+     * read - read the POD `name` of type `P` in entry `entry_id` into `value`.
+     *  returns: the `SS_RESPONSE_*` code, `SS_RESPONSE_TYPE_MISMATCH` if the POD holds another type
+     *  on error: this function does not error
+     * */
+    template<typename P> unsigned char read(uint32_t entry_id, std::string_view name, typename P::slot_type &value)
     {
-        client_status = fopen(NCC_PTR client_status_path, "rb");
+        if(!begin_request(entry_id, name, true)) return SS_RESPONSE_BAD_REQUEST;
 
-        while(!client_status)
-            client_status = fopen(NCC_PTR client_status_path, "rb");
-        
-        fclose(client_status);
-        client_status = fopen(NCC_PTR client_status_path, "rb");
-        if(!client_status) return false;
+        unsigned char response = send_built(CS_REQUEST_READ_POD, CS_RESULT);
+        if(response != SS_RESPONSE_OK) return response;
 
-        fseek(client_status, 0, SEEK_END);
-        if(!(ftell(client_status) > 0)) { fclose(client_status); return false; }
+        if(CS_RESULT.empty() || CS_RESULT[0] != P::store_code || !P::valid_size((uint32_t) CS_RESULT.size() - 1))
+            return SS_RESPONSE_TYPE_MISMATCH;
 
-        return true;
+        P::decode(value, &CS_RESULT[1], (uint32_t) CS_RESULT.size() - 1);
+        return SS_RESPONSE_OK;
     }
 
     /*
-     * listen - start listening on the server side; if `cont_run` is true, `listen` will handle everything for the programmer.
-     *  returns: nothing
-     *  on error: this function does not error directly
+     * write_stream - stream a value of `size` bytes into the BYTE_STREAM POD `name` in entry `entry_id`, a chunk at a
+     *                time: `fill` gets a buffer and how many of the next bytes of the value to put in it.
+     *  returns: the `SS_RESPONSE_*` code, `SS_RESPONSE_BAD_REQUEST` if `fill` returned false; the POD keeps its old
+     *           value unless every chunk went in
+     *  on error: this function does not error
+     *
+     *  Note: the value is kept in the server's blob file (see `pod_blobs.hpp`); only one chunk is ever held on either side.
      * */
-    void start(bool cont_run)
+    unsigned char write_stream(uint32_t entry_id, std::string_view name, uint64_t size, const std::function<bool (unsigned char *, uint32_t)> &fill)
     {
-        SS_IS_LISTENING = true;
+        if(!begin_request(entry_id, name, true)) return SS_RESPONSE_BAD_REQUEST;
+        size_t at = CS_REQUEST.size();
 
-        /* Prompt to the user that the SS is listening at IP using port. 
-         * EX: "Server is listening on 127.0.0.1 using port 8080.""
-         * */
-        std::cout << "\n\nServer is listening on " << SS_DB_IP_ADDR << " using port " << SS_DB_PORT << "\n" << std::endl;
+        CS_REQUEST.resize(at + 9);
+        CS_REQUEST[at] = CS_STREAM_BEGIN;
+        modb_put_u64(&CS_REQUEST[at + 1], size);
 
-        /* The file `server_status` will be read by the client-side.
-         * The file `client_status` will be read by the server-side.
-         * */
-        server_status_path = reallocate_UC_ptr(server_status_path, strlen(NCC_PTR SS_MODB_FOLDER));
-        client_status_path = reallocate_UC_ptr(client_status_path, strlen(NCC_PTR SS_MODB_FOLDER));
+        unsigned char response = send_built(CS_REQUEST_STREAM_POD, CS_RESULT);
+        for(uint64_t offset = 0; response == SS_RESPONSE_OK && offset < size; )
+        {
+            uint32_t chunk = (uint32_t) std::min<uint64_t>(size - offset, POD_BLOB_CHUNK_SIZE);
 
-        memcpy(server_status_path, SS_MODB_FOLDER, strlen(NCC_PTR SS_MODB_FOLDER));
-        memcpy(client_status_path, SS_MODB_FOLDER, strlen(NCC_PTR SS_MODB_FOLDER));
+            CS_REQUEST.resize(at + 9 + chunk);
+            CS_REQUEST[at] = CS_STREAM_WRITE;
+            modb_put_u64(&CS_REQUEST[at + 1], offset);
+            if(!fill(&CS_REQUEST[at + 9], chunk)) return SS_RESPONSE_BAD_REQUEST;
 
-        server_status_path = reallocate_UC_ptr(server_status_path, strlen(NCC_PTR SS_MODB_FOLDER) + 14);
-        client_status_path = reallocate_UC_ptr(client_status_path, strlen(NCC_PTR SS_MODB_FOLDER) + 14);
+            response = send_built(CS_REQUEST_STREAM_POD, CS_RESULT);
+            offset += chunk;
+        }
+        if(response != SS_RESPONSE_OK) return response;
 
-        memcpy(&server_status_path[strlen(NCC_PTR SS_MODB_FOLDER)], server_status_name, 14);
-        memset(&server_status_path[strlen(NCC_PTR SS_MODB_FOLDER) + 14], 0, 1);
-        memcpy(&client_status_path[strlen(NCC_PTR SS_MODB_FOLDER)], client_status_name, 14);
-        memset(&client_status_path[strlen(NCC_PTR SS_MODB_FOLDER) + 14], 0, 1);
+        CS_REQUEST.resize(at + 1);
+        CS_REQUEST[at] = CS_STREAM_COMMIT;
+        return send_built(CS_REQUEST_STREAM_POD, CS_RESULT);
+    }
 
-        server_status = fopen(NCC_PTR server_status_path, "wb");
-        database_assert(server_status, "\nError opening up %s for server-side.\n", server_status_path)
-        fwrite(&status, sizeof(unsigned char), 1, server_status);
+    /*
+     * read_stream - read the BYTE_STREAM POD `name` in entry `entry_id` a chunk at a time, handing each to `consume` in order.
+     *  returns: the `SS_RESPONSE_*` code, `SS_RESPONSE_BAD_REQUEST` if `consume` returned false or the value shrank
+     *  on error: this function does not error
+     *
+     *  Note: works on values in memory too. Chunks are read one request each, so a value stored into while it is
+     *        read can come out part old and part new.
+     * */
+    unsigned char read_stream(uint32_t entry_id, std::string_view name, const std::function<bool (const unsigned char *, uint32_t)> &consume)
+    {
+        if(!begin_request(entry_id, name, true)) return SS_RESPONSE_BAD_REQUEST;
+        size_t at = CS_REQUEST.size();
 
+        CS_REQUEST.push_back(CS_STREAM_INFO);
+        unsigned char response = send_built(CS_REQUEST_STREAM_POD, CS_RESULT);
+        if(response != SS_RESPONSE_OK) return response;
+        if(CS_RESULT.size() != 8) return SS_RESPONSE_BAD_REQUEST;
 
-        /* If the programmer wants to handle things themselves, just return. */
-        if(!cont_run) return;
+        uint64_t size = modb_get_u64(CS_RESULT.data());
+        CS_REQUEST.resize(at + 13);
+        CS_REQUEST[at] = CS_STREAM_READ;
 
-        if(wait_for_client_connection())
-        {
-            connection:
-            std::cout << "Client connection!" << std::endl;
-        }
-        else
+        for(uint64_t offset = 0; offset < size; offset += CS_RESULT.size())
         {
-            std::cout << "It appears there has been a connection, but the client sent no initial data." << std::endl;
-            while(!wait_for_client_connection());
-            goto connection;
+            modb_put_u64(&CS_REQUEST[at + 1], offset);
+            modb_put_u32(&CS_REQUEST[at + 9], (uint32_t) std::min<uint64_t>(size - offset, POD_BLOB_CHUNK_SIZE));
+
+            response = send_built(CS_REQUEST_STREAM_POD, CS_RESULT);
+            if(response != SS_RESPONSE_OK) return response;
+            if(CS_RESULT.empty() || !consume(CS_RESULT.data(), (uint32_t) CS_RESULT.size())) return SS_RESPONSE_BAD_REQUEST;
         }
+
+        return SS_RESPONSE_OK;
     }
 
-    ~DatabaseServerSide()
+    /*
+     * query - run the `CS_QUERY_*` `query_type` with `args` on the WORD/DWORD stream POD `name` in entry `entry_id`.
+     *  returns: the `SS_RESPONSE_*` code, the result is put in `result`
+     *  on error: this function does not error
+     * */
+    unsigned char query(uint32_t entry_id, std::string_view name, unsigned char query_type, const unsigned char *args, uint32_t args_size, std::vector<unsigned char> &result)
     {
-        if(SS_DB_IP_ADDR) free(SS_DB_IP_ADDR);
-        if(SS_DB_HOST) free(SS_DB_HOST);
-        if(SS_DB_NAME) free(SS_DB_NAME);
-        if(SS_MODB_FOLDER) free(SS_MODB_FOLDER);
-        if(server_status_path) free(server_status_path);
-        if(client_status_path) free(client_status_path);
-
-        SS_DB_IP_ADDR = SS_DB_HOST = 
-            SS_DB_NAME = SS_MODB_FOLDER =
-            server_status_path = client_status_path = nullptr;
-        
-        fclose(server_status);
-        if(client_status) fclose(client_status);
+        if(!begin_request(entry_id, name, true)) return SS_RESPONSE_BAD_REQUEST;
+
+        CS_REQUEST.push_back(query_type);
+        if(args_size > 0) CS_REQUEST.insert(CS_REQUEST.end(), args, args + args_size);
+        return send_built(CS_REQUEST_QUERY_POD, result);
     }
-} _DatabaseServerSide;
 
-typedef struct DatabaseClientSide
-{
+    /*
+     * create_index - index the POD `name` of every entry with a `CS_INDEX_*` index of kind `index_kind`.
+     *  returns: the `SS_RESPONSE_*` code, `SS_RESPONSE_BAD_REQUEST` if `name` is too long
+     *  on error: this function does not error
+     * */
+    unsigned char create_index(std::string_view name, unsigned char index_kind)
+    {
+        if(name.size() > 0xFF) return SS_RESPONSE_BAD_REQUEST;
 
-} _DatabaseClientSide;
+        CS_REQUEST.assign({index_kind, (unsigned char) name.size()});
+        CS_REQUEST.insert(CS_REQUEST.end(), name.begin(), name.end());
+        return send_built(CS_REQUEST_CREATE_INDEX, CS_RESULT);
+    }
 
-/* Bytes to skip (depending on OS type). */
-#ifdef _WIN32
-#define bytes_to_skip       6
-#endif
+    unsigned char drop_index(std::string_view name)
+    {
+        if(name.size() > 0xFF) return SS_RESPONSE_BAD_REQUEST;
 
-#ifdef _WIN64
-#define bytes_to_skip       6
-#endif
+        CS_REQUEST.assign(1, (unsigned char) name.size());
+        CS_REQUEST.insert(CS_REQUEST.end(), name.begin(), name.end());
+        return send_built(CS_REQUEST_DROP_INDEX, CS_RESULT);
+    }
 
-#if defined(__unix) || defined(__unix__) || defined(__linux__)
-#define bytes_to_skip       5
-#endif
+    /*
+     * lookup - find every entry whose SBYTE/SWORD/SDWORD POD `name` holds a value from `low` through `high`.
+     *  returns: the `SS_RESPONSE_*` code, the IDs of the entries (in no particular order) are put in `entry_ids`
+     *  on error: this function does not error
+     * */
+    unsigned char lookup(std::string_view name, uint32_t low, uint32_t high, std::vector<uint32_t> &entry_ids)
+    {
+        entry_ids.clear();
+        if(name.size() > 0xFF) return SS_RESPONSE_BAD_REQUEST;
 
-#if defined(__APPLE__) || defined(__MACH__)
-#define bytes_to_skip       4
-#endif
+        CS_REQUEST.assign(1, (unsigned char) name.size());
+        CS_REQUEST.insert(CS_REQUEST.end(), name.begin(), name.end());
+        CS_REQUEST.push_back(low == high ? CS_QUERY_FILTER_EQUAL : CS_QUERY_FILTER_RANGE);
+
+        size_t at = CS_REQUEST.size();
+        CS_REQUEST.resize(at + (low == high ? 4 : 8));
+        modb_put_u32(&CS_REQUEST[at], low);
+        if(low != high) modb_put_u32(&CS_REQUEST[at + 4], high);
+
+        unsigned char response = send_built(CS_REQUEST_LOOKUP_POD, CS_RESULT);
+        if(response != SS_RESPONSE_OK) return response;
+
+        if(CS_RESULT.size() < 4 || CS_RESULT.size() != 4 + (size_t) modb_get_u32(CS_RESULT.data()) * 4) return SS_RESPONSE_BAD_REQUEST;
 
-#if (!defined(_WIN32) || !defined(_WIN64)) && (!defined(__unix) || !defined(__unix__) || !defined(__linux__)) && (!defined(__APPLE__) || !defined(__MACH__))
-#define bytes_to_skip       12
+        entry_ids.resize(modb_get_u32(CS_RESULT.data()));
+        for(size_t i = 0; i < entry_ids.size(); i++) entry_ids[i] = modb_get_u32(&CS_RESULT[4 + i * 4]);
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * stats - the server's counters and latency histograms, as `name key=value ...` lines (see `modb_stats.hpp`).
+     *  returns: the `SS_RESPONSE_*` code, the text is put in `text`
+     *  on error: this function does not error
+     * */
+    unsigned char stats(std::string &text)
+    {
+        CS_REQUEST.clear();
+
+        unsigned char response = send_built(CS_REQUEST_SERVER_STATS, CS_RESULT);
+        text.assign(CS_RESULT.begin(), CS_RESULT.end());
+        return response;
+    }
+
+    /*
+     * server_state - the `SS_STATUS` the server is in, as told in-band by the session.
+     *  returns: the state, 0 before the session is open
+     *  on error: this function does not error
+     * */
+    unsigned char server_state()
+    {
+#if defined(__linux__)
+        return CS_TRANSPORT.server_state();
+#else
+        return 0;
 #endif
+    }
+} _DatabaseClientSide;
 
 class DatabaseConnect
 {
@@ -225,166 +1191,434 @@ private:
 
     unsigned char *modb_path = nullptr;
 
-public:
-    DatabaseConnect(unsigned char *modb_binary_path)
-    {
-        FILE *modb_binary = fopen(NCC_PTR modb_binary_path, "rb");
-        database_assert(modb_binary, "\nThe MODB binary file %s does not exist.\n", modb_binary_path)
+    /* A modb binary file bigger than the page cache (the one given to the constructor, or `own_cache`) is read through
+     * it and the entry found in it copied to `modb_entry_text`; a smaller one, or a v1 file, is mapped (`modb_map`).
+     * The write-ahead log stays mapped too. `modb_entry` points into one of them. Only the catalog of entries is
+     * paged this way; POD values are kept in memory, restored from the write-ahead log. `tail_map` holds the changes a compaction that stopped in the middle
+     * logged (see `wal_compaction.hpp`).
+     * */
+    ModbPageCache *modb_cache = nullptr;
+    std::unique_ptr<ModbPageCache> own_cache;
+    std::string modb_entry_text;
+    ModbMapping modb_map;
+    ModbMapping wal_map;
+    ModbMapping tail_map;
+    _ModbEntryView modb_entry;
 
-        fseek(modb_binary, 0, SEEK_END);
-        size_t modb_bin_size = ftell(modb_binary);
-        fseek(modb_binary, 0, SEEK_SET);
+    /* Name of the database to connect to; empty connects to the last one added. */
+    std::string_view modb_db_name;
+    bool modb_entry_found = false;
 
-        unsigned char *modb_bin_data = UC_PTR calloc(modb_bin_size, sizeof(*modb_bin_data));
-        database_assert(modb_bin_data, "\nError allocating initial memory for storing MODB binary data.\n")
-        fread(modb_bin_data, sizeof(unsigned char), modb_bin_size, modb_binary);
+    /* Why the constructor could not connect, `MODB_OK` if it did. */
+    modb_status connect_status = modb_status::MODB_OK;
 
-        fclose(modb_binary);
+    /*
+     * use_entry - make `entry` the database connected to, if it is the one asked for.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void use_entry(_ModbEntryView &entry)
+    {
+        if(!modb_db_name.empty() && entry.name != modb_db_name) return;
 
-#if defined(SERVER_SIDE) && defined(CLIENT_SIDE)
-        database_error("\nCannot have both SERVER_SIDE and CLIENT_SIDE defined in one program.\n")
-#endif
+        modb_entry = entry;
+        modb_entry_found = true;
+    }
 
 #ifdef SERVER_SIDE
-        DB_SS = new _DatabaseServerSide;
-#endif
+    /*
+     * open_blobs - open the blob file next to the modb binary file for the storage engine, before the write-ahead
+     *              log is replayed so the values it attached are claimed (see `pod_blobs.hpp`).
+     *  returns: nothing
+     *  on error: this function does not error; without the file `CS_STREAM_BEGIN` is answered `SS_RESPONSE_NOT_SUPPORTED`
+     * */
+    void open_blobs()
+    {
+        ModbBuffer blob_path;
+        blob_path.append_cstr(modb_path);
+        blob_path.append_cstr(pod_blob_file_extension);
 
-#ifdef CLIENT_SIDE
-        DB_CS = new _DatabaseClientSide;
-#endif
+        if(DB_SS->SS_BLOBS.open(blob_path.c_str())) DB_SS->SS_WORKERS.set_blobs(DB_SS->SS_BLOBS);
+        else std::cout << "MODB Notice:\n\tCould not open " << blob_path.c_str() << ", values cannot be streamed into the database." << std::endl;
+    }
+
+    /*
+     * load_indexes - declare the indexes in the `.idx` file next to the modb binary file, before the write-ahead
+     *                log is replayed so the indexes are filled in along with the entries.
+     *  returns: nothing
+     *  on error: this function does not error; a damaged `.idx` file is reported and left for the next index change to replace
+     * */
+    void load_indexes()
+    {
+        DB_SS->SS_INDEX_PATH.clear();
+        DB_SS->SS_INDEX_PATH.append_cstr(modb_path);
+        DB_SS->SS_INDEX_PATH.append_cstr(pod_index_file_extension);
 
-        size_t bin_index = bytes_to_skip;
-        unsigned short ind = 0;
-        while(modb_bin_data[bin_index] != static_cast<unsigned char> (modb_sections::MODB_END))
+        if(pod_index_file_read(UC_PTR DB_SS->SS_INDEX_PATH.c_str(), DB_SS->SS_INDEXES) == modb_status::MODB_FILE_DAMAGED)
+            std::cout << "MODB Notice:\n\t" << DB_SS->SS_INDEX_PATH.c_str() << " is damaged, no indexes were declared from it." << std::endl;
+
+        std::vector<unsigned char> payload, ignored;
+        for(const _PodIndexDecl &decl: DB_SS->SS_INDEXES)
         {
-            switch(modb_bin_data[bin_index])
-            {
-                case static_cast<unsigned char> (modb_sections::MODB_IP_ADDRESS): {
-                    bin_index++;
+            payload.assign({decl.kind, (unsigned char) decl.name.size()});
+            payload.insert(payload.end(), decl.name.begin(), decl.name.end());
+            DB_SS->SS_WORKERS.perform(CS_REQUEST_CREATE_INDEX, payload.data(), (uint32_t) payload.size(), ignored);
+        }
+    }
+#endif
+
+    /*
+     * replay_wal - apply every record in the write-ahead log next to the modb binary file.
+     *  returns: nothing
+     *  on error: this function does not error; on the server-side damaged records at the end of the log are dropped
+     *
+     *  Note: the client-side only takes database entries from the log; it skips storage engine changes and never cuts
+     *        the log, since a server may be in the middle of writing to it.
+     *  Note: on the server-side a compaction that stopped in the middle is finished or undone first, and the log
+     *        is then kept open so storage engine changes get logged to it.
+     * */
+    void replay_wal()
+    {
+        unsigned char *wal_path = wal_path_for(modb_path);
 
-                    while(modb_bin_data[bin_index] != 0)
+        auto apply = [this](unsigned char record_type, const unsigned char *payload, uint32_t payload_size) {
+            switch(record_type)
+            {
+                case WAL_RECORD_DB_ENTRY: {
+                    _ModbEntryView logged_entry;
+                    if(payload_size > 0 && payload[payload_size - 1] == static_cast<unsigned char> (modb_sections::MODB_END))
                     {
+                        modb_parse_entry(payload, payload_size, 0, logged_entry);
+                        use_entry(logged_entry);
+                    }
+                    break;
+                }
+                case WAL_RECORD_DB_ENTRY_V2: {
+                    _ModbEntryView logged_entry;
+                    if(modb_v2_decode_entry(payload, payload_size, logged_entry)) use_entry(logged_entry);
+                    break;
+                }
+                case WAL_RECORD_ENGINE_OP: {
 #ifdef SERVER_SIDE
-                        DB_SS->SS_DB_IP_ADDR[ind] = modb_bin_data[bin_index];
-                        ind++;
-
-                        DB_SS->DB_SS_UCPTR_REALLOC_IP_ADDR(ind + 1);
-#endif
-#ifdef CLIENT_SIDE
-                        /* TODO: Add client-side. */
+                    std::vector<unsigned char> ignored;
+                    if(payload_size > 0) DB_SS->SS_WORKERS.perform(payload[0], &payload[1], payload_size - 1, ignored);
 #endif
-                        bin_index++;
-                    }
-                    memset(&DB_SS->SS_DB_IP_ADDR[ind], 0, 1);
-
-                    std::cout << "\nmodb_sections::MODB_IP_ADDRESS:    " << DB_SS->SS_DB_IP_ADDR << std::endl;
-                    ind = 0;
                     break;
                 }
-                case static_cast<unsigned char> (modb_sections::MODB_PORT_AND_HOST): {
-                    bin_index++;
+                default: break;
+            }
+        };
+
+#ifdef SERVER_SIDE
+        bool owns_log = true;
+#else
+        bool owns_log = false;
+#endif
+        size_t replayed = WriteAheadLog::replay(wal_path, wal_map, apply, owns_log);
 
-                    /* Host. */
-                    while(modb_bin_data[bin_index] != 0)
-                    {
 #ifdef SERVER_SIDE
-                        DB_SS->SS_DB_HOST[ind] = modb_bin_data[bin_index];
-                        ind++;
+        WalCompactor &compactor = DB_SS->SS_COMPACTOR;
+        compactor.set_paths(modb_path);
+
+        if(compactor.has_unmerged_tail())
+        {
+            ModbBuffer tail_path;
+            tail_path.append_cstr(wal_path);
+            tail_path.append_cstr(wal_compact_extension);
 
-                        DB_SS->DB_SS_UCPTR_REALLOC_HOST(ind + 1);
+            replayed += WriteAheadLog::replay(UC_PTR tail_path.c_str(), tail_map, apply, true);
+            if(!compactor.merge_tail())
+                std::cout << "MODB Notice:\n\tCould not append " << tail_path.c_str() << " to " << wal_path << ", it is kept for the next start." << std::endl;
+        }
 #endif
-#ifdef CLIENT_SIDE
-                        /* TODO: Add client-side. */
+
+        if(replayed > 0)
+            std::cout << "\nReplayed " << replayed << " record(s) from " << wal_path << std::endl;
+
+#ifdef SERVER_SIDE
+        if(!DB_SS->SS_WAL.open_log(wal_path))
+            std::cout << "MODB Notice:\n\tCould not open " << wal_path << ", storage engine changes will not be durable." << std::endl;
+        else DB_SS->SS_WAL.reserve(WAL_SERVER_BUFFER_RESERVE);
+#endif
+
+        free(wal_path);
+    }
+
+    /*
+     * connect - connect to the database named `db_name` in the modb binary file at `modb_binary_path`.
+     *  returns: `MODB_OK`, or the `modb_status` saying why the file or database could not be used
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    modb_status connect(unsigned char *modb_binary_path, const unsigned char *db_name)
+    {
+        if(db_name) modb_db_name = std::string_view(NCC_PTR db_name);
+
+        if(!modb_cache)
+        {
+            own_cache.reset(new ModbPageCache());
+            modb_cache = own_cache.get();
+        }
+        database_check(modb_cache->refresh(NCC_PTR modb_binary_path), modb_status::MODB_FILE_NOT_FOUND, "\nThe MODB binary file %s does not exist.\n", modb_binary_path)
+
+#if defined(SERVER_SIDE) && defined(CLIENT_SIDE)
+        database_fail(modb_status::MODB_INVALID_ARGUMENT, "\nCannot have both SERVER_SIDE and CLIENT_SIDE defined in one program.\n")
 #endif
-                        bin_index++;
-                    }
-                    memset(&DB_SS->SS_DB_HOST[ind], 0, 1);
 
-                    bin_index++;
-                    ind = 0;
-                    while(modb_bin_data[bin_index] != 0)
-                    {
 #ifdef SERVER_SIDE
-                        DB_SS->SS_DB_PORT[ind] = modb_bin_data[bin_index];
-                        ind++;
+        DB_SS = new _DatabaseServerSide;
 #endif
+
 #ifdef CLIENT_SIDE
-                        /* TODO: Add client-side. */
+        DB_CS = new _DatabaseClientSide;
 #endif
-                        bin_index++;
-                    }
 
-                    std::cout << "modb_sections::MODB_PORT_AND_HOST: " << DB_SS->SS_DB_PORT << ", " << DB_SS->SS_DB_HOST << std::endl;
-                    ind = 0;
-                    break;
-                }
-                case static_cast<unsigned char> (modb_sections::MODB_DB_NAME): {
-                    bin_index++;
+        /* v1 files (OS header + NUL terminated sections) are mapped and scanned in place; connecting never rewrites
+         * the file (see `modb_migrate_to_v2`).
+         * */
+        unsigned char header[MODB_V2_HEADER_SIZE];
+        uint64_t file_size = modb_cache->file_size();
+        if(file_size > 0 && (file_size < sizeof(header) || !modb_cache->read(0, header, sizeof(header)) || !modb_is_v2(header, file_size)))
+        {
+            std::cout << "MODB Notice:\n\t" << modb_binary_path << " is in the v1 format; call `modb_migrate_to_v2` to rewrite it as v2." << std::endl;
 
-                    while(modb_bin_data[bin_index] != 0)
-                    {
-#ifdef SERVER_SIDE
-                        DB_SS->SS_DB_NAME[ind] = modb_bin_data[bin_index];
-                        ind++;
+            database_check(modb_map.map_file(modb_binary_path), modb_status::MODB_IO_ERROR,
+                "\nError reading the MODB binary file %s.\n", modb_binary_path)
+            modb_entry_found = modb_find_v1_entry(modb_map.data(), modb_map.size(), modb_db_name, modb_entry);
+        }
+
+        /* The name index (or, without a name, the directory) gives the entry directly; later entries win.
+         * A file no bigger than the page cache is mapped and its entry read in place, without a copy; a bigger one
+         * is read through the cache, only the pages of the buckets, row and sections looked at, and the entry copied.
+         * */
+        else if(file_size > 0 && file_size <= modb_cache->capacity())
+        {
+            ModbFileV2 modb_file;
+            database_check(modb_map.map_file(modb_binary_path), modb_status::MODB_IO_ERROR,
+                "\nError reading the MODB binary file %s.\n", modb_binary_path)
+            database_check(modb_file.open(modb_map.data(), modb_map.size()), modb_status::MODB_FILE_DAMAGED,
+                "\nThe MODB binary file %s is damaged.\n", modb_binary_path)
+
+            long index = modb_db_name.empty() ? (long) modb_file.entry_count() - 1 : modb_file.find_entry(modb_db_name);
+            if(index >= 0) modb_entry_found = modb_file.entry(index, modb_entry);
+        }
+        else if(file_size > 0)
+        {
+            ModbPagedFileV2 modb_file;
+            database_check(modb_file.open(*modb_cache), modb_status::MODB_FILE_DAMAGED,
+                "\nThe MODB binary file %s is damaged.\n", modb_binary_path)
+
+            long index = modb_db_name.empty() ? (long) modb_file.entry_count() - 1 : modb_file.find_entry(modb_db_name);
+            if(index >= 0)
+            {
+                database_check(modb_file.entry(index, modb_entry, modb_entry_text), modb_status::MODB_FILE_DAMAGED,
+                    "\nThe MODB binary file %s is damaged.\n", modb_binary_path)
+                modb_entry_found = true;
+            }
+        }
 
-                        DB_SS->DB_SS_UCPTR_REALLOC_DB_NAME(ind + 1);
+        /* Copy the path, the write-ahead log lives next to it. */
+        modb_path = UC_PTR calloc(strlen(NCC_PTR modb_binary_path) + 1, sizeof(*modb_path));
+        database_assert(modb_path, "\nError allocating memory for the MODB binary path.\n")
+        memcpy(modb_path, modb_binary_path, strlen(NCC_PTR modb_binary_path));
+
+#ifdef SERVER_SIDE
+        open_blobs();
+        load_indexes();
 #endif
-#ifdef CLIENT_SIDE
-                        /* TODO: Add client-side. */
+        replay_wal();
+
+#ifdef SERVER_SIDE
+        if(DB_SS->SS_BLOBS.is_open()) DB_SS->SS_BLOBS.finish_recovery();
 #endif
 
-                        bin_index++;
-                    }
-                    memset(&DB_SS->SS_DB_NAME[ind], 0, 1);
+        if(!modb_db_name.empty())
+            database_check(modb_entry_found, modb_status::MODB_NO_SUCH_DATABASE, "\nThere is no database named %s in %s.\n", db_name, modb_binary_path)
 
-                    std::cout << "modb_sections::MODB_DB_NAME:       " << DB_SS->SS_DB_NAME << std::endl;
-                    ind = 0;
-                    break;
-                }
-                case static_cast<unsigned char> (modb_sections::MODB_PATH): {
-                    bin_index++;
+        std::cout << "\nmodb_sections::MODB_IP_ADDRESS:    " << modb_entry.ip_address << std::endl;
+        std::cout << "modb_sections::MODB_PORT_AND_HOST: " << modb_entry.port << ", " << modb_entry.host << std::endl;
+        std::cout << "modb_sections::MODB_DB_NAME:       " << modb_entry.name << std::endl;
+        std::cout << "modb_sections::MODB_PATH:\t   " << modb_entry.folder << std::endl;
 
-                    while(modb_bin_data[bin_index] != static_cast<unsigned char> (modb_sections::MODB_END))
-                    {
 #ifdef SERVER_SIDE
-                        DB_SS->SS_MODB_FOLDER[ind] = modb_bin_data[bin_index];
-                        ind++;
-
-                        DB_SS->DB_SS_UCPTR_REALLOC_MODB_FOLDER(ind + 1);
+        DB_SS->SS_DB_IP_ADDR = modb_entry.ip_address;
+        DB_SS->SS_DB_HOST = modb_entry.host;
+        DB_SS->SS_DB_NAME = modb_entry.name;
+        DB_SS->SS_MODB_FOLDER = modb_entry.folder;
+        memcpy(DB_SS->SS_DB_PORT, modb_entry.port.data(), modb_entry.port.size() < 4 ? modb_entry.port.size() : 4);
 #endif
+
 #ifdef CLIENT_SIDE
-                        /* TODO: Add client-side. */
+        DB_CS->CS_DB_IP_ADDR = modb_entry.ip_address;
+        DB_CS->CS_DB_NAME = modb_entry.name;
+        DB_CS->CS_MODB_FOLDER = modb_entry.folder;
+        memcpy(DB_CS->CS_DB_PORT, modb_entry.port.data(), modb_entry.port.size() < 4 ? modb_entry.port.size() : 4);
 #endif
-                        bin_index++;
-                    }
-                    memset(&DB_SS->SS_MODB_FOLDER[ind], 0, 1);
-
-                    bin_index--;
-                    std::cout << "modb_sections::MODB_PATH:\t   " << DB_SS->SS_MODB_FOLDER << std::endl;
-                    ind = 0;
-                    break;
-                }
-                default: break;
-            }
-            bin_index++;
-        }
 
         std::cout << std::endl;
-        free(modb_bin_data);
-        modb_bin_data = nullptr;
+        return modb_status::MODB_OK;
+    }
+
+public:
+    /*
+     * DatabaseConnect - connect to the database named `db_name` in the modb binary file at `modb_binary_path`.
+     *  on error: this function does not error; check `status`, a file that cannot be read or a missing
+     *            database is reported there instead of ending the program
+     *
+     *  Note: without `db_name` the database added last is used. Entries in the write-ahead log are newer than
+     *        the ones in the file, so they win over a file entry with the same name.
+     *        Only the entries in the file are found through its name index (or directory) without a scan; entries
+     *        `DB_NEW` appended to the write-ahead log are found by replaying the whole log, until a compaction
+     *        folds them into the file (see `wal_compaction.hpp`).
+     *        The file is read through `cache` (see `modb_page_cache.hpp`), or a small cache of its own without one;
+     *        a program connecting to many databases of a large file can share one cache between connects made one
+     *        at a time, so the hot part of the file stays cached within the memory it was given.
+     * */
+    DatabaseConnect(unsigned char *modb_binary_path, const unsigned char *db_name = nullptr, ModbPageCache *cache = nullptr)
+    {
+        modb_cache = cache;
+        connect_status = connect(modb_binary_path, db_name);
     }
 
+    /*
+     * status - whether the constructor connected.
+     *  returns: `MODB_OK`, or the `modb_status` it failed with
+     *  on error: this function does not error
+     * */
+    modb_status status() { return connect_status; }
+
+    /*
+     * page_cache_stats - hits, misses and evictions of the page cache the modb binary file was read through.
+     *  returns: a copy of the counters
+     *  on error: this function does not error
+     * */
+    _PageCacheStats page_cache_stats() { return modb_cache ? modb_cache->stats() : _PageCacheStats(); }
+
 #ifdef SERVER_SIDE
 
     /*
      * SS_listen - start listening at the IP address using the port.
      *  cont_run - continuous run; does the user want the server-side struct to automatically handle everything?
+     *  timeout_ms - return after this many milliseconds without any activity (no requests, connections or
+     *               `client_status` writes); -1 serves until `SS_stop`
+     *  workers - worker threads requests are performed on; 0 runs one per core
+     *  returns: `MODB_OK` once done serving, `MODB_NOT_READY` if the constructor did not connect, or `MODB_SETUP_FAILED`
+     *  on error: this function does not error directly.
+     * */
+    modb_status SS_start(bool cont_run, int timeout_ms = -1, unsigned workers = 0)
+    {
+        database_check(connect_status == modb_status::MODB_OK, modb_status::MODB_NOT_READY, "\nCannot start a server that is not connected to a database.\n")
+
+        DB_SS->SS_CLIENT_WAIT_TIMEOUT = timeout_ms;
+        DB_SS->SS_WORKER_COUNT = workers;
+        return DB_SS->start(cont_run);
+    }
+
+    /*
+     * SS_stop - make a running `SS_start(true)` return; safe to call from another thread.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void SS_stop() { if(DB_SS) DB_SS->stop(); }
+
+    /*
+     * SS_set_compaction - compact the write-ahead log once it is at least `min_log_size` bytes and at least `garbage_ratio`
+     *                     of it is garbage (see `wal_compaction.hpp`); call before `SS_start`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void SS_set_compaction(uint64_t min_log_size, double garbage_ratio)
+    {
+        if(DB_SS) DB_SS->SS_COMPACTOR.configure(min_log_size, garbage_ratio);
+    }
+
+    /*
+     * SS_compact - make a running server compact the write-ahead log now, however much of it is garbage; safe to call from another thread.
+     *  returns: nothing
+     *  on error: this function does not error; asked while a compaction is under way, the next one starts once it is done
+     * */
+    void SS_compact() { if(DB_SS) DB_SS->request_compaction(); }
+
+    /*
+     * SS_compaction_stats - what compaction has done since the server started; safe to call from another thread.
+     *  returns: a copy of the stats
+     *  on error: this function does not error
+     * */
+    _CompactionStats SS_compaction_stats() { return DB_SS ? DB_SS->SS_COMPACTOR.compaction_stats() : _CompactionStats(); }
+
+    /*
+     * SS_set_codec - persist the values of PODs of type `pod_type` (`CS_CREATING_POD_WITH_TYPE_*`) with `codec`
+     *                (a `POD_CODEC_*`, or `POD_CODEC_AUTO`, the default for streams; see `pod_codecs.hpp`); call before `SS_start`.
+     *  returns: true if `codec` can take that type else false
+     *  on error: this function does not error
+     * */
+    bool SS_set_codec(unsigned char pod_type, unsigned char codec)
+    {
+        if(!DB_SS || !DB_SS->SS_CODECS.set(pod_type, codec)) return false;
+
+        DB_SS->SS_WORKERS.set_codecs(DB_SS->SS_CODECS);
+        return true;
+    }
+
+    /*
+     * SS_set_stats - record (the default) or do not record per-phase and per-request stats; call before `SS_start`.
      *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void SS_set_stats(bool enable) { if(DB_SS) DB_SS->SS_STATS.set_enabled(enable); }
+
+    /*
+     * SS_stats - the server's counters and latency histograms as text (see `modb_stats.hpp`); safe to call from another thread.
+     *  returns: the text, empty if this is not the server-side
+     *  on error: this function does not error
+     * */
+    std::string SS_stats()
+    {
+        std::string text;
+        if(DB_SS) DB_SS->stats_report(text);
+        return text;
+    }
+
+    /*
+     * SS_dump_stats - write what `SS_stats` returns to the file at `path`, replacing it.
+     *  returns: true if the file was written else false
+     *  on error: this function does not error
+     * */
+    bool SS_dump_stats(const char *path)
+    {
+        std::string text = SS_stats();
+
+        FILE *dump = fopen(path, "wb");
+        if(!dump) return false;
+
+        bool written = fwrite(text.data(), 1, text.size(), dump) == text.size();
+        return fclose(dump) == 0 && written;
+    }
+
+#endif
+
+#ifdef CLIENT_SIDE
+
+    /*
+     * CS_connect - open a session with the server of the database (see `DatabaseClientSide::connect`).
+     *  shared_memory - move the session onto shared-memory rings when the server is on this host
+     *  returns: `MODB_OK`, `MODB_NOT_READY` if the constructor did not connect, or `MODB_NO_SERVER`
      *  on error: this function does not error directly.
      * */
-    void SS_start(bool cont_run)
+    modb_status CS_connect(bool shared_memory = true)
+    {
+        database_check(connect_status == modb_status::MODB_OK, modb_status::MODB_NOT_READY, "\nCannot reach a server without being connected to a database.\n")
+        return DB_CS->connect(shared_memory);
+    }
+
+    /*
+     * CS_client - the client-side, to issue requests through once `CS_connect` succeeded.
+     *  returns: reference to the client-side
+     *  on error: this function will error if the constructor did not connect
+     * */
+    _DatabaseClientSide &CS_client()
     {
-        DB_SS->start(cont_run);
+        database_assert(DB_CS, "\nThe client-side is not connected to a database.\n")
+        return *DB_CS;
     }
 
 #endif
@@ -400,6 +1634,9 @@ public:
         delete DB_CS;
         DB_CS = nullptr;
 #endif
+
+        if(modb_path) free(modb_path);
+        modb_path = nullptr;
     }
 };
 
@@ -8,12 +8,34 @@ enum class modb_sections: unsigned char
     MODB_DB_NAME            = 0xD3,
     MODB_IP_ADDRESS         = 0xD1,
     MODB_PATH               = 0xD4,
-    MODB_END                = 0xD5
+    MODB_END                = 0xD5,
+    /* v2 files store the host and port as separate sections. */
+    MODB_HOST               = 0xD6,
+    MODB_PORT               = 0xD7
 };
 
 /* Values that are not wanted when writing to the modb binary file. */
 unsigned char unwanted_values[1] = {0x2E};
 
+#include "modb_format.hpp"
+
+/* What became of the commits a `CreateDB` handed to a `ModbCommitQueue`; shared with the queued jobs, which can
+ * outlive the object.
+ * */
+typedef struct CommitState
+{
+    std::mutex                  lock;
+    std::condition_variable     settled;
+
+    /* Queued commits not written (or failed) yet, and whether one of them is the file image. */
+    uint32_t                    in_flight = 0;
+    bool                        image_in_flight = false;
+
+    /* Only set once a commit is known to be on disk. */
+    bool                        image_written = false;
+    bool                        committed = false;
+} _CommitState;
+
 /* TODO: Make a struct that outlines the MODB binary data structure.
  *  This will be used to check if the values already existing in the MODB binary file
  *  match the ones the user is trying to create. If they do, the program will error.
@@ -26,25 +48,30 @@ private:
      * the file that will be used to write the binary etc.
      * */
     unsigned char *path = nullptr;
-    unsigned char *folder = nullptr;
+    ModbBuffer folder;
     FILE *db_bin_file = NULL;
     size_t db_bin_file_size = 0;
-    unsigned char *existing_db_info = nullptr;
-    size_t existing_db_size = 0;
+
+    /* Commits of this object, through `commit_new_database` or a `ModbCommitQueue`. */
+    std::shared_ptr<_CommitState> commit_state = std::make_shared<_CommitState>();
+
+    /* Write-ahead log new entries get appended to when adding to an existing database (`DB_NEW`). */
+    WriteAheadLog *db_wal = nullptr;
+
+    /* Temporaries of a commit; released in one go once the commit is written. */
+    ModbArena commit_arena;
 
     /* Database information. */
-    unsigned char *db_name          = nullptr;
+    ModbBuffer db_name;
     unsigned char db_port[5]        = {0, 0, 0, 0, '\0'};
-    unsigned char *db_ip_address    = nullptr;
-    unsigned char *db_host          = nullptr;
+    ModbBuffer db_ip_address;
+    ModbBuffer db_host;
 
     /* If this is true then the database already exists. */
     bool db_exists = false;
 
-    /* We want to know if the database got committed throughout the lifetime of the program.
-     * This is used in `check_if_not_committed`.
-     * */
-    bool db_committed = false;
+    /* Whether the path given to the constructor was usable; every commit fails with this until it is `MODB_OK`. */
+    modb_status create_status = modb_status::MODB_OK;
 
     /* The `modb` binary file header is OS-specific.
      * TODO: Make it to where we can represent this with a enum value instead of having
@@ -52,6 +79,7 @@ private:
      *       Too lazy to do that right now lol.
      * 
      *  Version 0.0.1: `modb` binary file OS-specific header describes the type of OS.
+     *  Version 2: files start with `modb_v2_magic` instead; the OS name is only reported when committing.
      * */
 #ifdef _WIN32
     unsigned char modb_header[6] = {'W', 'I', 'N', '3', '2', 0};
@@ -107,7 +135,7 @@ private:
         /* Clear out any unwanted values. */
         while(ptr_size != 0)
         {
-            for(int i = 0; i <= sizeof(unwanted_values)/sizeof(unwanted_values[0]); i++)
+            for(size_t i = 0; i < sizeof(unwanted_values)/sizeof(unwanted_values[0]); i++)
                 if(src[ptr_size] == unwanted_values[i]) { src[ptr_size] = 0x0; break; }
             
             ptr_size--;
@@ -120,15 +148,27 @@ private:
      * check_modb_bin_file - check if the file is not `NULL`. If it is, open in `wb` mode.
      *  returns: nothing
      *  on error: this function does not error
+     *
+     *  Note: the `.modb` file is being started over, so a write-ahead log left from the old one is removed.
      * */
     void check_modb_bin_file()
     {
         if(db_bin_file == NULL)
+        {
             db_bin_file = fopen(NCC_PTR path, "wb");
+
+            unsigned char *wal_path = wal_path_for(path);
+            remove(NCC_PTR wal_path);
+            free(wal_path);
+        }
     }
 
-public:
-    CreateDB(unsigned char *path_for_modb_binary)
+    /*
+     * set_path - take `path` as the modb binary file and save the folder it is in.
+     *  returns: `MODB_OK`, or `MODB_INVALID_ARGUMENT` if the file is not inside a folder
+     *  on error: this function does not error
+     * */
+    modb_status set_path(unsigned char *path_for_modb_binary)
     {
         path = UC_PTR path_for_modb_binary;
 
@@ -136,51 +176,121 @@ public:
         size_t i = 0;
         while(path[i] != '\0')
         {
-            database_assert(!(path[i + 1] == '\0'),
+            database_check(!(path[i + 1] == '\0'), modb_status::MODB_INVALID_ARGUMENT,
                 "\nThe MODB binary file needs to be located inside a folder.\n")
             
-            if(path[i] == '/' && !(path[i - 1] == '.')) break;
+            if(path[i] == '/' && !(i > 0 && path[i - 1] == '.')) break;
             i++;
         }
 
         /* Save the folder. */
-        folder = UC_PTR calloc(i, sizeof(*folder));
-        for(int x = 0; x < i; x++)
-            memset(&folder[x], path[x], 1);
+        folder.append(path, i);
 
         /* Check if a database exists. */
         FILE *db_file = fopen(NCC_PTR path, "rb");
 
         if(db_file) { db_exists = true; fclose(db_file); }
+        return modb_status::MODB_OK;
     }
 
     /*
-     * modb_bin_file_seek_end_for_new - seek to the end of the modb binary file just in case the user is adding
-     *                                  a new database.
-     *  returns: nothing
-     *  on error: this function does not error.
+     * open_commit_log - open the write-ahead log of the modb binary file as `db_wal`, for commits to append to.
+     *  returns: `MODB_OK`, or `MODB_IO_ERROR` if it cannot be opened
+     *  on error: this function does not error
+     * */
+    modb_status open_commit_log()
+    {
+        unsigned char *wal_path = wal_path_for(path);
+        db_wal = new WriteAheadLog;
+
+        bool opened = db_wal->open_log(wal_path);
+        free(wal_path);
+
+        if(!opened) { delete db_wal; db_wal = nullptr; }
+        database_check(opened, modb_status::MODB_IO_ERROR, "\nError opening the write-ahead log for %s.\n", path)
+        return modb_status::MODB_OK;
+    }
+
+    /*
+     * prepare_commit - check the database's settings and make sure there is something to commit it to.
+     *  returns: `MODB_OK` with `entry` describing the database, `MODB_INVALID_ARGUMENT` if a setting is missing, or the
+     *           `modb_status` saying why the database could not be written
+     *  on error: this function does not error
      * */
-    void modb_init_new_db_entry() { 
+    modb_status prepare_commit(_ModbEntryView &entry)
+    {
+        if(create_status != modb_status::MODB_OK) return create_status;
+
+        std::cout << "Committing database to: " << path << "\n\tOS: " << modb_header << std::endl;
+
+        /* If the user did not assign a host, assign `db_host` to the default host. */
+        if(!(user_has_assigned_host()))
+            give_default_host_value();
+        
+        /* Make sure everything else has been initialized. */
+        database_check(db_port[0] != 0, modb_status::MODB_INVALID_ARGUMENT, "\nMissing database port.\n\tRun `set_new_db_port` to setup the database port.\n")
+        database_check(!db_ip_address.empty(), modb_status::MODB_INVALID_ARGUMENT, "\nMissing database IP address.\n\tRun `set_new_db_ip_addr` to setup the database IP address.\n")
+        database_check(!db_name.empty(), modb_status::MODB_INVALID_ARGUMENT, "\nMissing database name.\n\tRun `set_new_db_name` to setup the database name.\n")
+
+        /* Make sure `db_bin_file` is valid (entries added to an existing database go to the write-ahead log instead).
+         * Only opened once the settings are known to be good, opening it starts the file over.
+         * */
+        if(!db_wal) check_modb_bin_file();
+        database_check(db_wal || db_bin_file, modb_status::MODB_FILE_NOT_FOUND, "\nCould not open %s for writing.\n", path)
+
+        entry.ip_address = std::string_view(db_ip_address.c_str(), db_ip_address.size());
+        entry.host = std::string_view(db_host.c_str(), db_host.size());
+        entry.port = std::string_view(NCC_PTR db_port, strlen(NCC_PTR db_port));
+        entry.name = std::string_view(db_name.c_str(), db_name.size());
+        entry.folder = std::string_view(folder.c_str(), folder.size());
+        return modb_status::MODB_OK;
+    }
+
+public:
+    /* Check `status` afterwards; a bad path is reported there instead of ending the program. */
+    CreateDB(unsigned char *path_for_modb_binary)
+    {
+        create_status = set_path(path_for_modb_binary);
+    }
+
+    /*
+     * status - whether the constructor could use the path it was given.
+     *  returns: `MODB_OK`, or the `modb_status` it failed with
+     *  on error: this function does not error
+     * */
+    modb_status status() { return create_status; }
+
+    /*
+     * modb_init_new_db_entry - prepare to add a new database entry to an existing modb binary file.
+     *  returns: `MODB_OK`, `MODB_FILE_NOT_FOUND` if the modb binary file does not exist or `MODB_IO_ERROR` if its
+     *           write-ahead log cannot be opened
+     *  on error: this function does not error
+     *
+     *  Note: the new entry is appended to the write-ahead log (`<path>.wal`) instead of rewriting the modb binary file,
+     *        `DatabaseConnect` replays it on startup.
+     * */
+    modb_status modb_init_new_db_entry() { 
+        if(create_status != modb_status::MODB_OK) return create_status;
+
+        /* Until the log is open, commits fail instead of starting the modb binary file over. */
+        create_status = modb_status::MODB_NOT_READY;
+
         db_exists = false;
         db_bin_file = fopen(NCC_PTR path, "rb");
 
         /* Make sure the modb binary file exists. */
-        database_assert(db_bin_file, 
+        database_check(db_bin_file, modb_status::MODB_FILE_NOT_FOUND,
             "\nThe MODB database binary file %s does not exist.\nTry using `database_method::DB_CREATE`.\n\tIf you want the program to auto comit the database, use `database_method::DB_CREATE_AND_AUTO_COMMIT`.\n",
             path)
 
-
-        /* Get size. */
-        fseek(db_bin_file, 0, SEEK_END);
-        existing_db_size = ftell(db_bin_file);
-        fseek(db_bin_file, 0, SEEK_SET);
-
-        existing_db_info = UC_PTR calloc(existing_db_size, sizeof(*existing_db_info));
-        fread(existing_db_info, sizeof(unsigned char), existing_db_size, db_bin_file);
         fclose(db_bin_file);
+        db_bin_file = NULL;
 
-        /* Open `path` to write bytes. */
-        db_bin_file = fopen(NCC_PTR path, "wb");
+        modb_status opened = open_commit_log();
+        if(opened != modb_status::MODB_OK) return opened;
+
+        create_status = modb_status::MODB_OK;
+        return modb_status::MODB_OK;
     }
 
     /*
@@ -204,19 +314,8 @@ public:
      * */
     void new_name(unsigned char *name)
     {
-        db_name = UC_PTR calloc(1, sizeof(*db_name));
-        
-        /* Make sure `db_name` got allocated and did not come back `NULL`. */
-        database_assert(db_name, "\nError allocating initial memory for `db_name`.\n")
-
-        size_t index = 0;
-        while(name[index] != '\0')
-        {
-            db_name[index] = name[index];
-            index++;
-
-            db_name = reallocate_UC_ptr(db_name, index + 1);
-        }
+        db_name.clear();
+        db_name.append_cstr(name);
     }
 
     /*
@@ -226,69 +325,45 @@ public:
      * */
     void new_ip_address(unsigned char *ip_address)
     {
-        db_ip_address = UC_PTR calloc(1, sizeof(*db_ip_address));
-
-        /* Make sure `db_ip_address` got allocated and did not come back `NULL`. */
-        database_assert(db_ip_address, "\nError allocating initial memory for `db_ip_address`.\n")
-
-        size_t index = 0;
-        while(ip_address[index] != '\0')
-        {
-            db_ip_address[index] = ip_address[index];
-            index++;
-
-            db_ip_address = reallocate_UC_ptr(db_ip_address, index + 1);
-        }
-
-        memset(&db_ip_address[index], 0, 1);
+        db_ip_address.clear();
+        db_ip_address.append_cstr(ip_address);
     }
 
     /*
      * new_host - assign `db_host`.
      *  returns: nothing
-     *  on error: this function will error if the length of `*host` is > 4 or if there is a value that is not a number
+     *  on error: this function will error if a memory allocation fails
      * */
     void new_host(unsigned char *host)
     {
-        db_host = UC_PTR calloc(1, sizeof(*db_host));
-
-        /* Make sure `db_host` got allocated and did not come back `NULL`. */
-        database_assert(db_host, "\nError allocating initial memory for `db_host`.\n")
-
-        size_t index = 0;
-        while(host[index] != '\0')
-        {
-            db_host[index] = host[index];
-            index++;
-
-            db_host = reallocate_UC_ptr(db_host, index + 1);
-        }
-
-        memset(&db_host[index], 0, 1);
+        db_host.clear();
+        db_host.append_cstr(host);
     }
 
     /*
      * new_port - assign `db_port`.
-     *  returns: nothing
-     *  on error: this functions will error if memory allocation fails
+     *  returns: `MODB_OK`, or `MODB_INVALID_ARGUMENT` if `port` is not 4 digits (`db_port` is left as it was)
+     *  on error: this function does not error
      * */
-    void new_port(unsigned char *port)
+    modb_status new_port(unsigned char *port)
     {
         unsigned char i = 0;
         while(port[i] != '\0')
         {
             /* Make sure the value is not non-ascii related. */
-            database_assert(!((port[i] >= 'a' && port[i] <= 'z') || (port[i] >= 'A' && port[i] <= 'Z')),
+            database_check(!((port[i] >= 'a' && port[i] <= 'z') || (port[i] >= 'A' && port[i] <= 'Z')), modb_status::MODB_INVALID_ARGUMENT,
                 "\n`port` must be represented by just numbers, no letters.\n")
             
             i++;
         }
 
         /* If the length of `port` is > 4, error. */
-        database_assert(i == 4, "\n`port` must be represented by 4 digits, not %d.\n", i)
+        database_check(i == 4, modb_status::MODB_INVALID_ARGUMENT, "\n`port` must be represented by 4 digits, not %d.\n", i)
 
-        for(i = 0; i < 6; i++)
+        for(i = 0; i < 5; i++)
             memset(&db_port[i], port[i], 1);
+
+        return modb_status::MODB_OK;
     }
 
     /*
@@ -313,118 +388,167 @@ public:
     }
 
     /*
-     * committ_new_database - committ the database and write to `db_bin_file`.
-     *  returns: nothing
-     *  on error: this function will error if there was a problem writing to `db_bin_file`, or if there was
-     *            a memory allocation error
+     * image_on_disk - wait for a file image handed to a `ModbCommitQueue` to be written or fail, then check whether
+     *                 the modb binary file holds one.
+     *  returns: true if a commit wrote the file image else false
+     *  on error: this function does not error
+     *
+     *  Note: until the image is known to be on disk, commits are not routed to the write-ahead log; a log entry
+     *        with no image under it would be all a reader finds if the image then failed.
      * */
-    void commit_new_database()
+    bool image_on_disk()
     {
-        /* Make sure `db_bin_file` is valid. */
-        check_modb_bin_file();
-
-        std::cout << "Committing database to: " << path << "\n\tOS: " << modb_header << std::endl;
+        std::unique_lock<std::mutex> guard(commit_state->lock);
+        while(commit_state->image_in_flight) commit_state->settled.wait(guard);
+        return db_bin_file_size != 0 || commit_state->image_written;
+    }
 
-        /* If the user did not assign a host, assign `db_host` to the default host. */
-        if(!(user_has_assigned_host()))
-            give_default_host_value();
-        
-        /* Make sure everything else has been initialized. */
-        database_assert(db_port, "\nMissing database port.\n\tRun `set_new_db_port` to setup the database port.\n")
-        database_assert(db_ip_address, "\nMissing database IP address.\n\tRun `set_new_db_ip_addr` to setup the database IP address.\n")
-        database_assert(db_name, "\nMissing database name.\n\tRun `set_new_db_name` to setup the database name.\n")
-
-        size_t bin_data_size = sizeof(modb_header)/sizeof(modb_header[0]);
-        unsigned char *modb_db_binary = UC_PTR calloc(bin_data_size, sizeof(*modb_db_binary));
-
-        /* Make sure `modb_db_binary` got allocated and did not come back `NULL`. */
-        database_assert(modb_db_binary, "\nError allocating initial memory for `modb_db_binary`.\n")
-
-        /* Assign the `modb_header` first. */
-        memcpy(modb_db_binary, modb_header, bin_data_size);
-
-        /* "Clear" out all memory in `modb_header` (set all elements to zero). */
-        memset(modb_header, 0, bin_data_size);
-
-        /* Database IP Address sections. */
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, bin_data_size + 1);
-        memset(&modb_db_binary[bin_data_size], static_cast<unsigned char> (modb_sections::MODB_IP_ADDRESS), 1);
-        bin_data_size++;
-
-        /* Get the length of the IP address. */
-        size_t val_size = 0;
-        while(db_ip_address[val_size] != '\0') val_size++;
-
-        /* Assign the IP address followed by a byte of padding. */
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, (bin_data_size + val_size) + 1);
-        memcpy(&modb_db_binary[bin_data_size], db_ip_address, val_size);
-        memset(&modb_db_binary[bin_data_size + val_size + 1], 0, 1);
-        bin_data_size += val_size + 1;
-
-        /* Database port and host section. */
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, bin_data_size + 1);
-        memset(&modb_db_binary[bin_data_size], static_cast<unsigned char> (modb_sections::MODB_PORT_AND_HOST), 1);
-        bin_data_size++;
-
-        /* Get the length of the port. */
-        val_size = 0;
-        while(db_host[val_size] != '\0') val_size++;
-
-        /* Assign the port followed by a byte of padding. */
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, (bin_data_size + val_size) + 1);
-        memcpy(&modb_db_binary[bin_data_size], db_host, val_size);
-        memset(&modb_db_binary[bin_data_size + val_size + 1], 0, 1);
-        bin_data_size += val_size + 1;
-        
-        /* Assign the host followed by a byte of padding. */
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, bin_data_size + 5);
-        memcpy(&modb_db_binary[bin_data_size], db_port, 5);
-        bin_data_size += 5;
-
-        /* Database name section. */
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, bin_data_size + 1);
-        memset(&modb_db_binary[bin_data_size], static_cast<unsigned char> (modb_sections::MODB_DB_NAME), 1);
-        bin_data_size++;
-        
-        /* Get the database name size. */
-        val_size = 0;
-        while(db_name[val_size] != '\0') val_size++;
+    /*
+     * committ_new_database - committ the database and write to `db_bin_file`, returning once it is on disk.
+     *  returns: `MODB_OK`, `MODB_INVALID_ARGUMENT` if a setting is missing, or the `modb_status` saying why the
+     *           database could not be written
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    modb_status commit_new_database()
+    {
+        _ModbEntryView entry;
+        modb_status prepared = prepare_commit(entry);
+        if(prepared != modb_status::MODB_OK) return prepared;
 
-        /* Assign the database name. */
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, (bin_data_size + val_size) + 1);
-        memcpy(&modb_db_binary[bin_data_size], db_name, val_size);
-        memset(&modb_db_binary[bin_data_size + val_size + 1], 0, 1);
-        bin_data_size += val_size + 1;
+        /* Once the modb binary file is written, later commits of this object go to its write-ahead log like `DB_NEW`;
+         * another file image appended to it would not be readable.
+         * */
+        if(!db_wal && image_on_disk())
+        {
+            modb_status opened = open_commit_log();
+            if(opened != modb_status::MODB_OK) return opened;
+        }
 
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, bin_data_size + 1);
-        memset(&modb_db_binary[bin_data_size], static_cast<unsigned char> (modb_sections::MODB_PATH), 1);
-        bin_data_size++;
+        /* When adding to an existing database (`database_method::DB_NEW`) only the new entry's sections are
+         * appended to the write-ahead log, the existing modb binary file is left alone.
+         * */
+        bool written;
+        if(db_wal)
+        {
+            ModbBuffer modb_db_entry(&commit_arena);
+            modb_v2_encode_entry(modb_db_entry, entry, nullptr);
+
+            /* A server compacting the log replaces it by a rename; the lock makes sure the entry lands in the log at the path. */
+            written = db_wal->lock_file();
+            if(written)
+            {
+                db_wal->append(WAL_RECORD_DB_ENTRY_V2, modb_db_entry.data(), modb_db_entry.size());
+                written = db_wal->commit();
+                db_wal->unlock_file();
+            }
+        }
+        else
+        {
+            ModbWriterV2 modb_db_binary(&commit_arena);
+            modb_db_binary.add_entry(entry);
+
+            /* Written over whatever a failed attempt left, then synced along with the folder, so the file is there after a crash. */
+            ModbBuffer &modb_db_file = modb_db_binary.finish();
+            written = fflush(db_bin_file) == 0 && ftruncate(fileno(db_bin_file), 0) == 0 && fseek(db_bin_file, 0, SEEK_SET) == 0 &&
+                      fwrite(modb_db_file.data(), sizeof(unsigned char), modb_db_file.size(), db_bin_file) == modb_db_file.size() &&
+                      fflush(db_bin_file) == 0 && modb_sync_descriptor(fileno(db_bin_file), true) &&
+                      modb_sync_folder(modb_folder_of(NCC_PTR path));
+            if(written) db_bin_file_size = modb_db_file.size();
+        }
+        commit_arena.reset();
 
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, bin_data_size + strlen(NCC_PTR folder));
-        memcpy(&modb_db_binary[bin_data_size], folder, strlen(NCC_PTR folder));
-        bin_data_size += strlen(NCC_PTR folder);
+        database_check(written, modb_status::MODB_IO_ERROR, "\nError writing the database to %s%s.\n", path, db_wal ? "'s write-ahead log" : "")
 
-        modb_db_binary = reallocate_UC_ptr(modb_db_binary, bin_data_size + 1);
-        memset(&modb_db_binary[bin_data_size], static_cast<unsigned char> (modb_sections::MODB_END), 1);
-        bin_data_size++;
+        std::lock_guard<std::mutex> guard(commit_state->lock);
+        commit_state->committed = true;
+        return modb_status::MODB_OK;
+    }
 
-        //UC_ptr_check(modb_db_binary, bin_data_size);
+    /*
+     * commit_new_database_async - committ the database like `commit_new_database`, but hand the write and its sync to
+     *                             `queue` instead of waiting for them.
+     *  returns: a future holding the commit's `modb_status` once it is on disk (or failed); `done`, if given, is called
+     *           with it first, on the queue's thread, or right away on this one if the commit could not be queued
+     *  on error: this function will error if there was a memory allocation error
+     *
+     *  Note: the queued commit owns its bytes and descriptor, so this object can go away before it is written.
+     *  Note: this object only counts as committed, and later commits only go to the write-ahead log, once the queue
+     *        reported `MODB_OK`; a commit made while a file image is still queued waits for it first.
+     * */
+    std::future<modb_status> commit_new_database_async(ModbCommitQueue &queue, std::function<void(modb_status)> done)
+    {
+        _ModbEntryView entry;
+        modb_status prepared = prepare_commit(entry);
+        if(prepared != modb_status::MODB_OK)
+        {
+            if(done) done(prepared);
+            return modb_commit_ready(prepared);
+        }
 
-        /* If there is existing database data, write that before writing new data.
-         * This will only happen if the user passes `database_method::DB_NEW` to `Database` class
-         * initializer.
-         * */
-        if(existing_db_info != nullptr)
-            fwrite(existing_db_info, sizeof(unsigned char), existing_db_size, db_bin_file);
+        /* Like `commit_new_database`, only the first commit writes the file image, the ones after it go to the log. */
+        if(!db_wal && image_on_disk())
+        {
+            modb_status opened = open_commit_log();
+            if(opened != modb_status::MODB_OK)
+            {
+                if(done) done(opened);
+                return modb_commit_ready(opened);
+            }
+        }
 
-        fwrite(modb_db_binary, sizeof(unsigned char), bin_data_size, db_bin_file);
+        _ModbCommitJob *job = new _ModbCommitJob;
+        if(db_wal)
+        {
+            ModbBuffer modb_db_entry(&commit_arena);
+            modb_v2_encode_entry(modb_db_entry, entry, nullptr);
+            WriteAheadLog::encode_record(job->data, WAL_RECORD_DB_ENTRY_V2, nullptr, 0, modb_db_entry.data(), (uint32_t) modb_db_entry.size());
+
+            /* The queue opens and locks the log at the path itself, like `WriteAheadLog::lock_file`. */
+            unsigned char *wal_path = wal_path_for(path);
+            job->log_path = NCC_PTR wal_path;
+            free(wal_path);
+        }
+        else
+        {
+            ModbWriterV2 modb_db_binary(&commit_arena);
+            modb_db_binary.add_entry(entry);
+
+            ModbBuffer &modb_db_file = modb_db_binary.finish();
+            job->data.assign(modb_db_file.data(), modb_db_file.data() + modb_db_file.size());
+
+            /* Written over whatever a failed attempt left; the queue cuts it back off if the write fails. */
+            if(fflush(db_bin_file) != 0 || ftruncate(fileno(db_bin_file), 0) != 0) job->fd = -1;
+            else job->fd = dup(fileno(db_bin_file));
+            job->offset = 0;
+            job->file_path = NCC_PTR path;
+            job->folder = modb_folder_of(NCC_PTR path);
+        }
+        commit_arena.reset();
 
-        /* Free out memory used for `modb_db_binary`. */
-        memset(modb_db_binary, 0, bin_data_size);
-        free(modb_db_binary);
-        modb_db_binary = nullptr;
+        bool image = !db_wal;
+        {
+            std::lock_guard<std::mutex> guard(commit_state->lock);
+            commit_state->in_flight++;
+            if(image) commit_state->image_in_flight = true;
+        }
 
-        db_committed = true;
+        std::shared_ptr<_CommitState> state = commit_state;
+        job->callback = [state, image, done](modb_status status) {
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                state->in_flight--;
+                if(status == modb_status::MODB_OK) state->committed = true;
+                if(image)
+                {
+                    state->image_in_flight = false;
+                    if(status == modb_status::MODB_OK) state->image_written = true;
+                }
+            }
+            state->settled.notify_all();
+
+            if(done) done(status);
+        };
+        return queue.submit(job);
     }
 
     /*
@@ -435,15 +559,20 @@ public:
      * */
     void check_if_not_committed()
     {
-        if(!db_committed) std::cout << "\nMODB Notice:\n\tYour program initiated a new database but did not committ it.\n\n\tIf you want the program to automatically committ the database for you\n\tpass `DB_CREATE_AND_AUTO_COMMITT` when initializing `Database`.\n" << std::endl;
+        if(!db_has_been_committed()) std::cout << "\nMODB Notice:\n\tYour program initiated a new database but did not committ it.\n\n\tIf you want the program to automatically committ the database for you\n\tpass `DB_CREATE_AND_AUTO_COMMITT` when initializing `Database`.\n" << std::endl;
     }
 
     /*
      * db_has_been_committed - check if the database has been committed.
-     *  returns: if the database has been committed it will return true else false
+     *  returns: true if a commit is on disk or still queued (its future tells how it went), false if none was made
+     *           or every one failed
      *  on error: this function does not error
      * */
-    bool db_has_been_committed() { return db_committed; }
+    bool db_has_been_committed()
+    {
+        std::lock_guard<std::mutex> guard(commit_state->lock);
+        return commit_state->committed || commit_state->in_flight > 0;
+    }
 
     ~CreateDB()
     {
@@ -451,17 +580,8 @@ public:
         if(db_bin_file)
             fclose(db_bin_file);
         
-        if(db_name) free(db_name);
-        if(db_host) free(db_host);
-        if(db_ip_address) free(db_ip_address);
-        if(existing_db_info) free(existing_db_info);
-        if(folder) free(folder);
-
-        db_name = nullptr;
-        db_host = nullptr;
-        db_ip_address = nullptr;
-        existing_db_info = nullptr;
-        folder = nullptr;
+        if(db_wal) delete db_wal;
+        db_wal = nullptr;
         db_bin_file = NULL;
 
         memset(db_port, 0, 5);
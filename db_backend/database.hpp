@@ -1,8 +1,63 @@
 #ifndef database
 #define database
 #include <stdlib.h>
+#include <cstddef>
 #include <cstring>
+#include <stdint.h>
+#include <errno.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <map>
+#include <set>
+#include <tuple>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <array>
+#include <utility>
 
+#if defined(__unix) || defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <linux/io_uring.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* `database_error`/`database_assert` end the process; they are only for memory allocation failures and for
+ * misusing the API. Anything a file, a setting or a client can get wrong goes through `database_fail`/`database_check`,
+ * which report the message and return a `modb_status` so a running server stays up.
+ * */
 #define database_error(err_msg, ...)            \
 {                                               \
     fprintf(stderr, err_msg, ##__VA_ARGS__);    \
@@ -12,6 +67,51 @@
     if(!(cond))                                 \
         database_error(err_msg, ##__VA_ARGS__)
 
+#define database_fail(status, err_msg, ...)                                     \
+{                                                                               \
+    snprintf(modb_last_error(), MODB_ERROR_MESSAGE_SIZE, err_msg, ##__VA_ARGS__); \
+    fputs(modb_last_error(), stderr);                                           \
+    return status;                                                              \
+}
+#define database_check(cond, status, err_msg, ...)  \
+    if(!(cond))                                     \
+        database_fail(status, err_msg, ##__VA_ARGS__)
+
+/* Result of anything that can fail without ending the process. */
+enum class modb_status: unsigned char
+{
+    MODB_OK                 = 0x0,
+    /* A `.modb` file (or the folder it should be in) does not exist or cannot be opened. */
+    MODB_FILE_NOT_FOUND     = 0x1,
+    /* The `.modb` file is not a MODB file, or is cut short. */
+    MODB_FILE_DAMAGED       = 0x2,
+    /* Reading, writing or migrating a file (or its write-ahead log) failed. */
+    MODB_IO_ERROR           = 0x3,
+    /* There is no database with the name asked for. */
+    MODB_NO_SUCH_DATABASE   = 0x4,
+    /* A value handed to the API is not valid (e.g. a port with letters in it). */
+    MODB_INVALID_ARGUMENT   = 0x5,
+    /* The object failed to set up earlier, see the status it was left with. */
+    MODB_NOT_READY          = 0x6,
+    /* The server could not set up its event loop, listeners or status files. */
+    MODB_SETUP_FAILED       = 0x7,
+    /* The client-side could not reach the server of the database. */
+    MODB_NO_SERVER          = 0x8
+};
+
+#define MODB_ERROR_MESSAGE_SIZE     512
+
+/*
+ * modb_last_error - message of the last `database_fail` on this thread.
+ *  returns: the message, empty if nothing has failed
+ *  on error: this function does not error
+ * */
+inline char *modb_last_error()
+{
+    static thread_local char message[MODB_ERROR_MESSAGE_SIZE] = {0};
+    return message;
+}
+
 #define UC_PTR        (unsigned char *)       // (U)nsigned (C)har
 #define UCC_PTR       (unsigned const char *) // (U)nsigned (C)onstant (C)har
 #define NC_PTR        (char *)                // (N)ormal (C)har
@@ -48,6 +148,84 @@ unsigned char *reallocate_UC_ptr(unsigned char *src, size_t new_size)
     return src;
 }
 
+/*
+ * modb_put_u16/modb_put_u32/modb_put_u64 - write a 16/32/64-bit value to `dst` in little-endian byte order.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+inline void modb_put_u16(unsigned char *dst, uint16_t val)
+{
+    dst[0] = val & 0xFF;
+    dst[1] = (val >> 8) & 0xFF;
+}
+
+inline void modb_put_u32(unsigned char *dst, uint32_t val)
+{
+    dst[0] = val & 0xFF;
+    dst[1] = (val >> 8) & 0xFF;
+    dst[2] = (val >> 16) & 0xFF;
+    dst[3] = (val >> 24) & 0xFF;
+}
+
+inline void modb_put_u64(unsigned char *dst, uint64_t val)
+{
+    modb_put_u32(dst, (uint32_t) val);
+    modb_put_u32(&dst[4], (uint32_t) (val >> 32));
+}
+
+/*
+ * modb_get_u16/modb_get_u32/modb_get_u64 - read a little-endian 16/32/64-bit value from `src`.
+ *  returns: the value
+ *  on error: this function does not error
+ * */
+inline uint16_t modb_get_u16(const unsigned char *src)
+{
+    return (uint16_t) (src[0] | (src[1] << 8));
+}
+
+inline uint32_t modb_get_u32(const unsigned char *src)
+{
+    return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+inline uint64_t modb_get_u64(const unsigned char *src)
+{
+    return (uint64_t) modb_get_u32(src) | ((uint64_t) modb_get_u32(&src[4]) << 32);
+}
+
+/*
+ * modb_crc32 - CRC-32 (IEEE 802.3 polynomial) of `size` bytes at `data`.
+ *  returns: the checksum
+ *  on error: this function does not error
+ * */
+inline uint32_t modb_crc32(const unsigned char *data, size_t size)
+{
+    /* Built once, on first use. */
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> crc_table(256);
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for(int bit = 0; bit < 8; bit++)
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            crc_table[i] = crc;
+        }
+        return crc_table;
+    }();
+
+    uint32_t crc = 0xFFFFFFFF;
+    for(size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+#include "modb_arena.hpp"
+#include "modb_buffer.hpp"
+#include "modb_mmap.hpp"
+#include "modb_page_cache.hpp"
+#include "write_ahead_log.hpp"
+#include "modb_commit_queue.hpp"
 #include "create_new_db.hpp"
 #include "connect_db.hpp"
 
@@ -73,25 +251,48 @@ private:
     /* For creating new database. */
     CreateDB *database_create = nullptr;
 
+    /* Set when the constructor fails; nothing is committed (or auto-committed) after that. */
+    modb_status DB_status = modb_status::MODB_OK;
+
     /* For existing database. */
-public:
-    Database(enum database_method db_method, unsigned char *path)
-    {
-        DB_method = db_method;
 
+    /*
+     * open - set up `database_create` for `db_method`.
+     *  returns: `MODB_OK`, or the `modb_status` saying why it could not be set up
+     *  on error: this function does not error
+     * */
+    modb_status open(unsigned char *path)
+    {
         switch(DB_method)
         {
             case database_method::DB_CREATE: 
-            case database_method::DB_CREATE_AND_AUTO_COMMIT: database_create = new CreateDB(path);break;
+            case database_method::DB_CREATE_AND_AUTO_COMMIT: {
+                database_create = new CreateDB(path);
+                return database_create->status();
+            }
             case database_method::DB_NEW: {
                 database_create = new CreateDB(path);
-                database_create->modb_init_new_db_entry();
-                break;
+                return database_create->modb_init_new_db_entry();
             }
-            default: database_error("\nInvalid Method.\n")
+            default: database_fail(modb_status::MODB_INVALID_ARGUMENT, "\nInvalid Method.\n")
         }
     }
 
+public:
+    /* Check `status` afterwards; a bad path or method is reported there instead of ending the program. */
+    Database(enum database_method db_method, unsigned char *path)
+    {
+        DB_method = db_method;
+        DB_status = open(path);
+    }
+
+    /*
+     * status - whether the database could be set up with the method and path it was given.
+     *  returns: `MODB_OK`, or the `modb_status` the constructor failed with
+     *  on error: this function does not error
+     * */
+    modb_status status() { return DB_status; }
+
     /* ----- CREATING DB FUNCTIONALITY. -------- */
 
     /*
@@ -99,42 +300,63 @@ public:
      *  returns: nothing
      *  on error: this function does not error directly
      * */
-    void set_new_db_name(unsigned char *new_db_name) { database_create->new_name(new_db_name); }
+    void set_new_db_name(unsigned char *new_db_name) { if(database_create) database_create->new_name(new_db_name); }
 
     /*
      * set_new_db_ip_addr - assign new ip address to the database.
      *  returns: nothing
      *  on error: this function does not error directly
      * */
-    void set_new_db_ip_addr(unsigned char *new_db_ip_addr) { database_create->new_ip_address(new_db_ip_addr); }
+    void set_new_db_ip_addr(unsigned char *new_db_ip_addr) { if(database_create) database_create->new_ip_address(new_db_ip_addr); }
 
     /*
      * set_new_db_host - assign new host to the database.
      *  returns: nothing
      *  on error: this function does not error directly
      * */
-    void set_new_db_host(unsigned char *new_db_host) { database_create->new_host(new_db_host); }
+    void set_new_db_host(unsigned char *new_db_host) { if(database_create) database_create->new_host(new_db_host); }
 
     /*
      * set_new_db_port - assign new port to the database.
-     *  returns: nothing
+     *  returns: `MODB_OK`, or `MODB_INVALID_ARGUMENT` if the port is not 4 digits
      *  on error: this function does not error directly
      * */
-    void set_new_db_port(unsigned char *new_db_port) { database_create->new_port(new_db_port); }
+    modb_status set_new_db_port(unsigned char *new_db_port) { return database_create ? database_create->new_port(new_db_port) : DB_status; }
 
     /*
-     * commit_db - committ the database to the `.modb` binary file.
-     *  returns: nothing (TODO - should this return something?)
+     * commit_db - committ the database to the `.modb` binary file, returning once it is on disk.
+     *  returns: `MODB_OK`, or the `modb_status` saying why the database could not be committed
      *  on error: this function does not error directly
      * */
-    void commit_db() { database_create->commit_new_database(); }
+    modb_status commit_db()
+    {
+        if(DB_status != modb_status::MODB_OK) return DB_status;
+        return database_create->commit_new_database();
+    }
+
+    /*
+     * commit_async - committ the database like `commit_db` without waiting for the write; commits made around the
+     *                same time (by any `Database`) are written and synced together (see `modb_commit_queue.hpp`).
+     *  returns: a future holding `MODB_OK` once the database is on disk, or the `modb_status` saying why it is not;
+     *           `done`, if given, is called with the same status first (on `queue`'s thread once it was queued)
+     *  on error: this function does not error directly
+     * */
+    std::future<modb_status> commit_async(std::function<void(modb_status)> done = nullptr, ModbCommitQueue *queue = nullptr)
+    {
+        if(DB_status != modb_status::MODB_OK)
+        {
+            if(done) done(DB_status);
+            return modb_commit_ready(DB_status);
+        }
+        return database_create->commit_new_database_async(queue ? *queue : modb_shared_commit_queue(), std::move(done));
+    }
 
     /* ----- END DB CREATION FUNCTIONALITY -----*/
 
     ~Database()
     {
         /* If the user did not commit, let them know. */
-        if(!(database_create->db_has_been_committed()) && (DB_method == database_method::DB_CREATE_AND_AUTO_COMMIT || DB_method == database_method::DB_NEW))
+        if(DB_status == modb_status::MODB_OK && database_create && !(database_create->db_has_been_committed()) && (DB_method == database_method::DB_CREATE_AND_AUTO_COMMIT || DB_method == database_method::DB_NEW))
             database_create->commit_new_database();
         /*if(DB_method == database_method::DB_CREATE_AND_AUTO_COMMITT || !(database_create->db_has_been_committed()))
             database_create->committ_new_database();
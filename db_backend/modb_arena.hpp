@@ -0,0 +1,148 @@
+#ifndef modb_arena
+#define modb_arena
+
+/* Size of the first chunk an arena allocates. */
+#define MODB_ARENA_CHUNK_SIZE       4096
+
+/* Bump allocator for temporaries that all die at the same time (one commit, one parse).
+ *
+ * `allocate` hands out memory from the current chunk and only goes to the heap when the chunk runs out;
+ * nothing is freed on its own, `reset` releases everything in one shot. If the last round needed more
+ * than one chunk, `reset` swaps them for a single chunk big enough for all of it, so from the next round
+ * on the same work makes no heap allocations at all.
+ * */
+class ModbArena
+{
+private:
+    typedef struct ArenaChunk
+    {
+        struct ArenaChunk   *previous;
+        size_t              size;
+    } _ArenaChunk;
+
+    _ArenaChunk *chunk = nullptr;
+    size_t chunk_used = 0;
+
+    /* Bytes handed out since the last `reset`, and across every chunk currently held. */
+    size_t used = 0;
+    size_t held = 0;
+
+    /*
+     * add_chunk - start a new chunk with room for at least `needed` bytes.
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void add_chunk(size_t needed)
+    {
+        size_t size = chunk ? chunk->size * 2 : MODB_ARENA_CHUNK_SIZE;
+        if(size < needed + sizeof(_ArenaChunk)) size = needed + sizeof(_ArenaChunk);
+
+        _ArenaChunk *grown = (_ArenaChunk *) malloc(size);
+        database_assert(grown, "\nError growing a MODB arena by %zu bytes.\n", size)
+
+        grown->previous = chunk;
+        grown->size = size;
+
+        chunk = grown;
+        chunk_used = sizeof(_ArenaChunk);
+        held += size;
+        heap_allocations().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release_chunks()
+    {
+        while(chunk)
+        {
+            _ArenaChunk *previous = chunk->previous;
+            free(chunk);
+            chunk = previous;
+        }
+        held = 0;
+    }
+
+public:
+    ModbArena() {}
+
+    /* Start with one chunk of `initial_size` bytes. */
+    explicit ModbArena(size_t initial_size) { add_chunk(initial_size); }
+
+    ModbArena(const ModbArena &) = delete;
+    ModbArena &operator=(const ModbArena &) = delete;
+
+    /*
+     * heap_allocations - number of chunks every `ModbArena` allocated so far (for benchmarks).
+     *  returns: reference to the counter; atomic, since worker threads grow their own buffers concurrently
+     *  on error: this function does not error
+     * */
+    static std::atomic<uint64_t> &heap_allocations()
+    {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+
+    /*
+     * allocate - get `size` bytes aligned to `align` (a power of two); valid until the next `reset`.
+     *  returns: pointer to the memory
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        size_t at = chunk ? (chunk_used + align - 1) & ~(align - 1) : 0;
+        if(!chunk || at + size > chunk->size)
+        {
+            add_chunk(size + align);
+            at = (chunk_used + align - 1) & ~(align - 1);
+        }
+
+        chunk_used = at + size;
+        used += size;
+
+        return (unsigned char *) chunk + at;
+    }
+
+    /*
+     * grow - resize the block `old` (of `old_size` bytes) to `new_size` bytes, in place if it was the last one handed out.
+     *  returns: pointer to the (possibly moved) block
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void *grow(void *old, size_t old_size, size_t new_size)
+    {
+        unsigned char *end = (unsigned char *) chunk + chunk_used;
+        if(old && (unsigned char *) old + old_size == end && chunk_used - old_size + new_size <= chunk->size)
+        {
+            chunk_used += new_size - old_size;
+            used += new_size - old_size;
+            return old;
+        }
+
+        void *moved = allocate(new_size);
+        if(old && old_size > 0) memcpy(moved, old, old_size);
+        return moved;
+    }
+
+    /*
+     * reset - release everything allocated so far in one shot.
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void reset()
+    {
+        if(chunk && chunk->previous)
+        {
+            /* Needed several chunks this round; keep a single one that fits all of it next time. */
+            size_t fits = held;
+            release_chunks();
+            add_chunk(fits);
+        }
+
+        if(chunk) chunk_used = sizeof(_ArenaChunk);
+        used = 0;
+    }
+
+    size_t bytes_used() const { return used; }
+    size_t bytes_held() const { return held; }
+
+    ~ModbArena() { release_chunks(); }
+};
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef modb_buffer
+#define modb_buffer
+
+/* Bytes a `ModbBuffer` holds inline before it goes to the heap. */
+#define MODB_BUFFER_INLINE_SIZE     64
+
+/* Growable byte buffer.
+ *
+ * Small contents live inside the object itself; past `MODB_BUFFER_INLINE_SIZE` bytes the buffer moves
+ * to the heap and doubles its capacity whenever it runs out, so appending n bytes one at a time costs
+ * O(log n) allocations instead of one `reallocate_UC_ptr` call per byte.
+ *
+ * A buffer given a `ModbArena` grows inside the arena instead of on the heap; its memory is released
+ * by the arena's `reset`, so the buffer must not outlive it.
+ *
+ * The contents are always followed by a NUL byte, so `c_str` can be handed to C APIs directly.
+ * */
+class ModbBuffer
+{
+private:
+    unsigned char *buf_data;
+    size_t buf_size = 0;
+    /* Usable bytes, not counting the byte reserved for the trailing NUL. */
+    size_t buf_capacity = MODB_BUFFER_INLINE_SIZE - 1;
+    unsigned char inline_data[MODB_BUFFER_INLINE_SIZE];
+
+    /* Arena the buffer grows in, or nullptr for the heap. */
+    ModbArena *buf_arena = nullptr;
+
+    bool on_heap() const { return buf_data != inline_data && !buf_arena; }
+
+    /*
+     * grow - make room for at least `needed` bytes.
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void grow(size_t needed)
+    {
+        size_t new_capacity = buf_capacity * 2 + 1;
+        if(new_capacity < needed) new_capacity = needed;
+
+        unsigned char *grown;
+        if(buf_arena)
+        {
+            bool in_arena = buf_data != inline_data;
+            grown = UC_PTR buf_arena->grow(in_arena ? buf_data : nullptr, in_arena ? buf_capacity + 1 : 0, new_capacity + 1);
+            if(!in_arena) memcpy(grown, inline_data, buf_size + 1);
+        }
+        else if(on_heap())
+            grown = UC_PTR realloc(buf_data, new_capacity + 1);
+        else
+        {
+            grown = UC_PTR malloc(new_capacity + 1);
+            if(grown) memcpy(grown, inline_data, buf_size + 1);
+        }
+
+        database_assert(grown, "\nError growing a MODB buffer to %zu bytes.\n", new_capacity + 1)
+
+        buf_data = grown;
+        buf_capacity = new_capacity;
+        if(!buf_arena) heap_allocations().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void take(ModbBuffer &other)
+    {
+        buf_size = other.buf_size;
+        buf_capacity = other.buf_capacity;
+        buf_arena = other.buf_arena;
+
+        if(other.buf_data != other.inline_data)
+            buf_data = other.buf_data;
+        else
+        {
+            buf_data = inline_data;
+            memcpy(inline_data, other.inline_data, other.buf_size + 1);
+        }
+
+        other.buf_data = other.inline_data;
+        other.buf_size = 0;
+        other.buf_capacity = MODB_BUFFER_INLINE_SIZE - 1;
+        other.inline_data[0] = 0;
+    }
+
+public:
+    ModbBuffer() : buf_data(inline_data) { inline_data[0] = 0; }
+
+    /* Grow inside `arena` (the heap if nullptr). */
+    explicit ModbBuffer(ModbArena *arena) : buf_data(inline_data), buf_arena(arena) { inline_data[0] = 0; }
+
+    ModbBuffer(const ModbBuffer &) = delete;
+    ModbBuffer &operator=(const ModbBuffer &) = delete;
+
+    ModbBuffer(ModbBuffer &&other) : buf_data(inline_data) { take(other); }
+
+    ModbBuffer &operator=(ModbBuffer &&other)
+    {
+        if(this != &other)
+        {
+            if(on_heap()) free(buf_data);
+            take(other);
+        }
+        return *this;
+    }
+
+    /*
+     * heap_allocations - number of heap allocations made by every `ModbBuffer` so far (for benchmarks).
+     *  returns: reference to the counter; atomic, since worker threads grow their own buffers concurrently
+     *  on error: this function does not error
+     * */
+    static std::atomic<uint64_t> &heap_allocations()
+    {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+
+    /*
+     * reserve - make sure `new_capacity` bytes fit without another allocation.
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void reserve(size_t new_capacity)
+    {
+        if(new_capacity > buf_capacity) grow(new_capacity);
+    }
+
+    void push_back(unsigned char value)
+    {
+        if(buf_size == buf_capacity) grow(buf_size + 1);
+
+        buf_data[buf_size++] = value;
+        buf_data[buf_size] = 0;
+    }
+
+    void append(const void *src, size_t size)
+    {
+        if(size == 0) return;
+        if(buf_size + size > buf_capacity) grow(buf_size + size);
+
+        memcpy(&buf_data[buf_size], src, size);
+        buf_size += size;
+        buf_data[buf_size] = 0;
+    }
+
+    /*
+     * append_cstr - append a NUL terminated string (without its NUL).
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void append_cstr(const unsigned char *src) { append(src, strlen(NCC_PTR src)); }
+
+    /*
+     * resize - change the size; new bytes are zeroed.
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void resize(size_t new_size)
+    {
+        if(new_size > buf_capacity) grow(new_size);
+        if(new_size > buf_size) memset(&buf_data[buf_size], 0, new_size - buf_size);
+
+        buf_size = new_size;
+        buf_data[buf_size] = 0;
+    }
+
+    /* Drop the contents but keep the memory for reuse. */
+    void clear()
+    {
+        buf_size = 0;
+        buf_data[0] = 0;
+    }
+
+    unsigned char *data() { return buf_data; }
+    const unsigned char *data() const { return buf_data; }
+    const char *c_str() const { return NCC_PTR buf_data; }
+    size_t size() const { return buf_size; }
+    size_t capacity() const { return buf_capacity; }
+    bool empty() const { return buf_size == 0; }
+
+    unsigned char &operator[](size_t index) { return buf_data[index]; }
+    const unsigned char &operator[](size_t index) const { return buf_data[index]; }
+
+    ~ModbBuffer()
+    {
+        if(on_heap()) free(buf_data);
+        buf_data = inline_data;
+    }
+};
+
+#endif
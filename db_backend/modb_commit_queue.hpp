@@ -0,0 +1,585 @@
+#ifndef modb_commit_queue
+#define modb_commit_queue
+
+/* Asynchronous, durable commits of `CreateDB` (see `Database::commit_async`).
+ *
+ * A commit is handed over as a job: the bytes to write and where they go, either a descriptor of the `.modb` file
+ * with the offset to write at, or the path of a write-ahead log to append to. A runner thread takes every job
+ * queued to it since its last pass (up to `MODB_COMMIT_BATCH_MAX`) and runs them as one batch:
+ *  - each write-ahead log is opened and locked once for the batch (see `wal_lock_at`), however many jobs append to
+ *    it, and its jobs are written one after the other from the end of the log, in the order they were queued;
+ *  - every write of the batch is submitted at once, then every descriptor written to (and the folder of a `.modb`
+ *    file written for the first time) is synced once, so commits arriving together share their fsyncs;
+ *  - a target with a failed write is cut back to where the batch started writing it, so no torn record or image
+ *    is left for a reader (or the next batch) to trip over;
+ *  - then each job's callback is called and its future made ready, with `MODB_OK` only once it is on disk.
+ * On Linux the batch goes through an io_uring set up with the raw system calls (no liburing), one submission for
+ * the writes and one for the syncs. Where io_uring is not there (or not allowed) `MODB_COMMIT_FALLBACK_THREADS`
+ * runners run batches with `pwrite` and `fdatasync` instead. Every job for one file goes to the same runner, so
+ * commits to a file are written in the order they were queued ("later entries win" depends on it).
+ * */
+#define MODB_COMMIT_BATCH_MAX           128
+#define MODB_COMMIT_RING_ENTRIES        256
+#define MODB_COMMIT_FALLBACK_THREADS    4
+
+/* Result of an operation the ring has not completed. */
+#define MODB_COMMIT_NOT_DONE            INT32_MIN
+
+typedef struct CommitQueueStats
+{
+    uint64_t    commits = 0;
+    uint64_t    failed = 0;
+    uint64_t    batches = 0;
+
+    /* Descriptors synced; fewer than `commits` when commits shared a batch. */
+    uint64_t    syncs = 0;
+} _CommitQueueStats;
+
+typedef struct ModbCommitJob
+{
+    /* `.modb` file: a descriptor of its own (the queue closes it), where to write and the file's path, which only
+     * picks the runner.
+     * */
+    int                         fd = -1;
+    uint64_t                    offset = 0;
+    std::string                 file_path;
+
+    /* Write-ahead log: its path, `data` is appended as whole records. */
+    std::string                 log_path;
+
+    /* Folder synced along with the write, once the file is new to it. */
+    std::string                 folder;
+
+    std::vector<unsigned char>  data;
+
+    std::function<void(modb_status)>    callback;
+    std::promise<modb_status>           done;
+} _ModbCommitJob;
+
+/* One write or sync the queue runs, through the ring or not. */
+typedef struct ModbCommitOp
+{
+    bool                    sync = false;
+    bool                    datasync = true;
+    int                     fd = -1;
+    const unsigned char     *data = nullptr;
+    uint32_t                size = 0;
+    uint64_t                offset = 0;
+    int32_t                 result = MODB_COMMIT_NOT_DONE;
+} _ModbCommitOp;
+
+/*
+ * modb_commit_ready - a future that already holds `status`, for commits that fail before they are queued.
+ *  returns: the future
+ *  on error: this function does not error
+ * */
+inline std::future<modb_status> modb_commit_ready(modb_status status)
+{
+    std::promise<modb_status> ready;
+    ready.set_value(status);
+    return ready.get_future();
+}
+
+/*
+ * modb_write_at - write all of `data` to `fd` at `offset` (appended if `fd` was opened with `O_APPEND`).
+ *  returns: true if everything was written else false
+ *  on error: this function does not error
+ * */
+inline bool modb_write_at(int fd, const unsigned char *data, size_t size, uint64_t offset)
+{
+    while(size > 0)
+    {
+        ssize_t wrote = pwrite(fd, data, size, (off_t) offset);
+        if(wrote == -1) { if(errno == EINTR) continue; return false; }
+
+        data += wrote;
+        size -= wrote;
+        offset += wrote;
+    }
+    return true;
+}
+
+/*
+ * modb_sync_descriptor - make what was written to `fd` durable, only the data (and the size) if `datasync`.
+ *  returns: true once it is on disk else false
+ *  on error: this function does not error
+ * */
+inline bool modb_sync_descriptor(int fd, bool datasync)
+{
+#if defined(__linux__)
+    if(datasync) return fdatasync(fd) == 0;
+#endif
+    return fsync(fd) == 0;
+}
+
+/*
+ * modb_folder_of - the folder the file at `path` is in.
+ *  returns: the folder, "." if `path` has none
+ *  on error: this function does not error
+ * */
+inline std::string modb_folder_of(const char *path)
+{
+    const char *last = strrchr(path, '/');
+    if(!last) return ".";
+    return last == path ? "/" : std::string(path, last - path);
+}
+
+/*
+ * modb_sync_folder - make the entries of `folder` durable, e.g. a file just created in it.
+ *  returns: true once they are on disk else false
+ *  on error: this function does not error
+ * */
+inline bool modb_sync_folder(const std::string &folder)
+{
+    int fd = open(folder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1) return false;
+
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+/* Submission and completion rings of an io_uring, set up and driven with the raw system calls. */
+class ModbCommitRing
+{
+private:
+    int ring_fd = -1;
+
+    unsigned char *sq_map = nullptr, *cq_map = nullptr;
+    size_t sq_map_size = 0, cq_map_size = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+    struct io_uring_cqe *cqes = nullptr;
+    unsigned entries = 0;
+
+    /*
+     * enter - submit `submit` entries and wait for `wait` completions, retrying interrupted calls.
+     *  returns: how many entries were submitted, -1 if the call failed
+     *  on error: this function does not error
+     * */
+    int enter(unsigned submit, unsigned wait)
+    {
+        for(;;)
+        {
+            int entered = (int) syscall(__NR_io_uring_enter, ring_fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if(entered >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)) return entered;
+        }
+    }
+
+    void close_ring()
+    {
+        if(sqes) munmap(sqes, sqes_size);
+        if(cq_map && cq_map != sq_map) munmap(cq_map, cq_map_size);
+        if(sq_map) munmap(sq_map, sq_map_size);
+        if(ring_fd != -1) close(ring_fd);
+
+        sqes = nullptr;
+        sq_map = cq_map = nullptr;
+        ring_fd = -1;
+    }
+
+public:
+    /*
+     * open - set up a ring of `ring_entries` entries.
+     *  returns: true if io_uring could be set up else false
+     *  on error: this function does not error
+     * */
+    bool open(unsigned ring_entries)
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        ring_fd = (int) syscall(__NR_io_uring_setup, ring_entries, &params);
+        if(ring_fd == -1) return false;
+
+        sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if(params.features & IORING_FEAT_SINGLE_MMAP) sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+        void *mapped = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if(mapped == MAP_FAILED) { close_ring(); return false; }
+        sq_map = UC_PTR mapped;
+
+        if(params.features & IORING_FEAT_SINGLE_MMAP) cq_map = sq_map;
+        else
+        {
+            mapped = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if(mapped == MAP_FAILED) { close_ring(); return false; }
+            cq_map = UC_PTR mapped;
+        }
+
+        sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        mapped = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if(mapped == MAP_FAILED) { close_ring(); return false; }
+        sqes = (struct io_uring_sqe *) mapped;
+
+        sq_head = (unsigned *) (sq_map + params.sq_off.head);
+        sq_tail = (unsigned *) (sq_map + params.sq_off.tail);
+        sq_mask = (unsigned *) (sq_map + params.sq_off.ring_mask);
+        sq_array = (unsigned *) (sq_map + params.sq_off.array);
+        cq_head = (unsigned *) (cq_map + params.cq_off.head);
+        cq_tail = (unsigned *) (cq_map + params.cq_off.tail);
+        cq_mask = (unsigned *) (cq_map + params.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe *) (cq_map + params.cq_off.cqes);
+        entries = params.sq_entries;
+        return true;
+    }
+
+    bool is_open() { return ring_fd != -1; }
+
+    /*
+     * run - submit `ops` (at most the ring's entries at a time) and wait until every one has completed, setting each
+     *       op's `result` to what the kernel returned for it.
+     *  returns: true if the ring ran them, false if it failed and was closed
+     *  on error: this function does not error
+     * */
+    bool run(std::vector<_ModbCommitOp *> &ops)
+    {
+        for(size_t first = 0; first < ops.size(); first += entries)
+        {
+            unsigned count = (unsigned) std::min<size_t>(entries, ops.size() - first);
+            unsigned tail = *sq_tail;
+
+            for(unsigned i = 0; i < count; i++)
+            {
+                _ModbCommitOp &op = *ops[first + i];
+                unsigned index = (tail + i) & *sq_mask;
+
+                struct io_uring_sqe *sqe = &sqes[index];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->fd = op.fd;
+                sqe->user_data = first + i;
+                if(op.sync)
+                {
+                    sqe->opcode = IORING_OP_FSYNC;
+                    sqe->fsync_flags = op.datasync ? IORING_FSYNC_DATASYNC : 0;
+                }
+                else
+                {
+                    sqe->opcode = IORING_OP_WRITE;
+                    sqe->addr = (uint64_t) (uintptr_t) op.data;
+                    sqe->len = op.size;
+                    sqe->off = op.offset;
+                }
+                sq_array[index] = index;
+            }
+            __atomic_store_n(sq_tail, tail + count, __ATOMIC_RELEASE);
+
+            /* Whatever was not taken in stays in the submission ring and is submitted by the next call; the kernel only
+             * waits when it took in everything it was asked to.
+             * */
+            unsigned submitted = 0, completed = 0;
+            while(completed < count)
+            {
+                int entered = enter(count - submitted, count - completed);
+                if(entered < 0) { close_ring(); return false; }
+                submitted += (unsigned) entered;
+
+                unsigned head = *cq_head, ready = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+                for(; head != ready; head++, completed++)
+                {
+                    struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+                    ops[cqe->user_data]->result = cqe->res;
+                }
+                __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            }
+        }
+        return true;
+    }
+
+    ~ModbCommitRing() { close_ring(); }
+};
+#endif
+
+/* A thread running batches, and the jobs queued to it. */
+typedef struct ModbCommitRunner
+{
+    std::vector<_ModbCommitJob *>   queued;
+    std::condition_variable         wake;
+    std::thread                     thread;
+} _ModbCommitRunner;
+
+class ModbCommitQueue
+{
+private:
+    std::mutex queue_lock;
+    bool stopping = false;
+
+    std::vector<std::unique_ptr<_ModbCommitRunner>> runners;
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    ModbCommitRing ring;
+#endif
+
+    std::atomic<uint64_t> commits{0}, failed{0}, batches{0}, syncs{0};
+
+    /*
+     * run_ops - run `ops` through the ring, then whatever the ring did not run (or wrote short) with `pwrite`/`fsync`.
+     *  returns: nothing; each op's `result` is left at its size (or 0 for a sync) if it succeeded
+     *  on error: this function does not error
+     * */
+    void run_ops(std::vector<_ModbCommitOp> &ops)
+    {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        if(ring.is_open())
+        {
+            std::vector<_ModbCommitOp *> pending;
+            for(_ModbCommitOp &op: ops)
+                if(op.result == MODB_COMMIT_NOT_DONE) pending.push_back(&op);
+
+            /* Ops the failed ring had taken in may still be running; they are not run a second time. */
+            if(!ring.run(pending))
+                for(_ModbCommitOp *op: pending)
+                    if(op->result == MODB_COMMIT_NOT_DONE) op->result = -EIO;
+        }
+#endif
+
+        for(_ModbCommitOp &op: ops)
+        {
+            if(op.sync)
+            {
+                if(op.result == MODB_COMMIT_NOT_DONE) op.result = modb_sync_descriptor(op.fd, op.datasync) ? 0 : -errno;
+                continue;
+            }
+
+            /* A short write is finished here; the ring reports errors as negative results. */
+            uint32_t wrote = op.result > 0 ? (uint32_t) op.result : 0;
+            if(op.result == MODB_COMMIT_NOT_DONE || (op.result >= 0 && wrote < op.size))
+                op.result = modb_write_at(op.fd, op.data + wrote, op.size - wrote, op.offset + wrote) ? (int32_t) op.size : -EIO;
+        }
+    }
+
+    /*
+     * run_batch - write every job of `batch` and sync what they wrote to, then complete and free the jobs.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void run_batch(std::vector<_ModbCommitJob *> &batch)
+    {
+        /* Descriptors synced for the batch: each job's own, one per log and one per folder; all closed at the end.
+         * `starts` is where the batch started writing each of them, `ends` where its next log record goes.
+         * */
+        std::vector<_ModbCommitOp> writes(batch.size()), sync_ops;
+        std::vector<uint64_t> starts, ends;
+        std::vector<size_t> target_of(batch.size()), folder_of(batch.size(), SIZE_MAX);
+        std::unordered_map<std::string, size_t> log_targets, folder_targets;
+
+        auto add_target = [&sync_ops, &starts, &ends](int fd, bool datasync, uint64_t start) {
+            _ModbCommitOp op;
+            op.sync = true;
+            op.datasync = datasync;
+            op.fd = fd;
+            op.result = fd == -1 ? -EBADF : MODB_COMMIT_NOT_DONE;
+            sync_ops.push_back(op);
+            starts.push_back(start);
+            ends.push_back(start);
+            return sync_ops.size() - 1;
+        };
+
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+            _ModbCommitJob *job = batch[i];
+
+            if(!job->log_path.empty())
+            {
+                /* Not opened with `O_APPEND`: the ring may run the writes in any order, so each gets its own offset. */
+                auto found = log_targets.find(job->log_path);
+                if(found == log_targets.end())
+                {
+                    struct stat info;
+                    int fd = open(job->log_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+                    if(fd != -1 && (!wal_lock_at(fd, job->log_path) || fstat(fd, &info) != 0)) { close(fd); fd = -1; }
+                    found = log_targets.emplace(job->log_path, add_target(fd, true, fd == -1 ? 0 : (uint64_t) info.st_size)).first;
+                }
+                target_of[i] = found->second;
+                job->offset = ends[target_of[i]];
+                ends[target_of[i]] += job->data.size();
+            }
+            else target_of[i] = add_target(job->fd, true, job->offset);
+
+            if(!job->folder.empty())
+            {
+                auto found = folder_targets.find(job->folder);
+                if(found == folder_targets.end())
+                    found = folder_targets.emplace(job->folder, add_target(open(job->folder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC), false, 0)).first;
+                folder_of[i] = found->second;
+            }
+
+            _ModbCommitOp &write = writes[i];
+            write.fd = sync_ops[target_of[i]].fd;
+            write.data = job->data.data();
+            write.size = (uint32_t) job->data.size();
+            write.offset = job->offset;
+            if(write.fd == -1) write.result = -EBADF;
+        }
+
+        run_ops(writes);
+
+        /* Only what was written in full is worth syncing; a target with a failed write fails all its jobs anyway,
+         * and is cut back to where the batch started on it.
+         * */
+        for(size_t i = 0; i < batch.size(); i++)
+            if(writes[i].result != (int32_t) writes[i].size && sync_ops[target_of[i]].result != -EIO)
+            {
+                _ModbCommitOp &target = sync_ops[target_of[i]];
+                target.result = -EIO;
+                if(target.fd != -1 && ftruncate(target.fd, (off_t) starts[target_of[i]]) != 0)
+                    std::cout << "MODB Notice:\n\tCould not cut a failed commit off " << (batch[i]->log_path.empty() ? batch[i]->file_path : batch[i]->log_path) << "." << std::endl;
+            }
+
+        run_ops(sync_ops);
+
+        /* Closing a log's descriptor also drops its lock. */
+        for(_ModbCommitOp &op: sync_ops)
+            if(op.fd != -1) close(op.fd);
+
+        std::vector<modb_status> statuses(batch.size());
+        uint64_t batch_failed = 0;
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+            bool ok = writes[i].result == (int32_t) writes[i].size && sync_ops[target_of[i]].result == 0 &&
+                      (folder_of[i] == SIZE_MAX || sync_ops[folder_of[i]].result == 0);
+            statuses[i] = ok ? modb_status::MODB_OK : modb_status::MODB_IO_ERROR;
+            batch_failed += !ok;
+        }
+
+        /* Counted before anyone is told, so `stats` taken after a future is ready includes its commit. */
+        commits.fetch_add(batch.size(), std::memory_order_relaxed);
+        failed.fetch_add(batch_failed, std::memory_order_relaxed);
+        batches.fetch_add(1, std::memory_order_relaxed);
+        syncs.fetch_add(sync_ops.size(), std::memory_order_relaxed);
+
+        for(size_t i = 0; i < batch.size(); i++)
+        {
+            _ModbCommitJob *job = batch[i];
+            if(job->callback) job->callback(statuses[i]);
+            job->done.set_value(statuses[i]);
+            delete job;
+        }
+    }
+
+    /*
+     * run - take batches off `runner`'s queue until the queue is stopped and it is empty.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void run(_ModbCommitRunner &runner)
+    {
+        std::vector<_ModbCommitJob *> batch;
+        for(;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(queue_lock);
+                while(runner.queued.empty() && !stopping) runner.wake.wait(guard);
+                if(runner.queued.empty()) return;
+
+                size_t take = std::min<size_t>(runner.queued.size(), MODB_COMMIT_BATCH_MAX);
+                batch.assign(runner.queued.begin(), runner.queued.begin() + take);
+                runner.queued.erase(runner.queued.begin(), runner.queued.begin() + take);
+            }
+
+            run_batch(batch);
+        }
+    }
+
+public:
+    /* With `use_ring` false the fallback threads are used even where io_uring is there (e.g. to compare the two). */
+    ModbCommitQueue(bool use_ring = true)
+    {
+        unsigned threads = MODB_COMMIT_FALLBACK_THREADS;
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        /* The ring is only driven by one thread; it keeps that thread busy with a whole batch at a time. */
+        if(use_ring && ring.open(MODB_COMMIT_RING_ENTRIES)) threads = 1;
+#endif
+
+        for(unsigned i = 0; i < threads; i++)
+            runners.emplace_back(new _ModbCommitRunner);
+
+        /* Started once `runners` is filled in, since `submit` may be called as soon as the first one runs. */
+        for(std::unique_ptr<_ModbCommitRunner> &runner: runners)
+        {
+            _ModbCommitRunner *started = runner.get();
+            runner->thread = std::thread([this, started]() { run(*started); });
+        }
+    }
+
+    ModbCommitQueue(const ModbCommitQueue &) = delete;
+    ModbCommitQueue &operator=(const ModbCommitQueue &) = delete;
+
+    /*
+     * using_ring - are batches run through io_uring (else through the fallback threads)?
+     *  returns: true if so else false
+     *  on error: this function does not error
+     * */
+    bool using_ring()
+    {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        return ring.is_open();
+#else
+        return false;
+#endif
+    }
+
+    /*
+     * submit - queue `job` to the runner of the file it writes to; the queue owns it from here on.
+     *  returns: the future the commit's `modb_status` is put in once it is on disk (or failed)
+     *  on error: this function does not error
+     * */
+    std::future<modb_status> submit(_ModbCommitJob *job)
+    {
+        std::future<modb_status> result = job->done.get_future();
+        _ModbCommitRunner &runner = *runners[std::hash<std::string>()(job->log_path.empty() ? job->file_path : job->log_path) % runners.size()];
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            runner.queued.push_back(job);
+        }
+        runner.wake.notify_one();
+        return result;
+    }
+
+    /*
+     * stats - how many commits were run, in how many batches and with how many syncs.
+     *  returns: the counts so far
+     *  on error: this function does not error
+     * */
+    _CommitQueueStats stats()
+    {
+        _CommitQueueStats counts;
+        counts.commits = commits.load(std::memory_order_relaxed);
+        counts.failed = failed.load(std::memory_order_relaxed);
+        counts.batches = batches.load(std::memory_order_relaxed);
+        counts.syncs = syncs.load(std::memory_order_relaxed);
+        return counts;
+    }
+
+    /* Every job queued so far is still run before this returns. */
+    ~ModbCommitQueue()
+    {
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            stopping = true;
+        }
+        for(std::unique_ptr<_ModbCommitRunner> &runner: runners)
+        {
+            runner->wake.notify_all();
+            runner->thread.join();
+        }
+    }
+};
+
+/*
+ * modb_shared_commit_queue - the queue `Database::commit_async` uses unless it is given one; started on first use.
+ *  returns: the queue
+ *  on error: this function does not error
+ * */
+inline ModbCommitQueue &modb_shared_commit_queue()
+{
+    static ModbCommitQueue queue;
+    return queue;
+}
+
+#endif
@@ -0,0 +1,879 @@
+#ifndef modb_format
+#define modb_format
+
+/* Layout of the modb binary file.
+ *
+ * Version 1 (read-only, kept so existing files can be read and migrated):
+ *      for each entry: [OS header (`bytes_to_skip` bytes)][modb_sections tag][NUL terminated value]...[MODB_END]
+ *  Values cannot contain NUL or 0xD5 and the file can only be scanned front to back.
+ *
+ * Version 2:
+ *      [header: "MODB"][2: version][2: header size]
+ *      [entries: each a run of sections, [1: modb_sections tag][4: length][value]]
+ *      [blocks: the directory, plus any other `MODB_BLOCK_*`]
+ *      [block table: for each block [1: MODB_BLOCK_*][8: offset][8: size][4: CRC-32 (checked by `ModbFileV2::verify`)]]
+ *      [footer: [8: block table offset][4: block count]["MODB"]]
+ *  The directory block is [4: entry count][4: row size] followed by one fixed-size row per entry:
+ *      [8: entry offset][4: entry size] then, for each `MODB_V2_SECTION_*`, [4: value offset in entry][4: value length]
+ *  so entry N, and any of its sections, is found with one lookup.
+ *  The name index block is [4: bucket count (a power of two)] followed by buckets of [4: name hash][4: entry index + 1],
+ *  an open-addressing (linear probing) hash table from `MODB_DB_NAME` to the last entry with that name; 0 marks an
+ *  empty bucket. All integers are little-endian.
+ * */
+
+/* Bytes to skip (depending on OS type); the size of the OS header in front of every v1 entry. */
+#ifdef _WIN32
+#define bytes_to_skip       6
+#endif
+
+#ifdef _WIN64
+#define bytes_to_skip       6
+#endif
+
+#if defined(__unix) || defined(__unix__) || defined(__linux__)
+#define bytes_to_skip       5
+#endif
+
+#if defined(__APPLE__) || defined(__MACH__)
+#define bytes_to_skip       4
+#endif
+
+#if (!defined(_WIN32) || !defined(_WIN64)) && (!defined(__unix) || !defined(__unix__) || !defined(__linux__)) && (!defined(__APPLE__) || !defined(__MACH__))
+#define bytes_to_skip       12
+#endif
+
+/* One database entry parsed out of a modb binary file; every field points into the mapped file. */
+typedef struct ModbEntryView
+{
+    std::string_view    ip_address;
+    std::string_view    host;
+    std::string_view    port;
+    std::string_view    name;
+    std::string_view    folder;
+} _ModbEntryView;
+
+/*
+ * modb_read_field - view of the bytes from `at` up to the next NUL or `MODB_END`, `at` is left on that byte.
+ *  returns: the field
+ *  on error: this function does not error; the field stops at `size` if the data runs out
+ * */
+inline std::string_view modb_read_field(const unsigned char *data, size_t size, size_t &at, bool stop_at_nul)
+{
+    size_t start = at;
+
+    while(at < size && data[at] != static_cast<unsigned char> (modb_sections::MODB_END) && !(stop_at_nul && data[at] == 0))
+        at++;
+
+    return std::string_view(NCC_PTR &data[start], at - start);
+}
+
+/*
+ * modb_parse_entry - parse the v1 `modb_sections` of one entry starting at `at`, up to `MODB_END`.
+ *  returns: index just past the entry's `MODB_END` (or `size` if the data ran out)
+ *  on error: this function does not error
+ * */
+inline size_t modb_parse_entry(const unsigned char *data, size_t size, size_t at, _ModbEntryView &entry)
+{
+    while(at < size && data[at] != static_cast<unsigned char> (modb_sections::MODB_END))
+    {
+        switch(data[at])
+        {
+            case static_cast<unsigned char> (modb_sections::MODB_IP_ADDRESS): {
+                at++;
+                entry.ip_address = modb_read_field(data, size, at, true);
+                break;
+            }
+            case static_cast<unsigned char> (modb_sections::MODB_PORT_AND_HOST): {
+                at++;
+                entry.host = modb_read_field(data, size, at, true);
+
+                /* Skip the NUL between the host and the port. */
+                if(at < size && data[at] == 0) at++;
+                entry.port = modb_read_field(data, size, at, true);
+                break;
+            }
+            case static_cast<unsigned char> (modb_sections::MODB_DB_NAME): {
+                at++;
+                entry.name = modb_read_field(data, size, at, true);
+                break;
+            }
+            case static_cast<unsigned char> (modb_sections::MODB_PATH): {
+                /* The path is not NUL terminated, it runs up to `MODB_END`. */
+                at++;
+                entry.folder = modb_read_field(data, size, at, false);
+                continue;
+            }
+            default: break;
+        }
+
+        /* Step over the NUL ending the field (or an unknown byte). */
+        if(at < size && data[at] != static_cast<unsigned char> (modb_sections::MODB_END)) at++;
+    }
+
+    return at < size ? at + 1 : size;
+}
+
+
+#define MODB_V2_VERSION                 2
+#define MODB_V2_HEADER_SIZE             8
+#define MODB_V2_FOOTER_SIZE             16
+#define MODB_V2_SECTION_HEADER_SIZE     5
+#define MODB_V2_BLOCK_TABLE_ROW_SIZE    21
+
+/* Blocks a v2 file can carry. */
+#define MODB_BLOCK_DIRECTORY            0x01 // offset table for every entry and its sections
+#define MODB_BLOCK_NAME_INDEX           0x02 // hash table from database name to entry index
+
+/* Column of each section in a directory row. */
+#define MODB_V2_SECTION_IP_ADDRESS      0
+#define MODB_V2_SECTION_HOST            1
+#define MODB_V2_SECTION_PORT            2
+#define MODB_V2_SECTION_DB_NAME         3
+#define MODB_V2_SECTION_PATH            4
+#define MODB_V2_SECTION_COUNT           5
+
+#define MODB_V2_DIRECTORY_ROW_SIZE      (12 + MODB_V2_SECTION_COUNT * 8)
+
+static const unsigned char modb_v2_magic[4] = {'M', 'O', 'D', 'B'};
+
+/* Section tag written for each directory column. */
+static const unsigned char modb_v2_section_tags[MODB_V2_SECTION_COUNT] = {
+    static_cast<unsigned char> (modb_sections::MODB_IP_ADDRESS),
+    static_cast<unsigned char> (modb_sections::MODB_HOST),
+    static_cast<unsigned char> (modb_sections::MODB_PORT),
+    static_cast<unsigned char> (modb_sections::MODB_DB_NAME),
+    static_cast<unsigned char> (modb_sections::MODB_PATH)
+};
+
+/*
+ * modb_name_hash - FNV-1a hash of a database name, as stored in the name index.
+ *  returns: the hash
+ *  on error: this function does not error
+ * */
+inline uint32_t modb_name_hash(std::string_view name)
+{
+    uint32_t hash = 2166136261u;
+    for(unsigned char c: name)
+        hash = (hash ^ c) * 16777619u;
+
+    return hash;
+}
+
+/*
+ * modb_v2_entry_field - the field of `entry` stored in directory column `column`.
+ *  returns: reference to the field
+ *  on error: this function does not error
+ * */
+inline std::string_view &modb_v2_entry_field(_ModbEntryView &entry, int column)
+{
+    switch(column)
+    {
+        case MODB_V2_SECTION_IP_ADDRESS: return entry.ip_address;
+        case MODB_V2_SECTION_HOST: return entry.host;
+        case MODB_V2_SECTION_PORT: return entry.port;
+        case MODB_V2_SECTION_DB_NAME: return entry.name;
+        default: return entry.folder;
+    }
+}
+
+/*
+ * modb_v2_section_column - directory column for the section tag `tag`.
+ *  returns: the `MODB_V2_SECTION_*` column, or -1 for tags v2 entries do not use
+ *  on error: this function does not error
+ * */
+inline int modb_v2_section_column(unsigned char tag)
+{
+    for(int column = 0; column < MODB_V2_SECTION_COUNT; column++)
+        if(modb_v2_section_tags[column] == tag) return column;
+
+    return -1;
+}
+
+/*
+ * modb_is_v2 - check if `data` starts with the v2 header.
+ *  returns: true if it does else false
+ *  on error: this function does not error
+ * */
+inline bool modb_is_v2(const unsigned char *data, size_t size)
+{
+    return size >= MODB_V2_HEADER_SIZE + MODB_V2_FOOTER_SIZE &&
+           memcmp(data, modb_v2_magic, 4) == 0 && modb_get_u16(&data[4]) == MODB_V2_VERSION;
+}
+
+/*
+ * modb_v2_encode_entry - append the sections of `entry` to `out`.
+ *  returns: nothing; if `row` is given, the section columns of its directory row are filled in
+ *  on error: this function will error if there was a memory allocation error
+ * */
+inline void modb_v2_encode_entry(ModbBuffer &out, _ModbEntryView &entry, unsigned char *row)
+{
+    size_t entry_start = out.size();
+
+    for(int column = 0; column < MODB_V2_SECTION_COUNT; column++)
+    {
+        std::string_view &value = modb_v2_entry_field(entry, column);
+        unsigned char section[MODB_V2_SECTION_HEADER_SIZE];
+
+        section[0] = modb_v2_section_tags[column];
+        modb_put_u32(&section[1], (uint32_t) value.size());
+        out.append(section, MODB_V2_SECTION_HEADER_SIZE);
+
+        if(row)
+        {
+            modb_put_u32(&row[12 + column * 8], (uint32_t) (out.size() - entry_start));
+            modb_put_u32(&row[16 + column * 8], (uint32_t) value.size());
+        }
+
+        out.append(value.data(), value.size());
+    }
+}
+
+/*
+ * modb_v2_decode_entry - parse the sections of one v2 entry (as stored in a file or a write-ahead log record).
+ *  returns: true if every section fit inside `size` bytes else false
+ *  on error: this function does not error
+ * */
+inline bool modb_v2_decode_entry(const unsigned char *data, size_t size, _ModbEntryView &entry)
+{
+    size_t at = 0;
+    while(size - at >= MODB_V2_SECTION_HEADER_SIZE)
+    {
+        uint32_t value_size = modb_get_u32(&data[at + 1]);
+        if(size - at - MODB_V2_SECTION_HEADER_SIZE < value_size) return false;
+
+        int column = modb_v2_section_column(data[at]);
+        if(column != -1)
+            modb_v2_entry_field(entry, column) = std::string_view(NCC_PTR &data[at + MODB_V2_SECTION_HEADER_SIZE], value_size);
+
+        at += MODB_V2_SECTION_HEADER_SIZE + value_size;
+    }
+
+    return at == size;
+}
+
+/* Reader for a v2 modb binary file that is already in memory (normally a `ModbMapping`). */
+class ModbFileV2
+{
+private:
+    const unsigned char *file_data = nullptr;
+    size_t file_size = 0;
+
+    const unsigned char *block_table = nullptr;
+    uint32_t block_count = 0;
+
+    const unsigned char *directory = nullptr;
+    uint32_t directory_entries = 0;
+    uint32_t directory_row_size = 0;
+
+    const unsigned char *name_index = nullptr;
+    uint32_t name_index_buckets = 0;
+
+public:
+    /*
+     * open - check the header, footer and block table of the file in `data` and locate the directory.
+     *  returns: true if the file is a well-formed v2 file else false
+     *  on error: this function does not error
+     * */
+    bool open(const unsigned char *data, size_t size)
+    {
+        if(!modb_is_v2(data, size)) return false;
+
+        const unsigned char *footer = &data[size - MODB_V2_FOOTER_SIZE];
+        if(memcmp(&footer[12], modb_v2_magic, 4) != 0) return false;
+
+        uint64_t table_offset = modb_get_u32(footer) | ((uint64_t) modb_get_u32(&footer[4]) << 32);
+        uint32_t table_rows = modb_get_u32(&footer[8]);
+
+        if(table_offset > size - MODB_V2_FOOTER_SIZE ||
+           (size - MODB_V2_FOOTER_SIZE - table_offset) / MODB_V2_BLOCK_TABLE_ROW_SIZE < table_rows)
+            return false;
+
+        file_data = data;
+        file_size = size;
+        block_table = &data[table_offset];
+        block_count = table_rows;
+
+        size_t directory_size;
+        directory = block(MODB_BLOCK_DIRECTORY, directory_size);
+        if(!directory || directory_size < 8) return false;
+
+        directory_entries = modb_get_u32(directory);
+        directory_row_size = modb_get_u32(&directory[4]);
+
+        if(directory_row_size < MODB_V2_DIRECTORY_ROW_SIZE ||
+           (directory_size - 8) / directory_row_size < directory_entries)
+            return false;
+
+        /* Files written before the catalog have no name index, `find_entry` scans the directory for those. */
+        size_t index_size;
+        name_index = block(MODB_BLOCK_NAME_INDEX, index_size);
+        if(name_index && index_size >= 4)
+        {
+            name_index_buckets = modb_get_u32(name_index);
+            if((name_index_buckets & (name_index_buckets - 1)) != 0 || (index_size - 4) / 8 < name_index_buckets)
+                name_index_buckets = 0;
+        }
+
+        return true;
+    }
+
+    /*
+     * block - find a block by its `MODB_BLOCK_*` kind.
+     *  returns: pointer to the block (and its size in `size`), or nullptr if it is missing or out of bounds
+     *  on error: this function does not error
+     *
+     *  Note: the checksum is not checked here so opening a large file stays O(1), see `verify`.
+     * */
+    const unsigned char *block(unsigned char kind, size_t &size)
+    {
+        for(uint32_t i = 0; i < block_count; i++)
+        {
+            const unsigned char *row = &block_table[i * MODB_V2_BLOCK_TABLE_ROW_SIZE];
+            if(row[0] != kind) continue;
+
+            uint64_t offset = modb_get_u32(&row[1]) | ((uint64_t) modb_get_u32(&row[5]) << 32);
+            uint64_t block_size = modb_get_u32(&row[9]) | ((uint64_t) modb_get_u32(&row[13]) << 32);
+
+            if(offset > file_size || file_size - offset < block_size) return nullptr;
+
+            size = block_size;
+            return &file_data[offset];
+        }
+
+        return nullptr;
+    }
+
+    /*
+     * verify - check the CRC-32 of every block in the block table.
+     *  returns: true if they all match else false
+     *  on error: this function does not error
+     * */
+    bool verify()
+    {
+        for(uint32_t i = 0; i < block_count; i++)
+        {
+            const unsigned char *row = &block_table[i * MODB_V2_BLOCK_TABLE_ROW_SIZE];
+
+            size_t block_size;
+            const unsigned char *data = block(row[0], block_size);
+            if(!data || modb_crc32(data, block_size) != modb_get_u32(&row[17])) return false;
+        }
+
+        return true;
+    }
+
+    size_t entry_count() { return directory_entries; }
+
+    /*
+     * find_entry - find the last entry whose `MODB_DB_NAME` is `name`.
+     *  returns: the entry's index, or -1 if there is no such entry
+     *  on error: this function does not error
+     * */
+    long find_entry(std::string_view name)
+    {
+        if(name_index_buckets == 0)
+        {
+            for(size_t index = directory_entries; index > 0; index--)
+                if(section(index - 1, MODB_V2_SECTION_DB_NAME) == name) return index - 1;
+
+            return -1;
+        }
+
+        uint32_t hash = modb_name_hash(name);
+        for(uint32_t probe = 0, bucket = hash & (name_index_buckets - 1); probe < name_index_buckets;
+            probe++, bucket = (bucket + 1) & (name_index_buckets - 1))
+        {
+            const unsigned char *slot = &name_index[4 + bucket * 8];
+            uint32_t entry_index = modb_get_u32(&slot[4]);
+
+            if(entry_index == 0) break;
+            if(modb_get_u32(slot) == hash && section(entry_index - 1, MODB_V2_SECTION_DB_NAME) == name)
+                return entry_index - 1;
+        }
+
+        return -1;
+    }
+
+    /*
+     * section - get one section of entry `index` straight from the directory.
+     *  returns: the section value, empty if the entry or section does not exist
+     *  on error: this function does not error
+     * */
+    std::string_view section(size_t index, int column)
+    {
+        if(index >= directory_entries || column < 0 || column >= MODB_V2_SECTION_COUNT) return std::string_view();
+
+        const unsigned char *row = &directory[8 + index * directory_row_size];
+        uint64_t entry_offset = modb_get_u32(row) | ((uint64_t) modb_get_u32(&row[4]) << 32);
+        uint32_t entry_size = modb_get_u32(&row[8]);
+        uint32_t value_offset = modb_get_u32(&row[12 + column * 8]);
+        uint32_t value_size = modb_get_u32(&row[16 + column * 8]);
+
+        if(entry_offset > file_size || file_size - entry_offset < entry_size) return std::string_view();
+        if(value_offset > entry_size || entry_size - value_offset < value_size) return std::string_view();
+
+        return std::string_view(NCC_PTR &file_data[entry_offset + value_offset], value_size);
+    }
+
+    /*
+     * entry - fill `entry` with every section of entry `index`.
+     *  returns: true if the entry exists else false
+     *  on error: this function does not error
+     * */
+    bool entry(size_t index, _ModbEntryView &entry)
+    {
+        if(index >= directory_entries) return false;
+
+        for(int column = 0; column < MODB_V2_SECTION_COUNT; column++)
+            modb_v2_entry_field(entry, column) = section(index, column);
+
+        return true;
+    }
+};
+
+/* A v2 modb binary file read through a `ModbPageCache` rather than mapped whole.
+ *
+ * `open` reads the footer and block table; each lookup after that reads only the name index buckets, directory
+ * rows and sections it needs, so a file much bigger than memory costs no more than the pages it touches. Values
+ * are copied out, since a page can be evicted once it is unpinned.
+ * */
+class ModbPagedFileV2
+{
+private:
+    ModbPageCache *cache = nullptr;
+    uint64_t file_size = 0;
+
+    std::vector<unsigned char> block_table;
+
+    uint64_t directory = 0;
+    uint32_t directory_entries = 0;
+    uint32_t directory_row_size = 0;
+
+    uint64_t name_index = 0;
+    uint32_t name_index_buckets = 0;
+
+    /* Directory row and name being compared; kept so lookups do not allocate. */
+    unsigned char row[MODB_V2_DIRECTORY_ROW_SIZE];
+    std::string candidate;
+
+    bool block(unsigned char kind, uint64_t &offset, uint64_t &size)
+    {
+        for(size_t at = 0; at + MODB_V2_BLOCK_TABLE_ROW_SIZE <= block_table.size(); at += MODB_V2_BLOCK_TABLE_ROW_SIZE)
+        {
+            if(block_table[at] != kind) continue;
+
+            offset = modb_get_u32(&block_table[at + 1]) | ((uint64_t) modb_get_u32(&block_table[at + 5]) << 32);
+            size = modb_get_u32(&block_table[at + 9]) | ((uint64_t) modb_get_u32(&block_table[at + 13]) << 32);
+            return offset <= file_size && file_size - offset >= size;
+        }
+
+        return false;
+    }
+
+    bool read_row(size_t index)
+    {
+        return index < directory_entries && cache->read(directory + 8 + (uint64_t) index * directory_row_size, row, MODB_V2_DIRECTORY_ROW_SIZE);
+    }
+
+    /*
+     * section_span - where section `column` of the entry whose directory row was read last is in the file.
+     *  returns: true if the section is in bounds else false
+     *  on error: this function does not error
+     * */
+    bool section_span(int column, uint64_t &offset, uint32_t &size)
+    {
+        if(column < 0 || column >= MODB_V2_SECTION_COUNT) return false;
+
+        uint64_t entry_offset = modb_get_u32(row) | ((uint64_t) modb_get_u32(&row[4]) << 32);
+        uint32_t entry_size = modb_get_u32(&row[8]);
+        uint32_t value_offset = modb_get_u32(&row[12 + column * 8]);
+        size = modb_get_u32(&row[16 + column * 8]);
+
+        if(entry_offset > file_size || file_size - entry_offset < entry_size) return false;
+        if(value_offset > entry_size || entry_size - value_offset < size) return false;
+
+        offset = entry_offset + value_offset;
+        return true;
+    }
+
+public:
+    /*
+     * open - check the header, footer and block table of the file `file_cache` reads and locate the directory.
+     *  returns: true if the file is a well-formed v2 file else false
+     *  on error: this function does not error
+     * */
+    bool open(ModbPageCache &file_cache)
+    {
+        cache = &file_cache;
+        file_size = cache->file_size();
+
+        unsigned char header[MODB_V2_HEADER_SIZE], footer[MODB_V2_FOOTER_SIZE];
+        if(file_size < MODB_V2_HEADER_SIZE + MODB_V2_FOOTER_SIZE || !cache->read(0, header, sizeof(header)) ||
+           !modb_is_v2(header, file_size) || !cache->read(file_size - MODB_V2_FOOTER_SIZE, footer, sizeof(footer)))
+            return false;
+        if(memcmp(&footer[12], modb_v2_magic, 4) != 0) return false;
+
+        uint64_t table_offset = modb_get_u32(footer) | ((uint64_t) modb_get_u32(&footer[4]) << 32);
+        uint32_t table_rows = modb_get_u32(&footer[8]);
+
+        if(table_offset > file_size - MODB_V2_FOOTER_SIZE ||
+           (file_size - MODB_V2_FOOTER_SIZE - table_offset) / MODB_V2_BLOCK_TABLE_ROW_SIZE < table_rows)
+            return false;
+
+        block_table.resize((size_t) table_rows * MODB_V2_BLOCK_TABLE_ROW_SIZE);
+        if(!cache->read(table_offset, block_table.data(), block_table.size())) return false;
+
+        uint64_t directory_size;
+        unsigned char counts[8];
+        if(!block(MODB_BLOCK_DIRECTORY, directory, directory_size) || directory_size < 8 || !cache->read(directory, counts, 8)) return false;
+
+        directory_entries = modb_get_u32(counts);
+        directory_row_size = modb_get_u32(&counts[4]);
+
+        if(directory_row_size < MODB_V2_DIRECTORY_ROW_SIZE ||
+           (directory_size - 8) / directory_row_size < directory_entries)
+            return false;
+
+        /* Files written before the catalog have no name index, `find_entry` scans the directory for those. */
+        uint64_t index_size;
+        name_index_buckets = 0;
+        if(block(MODB_BLOCK_NAME_INDEX, name_index, index_size) && index_size >= 4 && cache->read(name_index, counts, 4))
+        {
+            name_index_buckets = modb_get_u32(counts);
+            if((name_index_buckets & (name_index_buckets - 1)) != 0 || (index_size - 4) / 8 < name_index_buckets)
+                name_index_buckets = 0;
+        }
+
+        return true;
+    }
+
+    size_t entry_count() { return directory_entries; }
+
+    /*
+     * find_entry - find the last entry whose `MODB_DB_NAME` is `name`.
+     *  returns: the entry's index, or -1 if there is no such entry
+     *  on error: this function does not error
+     * */
+    long find_entry(std::string_view name)
+    {
+        if(name_index_buckets == 0)
+        {
+            for(size_t index = directory_entries; index > 0; index--)
+                if(section(index - 1, MODB_V2_SECTION_DB_NAME, candidate) && candidate == name) return index - 1;
+
+            return -1;
+        }
+
+        uint32_t hash = modb_name_hash(name);
+        unsigned char slot[8];
+        for(uint32_t probe = 0, bucket = hash & (name_index_buckets - 1); probe < name_index_buckets;
+            probe++, bucket = (bucket + 1) & (name_index_buckets - 1))
+        {
+            if(!cache->read(name_index + 4 + (uint64_t) bucket * 8, slot, 8)) return -1;
+            uint32_t entry_index = modb_get_u32(&slot[4]);
+
+            if(entry_index == 0) break;
+            if(modb_get_u32(slot) == hash && section(entry_index - 1, MODB_V2_SECTION_DB_NAME, candidate) && candidate == name)
+                return entry_index - 1;
+        }
+
+        return -1;
+    }
+
+    /*
+     * section - copy one section of entry `index` into `out`.
+     *  returns: true if the entry and section exist else false (`out` is left empty)
+     *  on error: this function does not error
+     * */
+    bool section(size_t index, int column, std::string &out)
+    {
+        out.clear();
+
+        uint64_t offset;
+        uint32_t size;
+        if(!read_row(index) || !section_span(column, offset, size)) return false;
+
+        out.resize(size);
+        if(cache->read(offset, UC_PTR out.data(), size)) return true;
+
+        out.clear();
+        return false;
+    }
+
+    /*
+     * entry - copy every section of entry `index` into `storage` and point `entry` at them.
+     *  returns: true if the entry exists else false
+     *  on error: this function does not error; `entry` is only valid while `storage` is left alone
+     * */
+    bool entry(size_t index, _ModbEntryView &entry, std::string &storage)
+    {
+        uint64_t offsets[MODB_V2_SECTION_COUNT];
+        uint32_t sizes[MODB_V2_SECTION_COUNT];
+        size_t total = 0;
+
+        if(!read_row(index)) return false;
+        for(int column = 0; column < MODB_V2_SECTION_COUNT; column++)
+        {
+            if(!section_span(column, offsets[column], sizes[column])) return false;
+            total += sizes[column];
+        }
+
+        storage.resize(total);
+        size_t at = 0;
+        for(int column = 0; column < MODB_V2_SECTION_COUNT; column++)
+        {
+            if(!cache->read(offsets[column], UC_PTR &storage[at], sizes[column])) return false;
+
+            modb_v2_entry_field(entry, column) = std::string_view(&storage[at], sizes[column]);
+            at += sizes[column];
+        }
+
+        return true;
+    }
+};
+
+/* Writer for v2 modb binary files: add every entry, then any extra blocks, then `finish`. */
+class ModbWriterV2
+{
+private:
+    /* Where every buffer below grows, nullptr for the heap. */
+    ModbArena *arena;
+
+    ModbBuffer out;
+    ModbBuffer directory;
+    uint32_t entries = 0;
+
+    /* For the name index, one row per entry: [4: `modb_name_hash`][8: offset of the name in `out`][4: name length]. */
+    ModbBuffer names;
+
+    /* Block table rows of every block written so far. */
+    ModbBuffer block_table;
+
+    bool finished = false;
+
+    /*
+     * same_name - do entries `a` and `b` have the same name?
+     *  returns: true if so else false
+     *  on error: this function does not error
+     * */
+    bool same_name(uint32_t a, uint32_t b)
+    {
+        const unsigned char *row_a = &names[a * 16], *row_b = &names[b * 16];
+        uint32_t size = modb_get_u32(&row_a[12]);
+
+        return modb_get_u32(row_a) == modb_get_u32(row_b) && size == modb_get_u32(&row_b[12]) &&
+               memcmp(&out[modb_get_u32(&row_a[4]) | ((uint64_t) modb_get_u32(&row_a[8]) << 32)],
+                      &out[modb_get_u32(&row_b[4]) | ((uint64_t) modb_get_u32(&row_b[8]) << 32)], size) == 0;
+    }
+
+public:
+    /* Grow the file image in `arena` (the heap if nullptr); the arena must outlive the writer.
+     * Buffers that outgrow their space leave the old copy behind until the arena is reset, so only use one for small files. */
+    explicit ModbWriterV2(ModbArena *writer_arena = nullptr)
+        : arena(writer_arena), out(writer_arena), directory(writer_arena), names(writer_arena), block_table(writer_arena)
+    {
+        unsigned char header[MODB_V2_HEADER_SIZE];
+        memcpy(header, modb_v2_magic, 4);
+        modb_put_u16(&header[4], MODB_V2_VERSION);
+        modb_put_u16(&header[6], MODB_V2_HEADER_SIZE);
+        out.append(header, MODB_V2_HEADER_SIZE);
+
+        directory.resize(8);
+    }
+
+    /*
+     * add_entry - append an entry and its directory row.
+     *  returns: the entry's index
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    uint32_t add_entry(_ModbEntryView &entry)
+    {
+        unsigned char row[MODB_V2_DIRECTORY_ROW_SIZE];
+        uint64_t entry_offset = out.size();
+
+        modb_v2_encode_entry(out, entry, row);
+
+        modb_put_u32(row, (uint32_t) entry_offset);
+        modb_put_u32(&row[4], (uint32_t) (entry_offset >> 32));
+        modb_put_u32(&row[8], (uint32_t) (out.size() - entry_offset));
+        directory.append(row, MODB_V2_DIRECTORY_ROW_SIZE);
+
+        unsigned char name_row[16];
+        uint64_t name_offset = entry_offset + modb_get_u32(&row[12 + MODB_V2_SECTION_DB_NAME * 8]);
+        modb_put_u32(name_row, modb_name_hash(entry.name));
+        modb_put_u32(&name_row[4], (uint32_t) name_offset);
+        modb_put_u32(&name_row[8], (uint32_t) (name_offset >> 32));
+        modb_put_u32(&name_row[12], (uint32_t) entry.name.size());
+        names.append(name_row, 16);
+
+        return entries++;
+    }
+
+    /*
+     * add_block - append a block of `MODB_BLOCK_*` kind `kind`; call after the last `add_entry`.
+     *  returns: offset of the block in the file
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    uint64_t add_block(unsigned char kind, const unsigned char *data, size_t size)
+    {
+        uint64_t offset = out.size();
+        out.append(data, size);
+
+        unsigned char row[MODB_V2_BLOCK_TABLE_ROW_SIZE];
+        row[0] = kind;
+        modb_put_u32(&row[1], (uint32_t) offset);
+        modb_put_u32(&row[5], (uint32_t) (offset >> 32));
+        modb_put_u32(&row[9], (uint32_t) size);
+        modb_put_u32(&row[13], (uint32_t) ((uint64_t) size >> 32));
+        modb_put_u32(&row[17], modb_crc32(data, size));
+        block_table.append(row, MODB_V2_BLOCK_TABLE_ROW_SIZE);
+
+        return offset;
+    }
+
+    /*
+     * finish - write the directory, block table and footer.
+     *  returns: the complete file
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    ModbBuffer &finish()
+    {
+        if(finished) return out;
+
+        modb_put_u32(directory.data(), entries);
+        modb_put_u32(&directory[4], MODB_V2_DIRECTORY_ROW_SIZE);
+        add_block(MODB_BLOCK_DIRECTORY, directory.data(), directory.size());
+
+        /* At most half full, so probes stay short. */
+        uint32_t buckets = 1;
+        while(buckets < entries * 2) buckets <<= 1;
+
+        ModbBuffer name_index(arena);
+        name_index.resize(4 + (size_t) buckets * 8);
+        modb_put_u32(name_index.data(), buckets);
+
+        for(uint32_t index = 0; index < entries; index++)
+        {
+            uint32_t hash = modb_get_u32(&names[index * 16]);
+            uint32_t bucket = hash & (buckets - 1);
+            while(true)
+            {
+                unsigned char *slot = &name_index[4 + bucket * 8];
+                uint32_t taken = modb_get_u32(&slot[4]);
+
+                /* A later entry with the same name replaces the earlier one. */
+                if(taken == 0 || same_name(taken - 1, index))
+                {
+                    modb_put_u32(slot, hash);
+                    modb_put_u32(&slot[4], index + 1);
+                    break;
+                }
+
+                bucket = (bucket + 1) & (buckets - 1);
+            }
+        }
+        add_block(MODB_BLOCK_NAME_INDEX, name_index.data(), name_index.size());
+
+        uint64_t table_offset = out.size();
+        out.append(block_table.data(), block_table.size());
+
+        unsigned char footer[MODB_V2_FOOTER_SIZE];
+        modb_put_u32(footer, (uint32_t) table_offset);
+        modb_put_u32(&footer[4], (uint32_t) (table_offset >> 32));
+        modb_put_u32(&footer[8], (uint32_t) (block_table.size() / MODB_V2_BLOCK_TABLE_ROW_SIZE));
+        memcpy(&footer[12], modb_v2_magic, 4);
+        out.append(footer, MODB_V2_FOOTER_SIZE);
+
+        finished = true;
+        return out;
+    }
+
+    /*
+     * write_file - finish the file and write it to `path` through a temporary file and an atomic rename.
+     *  returns: true if the file was written and synced, along with the folder the rename changed, else false
+     *  on error: this function does not error
+     * */
+    bool write_file(const unsigned char *path)
+    {
+        ModbBuffer &file = finish();
+
+        ModbBuffer temp_path(arena);
+        temp_path.append_cstr(path);
+        temp_path.append_cstr(UC_PTR ".tmp");
+
+        FILE *temp = fopen(temp_path.c_str(), "wb");
+        if(!temp) return false;
+
+        bool ok = fwrite(file.data(), sizeof(unsigned char), file.size(), temp) == file.size() && fflush(temp) == 0;
+#if defined(__unix) || defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+        ok = ok && fsync(fileno(temp)) == 0;
+#endif
+        ok = fclose(temp) == 0 && ok;
+
+        if(!ok || rename(temp_path.c_str(), NCC_PTR path) != 0)
+        {
+            remove(temp_path.c_str());
+            return false;
+        }
+
+        /* Until the folder is synced a crash can still bring back the old file, or none. */
+#if defined(__unix) || defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+        return modb_sync_folder(modb_folder_of(NCC_PTR path));
+#else
+        return true;
+#endif
+    }
+};
+
+/*
+ * modb_find_v1_entry - find the entry named `name` (the last one if `name` is empty) in the v1 modb binary file
+ *                      `data`; later entries win.
+ *  returns: true if there is one else false
+ *  on error: this function does not error; `entry` points into `data`
+ * */
+inline bool modb_find_v1_entry(const unsigned char *data, size_t size, std::string_view name, _ModbEntryView &entry)
+{
+    bool found = false;
+    size_t at = 0;
+
+    while(at + bytes_to_skip < size)
+    {
+        _ModbEntryView next;
+        at = modb_parse_entry(data, size, at + bytes_to_skip, next);
+        if(name.empty() || next.name == name)
+        {
+            entry = next;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/*
+ * modb_migrate_to_v2 - rewrite a v1 modb binary file at `path` in the v2 format, keeping every entry.
+ *                      `DatabaseConnect` reads v1 files as they are; this is only run when asked for, and by a
+ *                      compaction, which rewrites the file anyway.
+ *  returns: true if the file is v2 afterwards (it may already have been) else false
+ *  on error: this function does not error
+ * */
+inline bool modb_migrate_to_v2(const unsigned char *path)
+{
+    ModbMapping v1_file;
+    if(!v1_file.map_file(path)) return false;
+    if(modb_is_v2(v1_file.data(), v1_file.size())) return true;
+
+    ModbWriterV2 writer;
+
+    size_t at = 0;
+    while(at + bytes_to_skip < v1_file.size())
+    {
+        _ModbEntryView entry;
+        at = modb_parse_entry(v1_file.data(), v1_file.size(), at + bytes_to_skip, entry);
+        writer.add_entry(entry);
+    }
+
+    return writer.write_file(path);
+}
+
+#endif
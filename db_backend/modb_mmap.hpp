@@ -0,0 +1,104 @@
+#ifndef modb_mmap
+#define modb_mmap
+
+/* Read-only view of a whole file.
+ *
+ * On POSIX systems the file is memory-mapped, so parsing works on the page cache directly and
+ * anything pointing into `data()` stays valid for as long as the `ModbMapping` is alive.
+ * Elsewhere the file is read into one buffer instead.
+ * */
+class ModbMapping
+{
+private:
+    unsigned char *map_data = nullptr;
+    size_t map_size = 0;
+    bool mapped = false;
+
+public:
+    ModbMapping() {}
+    ModbMapping(const ModbMapping &) = delete;
+    ModbMapping &operator=(const ModbMapping &) = delete;
+
+    ModbMapping(ModbMapping &&other)
+        : map_data(other.map_data), map_size(other.map_size), mapped(other.mapped)
+    {
+        other.map_data = nullptr;
+        other.map_size = 0;
+        other.mapped = false;
+    }
+
+    /*
+     * map_file - map the file at `path` for reading.
+     *  returns: true if the file was mapped (an empty file maps to no data) else false
+     *  on error: this function does not error
+     * */
+    bool map_file(const unsigned char *path)
+    {
+        unmap();
+
+#if defined(__unix) || defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+        int fd = open(NCC_PTR path, O_RDONLY | O_CLOEXEC);
+        if(fd == -1) return false;
+
+        struct stat file_info;
+        if(fstat(fd, &file_info) == -1) { close(fd); return false; }
+
+        map_size = file_info.st_size;
+        if(map_size > 0)
+        {
+            void *addr = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(addr == MAP_FAILED) { close(fd); map_size = 0; return false; }
+
+            /* The loaders scan front to back. */
+            madvise(addr, map_size, MADV_SEQUENTIAL);
+
+            map_data = UC_PTR addr;
+            mapped = true;
+        }
+
+        close(fd);
+        return true;
+#else
+        FILE *file = fopen(NCC_PTR path, "rb");
+        if(!file) return false;
+
+        fseek(file, 0, SEEK_END);
+        map_size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        if(map_size > 0)
+        {
+            map_data = UC_PTR malloc(map_size);
+            database_assert(map_data, "\nError allocating memory for reading %s.\n", path)
+            map_size = fread(map_data, sizeof(unsigned char), map_size, file);
+        }
+
+        fclose(file);
+        return true;
+#endif
+    }
+
+    const unsigned char *data() const { return map_data; }
+    size_t size() const { return map_size; }
+
+    /*
+     * unmap - release the mapping; pointers into `data()` are no longer valid after this.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void unmap()
+    {
+#if defined(__unix) || defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+        if(mapped) munmap(map_data, map_size);
+#else
+        if(map_data) free(map_data);
+#endif
+        map_data = nullptr;
+        map_size = 0;
+        mapped = false;
+    }
+
+    ~ModbMapping() { unmap(); }
+};
+
+#endif
@@ -0,0 +1,357 @@
+#ifndef modb_page_cache
+#define modb_page_cache
+
+/* Fixed-size buffer cache over a file, for reading `.modb` files that do not fit in memory.
+ *
+ * It pages the catalog of database entries (the `.modb` file); POD values are not in that file, they are kept in
+ * memory and restored from the write-ahead log (see `write_ahead_log.hpp` and `wal_compaction.hpp`).
+ *
+ * The file is read `MODB_PAGE_SIZE` bytes at a time into frames set aside up front, so the cache never holds
+ * more than the capacity it was made with. Pages are spread over `MODB_PAGE_CACHE_SHARDS` shards by page number,
+ * each with its own frames, map and CLOCK hand:
+ *  - a hit only takes its shard's lock shared, pins the frame and sets its reference bit (both atomics), so
+ *    readers of the same shard do not wait on each other and nothing is held across the whole cache;
+ *  - a miss takes its shard's lock exclusively, sweeps the CLOCK hand past pinned frames and frames referenced
+ *    since the last sweep (clearing their bit), and reads the page into the first frame it lands on.
+ * A pinned frame is never evicted; `ModbPagePin` unpins when it goes away.
+ * */
+#define MODB_PAGE_SIZE              4096
+#define MODB_PAGE_CACHE_SHARDS      16
+
+/* Capacity a `DatabaseConnect` without a cache of its own reads through. */
+#define MODB_PAGE_CACHE_DEFAULT_SIZE    (64 * MODB_PAGE_SIZE)
+
+#define MODB_PAGE_NONE              UINT64_MAX
+
+typedef struct PageCacheStats
+{
+    uint64_t    hits = 0;
+    uint64_t    misses = 0;
+    uint64_t    evictions = 0;
+
+    /* Reads that found every frame of their shard pinned and went to the file directly. */
+    uint64_t    bypassed = 0;
+
+    uint64_t    frames = 0;
+} _PageCacheStats;
+
+typedef struct ModbPageFrame
+{
+    uint64_t                page = MODB_PAGE_NONE;
+    uint32_t                size = 0;
+    unsigned char           *data = nullptr;
+    std::atomic<uint32_t>   pins{0};
+    std::atomic<bool>       referenced{false};
+} _ModbPageFrame;
+
+typedef struct alignas(64) ModbPageShard
+{
+    std::shared_mutex                       lock;
+    std::unordered_map<uint64_t, uint32_t>  frame_of;
+    std::unique_ptr<_ModbPageFrame[]>       frames;
+    uint32_t                                frame_count = 0;
+    uint32_t                                hand = 0;
+
+    std::atomic<uint64_t>                   hits{0};
+    std::atomic<uint64_t>                   misses{0};
+    std::atomic<uint64_t>                   evictions{0};
+    std::atomic<uint64_t>                   bypassed{0};
+} _ModbPageShard;
+
+/* A page held in the cache; the frame cannot be evicted until this goes away. */
+class ModbPagePin
+{
+private:
+    _ModbPageFrame *frame = nullptr;
+
+public:
+    ModbPagePin() = default;
+    explicit ModbPagePin(_ModbPageFrame *pinned) : frame(pinned) {}
+    ModbPagePin(const ModbPagePin &) = delete;
+    ModbPagePin &operator=(const ModbPagePin &) = delete;
+
+    ModbPagePin(ModbPagePin &&other) : frame(other.frame) { other.frame = nullptr; }
+    ModbPagePin &operator=(ModbPagePin &&other)
+    {
+        release();
+        frame = other.frame;
+        other.frame = nullptr;
+        return *this;
+    }
+
+    bool valid() const { return frame != nullptr; }
+    const unsigned char *data() const { return frame->data; }
+
+    /* Bytes of the page in the file; only the last page is short. */
+    uint32_t size() const { return frame->size; }
+
+    void release()
+    {
+        if(frame) frame->pins.fetch_sub(1, std::memory_order_release);
+        frame = nullptr;
+    }
+
+    ~ModbPagePin() { release(); }
+};
+
+class ModbPageCache
+{
+private:
+    int fd = -1;
+    uint64_t size = 0;
+
+    /* Identity of the open file, to tell when the path has been replaced (see `refresh`). */
+    dev_t file_device = 0;
+    ino_t file_inode = 0;
+    int64_t file_modified = 0;
+
+    std::unique_ptr<_ModbPageShard[]> shards;
+    std::unique_ptr<unsigned char[]> memory;
+
+    static uint32_t shard_of(uint64_t page) { return (uint32_t) ((page * 0x9E3779B97F4A7C15ull) >> 60) % MODB_PAGE_CACHE_SHARDS; }
+
+    static int64_t modified_of(const struct stat &info) { return (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec; }
+
+    /*
+     * load - read `page` into a frame of `shard` (whose lock is held exclusively) and pin it.
+     *  returns: the frame, or nullptr if every frame is pinned or the page could not be read
+     *  on error: this function does not error
+     * */
+    _ModbPageFrame *load(_ModbPageShard &shard, uint64_t page)
+    {
+        /* Two turns of the hand: the first may only be clearing reference bits. */
+        _ModbPageFrame *victim = nullptr;
+        for(uint32_t turns = 0; turns < 2 * shard.frame_count; turns++)
+        {
+            _ModbPageFrame &frame = shard.frames[shard.hand];
+            shard.hand = shard.hand + 1 == shard.frame_count ? 0 : shard.hand + 1;
+
+            if(frame.pins.load(std::memory_order_acquire) > 0) continue;
+            if(frame.referenced.exchange(false, std::memory_order_relaxed)) continue;
+
+            victim = &frame;
+            break;
+        }
+        if(!victim) return nullptr;
+
+        if(victim->page != MODB_PAGE_NONE)
+        {
+            shard.frame_of.erase(victim->page);
+            victim->page = MODB_PAGE_NONE;
+            shard.evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t offset = page * MODB_PAGE_SIZE;
+        uint32_t wanted = (uint32_t) (size - offset < MODB_PAGE_SIZE ? size - offset : MODB_PAGE_SIZE);
+        if(!read_file(offset, victim->data, wanted)) return nullptr;
+
+        victim->page = page;
+        victim->size = wanted;
+        victim->pins.store(1, std::memory_order_relaxed);
+        victim->referenced.store(true, std::memory_order_relaxed);
+        shard.frame_of.emplace(page, (uint32_t) (victim - shard.frames.get()));
+        return victim;
+    }
+
+    bool read_file(uint64_t offset, unsigned char *out, size_t wanted)
+    {
+        while(wanted > 0)
+        {
+            ssize_t got = pread(fd, out, wanted, (off_t) offset);
+            if(got == -1 && errno == EINTR) continue;
+            if(got <= 0) return false;
+
+            out += got;
+            offset += got;
+            wanted -= got;
+        }
+        return true;
+    }
+
+    /* Forgets every page; a frame still pinned keeps its bytes until it is unpinned, then is reused. */
+    void drop_pages()
+    {
+        for(uint32_t i = 0; i < MODB_PAGE_CACHE_SHARDS; i++)
+        {
+            _ModbPageShard &shard = shards[i];
+            std::unique_lock<std::shared_mutex> guard(shard.lock);
+
+            for(uint32_t frame = 0; frame < shard.frame_count; frame++)
+            {
+                shard.frames[frame].page = MODB_PAGE_NONE;
+                shard.frames[frame].referenced.store(false, std::memory_order_relaxed);
+            }
+            shard.frame_of.clear();
+        }
+    }
+
+public:
+    /*
+     * ModbPageCache - set aside frames for `capacity` bytes of pages (at least one per shard).
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    explicit ModbPageCache(size_t capacity = MODB_PAGE_CACHE_DEFAULT_SIZE)
+    {
+        uint32_t per_shard = (uint32_t) (capacity / MODB_PAGE_SIZE / MODB_PAGE_CACHE_SHARDS);
+        if(per_shard == 0) per_shard = 1;
+
+        shards.reset(new (std::nothrow) _ModbPageShard[MODB_PAGE_CACHE_SHARDS]);
+        memory.reset(new (std::nothrow) unsigned char[(size_t) per_shard * MODB_PAGE_CACHE_SHARDS * MODB_PAGE_SIZE]);
+        database_assert(shards && memory, "\nError allocating a page cache of %zu bytes.\n", capacity)
+
+        for(uint32_t i = 0; i < MODB_PAGE_CACHE_SHARDS; i++)
+        {
+            _ModbPageShard &shard = shards[i];
+            shard.frames.reset(new (std::nothrow) _ModbPageFrame[per_shard]);
+            database_assert(shard.frames, "\nError allocating a page cache of %zu bytes.\n", capacity)
+
+            shard.frame_count = per_shard;
+            shard.frame_of.reserve(per_shard);
+            for(uint32_t frame = 0; frame < per_shard; frame++)
+                shard.frames[frame].data = &memory[((size_t) i * per_shard + frame) * MODB_PAGE_SIZE];
+        }
+    }
+
+    ModbPageCache(const ModbPageCache &) = delete;
+    ModbPageCache &operator=(const ModbPageCache &) = delete;
+
+    /*
+     * refresh - read the file at `path` from now on; the cached pages are kept if it is still the file read so far
+     *           (same inode, size and modification time), and dropped if it was replaced or changed.
+     *  returns: true if the file is open else false
+     *  on error: this function does not error
+     *
+     *  Note: not while other threads read through the cache.
+     * */
+    bool refresh(const char *path)
+    {
+        struct stat info;
+        if(stat(path, &info) == -1) return false;
+
+        if(fd != -1 && info.st_dev == file_device && info.st_ino == file_inode &&
+           (uint64_t) info.st_size == size && modified_of(info) == file_modified)
+            return true;
+
+        int opened = ::open(path, O_RDONLY | O_CLOEXEC);
+        if(opened == -1) return false;
+        if(fstat(opened, &info) == -1) { ::close(opened); return false; }
+
+        if(fd != -1) ::close(fd);
+        fd = opened;
+        size = (uint64_t) info.st_size;
+        file_device = info.st_dev;
+        file_inode = info.st_ino;
+        file_modified = modified_of(info);
+
+        drop_pages();
+        return true;
+    }
+
+    bool is_open() { return fd != -1; }
+    uint64_t file_size() { return size; }
+
+    /* Bytes of pages the cache holds at most. */
+    uint64_t capacity() { return (uint64_t) shards[0].frame_count * MODB_PAGE_CACHE_SHARDS * MODB_PAGE_SIZE; }
+
+    /*
+     * pin - get page `page` of the file, reading it in on a miss.
+     *  returns: the pinned page, not valid if the page is past the end of the file, could not be read or every
+     *           frame of its shard is pinned
+     *  on error: this function does not error
+     * */
+    ModbPagePin pin(uint64_t page)
+    {
+        if(fd == -1 || page >= (size + MODB_PAGE_SIZE - 1) / MODB_PAGE_SIZE) return ModbPagePin();
+
+        _ModbPageShard &shard = shards[shard_of(page)];
+        {
+            std::shared_lock<std::shared_mutex> guard(shard.lock);
+
+            auto found = shard.frame_of.find(page);
+            if(found != shard.frame_of.end())
+            {
+                _ModbPageFrame &frame = shard.frames[found->second];
+                frame.pins.fetch_add(1, std::memory_order_acquire);
+                if(!frame.referenced.load(std::memory_order_relaxed)) frame.referenced.store(true, std::memory_order_relaxed);
+
+                shard.hits.fetch_add(1, std::memory_order_relaxed);
+                return ModbPagePin(&frame);
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+
+        /* Another reader may have loaded it in between. */
+        auto found = shard.frame_of.find(page);
+        if(found != shard.frame_of.end())
+        {
+            _ModbPageFrame &frame = shard.frames[found->second];
+            frame.pins.fetch_add(1, std::memory_order_acquire);
+            frame.referenced.store(true, std::memory_order_relaxed);
+
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return ModbPagePin(&frame);
+        }
+
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        return ModbPagePin(load(shard, page));
+    }
+
+    /*
+     * read - copy `wanted` bytes from `offset` of the file to `out`, through the cache.
+     *  returns: true if every byte was copied else false (the range runs past the end, or the file could not be read)
+     *  on error: this function does not error
+     * */
+    bool read(uint64_t offset, unsigned char *out, size_t wanted)
+    {
+        if(offset > size || wanted > size - offset) return false;
+
+        while(wanted > 0)
+        {
+            uint64_t page = offset / MODB_PAGE_SIZE;
+            uint32_t within = (uint32_t) (offset % MODB_PAGE_SIZE);
+            size_t part = MODB_PAGE_SIZE - within < wanted ? MODB_PAGE_SIZE - within : wanted;
+
+            ModbPagePin pinned = pin(page);
+            if(pinned.valid()) memcpy(out, &pinned.data()[within], part);
+            else
+            {
+                /* Every frame of the shard is pinned by someone else; read around the cache. */
+                if(!read_file(offset, out, part)) return false;
+                shards[shard_of(page)].bypassed.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            out += part;
+            offset += part;
+            wanted -= part;
+        }
+        return true;
+    }
+
+    /*
+     * stats - the counters of every shard added up; safe to call from any thread.
+     *  returns: the counters
+     *  on error: this function does not error
+     * */
+    _PageCacheStats stats()
+    {
+        _PageCacheStats total;
+        for(uint32_t i = 0; i < MODB_PAGE_CACHE_SHARDS; i++)
+        {
+            total.hits += shards[i].hits.load(std::memory_order_relaxed);
+            total.misses += shards[i].misses.load(std::memory_order_relaxed);
+            total.evictions += shards[i].evictions.load(std::memory_order_relaxed);
+            total.bypassed += shards[i].bypassed.load(std::memory_order_relaxed);
+            total.frames += shards[i].frame_count;
+        }
+        return total;
+    }
+
+    ~ModbPageCache()
+    {
+        if(fd != -1) ::close(fd);
+        fd = -1;
+    }
+};
+
+#endif
@@ -0,0 +1,305 @@
+#ifndef modb_stats
+#define modb_stats
+
+/* Server-side counters and latency histograms.
+ *
+ * Every thread of the server (the event loop and each worker) records into a `ModbThreadStats` of its own,
+ * so recording is a few plain increments and never contends; `ModbStats` adds the threads up when asked.
+ * Requests and responses are all counted, but only every `MODB_STATS_SAMPLE_EVERY`th one is timed, which keeps
+ * the clock off the hot path. Histograms are HDR-style: exact below 16 ns, then 16 buckets per power of two
+ * (about 6% wide) up to 2^40 ns.
+ *
+ * Phases are named after the `SS_STATUS` the server is in during them:
+ *  MODB_PHASE_LISTENING    the event loop waiting for something to do
+ *  MODB_PHASE_READING      taking requests off sockets and shared-memory rings
+ *  MODB_PHASE_PERFORMING   performing one request, on the event loop or a worker
+ *  MODB_PHASE_PUBLISHING   making the changes of a pass durable and writing its responses
+ * Per `CS_REQUEST_*` there is a count, how many did not get `SS_RESPONSE_OK`, the latency from the request being
+ * read to its response being ready, and the time spent performing it (the rest of the latency is queueing).
+ * */
+#define MODB_PHASE_LISTENING            0
+#define MODB_PHASE_READING              1
+#define MODB_PHASE_PERFORMING           2
+#define MODB_PHASE_PUBLISHING           3
+#define MODB_PHASE_COUNT                4
+
+/* Power of two. */
+#define MODB_STATS_SAMPLE_EVERY         16
+
+#define MODB_STATS_HISTOGRAM_BUCKETS    (16 + 36 * 16)
+
+/* One slot per `CS_REQUEST_*` (0xF0 through 0xFF), the last for anything else. */
+#define MODB_STATS_OPCODES              17
+#define modb_stats_opcode_slot(opcode)  ((opcode) >= CS_REQUEST_CREATE_NEW_DB_ENTRY && (opcode) <= CS_REQUEST_STREAM_POD ? (opcode) - CS_REQUEST_CREATE_NEW_DB_ENTRY : MODB_STATS_OPCODES - 1)
+
+/*
+ * modb_stats_now - monotonic time in nanoseconds, for timing samples.
+ *  returns: the time
+ *  on error: this function does not error
+ * */
+inline uint64_t modb_stats_now()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * modb_stats_sampled - advance `tick` and check if the event it counts is one to time.
+ *  returns: true every `MODB_STATS_SAMPLE_EVERY`th call
+ *  on error: this function does not error
+ * */
+inline bool modb_stats_sampled(uint32_t &tick) { return (++tick & (MODB_STATS_SAMPLE_EVERY - 1)) == 0; }
+
+/* Only the owning thread records; any thread may read, so the fields are atomics updated without read-modify-writes. */
+typedef struct ModbHistogram
+{
+    std::atomic<uint64_t>   counts[MODB_STATS_HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t>   total;
+    std::atomic<uint64_t>   sum;
+    std::atomic<uint64_t>   largest;
+
+    static uint32_t bucket_of(uint64_t ns)
+    {
+        if(ns < 16) return (uint32_t) ns;
+
+        uint32_t exponent = 63 - __builtin_clzll(ns);
+        if(exponent > 39) return MODB_STATS_HISTOGRAM_BUCKETS - 1;
+
+        return 16 + (exponent - 4) * 16 + (uint32_t) ((ns >> (exponent - 4)) - 16);
+    }
+
+    static uint64_t lowest_in(uint32_t bucket)
+    {
+        if(bucket < 16) return bucket;
+
+        uint32_t exponent = (bucket - 16) / 16 + 4;
+        return (uint64_t) (16 + (bucket - 16) % 16) << (exponent - 4);
+    }
+
+    static void bump(std::atomic<uint64_t> &counter, uint64_t by)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        for(std::atomic<uint64_t> &count: counts) count.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        largest.store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t ns)
+    {
+        bump(counts[bucket_of(ns)], 1);
+        bump(total, 1);
+        bump(sum, ns);
+        if(ns > largest.load(std::memory_order_relaxed)) largest.store(ns, std::memory_order_relaxed);
+    }
+} _ModbHistogram;
+
+/* Histograms of several threads added up; a plain copy, so percentiles are taken from numbers that hold still. */
+typedef struct ModbHistogramTotal
+{
+    uint64_t    counts[MODB_STATS_HISTOGRAM_BUCKETS] = {0};
+    uint64_t    total = 0;
+    uint64_t    sum = 0;
+    uint64_t    largest = 0;
+
+    void add(const _ModbHistogram &histogram)
+    {
+        for(uint32_t bucket = 0; bucket < MODB_STATS_HISTOGRAM_BUCKETS; bucket++) counts[bucket] += histogram.counts[bucket].load(std::memory_order_relaxed);
+        total += histogram.total.load(std::memory_order_relaxed);
+        sum += histogram.sum.load(std::memory_order_relaxed);
+
+        uint64_t their_largest = histogram.largest.load(std::memory_order_relaxed);
+        if(their_largest > largest) largest = their_largest;
+    }
+
+    /*
+     * percentile - smallest latency at least `fraction` of the samples are at or below.
+     *  returns: the latency in nanoseconds (the bottom of its bucket), 0 without samples
+     *  on error: this function does not error
+     * */
+    uint64_t percentile(double fraction)
+    {
+        if(total == 0) return 0;
+
+        uint64_t wanted = (uint64_t) (fraction * total + 0.5), seen = 0;
+        if(wanted == 0) wanted = 1;
+
+        for(uint32_t bucket = 0; bucket < MODB_STATS_HISTOGRAM_BUCKETS; bucket++)
+        {
+            seen += counts[bucket];
+            if(seen >= wanted) return ModbHistogram::lowest_in(bucket);
+        }
+        return largest;
+    }
+} _ModbHistogramTotal;
+
+typedef struct ModbThreadStats
+{
+    _ModbHistogram          phases[MODB_PHASE_COUNT];
+
+    /* Per `modb_stats_opcode_slot`. */
+    std::atomic<uint64_t>   requests[MODB_STATS_OPCODES];
+    std::atomic<uint64_t>   failed[MODB_STATS_OPCODES];
+    _ModbHistogram          latency[MODB_STATS_OPCODES];
+    _ModbHistogram          service[MODB_STATS_OPCODES];
+
+    std::atomic<uint64_t>   bytes_read;
+    std::atomic<uint64_t>   bytes_written;
+
+    ModbThreadStats() { reset(); }
+
+    ModbThreadStats(const ModbThreadStats &) = delete;
+    ModbThreadStats &operator=(const ModbThreadStats &) = delete;
+
+    void reset()
+    {
+        for(_ModbHistogram &phase: phases) phase.reset();
+        for(uint32_t slot = 0; slot < MODB_STATS_OPCODES; slot++)
+        {
+            requests[slot].store(0, std::memory_order_relaxed);
+            failed[slot].store(0, std::memory_order_relaxed);
+            latency[slot].reset();
+            service[slot].reset();
+        }
+        bytes_read.store(0, std::memory_order_relaxed);
+        bytes_written.store(0, std::memory_order_relaxed);
+    }
+
+    /*
+     * count_request - count a request, and whether it got `SS_RESPONSE_OK`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void count_request(unsigned char opcode, bool ok)
+    {
+        uint32_t slot = modb_stats_opcode_slot(opcode);
+
+        ModbHistogram::bump(requests[slot], 1);
+        if(!ok) ModbHistogram::bump(failed[slot], 1);
+    }
+
+    void count_read(uint64_t bytes) { ModbHistogram::bump(bytes_read, bytes); }
+    void count_written(uint64_t bytes) { ModbHistogram::bump(bytes_written, bytes); }
+} _ModbThreadStats;
+
+class ModbStats
+{
+private:
+    /* Slot 0 is the event loop, slot `i + 1` worker `i`; never shrinks, so handed out pointers stay valid. */
+    std::mutex lock;
+    std::vector<std::unique_ptr<_ModbThreadStats>> threads;
+
+    std::atomic<bool> enabled{true};
+    uint64_t started_at = modb_stats_now();
+
+    static const char *opcode_name(uint32_t slot)
+    {
+        static const char *names[MODB_STATS_OPCODES] = {
+            "create_entry", "delete_entry", "create_pod", "delete_pod", "store", "read_pod", "batch", "query_pod",
+            "create_index", "drop_index", "lookup_pod", "server_stats", "open_session", "doorbell", "server_status", "stream_pod", "other"
+        };
+        return names[slot];
+    }
+
+    static void report_histogram(std::string &out, const char *kind, const char *name, _ModbHistogramTotal &histogram)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "%s.%s sampled=%llu mean_ns=%llu p50_ns=%llu p90_ns=%llu p99_ns=%llu p999_ns=%llu max_ns=%llu\n", kind, name,
+                 (unsigned long long) histogram.total, (unsigned long long) (histogram.total ? histogram.sum / histogram.total : 0),
+                 (unsigned long long) histogram.percentile(0.5), (unsigned long long) histogram.percentile(0.9),
+                 (unsigned long long) histogram.percentile(0.99), (unsigned long long) histogram.percentile(0.999), (unsigned long long) histogram.largest);
+        out += line;
+    }
+
+public:
+    /*
+     * thread - stats slot `index` (0 for the event loop, `i + 1` for worker `i`), made on first use.
+     *  returns: the slot; it stays valid as long as `this` does
+     *  on error: this function does not error
+     * */
+    _ModbThreadStats *thread(uint32_t index)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        while(threads.size() <= index) threads.emplace_back(new _ModbThreadStats);
+        return threads[index].get();
+    }
+
+    /*
+     * set_enabled - turn recording on or off; takes effect the next time the server starts.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_enabled(bool enable) { enabled.store(enable); }
+    bool is_enabled() { return enabled.load(); }
+
+    /*
+     * reset - zero every counter and histogram; only while nothing records (the server is not running).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void reset()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        for(auto &slot: threads) slot->reset();
+        started_at = modb_stats_now();
+    }
+
+    /*
+     * report - append every thread's stats, added up, to `out` as `name key=value ...` lines; safe to call from any thread.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void report(std::string &out)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        char line[256];
+
+        uint64_t bytes_read = 0, bytes_written = 0;
+        for(auto &slot: threads)
+        {
+            bytes_read += slot->bytes_read.load(std::memory_order_relaxed);
+            bytes_written += slot->bytes_written.load(std::memory_order_relaxed);
+        }
+
+        snprintf(line, sizeof(line), "server uptime_ms=%llu threads=%zu sample_every=%u bytes_read=%llu bytes_written=%llu\n",
+                 (unsigned long long) ((modb_stats_now() - started_at) / 1000000), threads.size(), MODB_STATS_SAMPLE_EVERY,
+                 (unsigned long long) bytes_read, (unsigned long long) bytes_written);
+        out += line;
+
+        static const char *phase_names[MODB_PHASE_COUNT] = {"listening", "reading", "performing", "publishing"};
+        for(uint32_t phase = 0; phase < MODB_PHASE_COUNT; phase++)
+        {
+            _ModbHistogramTotal total;
+            for(auto &slot: threads) total.add(slot->phases[phase]);
+
+            report_histogram(out, "phase", phase_names[phase], total);
+        }
+
+        for(uint32_t opcode = 0; opcode < MODB_STATS_OPCODES; opcode++)
+        {
+            uint64_t requests = 0, failed = 0;
+            _ModbHistogramTotal latency, service;
+
+            for(auto &slot: threads)
+            {
+                requests += slot->requests[opcode].load(std::memory_order_relaxed);
+                failed += slot->failed[opcode].load(std::memory_order_relaxed);
+                latency.add(slot->latency[opcode]);
+                service.add(slot->service[opcode]);
+            }
+            if(requests == 0 && service.total == 0) continue;
+
+            snprintf(line, sizeof(line), "requests.%s count=%llu failed=%llu\n", opcode_name(opcode), (unsigned long long) requests, (unsigned long long) failed);
+            out += line;
+            report_histogram(out, "latency", opcode_name(opcode), latency);
+            report_histogram(out, "service", opcode_name(opcode), service);
+        }
+    }
+};
+
+#endif
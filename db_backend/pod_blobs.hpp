@@ -0,0 +1,352 @@
+#ifndef pod_blobs
+#define pod_blobs
+
+/* Blob file for large BYTE_STREAM values.
+ *
+ * A BYTE_STREAM POD can hold its value in memory like any other POD, or have it kept in `<path>.blob` next to
+ * the `.modb`, in an extent of its own. Values reach the blob file through `CS_REQUEST_STREAM_POD`, one chunk
+ * per request, so neither side ever holds the whole value:
+ *      CS_STREAM_BEGIN     an extent big enough for the new value is set aside
+ *      CS_STREAM_WRITE     chunks are written into it, in any order
+ *      CS_STREAM_COMMIT    the blob file is synced and the extent becomes the value of the POD
+ * `CS_STREAM_READ` reads a value back a chunk at a time; for a value in the blob file the server hands the
+ * region of the file to the transport, which `sendfile`s it to the socket without copying it into a response.
+ *
+ * Only a commit is written to the write-ahead log, as the extent it attached (`CS_STREAM_ATTACH`), and only
+ * after the extent is synced, so a crash at any point leaves the old value or the new one. An extent a change
+ * detaches is not reused until that change is durable, nor while it is still being sent.
+ *
+ * Free space is not kept on disk: on start-up the whole file is free, and replaying the log claims the extents
+ * PODs still hold. Extents are `POD_BLOB_ALIGN` aligned; a free tail of the file is cut off once replay is done.
+ * */
+#define POD_BLOB_ALIGN              4096
+
+/* Chunk size clients move values in, and the most a `CS_STREAM_READ` answers with. */
+#define POD_BLOB_CHUNK_SIZE         (1024 * 1024)
+#define POD_BLOB_CHUNK_MAX          (SS_FRAME_MAX_PAYLOAD - 16)
+
+/* Largest value the blob file takes (1 TiB); aligning it, and the file's end past it, stays well inside an `off_t`. */
+#define POD_BLOB_MAX_SIZE           ((uint64_t) 1 << 40)
+
+/* What the published version of a POD kept in the blob file holds instead of [1: CS_STORING_*][value]. */
+#define POD_BLOB_VERSION            0x00
+
+#define pod_blob_file_extension     UC_PTR ".blob"
+#define pod_blob_align(size)        (((size) + POD_BLOB_ALIGN - 1) & ~(uint64_t) (POD_BLOB_ALIGN - 1))
+
+/* Where a value lives in the blob file; `capacity` is what was set aside for it. */
+typedef struct PodBlobExtent
+{
+    uint64_t    offset = 0;
+    uint64_t    capacity = 0;
+    uint64_t    size = 0;
+} _PodBlobExtent;
+
+/* Part of a value to send straight from the blob file; `extent` is the offset of its extent, pinned until it is sent. */
+typedef struct PodBlobRegion
+{
+    int         fd = -1;
+    uint64_t    offset = 0;
+    uint32_t    size = 0;
+    uint64_t    extent = 0;
+} _PodBlobRegion;
+
+class PodBlobFile
+{
+private:
+    int fd = -1;
+
+    /* Guards everything below; workers allocate and retire, the event loop recycles and unpins. */
+    std::mutex lock;
+
+    /* End of the space handed out so far, and the free extents before it by offset (neighbours are merged). */
+    uint64_t end = 0;
+    std::map<uint64_t, uint64_t> free_extents;
+
+    /* Extents detached by changes not yet durable (see `take_retired`). */
+    std::vector<_PodBlobExtent> retired;
+
+    /* Regions of an extent still being sent, by extent offset, and the freed extents that wait on them. */
+    std::unordered_map<uint64_t, uint32_t> pins;
+    std::unordered_map<uint64_t, uint64_t> unpinned_frees;
+
+    /* Set until the log has been replayed; only then are extents claimed (see `claim`). */
+    bool recovering = true;
+
+    void free_locked(uint64_t offset, uint64_t capacity)
+    {
+        if(capacity == 0) return;
+
+        auto next = free_extents.lower_bound(offset);
+        if(next != free_extents.end() && offset + capacity == next->first)
+        {
+            capacity += next->second;
+            next = free_extents.erase(next);
+        }
+
+        if(next != free_extents.begin())
+        {
+            auto previous = std::prev(next);
+            if(previous->first + previous->second == offset)
+            {
+                previous->second += capacity;
+                return;
+            }
+        }
+
+        free_extents.emplace(offset, capacity);
+    }
+
+public:
+    PodBlobFile() = default;
+    PodBlobFile(const PodBlobFile &) = delete;
+    PodBlobFile &operator=(const PodBlobFile &) = delete;
+
+    /*
+     * open - open (or create) the blob file at `path`; all of it is free until `claim` says otherwise.
+     *  returns: true if the file is open else false
+     *  on error: this function does not error
+     * */
+    bool open(const char *path)
+    {
+        fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if(fd == -1) return false;
+
+        struct stat info;
+        if(fstat(fd, &info) == -1) { ::close(fd); fd = -1; return false; }
+
+        end = pod_blob_align((uint64_t) info.st_size);
+        free_extents.clear();
+        if(end > 0) free_extents.emplace(0, end);
+        return true;
+    }
+
+    bool is_open() { return fd != -1; }
+    bool is_recovering() { return recovering; }
+    int descriptor() { return fd; }
+
+    /*
+     * claim - take the extent a replayed `CS_STREAM_ATTACH` names out of the free space.
+     *  returns: true if all of it was free else false
+     *  on error: this function does not error
+     * */
+    bool claim(const _PodBlobExtent &extent)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if(extent.capacity == 0 || extent.capacity > pod_blob_align(POD_BLOB_MAX_SIZE) || extent.offset % POD_BLOB_ALIGN != 0 ||
+           extent.size > extent.capacity || extent.offset > (uint64_t) INT64_MAX - extent.capacity)
+            return false;
+
+        auto found = free_extents.upper_bound(extent.offset);
+        if(found == free_extents.begin()) return false;
+        --found;
+
+        uint64_t free_offset = found->first, free_size = found->second;
+        if(free_offset + free_size < extent.offset + extent.capacity) return false;
+
+        free_extents.erase(found);
+        if(extent.offset > free_offset) free_extents.emplace(free_offset, extent.offset - free_offset);
+        if(free_offset + free_size > extent.offset + extent.capacity)
+            free_extents.emplace(extent.offset + extent.capacity, free_offset + free_size - extent.offset - extent.capacity);
+        return true;
+    }
+
+    /*
+     * finish_recovery - stop accepting `claim`s and cut off the free tail of the file.
+     *  returns: nothing
+     *  on error: this function does not error; a file that cannot be cut keeps its tail as free space
+     * */
+    void finish_recovery()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        recovering = false;
+
+        if(free_extents.empty()) return;
+
+        auto last = std::prev(free_extents.end());
+        if(last->first + last->second == end && ftruncate(fd, (off_t) last->first) == 0)
+        {
+            end = last->first;
+            free_extents.erase(last);
+        }
+    }
+
+    /*
+     * allocate - set aside an extent for a value of `size` bytes, reusing free space (first fit) before growing the file.
+     *  returns: true if `extent` was filled in else false (the file could not grow, or `size` is above `POD_BLOB_MAX_SIZE`)
+     *  on error: this function does not error
+     * */
+    bool allocate(uint64_t size, _PodBlobExtent &extent)
+    {
+        if(size > POD_BLOB_MAX_SIZE) return false;
+
+        uint64_t capacity = pod_blob_align(size > 0 ? size : 1);
+        std::lock_guard<std::mutex> guard(lock);
+
+        for(auto space = free_extents.begin(); space != free_extents.end(); ++space)
+        {
+            if(space->second < capacity) continue;
+
+            extent.offset = space->first;
+            extent.capacity = capacity;
+            extent.size = size;
+
+            if(space->second > capacity) free_extents.emplace(space->first + capacity, space->second - capacity);
+            free_extents.erase(space);
+            return true;
+        }
+
+        /* Reserved up front so writes into it cannot run out of space half way. */
+        if(posix_fallocate(fd, (off_t) end, (off_t) capacity) != 0) return false;
+
+        extent.offset = end;
+        extent.capacity = capacity;
+        extent.size = size;
+        end += capacity;
+        return true;
+    }
+
+    /*
+     * release - free an extent no one can see any more (never attached, or detached while replaying).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void release(const _PodBlobExtent &extent)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        free_locked(extent.offset, extent.capacity);
+    }
+
+    /*
+     * retire - free an extent once the change that detached it is durable; while replaying that is now.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void retire(const _PodBlobExtent &extent)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if(recovering) free_locked(extent.offset, extent.capacity);
+        else retired.push_back(extent);
+    }
+
+    /*
+     * take_retired - move the extents retired so far to `out`; take them before the write-ahead log is committed
+     *                and `recycle` them after, so only extents of changes the commit made durable are freed.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void take_retired(std::vector<_PodBlobExtent> &out)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        out.insert(out.end(), retired.begin(), retired.end());
+        retired.clear();
+    }
+
+    void recycle(std::vector<_PodBlobExtent> &extents)
+    {
+        if(extents.empty()) return;
+
+        std::lock_guard<std::mutex> guard(lock);
+        for(const _PodBlobExtent &extent: extents)
+        {
+            if(pins.count(extent.offset)) unpinned_frees[extent.offset] = extent.capacity;
+            else free_locked(extent.offset, extent.capacity);
+        }
+        extents.clear();
+    }
+
+    /*
+     * pin/unpin - keep the extent at `offset` from being freed while part of it is being sent.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void pin(uint64_t offset)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pins[offset]++;
+    }
+
+    void unpin(uint64_t offset)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto pinned = pins.find(offset);
+        if(pinned == pins.end() || --pinned->second > 0) return;
+        pins.erase(pinned);
+
+        auto waiting = unpinned_frees.find(offset);
+        if(waiting == unpinned_frees.end()) return;
+
+        free_locked(offset, waiting->second);
+        unpinned_frees.erase(waiting);
+    }
+
+    /*
+     * write/read - copy `size` bytes to or from the value in `extent`, from byte `at` of the value on.
+     *  returns: true if every byte was copied else false
+     *  on error: this function does not error
+     * */
+    bool write(const _PodBlobExtent &extent, uint64_t at, const unsigned char *data, size_t size)
+    {
+        if(at > extent.size || size > extent.size - at) return false;
+
+        uint64_t offset = extent.offset + at;
+        while(size > 0)
+        {
+            ssize_t wrote = pwrite(fd, data, size, (off_t) offset);
+            if(wrote == -1 && errno == EINTR) continue;
+            if(wrote <= 0) return false;
+
+            data += wrote;
+            offset += wrote;
+            size -= wrote;
+        }
+        return true;
+    }
+
+    bool read(const _PodBlobExtent &extent, uint64_t at, unsigned char *data, size_t size)
+    {
+        if(at > extent.size || size > extent.size - at) return false;
+
+        uint64_t offset = extent.offset + at;
+        while(size > 0)
+        {
+            ssize_t got = pread(fd, data, size, (off_t) offset);
+            if(got == -1 && errno == EINTR) continue;
+            if(got <= 0) return false;
+
+            data += got;
+            offset += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    /*
+     * sync - make everything written to the blob file so far durable.
+     *  returns: true on success else false
+     *  on error: this function does not error
+     * */
+    bool sync() { return fdatasync(fd) == 0; }
+
+    /*
+     * file_size - how big the blob file is, free space included.
+     *  returns: the size in bytes
+     *  on error: this function does not error
+     * */
+    uint64_t file_size()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return end;
+    }
+
+    ~PodBlobFile()
+    {
+        if(fd != -1) ::close(fd);
+        fd = -1;
+    }
+};
+
+#endif
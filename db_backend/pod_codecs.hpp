@@ -0,0 +1,535 @@
+#ifndef pod_codecs
+#define pod_codecs
+
+/* Codecs stream values are compressed with when they are persisted.
+ *
+ * POD values reach disk as the `CS_REQUEST_TO_STORE_IN` records of the write-ahead log, and again as the records a
+ * compaction snapshot writes (see `wal_compaction.hpp`). A stream value of at least `POD_CODEC_MIN_SIZE` bytes is
+ * written there as `CS_STORING_ENCODED` instead of its own `CS_STORING_*`, if the codec picked for its type makes
+ * it smaller:
+ *      [1: CS_STORING_ENCODED][1: CS_STORING_* of the value][1: POD_CODEC_*][4: decoded size][encoded value]
+ * Replaying (or any client sending one) decodes it back before it is stored, so the columns never see encoded values.
+ *
+ * Codecs, by id (`pod_codec_table`):
+ *  POD_CODEC_NONE              the value as it is
+ *  POD_CODEC_DELTA_BITPACK     WORD/DWORD streams: each value becomes the zig-zagged difference to the one before,
+ *                              packed `POD_CODEC_BLOCK` at a time with as many bits as the largest of them needs
+ *                              ([1: bits][packed differences] per block, `POD_CODEC_PADDING` zero bytes at the end)
+ *  POD_CODEC_LZ                any stream: LZ77 in the LZ4 layout; sequences of [1: literal length << 4 | match length - 4]
+ *                              [more literal length][literals][2: match offset][more match length], the last one literals only
+ * Which codec a type gets is set per column (`_PodCodecPolicy`); `POD_CODEC_AUTO` encodes a sample of each value
+ * with the codec made for the type and only encodes the value if the sample shrank enough.
+ * */
+#define POD_CODEC_NONE              0x00
+#define POD_CODEC_DELTA_BITPACK     0x01
+#define POD_CODEC_LZ                0x02
+#define POD_CODEC_COUNT             3
+
+/* Policy only: pick by sampling. */
+#define POD_CODEC_AUTO              0xFF
+
+/* Bytes before the encoded value: [1: CS_STORING_ENCODED][1: CS_STORING_*][1: POD_CODEC_*][4: decoded size]. */
+#define POD_CODEC_HEADER_SIZE       7
+
+/* Largest decoded value taken: what a plain store could carry, so `CS_REQUEST_READ_POD` can still answer it in one
+ * frame ([1: CS_STORING_*][value]).
+ * */
+#define POD_CODEC_MAX_VALUE         (SS_FRAME_MAX_PAYLOAD - 1)
+
+/* Values smaller than this are not worth encoding. */
+#define POD_CODEC_MIN_SIZE          64
+
+/* `POD_CODEC_AUTO` encodes the first `POD_CODEC_SAMPLE_SIZE` bytes and keeps the codec if they shrank to 7/8 or less. */
+#define POD_CODEC_SAMPLE_SIZE       4096
+
+#define POD_CODEC_BLOCK             128
+#define POD_CODEC_PADDING           8
+
+#define POD_CODEC_LZ_HASH_BITS      12
+#define POD_CODEC_LZ_MIN_MATCH      4
+#define POD_CODEC_LZ_MAX_OFFSET     0xFFFF
+
+/* Unaligned little-endian loads and stores the codecs work in (`pod_codec_load_u32` only feeds a hash, so byte order does not matter). */
+inline uint64_t pod_codec_load_u64(const unsigned char *at)
+{
+    uint64_t value;
+    memcpy(&value, at, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+inline uint32_t pod_codec_load_u32(const unsigned char *at)
+{
+    uint32_t value;
+    memcpy(&value, at, 4);
+    return value;
+}
+
+template<typename T>
+inline T pod_codec_load(const unsigned char *at)
+{
+    T value;
+    memcpy(&value, at, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if(sizeof(T) == 2) value = (T) __builtin_bswap16((uint16_t) value);
+    else value = (T) __builtin_bswap32((uint32_t) value);
+#endif
+    return value;
+}
+
+template<typename T>
+inline void pod_codec_store(unsigned char *at, T value)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if(sizeof(T) == 2) value = (T) __builtin_bswap16((uint16_t) value);
+    else value = (T) __builtin_bswap32((uint32_t) value);
+#endif
+    memcpy(at, &value, sizeof(T));
+}
+
+/* Unpacks a whole block of `Bits` wide differences, 8 (`Bits` bytes) at a time; the width is a constant, so every
+ * offset, shift and mask within the 8 is too.
+ * */
+template<unsigned Bits>
+void pod_codec_unpack_block(const unsigned char *packed, uint32_t *deltas)
+{
+    const uint64_t mask = (1ull << Bits) - 1;
+    for(uint32_t group = 0; group < POD_CODEC_BLOCK; group += 8, packed += Bits)
+    {
+#pragma GCC unroll 8
+        for(uint32_t i = 0; i < 8; i++)
+            deltas[group + i] = (uint32_t) ((pod_codec_load_u64(&packed[(i * Bits) >> 3]) >> ((i * Bits) & 7)) & mask);
+    }
+}
+
+typedef void (*pod_codec_unpack_fn)(const unsigned char *, uint32_t *);
+
+template<unsigned... Bits>
+constexpr std::array<pod_codec_unpack_fn, sizeof...(Bits)> pod_codec_unpackers(std::integer_sequence<unsigned, Bits...>)
+{
+    return {pod_codec_unpack_block<Bits>...};
+}
+
+/* By width, 0 through 32 bits. */
+static const std::array<pod_codec_unpack_fn, 33> pod_codec_unpack_table = pod_codec_unpackers(std::make_integer_sequence<unsigned, 33>());
+
+/* Undoes the zig-zag of `count` differences and adds them up from `previous` into `values`. SSE2 is part of
+ * x86-64 itself, so unlike the kernels in `stream_kernels.hpp` there is nothing to pick at runtime.
+ * */
+template<typename T>
+void pod_codec_prefix_scalar(const uint32_t *deltas, uint32_t count, unsigned char *values, T &previous)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        T delta = (T) deltas[i];
+        previous = (T) (previous + (T) ((delta >> 1) ^ (T) -(T) (delta & 1)));
+        pod_codec_store<T>(&values[i * sizeof(T)], previous);
+    }
+}
+
+#if defined(__SSE2__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Four differences undone and added up at once; `previous` holds the last sum in every lane. */
+inline __m128i pod_codec_prefix_4(__m128i deltas, __m128i &previous)
+{
+    __m128i sums = _mm_xor_si128(_mm_srli_epi32(deltas, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(deltas, _mm_set1_epi32(1))));
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+    sums = _mm_add_epi32(sums, previous);
+
+    previous = _mm_shuffle_epi32(sums, 0xFF);
+    return sums;
+}
+
+template<typename T>
+void pod_codec_prefix(const uint32_t *deltas, uint32_t count, unsigned char *values, T &previous)
+{
+    __m128i last = _mm_set1_epi32((int) previous);
+    uint32_t i = 0;
+
+    if(sizeof(T) == 4)
+        for(; i + 4 <= count; i += 4)
+            _mm_storeu_si128((__m128i *) &values[i * 4], pod_codec_prefix_4(_mm_loadu_si128((const __m128i *) &deltas[i]), last));
+    else
+        for(; i + 8 <= count; i += 8)
+        {
+            /* Only the low 16 bits of each sum count; sign-extended, they pack without saturating. */
+            __m128i low = pod_codec_prefix_4(_mm_loadu_si128((const __m128i *) &deltas[i]), last);
+            __m128i high = pod_codec_prefix_4(_mm_loadu_si128((const __m128i *) &deltas[i + 4]), last);
+            low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+            high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+            _mm_storeu_si128((__m128i *) &values[i * 2], _mm_packs_epi32(low, high));
+        }
+
+    previous = (T) _mm_cvtsi128_si32(last);
+    pod_codec_prefix_scalar<T>(&deltas[i], count - i, &values[i * sizeof(T)], previous);
+}
+#else
+template<typename T>
+void pod_codec_prefix(const uint32_t *deltas, uint32_t count, unsigned char *values, T &previous)
+{
+    pod_codec_prefix_scalar<T>(deltas, count, values, previous);
+}
+#endif
+
+/*
+ * pod_codec_delta_encode - append `value` (a stream of `T`s) encoded with `POD_CODEC_DELTA_BITPACK` to `out`.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+template<typename T>
+void pod_codec_delta_encode(const unsigned char *value, uint32_t size, std::vector<unsigned char> &out)
+{
+    typedef typename std::make_signed<T>::type signed_type;
+
+    uint32_t count = size / sizeof(T);
+    uint32_t deltas[POD_CODEC_BLOCK];
+    T previous = 0;
+
+    for(uint32_t first = 0; first < count; first += POD_CODEC_BLOCK)
+    {
+        uint32_t block = count - first < POD_CODEC_BLOCK ? count - first : POD_CODEC_BLOCK;
+        uint32_t used = 0;
+
+        for(uint32_t i = 0; i < block; i++)
+        {
+            T current = pod_codec_load<T>(&value[(uint64_t) (first + i) * sizeof(T)]);
+            T delta = (T) (current - previous);
+            deltas[i] = (T) ((T) (delta << 1) ^ (T) ((signed_type) delta >> (sizeof(T) * 8 - 1)));
+            used |= deltas[i];
+            previous = current;
+        }
+
+        unsigned char bits = used ? (unsigned char) (32 - __builtin_clz(used)) : 0;
+        uint32_t block_bytes = (block * bits + 7) / 8;
+
+        /* Packed into 4 bytes at a time, so there is room for the last 4 until the block is done. */
+        size_t at = out.size();
+        out.resize(at + 1 + block_bytes + 4);
+        out[at] = bits;
+
+        unsigned char *packed = &out[at + 1];
+        uint64_t pending = 0;
+        unsigned filled = 0;
+        for(uint32_t i = 0; i < block; i++)
+        {
+            pending |= (uint64_t) deltas[i] << filled;
+            filled += bits;
+            if(filled < 32) continue;
+
+            modb_put_u32(packed, (uint32_t) pending);
+            packed += 4;
+            pending >>= 32;
+            filled -= 32;
+        }
+        modb_put_u32(packed, (uint32_t) pending);
+
+        out.resize(at + 1 + block_bytes);
+    }
+
+    out.resize(out.size() + POD_CODEC_PADDING, 0);
+}
+
+/*
+ * pod_codec_delta_decode - decode a `POD_CODEC_DELTA_BITPACK` value of `out_size` bytes from `data` into `out`.
+ *  returns: true if `data` held exactly that else false
+ *  on error: this function does not error; malformed data returns false
+ * */
+template<typename T>
+bool pod_codec_delta_decode(const unsigned char *data, uint32_t size, unsigned char *out, uint32_t out_size)
+{
+    if(out_size % sizeof(T) != 0 || size < POD_CODEC_PADDING) return false;
+
+    uint32_t count = out_size / sizeof(T);
+    uint32_t end = size - POD_CODEC_PADDING, at = 0;
+    uint32_t deltas[POD_CODEC_BLOCK];
+    T previous = 0;
+
+    for(uint32_t first = 0; first < count; first += POD_CODEC_BLOCK)
+    {
+        uint32_t block = count - first < POD_CODEC_BLOCK ? count - first : POD_CODEC_BLOCK;
+        if(at >= end) return false;
+
+        unsigned char bits = data[at++];
+        if(bits > sizeof(T) * 8) return false;
+
+        uint32_t block_bytes = (block * bits + 7) / 8;
+        if(block_bytes > end - at) return false;
+
+        /* Every 8 byte load starts inside the block, the padding covers the last ones. */
+        const unsigned char *packed = &data[at];
+        if(block == POD_CODEC_BLOCK) pod_codec_unpack_table[bits](packed, deltas);
+        else
+        {
+            uint64_t mask = (1ull << bits) - 1;
+            for(uint32_t i = 0, position = 0; i < block; i++, position += bits)
+                deltas[i] = (uint32_t) ((pod_codec_load_u64(&packed[position >> 3]) >> (position & 7)) & mask);
+        }
+
+        pod_codec_prefix<T>(deltas, block, &out[(uint64_t) first * sizeof(T)], previous);
+
+        at += block_bytes;
+    }
+
+    return at == end;
+}
+
+inline void pod_codec_lz_length(std::vector<unsigned char> &out, uint32_t length)
+{
+    for(; length >= 255; length -= 255) out.push_back(255);
+    out.push_back((unsigned char) length);
+}
+
+inline void pod_codec_lz_sequence(std::vector<unsigned char> &out, const unsigned char *literals, uint32_t literal_size, uint32_t offset, uint32_t match_size)
+{
+    uint32_t match_code = match_size ? match_size - POD_CODEC_LZ_MIN_MATCH : 0;
+
+    out.push_back((unsigned char) ((literal_size < 15 ? literal_size : 15) << 4 | (match_code < 15 ? match_code : 15)));
+    if(literal_size >= 15) pod_codec_lz_length(out, literal_size - 15);
+    out.insert(out.end(), literals, literals + literal_size);
+
+    if(!match_size) return;
+
+    out.push_back((unsigned char) offset);
+    out.push_back((unsigned char) (offset >> 8));
+    if(match_code >= 15) pod_codec_lz_length(out, match_code - 15);
+}
+
+/*
+ * pod_codec_lz_encode - append `value` encoded with `POD_CODEC_LZ` to `out`.
+ *  returns: nothing
+ *  on error: this function does not error
+ *
+ *  Note: greedy, one candidate per hash of 4 bytes; the step grows over stretches that do not match, so data that
+ *        does not compress is gone over quickly.
+ * */
+inline void pod_codec_lz_encode(const unsigned char *value, uint32_t size, std::vector<unsigned char> &out)
+{
+    uint32_t table[1 << POD_CODEC_LZ_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    uint32_t anchor = 0, at = 0;
+    while(size >= POD_CODEC_LZ_MIN_MATCH && at <= size - POD_CODEC_LZ_MIN_MATCH)
+    {
+        uint32_t sequence = pod_codec_load_u32(&value[at]);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - POD_CODEC_LZ_HASH_BITS);
+        uint32_t candidate = table[hash];
+        table[hash] = at;
+
+        if(candidate == UINT32_MAX || at - candidate > POD_CODEC_LZ_MAX_OFFSET || pod_codec_load_u32(&value[candidate]) != sequence)
+        {
+            at += 1 + ((at - anchor) >> 6);
+            continue;
+        }
+
+        uint32_t match_size = POD_CODEC_LZ_MIN_MATCH;
+        while(at + match_size < size && value[candidate + match_size] == value[at + match_size]) match_size++;
+
+        pod_codec_lz_sequence(out, &value[anchor], at - anchor, at - candidate, match_size);
+        at += match_size;
+        anchor = at;
+    }
+
+    pod_codec_lz_sequence(out, &value[anchor], size - anchor, 0, 0);
+}
+
+inline bool pod_codec_lz_read_length(const unsigned char *&at, const unsigned char *end, uint32_t &length)
+{
+    unsigned char more;
+    do
+    {
+        if(at == end) return false;
+        more = *at++;
+        length += more;
+    } while(more == 255);
+    return true;
+}
+
+/*
+ * pod_codec_lz_decode - decode a `POD_CODEC_LZ` value of `out_size` bytes from `data` into `out`.
+ *  returns: true if `data` held exactly that else false
+ *  on error: this function does not error; malformed data returns false
+ * */
+inline bool pod_codec_lz_decode(const unsigned char *data, uint32_t size, unsigned char *out, uint32_t out_size)
+{
+    const unsigned char *at = data, *end = data + size;
+    uint32_t written = 0;
+
+    while(at < end)
+    {
+        unsigned char token = *at++;
+
+        uint32_t literal_size = token >> 4;
+        if(literal_size == 15 && !pod_codec_lz_read_length(at, end, literal_size)) return false;
+        if(literal_size > (uint32_t) (end - at) || literal_size > out_size - written) return false;
+
+        memcpy(&out[written], at, literal_size);
+        at += literal_size;
+        written += literal_size;
+
+        /* The last sequence has no match. */
+        if(at == end) break;
+        if(end - at < 2) return false;
+
+        uint32_t offset = at[0] | (uint32_t) at[1] << 8;
+        at += 2;
+
+        uint32_t match_size = token & 0x0F;
+        if(match_size == 15 && !pod_codec_lz_read_length(at, end, match_size)) return false;
+        match_size += POD_CODEC_LZ_MIN_MATCH;
+
+        if(offset == 0 || offset > written || match_size > out_size - written) return false;
+
+        unsigned char *to = &out[written];
+        const unsigned char *from = to - offset;
+        if(offset >= match_size) memcpy(to, from, match_size);
+        else for(uint32_t i = 0; i < match_size; i++) to[i] = from[i];
+        written += match_size;
+    }
+
+    return written == out_size;
+}
+
+/* Encoders and decoders by `POD_CODEC_*`, and the store types each can take (bit `CS_STORING_* - CS_STORING_SBYTE`). */
+typedef struct PodCodec
+{
+    const char  *name;
+    uint32_t    store_types;
+    void        (*encode[POD_COLUMN_COUNT])(const unsigned char *, uint32_t, std::vector<unsigned char> &);
+    bool        (*decode[POD_COLUMN_COUNT])(const unsigned char *, uint32_t, unsigned char *, uint32_t);
+} _PodCodec;
+
+#define pod_codec_stream_types      (1u << POD_COLUMN_BYTE_STREAM | 1u << POD_COLUMN_WORD_STREAM | 1u << POD_COLUMN_DWORD_STREAM)
+
+static const _PodCodec pod_codec_table[POD_CODEC_COUNT] = {
+    {"none", 0, {}, {}},
+    {"delta_bitpack", 1u << POD_COLUMN_WORD_STREAM | 1u << POD_COLUMN_DWORD_STREAM,
+        {nullptr, nullptr, nullptr, pod_codec_delta_encode<uint16_t>, nullptr, pod_codec_delta_encode<uint32_t>},
+        {nullptr, nullptr, nullptr, pod_codec_delta_decode<uint16_t>, nullptr, pod_codec_delta_decode<uint32_t>}},
+    {"lz", pod_codec_stream_types,
+        {nullptr, pod_codec_lz_encode, nullptr, pod_codec_lz_encode, nullptr, pod_codec_lz_encode},
+        {nullptr, pod_codec_lz_decode, nullptr, pod_codec_lz_decode, nullptr, pod_codec_lz_decode}},
+};
+
+/* Codec `POD_CODEC_AUTO` samples with, by column. */
+static const unsigned char pod_codec_natural[POD_COLUMN_COUNT] = {
+    POD_CODEC_NONE, POD_CODEC_LZ, POD_CODEC_NONE, POD_CODEC_DELTA_BITPACK, POD_CODEC_NONE, POD_CODEC_DELTA_BITPACK
+};
+
+inline bool pod_codec_fits(unsigned char codec, unsigned char column)
+{
+    return codec < POD_CODEC_COUNT && column < POD_COLUMN_COUNT && (pod_codec_table[codec].store_types >> column & 1);
+}
+
+/* Which codec each column is persisted with: a `POD_CODEC_*`, or `POD_CODEC_AUTO`. */
+typedef struct PodCodecPolicy
+{
+    unsigned char for_column[POD_COLUMN_COUNT] = {
+        POD_CODEC_NONE, POD_CODEC_AUTO, POD_CODEC_NONE, POD_CODEC_AUTO, POD_CODEC_NONE, POD_CODEC_AUTO
+    };
+
+    /*
+     * set - persist PODs of type `pod_type` (`CS_CREATING_POD_WITH_TYPE_*`) with `codec`.
+     *  returns: true if the codec can take that type else false (nothing changes)
+     *  on error: this function does not error
+     * */
+    bool set(unsigned char pod_type, unsigned char codec)
+    {
+        unsigned char column = pod_column_from_create(pod_type);
+        if(column >= POD_COLUMN_COUNT) return false;
+        if(codec != POD_CODEC_NONE && codec != POD_CODEC_AUTO && !pod_codec_fits(codec, column)) return false;
+        if(codec == POD_CODEC_AUTO && !(pod_codec_stream_types >> column & 1)) return false;
+
+        for_column[column] = codec;
+        return true;
+    }
+} _PodCodecPolicy;
+
+/*
+ * pod_codec_choose - the codec `policy` has a value of `store_type` encoded with.
+ *  returns: a `POD_CODEC_*`, `POD_CODEC_NONE` if the value is to be kept as it is
+ *  on error: this function does not error
+ * */
+inline unsigned char pod_codec_choose(const _PodCodecPolicy &policy, unsigned char store_type, const unsigned char *value, uint32_t size,
+                                      std::vector<unsigned char> &scratch)
+{
+    unsigned char column = pod_column_from_store(store_type);
+    if(column >= POD_COLUMN_COUNT || size < POD_CODEC_MIN_SIZE) return POD_CODEC_NONE;
+
+    unsigned char codec = policy.for_column[column];
+    if(codec != POD_CODEC_AUTO) return pod_codec_fits(codec, column) ? codec : POD_CODEC_NONE;
+
+    codec = pod_codec_natural[column];
+    if(!pod_codec_fits(codec, column)) return POD_CODEC_NONE;
+
+    /* Whole elements only. */
+    uint32_t sample = size < POD_CODEC_SAMPLE_SIZE ? size : POD_CODEC_SAMPLE_SIZE;
+    sample -= sample % (column == POD_COLUMN_DWORD_STREAM ? 4 : column == POD_COLUMN_WORD_STREAM ? 2 : 1);
+
+    scratch.clear();
+    pod_codec_table[codec].encode[column](value, sample, scratch);
+    return scratch.size() * 8 <= (uint64_t) sample * 7 ? codec : POD_CODEC_NONE;
+}
+
+/*
+ * pod_codec_encode - append [1: CS_STORING_ENCODED][1: `store_type`][1: `codec`][4: size][encoded value] to `out`.
+ *  returns: true if that is smaller than [1: `store_type`][value] else false (`out` is left as it was)
+ *  on error: this function does not error
+ * */
+inline bool pod_codec_encode(unsigned char codec, unsigned char store_type, const unsigned char *value, uint32_t size, std::vector<unsigned char> &out)
+{
+    unsigned char column = pod_column_from_store(store_type);
+    if(codec == POD_CODEC_NONE || !pod_codec_fits(codec, column)) return false;
+
+    size_t at = out.size();
+    out.resize(at + POD_CODEC_HEADER_SIZE);
+    out[at] = CS_STORING_ENCODED;
+    out[at + 1] = store_type;
+    out[at + 2] = codec;
+    modb_put_u32(&out[at + 3], size);
+
+    pod_codec_table[codec].encode[column](value, size, out);
+    if(out.size() - at < (size_t) size + 1) return true;
+
+    out.resize(at);
+    return false;
+}
+
+/*
+ * pod_codec_value_size - size of the value [1: CS_STORING_*][1: POD_CODEC_*][4: size][encoded value] decodes to.
+ *  returns: the size it claims, 0 if `encoded` is too short to say
+ *  on error: this function does not error
+ * */
+inline uint32_t pod_codec_value_size(const unsigned char *encoded, uint32_t size)
+{
+    return size < POD_CODEC_HEADER_SIZE - 1 ? 0 : modb_get_u32(&encoded[2]);
+}
+
+/*
+ * pod_codec_decode - decode [1: CS_STORING_*][1: POD_CODEC_*][4: size][encoded value] (what follows `CS_STORING_ENCODED`)
+ *                    into `value`.
+ *  returns: the `CS_STORING_*` of the value, 0 if `encoded` is malformed or decodes past `POD_CODEC_MAX_VALUE`
+ *  on error: this function does not error
+ * */
+inline unsigned char pod_codec_decode(const unsigned char *encoded, uint32_t size, std::vector<unsigned char> &value)
+{
+    if(size < POD_CODEC_HEADER_SIZE - 1) return 0;
+
+    unsigned char store_type = encoded[0], codec = encoded[1];
+    unsigned char column = pod_column_from_store(store_type);
+    if(!pod_codec_fits(codec, column)) return 0;
+
+    uint32_t value_size = pod_codec_value_size(encoded, size);
+
+    /* No codec shrinks a value to less than a 512th of it (a block of equal DWORDs), so a size past that is not believed. */
+    if(value_size > POD_CODEC_MAX_VALUE || (uint64_t) value_size > (uint64_t) size * 512) return 0;
+
+    value.resize(value_size);
+    if(!pod_codec_table[codec].decode[column](&encoded[POD_CODEC_HEADER_SIZE - 1], size - (POD_CODEC_HEADER_SIZE - 1), value.data(), value_size))
+        return 0;
+
+    return store_type;
+}
+
+#endif
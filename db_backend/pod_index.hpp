@@ -0,0 +1,234 @@
+#ifndef pod_index
+#define pod_index
+
+/* Secondary indexes on POD values.
+ *
+ * An index is declared per POD name (`CS_REQUEST_CREATE_INDEX`) and covers that POD in every entry that
+ * holds it as an SBYTE, SWORD or SDWORD; stream PODs are never indexed. Every storage engine shard keeps
+ * its own `PodIndex` per indexed name and updates it as PODs are created, stored into and deleted, so a
+ * `CS_REQUEST_LOOKUP_POD` never has to look at entries that do not match.
+ *
+ * Only the declarations are kept on disk, in `<path>.idx` next to the `.modb`:
+ *      [4: POD_INDEX_FILE_MAGIC][1: POD_INDEX_FILE_VERSION][4: index count]
+ *      per index: [1: CS_INDEX_*][1: name length][name]
+ *      [4: CRC-32 of everything before it]
+ * The indexes themselves are rebuilt as the write-ahead log is replayed on start-up.
+ * */
+#define POD_INDEX_FILE_MAGIC        0x5849444Du // "MDIX"
+#define POD_INDEX_FILE_VERSION      1
+
+#define pod_index_file_extension    UC_PTR ".idx"
+
+/* Declaration of one index, as kept in the `.idx` file. */
+typedef struct PodIndexDecl
+{
+    std::string     name;
+    /* `CS_INDEX_*` */
+    unsigned char   kind;
+} _PodIndexDecl;
+
+/* Index on one POD name within one shard. */
+class PodIndex
+{
+private:
+    typedef struct Indexed
+    {
+        uint32_t    value;
+        /* Position of the entry in its value's bucket (hash indexes only). */
+        uint32_t    at;
+    } _Indexed;
+
+    unsigned char kind;
+
+    /* Value each indexed entry is filed under. */
+    std::unordered_map<uint32_t, _Indexed> indexed;
+
+    /* `CS_INDEX_HASH`: entry IDs per value. */
+    std::unordered_map<uint32_t, std::vector<uint32_t>> buckets;
+
+    /* `CS_INDEX_SORTED`: (value, entry ID) pairs in order. */
+    std::set<std::pair<uint32_t, uint32_t>> ordered;
+
+    void unfile(uint32_t entry_id, _Indexed filed)
+    {
+        if(kind == CS_INDEX_SORTED)
+        {
+            ordered.erase({filed.value, entry_id});
+            return;
+        }
+
+        /* Swap the last entry of the bucket into the hole, so removing never searches the bucket. */
+        auto bucket = buckets.find(filed.value);
+        std::vector<uint32_t> &ids = bucket->second;
+
+        ids[filed.at] = ids.back();
+        if(ids[filed.at] != entry_id) indexed[ids[filed.at]].at = filed.at;
+        ids.pop_back();
+
+        if(ids.empty()) buckets.erase(bucket);
+    }
+
+    static void append_id(std::vector<unsigned char> &response, uint32_t entry_id)
+    {
+        size_t at = response.size();
+        response.resize(at + 4);
+        modb_put_u32(&response[at], entry_id);
+    }
+
+public:
+    explicit PodIndex(unsigned char index_kind) : kind(index_kind) {}
+
+    /*
+     * put - file entry `entry_id` under `value`, moving it if it was filed under another one.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void put(uint32_t entry_id, uint32_t value)
+    {
+        auto filed = indexed.find(entry_id);
+        if(filed != indexed.end())
+        {
+            if(filed->second.value == value) return;
+
+            unfile(entry_id, filed->second);
+            indexed.erase(filed);
+        }
+
+        _Indexed entry = {value, 0};
+        if(kind == CS_INDEX_SORTED)
+            ordered.emplace(value, entry_id);
+        else
+        {
+            std::vector<uint32_t> &ids = buckets[value];
+            entry.at = (uint32_t) ids.size();
+            ids.push_back(entry_id);
+        }
+
+        indexed[entry_id] = entry;
+    }
+
+    /*
+     * remove - take entry `entry_id` out of the index.
+     *  returns: nothing
+     *  on error: this function does not error; entries that are not indexed are ignored
+     * */
+    void remove(uint32_t entry_id)
+    {
+        auto filed = indexed.find(entry_id);
+        if(filed == indexed.end()) return;
+
+        unfile(entry_id, filed->second);
+        indexed.erase(filed);
+    }
+
+    /*
+     * lookup - append the ID of every entry filed under a value from `low` through `high` to `response`.
+     *  returns: how many IDs were appended
+     *  on error: this function does not error
+     *
+     *  Note: a range on a hash index goes over every indexed entry, which is still less than every entry.
+     * */
+    uint32_t lookup(uint32_t low, uint32_t high, std::vector<unsigned char> &response)
+    {
+        uint32_t found = 0;
+        if(low > high) return 0;
+
+        if(kind == CS_INDEX_SORTED)
+        {
+            for(auto it = ordered.lower_bound({low, 0}); it != ordered.end() && it->first <= high; ++it, found++)
+                append_id(response, it->second);
+        }
+        else if(low == high)
+        {
+            auto bucket = buckets.find(low);
+            if(bucket == buckets.end()) return 0;
+
+            for(uint32_t entry_id: bucket->second) append_id(response, entry_id);
+            found = (uint32_t) bucket->second.size();
+        }
+        else
+        {
+            for(auto &filed: indexed)
+                if(filed.second.value >= low && filed.second.value <= high) { append_id(response, filed.first); found++; }
+        }
+
+        return found;
+    }
+
+    size_t size() { return indexed.size(); }
+};
+
+/*
+ * pod_index_file_write - write the index declarations `decls` to `path` through a temporary file and an atomic rename.
+ *  returns: true if the file was written and synced else false
+ *  on error: this function does not error
+ * */
+inline bool pod_index_file_write(const unsigned char *path, const std::vector<_PodIndexDecl> &decls)
+{
+    std::vector<unsigned char> file(9);
+    modb_put_u32(&file[0], POD_INDEX_FILE_MAGIC);
+    file[4] = POD_INDEX_FILE_VERSION;
+    modb_put_u32(&file[5], (uint32_t) decls.size());
+
+    for(const _PodIndexDecl &decl: decls)
+    {
+        file.push_back(decl.kind);
+        file.push_back((unsigned char) decl.name.size());
+        file.insert(file.end(), decl.name.begin(), decl.name.end());
+    }
+
+    size_t at = file.size();
+    file.resize(at + 4);
+    modb_put_u32(&file[at], modb_crc32(file.data(), at));
+
+    std::string temp_path = std::string(NCC_PTR path) + ".tmp";
+    FILE *temp = fopen(temp_path.c_str(), "wb");
+    if(!temp) return false;
+
+    bool ok = fwrite(file.data(), sizeof(unsigned char), file.size(), temp) == file.size() && fflush(temp) == 0;
+#if defined(__unix) || defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+    ok = ok && fsync(fileno(temp)) == 0;
+#endif
+    ok = fclose(temp) == 0 && ok;
+
+    if(!ok || rename(temp_path.c_str(), NCC_PTR path) != 0)
+    {
+        remove(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * pod_index_file_read - read the index declarations in the `.idx` file at `path` into `decls`.
+ *  returns: `MODB_OK`, `MODB_FILE_NOT_FOUND` if there is no such file (no indexes), or `MODB_FILE_DAMAGED`
+ *  on error: this function does not error; `decls` is left empty unless the whole file checks out
+ * */
+inline modb_status pod_index_file_read(const unsigned char *path, std::vector<_PodIndexDecl> &decls)
+{
+    decls.clear();
+
+    ModbMapping file;
+    if(!file.map_file(path)) return modb_status::MODB_FILE_NOT_FOUND;
+
+    const unsigned char *data = file.data();
+    size_t size = file.size();
+    if(size < 13 || modb_get_u32(data) != POD_INDEX_FILE_MAGIC || data[4] != POD_INDEX_FILE_VERSION ||
+       modb_crc32(data, size - 4) != modb_get_u32(&data[size - 4]))
+        return modb_status::MODB_FILE_DAMAGED;
+
+    uint32_t count = modb_get_u32(&data[5]);
+    size_t at = 9;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(at + 2 > size - 4 || at + 2 + data[at + 1] > size - 4) { decls.clear(); return modb_status::MODB_FILE_DAMAGED; }
+
+        decls.push_back({std::string(NCC_PTR &data[at + 2], data[at + 1]), data[at]});
+        at += 2 + data[at + 1];
+    }
+
+    return modb_status::MODB_OK;
+}
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef pod_types
+#define pod_types
+
+/* Compile-time description of every Piece Of Data (POD) type.
+ *
+ * `Pod<T, Stream>` ties a value type to its column and to its `CS_CREATING_POD_WITH_TYPE_*` / `CS_STORING_*`
+ * wire codes, and generates its size check, encode and decode. `PodColumns` keeps one column per type and
+ * dispatches through tables of handlers built from these templates, so a store or read does one indexed call
+ * instead of switching on the type byte and again on the element size.
+ * */
+
+/* Column index for a POD type; `CS_CREATING_POD_WITH_TYPE_*` and `CS_STORING_*` both map onto these. */
+#define POD_COLUMN_SBYTE            0
+#define POD_COLUMN_BYTE_STREAM      1
+#define POD_COLUMN_SWORD            2
+#define POD_COLUMN_WORD_STREAM      3
+#define POD_COLUMN_SDWORD           4
+#define POD_COLUMN_DWORD_STREAM     5
+#define POD_COLUMN_COUNT            6
+
+#define pod_column_from_create(type)    ((unsigned char) ((type) - CS_CREATING_POD_WITH_TYPE_SBYTE))
+#define pod_column_from_store(type)     ((unsigned char) ((type) - CS_STORING_SBYTE))
+
+template<typename T, bool Stream>
+struct Pod
+{
+    static_assert(std::is_unsigned<T>::value && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4),
+                  "POD values are unsigned 1, 2 or 4 byte integers");
+
+    typedef T value_type;
+
+    /* What one slot of this type's column holds. */
+    typedef typename std::conditional<Stream, std::vector<T>, T>::type slot_type;
+
+    static constexpr bool           stream = Stream;
+    static constexpr unsigned char  element_size = sizeof(T);
+    static constexpr unsigned char  column = (sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 2 : 4) + (Stream ? 1 : 0);
+    static constexpr unsigned char  create_code = CS_CREATING_POD_WITH_TYPE_SBYTE + column;
+    static constexpr unsigned char  store_code = CS_STORING_SBYTE + column;
+
+    /* Is an encoded value of `size` bytes valid for this type? */
+    static constexpr bool valid_size(uint32_t size) { return Stream ? size % sizeof(T) == 0 : size == sizeof(T); }
+
+    static T decode_one(const unsigned char *data)
+    {
+        if constexpr(sizeof(T) == 1) return data[0];
+        else if constexpr(sizeof(T) == 2) return modb_get_u16(data);
+        else return modb_get_u32(data);
+    }
+
+    static void encode_one(unsigned char *out, T value)
+    {
+        if constexpr(sizeof(T) == 1) out[0] = value;
+        else if constexpr(sizeof(T) == 2) modb_put_u16(out, value);
+        else modb_put_u32(out, value);
+    }
+
+    /*
+     * decode - set `slot` from an encoded value of `size` bytes (already checked with `valid_size`).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    static void decode(slot_type &slot, const unsigned char *data, uint32_t size)
+    {
+        if constexpr(!Stream) slot = decode_one(data);
+        else if constexpr(sizeof(T) == 1) slot.assign(data, data + size);
+        else
+        {
+            slot.resize(size / sizeof(T));
+            for(size_t i = 0; i < slot.size(); i++) slot[i] = decode_one(&data[i * sizeof(T)]);
+        }
+    }
+
+    /*
+     * encode - append the encoded value of `slot` to `out`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    static void encode(const slot_type &slot, std::vector<unsigned char> &out)
+    {
+        size_t at = out.size();
+
+        if constexpr(!Stream)
+        {
+            out.resize(at + sizeof(T));
+            encode_one(&out[at], slot);
+        }
+        else if constexpr(sizeof(T) == 1) out.insert(out.end(), slot.begin(), slot.end());
+        else
+        {
+            out.resize(at + slot.size() * sizeof(T));
+            for(size_t i = 0; i < slot.size(); i++) encode_one(&out[at + i * sizeof(T)], slot[i]);
+        }
+    }
+
+    /* Empty a slot before it is reused; streams keep their capacity. */
+    static void clear(slot_type &slot)
+    {
+        if constexpr(Stream) slot.clear();
+        else slot = 0;
+    }
+};
+
+typedef Pod<uint8_t, false>     PodSByte;
+typedef Pod<uint8_t, true>      PodByteStream;
+typedef Pod<uint16_t, false>    PodSWord;
+typedef Pod<uint16_t, true>     PodWordStream;
+typedef Pod<uint32_t, false>    PodSDWord;
+typedef Pod<uint32_t, true>     PodDWordStream;
+
+static_assert(PodSByte::create_code == CS_CREATING_POD_WITH_TYPE_SBYTE && PodSByte::store_code == CS_STORING_SBYTE, "POD wire codes");
+static_assert(PodByteStream::create_code == CS_CREATING_POD_WITH_TYPE_BYTE_STREAM && PodByteStream::store_code == CS_STORING_BYTE_STREAM, "POD wire codes");
+static_assert(PodSWord::create_code == CS_CREATING_POD_WITH_TYPE_SWORD && PodSWord::store_code == CS_STORING_SWORD, "POD wire codes");
+static_assert(PodWordStream::create_code == CS_CREATING_POD_WITH_TYPE_WORD_STREAM && PodWordStream::store_code == CS_STORING_WORD_STREAM, "POD wire codes");
+static_assert(PodSDWord::create_code == CS_CREATING_POD_WITH_TYPE_SDWORD && PodSDWord::store_code == CS_STORING_SDWORD, "POD wire codes");
+static_assert(PodDWordStream::create_code == CS_CREATING_POD_WITH_TYPE_DWORD_STREAM && PodDWordStream::store_code == CS_STORING_DWORD_STREAM, "POD wire codes");
+
+typedef struct PodSlot
+{
+    /* `POD_COLUMN_*` the POD lives in. */
+    unsigned char   column;
+    /* Index into that column. */
+    uint32_t        slot;
+} _PodSlot;
+
+/* One column per POD type. */
+class PodColumns
+{
+private:
+    std::vector<PodSByte::slot_type>        sbyte_column;
+    std::vector<PodByteStream::slot_type>   byte_stream_column;
+    std::vector<PodSWord::slot_type>        sword_column;
+    std::vector<PodWordStream::slot_type>   word_stream_column;
+    std::vector<PodSDWord::slot_type>       sdword_column;
+    std::vector<PodDWordStream::slot_type>  dword_stream_column;
+
+    /* Slots freed by deleted PODs, reused before a column grows. */
+    std::vector<uint32_t>                   free_slots[POD_COLUMN_COUNT];
+
+    /* Handlers for one type; static so the tables below are plain function pointers. */
+    template<typename P> static uint32_t grow_as(PodColumns &columns)
+    {
+        columns.column<P>().emplace_back();
+        return (uint32_t) columns.column<P>().size() - 1;
+    }
+
+    template<typename P> static void release_as(PodColumns &columns, uint32_t slot) { P::clear(columns.column<P>()[slot]); }
+
+    template<typename P> static unsigned char store_as(PodColumns &columns, uint32_t slot, const unsigned char *value, uint32_t value_size)
+    {
+        if(!P::valid_size(value_size)) return SS_RESPONSE_BAD_REQUEST;
+
+        P::decode(columns.column<P>()[slot], value, value_size);
+        return SS_RESPONSE_OK;
+    }
+
+    template<typename P> static void read_as(PodColumns &columns, uint32_t slot, std::vector<unsigned char> &response)
+    {
+        response.push_back(P::store_code);
+        P::encode(columns.column<P>()[slot], response);
+    }
+
+    template<typename P> static uint32_t value_as(PodColumns &columns, uint32_t slot) { return columns.column<P>()[slot]; }
+
+    template<typename P> static uint32_t size_as(PodColumns &columns, uint32_t slot)
+    {
+        if constexpr(P::stream) return (uint32_t) (columns.column<P>()[slot].size() * P::element_size);
+        else return P::element_size;
+    }
+
+    typedef uint32_t (*GrowHandler)(PodColumns &);
+    typedef void (*ReleaseHandler)(PodColumns &, uint32_t);
+    typedef unsigned char (*StoreHandler)(PodColumns &, uint32_t, const unsigned char *, uint32_t);
+    typedef void (*ReadHandler)(PodColumns &, uint32_t, std::vector<unsigned char> &);
+    typedef uint32_t (*ValueHandler)(PodColumns &, uint32_t);
+    typedef uint32_t (*SizeHandler)(PodColumns &, uint32_t);
+
+    /* Handlers indexed by `POD_COLUMN_*`. */
+    static constexpr GrowHandler grow_table[POD_COLUMN_COUNT] = {
+        grow_as<PodSByte>, grow_as<PodByteStream>, grow_as<PodSWord>,
+        grow_as<PodWordStream>, grow_as<PodSDWord>, grow_as<PodDWordStream>
+    };
+    static constexpr ReleaseHandler release_table[POD_COLUMN_COUNT] = {
+        release_as<PodSByte>, release_as<PodByteStream>, release_as<PodSWord>,
+        release_as<PodWordStream>, release_as<PodSDWord>, release_as<PodDWordStream>
+    };
+    static constexpr StoreHandler store_table[POD_COLUMN_COUNT] = {
+        store_as<PodSByte>, store_as<PodByteStream>, store_as<PodSWord>,
+        store_as<PodWordStream>, store_as<PodSDWord>, store_as<PodDWordStream>
+    };
+    static constexpr ReadHandler read_table[POD_COLUMN_COUNT] = {
+        read_as<PodSByte>, read_as<PodByteStream>, read_as<PodSWord>,
+        read_as<PodWordStream>, read_as<PodSDWord>, read_as<PodDWordStream>
+    };
+    /* Streams have no single value. */
+    static constexpr ValueHandler value_table[POD_COLUMN_COUNT] = {
+        value_as<PodSByte>, nullptr, value_as<PodSWord>,
+        nullptr, value_as<PodSDWord>, nullptr
+    };
+    static constexpr SizeHandler size_table[POD_COLUMN_COUNT] = {
+        size_as<PodSByte>, size_as<PodByteStream>, size_as<PodSWord>,
+        size_as<PodWordStream>, size_as<PodSDWord>, size_as<PodDWordStream>
+    };
+
+public:
+    /*
+     * column - the column holding PODs of type `P`.
+     *  returns: reference to the column
+     *  on error: this function does not error
+     * */
+    template<typename P> std::vector<typename P::slot_type> &column()
+    {
+        if constexpr(P::column == POD_COLUMN_SBYTE) return sbyte_column;
+        else if constexpr(P::column == POD_COLUMN_BYTE_STREAM) return byte_stream_column;
+        else if constexpr(P::column == POD_COLUMN_SWORD) return sword_column;
+        else if constexpr(P::column == POD_COLUMN_WORD_STREAM) return word_stream_column;
+        else if constexpr(P::column == POD_COLUMN_SDWORD) return sdword_column;
+        else return dword_stream_column;
+    }
+
+    /*
+     * allocate - get a free slot in `column` (a `POD_COLUMN_*`), growing the column if none are free.
+     *  returns: the slot index
+     *  on error: this function does not error
+     * */
+    uint32_t allocate(unsigned char column)
+    {
+        if(!free_slots[column].empty())
+        {
+            uint32_t slot = free_slots[column].back();
+            free_slots[column].pop_back();
+            return slot;
+        }
+
+        return grow_table[column](*this);
+    }
+
+    /*
+     * release - reset the value in a slot and hand it back to the free list.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void release(_PodSlot pod)
+    {
+        release_table[pod.column](*this, pod.slot);
+        free_slots[pod.column].push_back(pod.slot);
+    }
+
+    /*
+     * store - decode `value` into the slot of `pod`.
+     *  returns: `SS_RESPONSE_OK`, or `SS_RESPONSE_BAD_REQUEST` if `value` has the wrong size for the type
+     *  on error: this function does not error
+     * */
+    unsigned char store(_PodSlot pod, const unsigned char *value, uint32_t value_size)
+    {
+        return store_table[pod.column](*this, pod.slot, value, value_size);
+    }
+
+    /*
+     * read - append the type (`CS_STORING_*`) and encoded value of `pod` to `response`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void read(_PodSlot pod, std::vector<unsigned char> &response)
+    {
+        read_table[pod.column](*this, pod.slot, response);
+    }
+
+    /*
+     * encoded_size - how many bytes the encoded value of `pod` takes (without its type).
+     *  returns: the size
+     *  on error: this function does not error
+     * */
+    uint32_t encoded_size(_PodSlot pod)
+    {
+        return size_table[pod.column](*this, pod.slot);
+    }
+
+    /*
+     * single_value - get the value of an SBYTE/SWORD/SDWORD `pod`, widened to 4 bytes.
+     *  returns: true if `value` was set, false if `pod` is a stream
+     *  on error: this function does not error
+     * */
+    bool single_value(_PodSlot pod, uint32_t &value)
+    {
+        if(!value_table[pod.column]) return false;
+
+        value = value_table[pod.column](*this, pod.slot);
+        return true;
+    }
+};
+
+#endif
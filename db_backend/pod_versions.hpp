@@ -0,0 +1,597 @@
+#ifndef pod_versions
+#define pod_versions
+
+/* Multi-version copies of the PODs of a shard, so reads never wait on the worker that owns it.
+ *
+ * Besides its columns, which only the owning worker touches, a shard keeps every entry and POD as a chain of
+ * versions (newest first) that any thread may read. Each change the worker makes pushes a version stamped with
+ * the shard's next change number; once the change is logged the worker publishes that number, and a reader only
+ * sees versions up to the number published when it started. Deleting pushes a version marked deleted, so a
+ * reader that started before the delete still finds what it was reading.
+ *
+ * The worker never frees anything a reader may still be looking at. Replaced versions, PODs that stayed deleted
+ * and outgrown tables are retired with the epoch (see `ModbEpochs`) they were replaced in, and freed once every
+ * reader pinned since then has moved past that epoch.
+ * */
+
+/* Readers that can be pinned at once; a reader past this many waits for a slot. */
+#define MODB_EPOCH_SLOTS                64
+
+#define POD_VERSIONS_INITIAL_BUCKETS    64
+
+/* Retired versions kept before the worker tries to free them. */
+#define POD_VERSIONS_RECLAIM_BATCH      256
+
+/* Freed versions are kept for the next `put` by size class: the struct and its value rounded up to a power of two,
+ * from 64 bytes to 64 KiB. Versions larger than that are allocated for each `put`. A class keeps up to
+ * `POD_VERSIONS_POOL_BYTES` of free versions; what is freed past that goes back to the heap.
+ * */
+#define POD_VERSIONS_POOL_MIN_SHIFT     6
+#define POD_VERSIONS_POOL_CLASSES       11
+#define POD_VERSIONS_POOL_BYTES         (1024 * 1024)
+
+/* Epochs of an epoch-based reclamation scheme.
+ *
+ * A reader pins the current epoch in a free slot for as long as it looks at shared versions. Anything a writer
+ * replaces is retired with the epoch current right after it was replaced, and can be freed once `advance` says
+ * every pinned reader is past it: such a reader pinned after the replacement and can only have found the new one.
+ * */
+class ModbEpochs
+{
+private:
+    /* 0 marks a free slot, so epochs start at 1. */
+    typedef struct alignas(64) EpochSlot
+    {
+        std::atomic<uint64_t>   pinned{0};
+    } _EpochSlot;
+
+    alignas(64) std::atomic<uint64_t> global{1};
+    _EpochSlot slots[MODB_EPOCH_SLOTS];
+
+public:
+    /*
+     * pin - pin the current epoch for the calling thread.
+     *  returns: the slot to `unpin` with
+     *  on error: this function does not error; with every slot taken it waits for one to free up
+     * */
+    uint32_t pin()
+    {
+        uint32_t slot = (uint32_t) (std::hash<std::thread::id>()(std::this_thread::get_id()) % MODB_EPOCH_SLOTS);
+        uint64_t epoch = global.load(), free_slot = 0;
+
+        while(!slots[slot].pinned.compare_exchange_weak(free_slot, epoch))
+        {
+            free_slot = 0;
+            slot = (slot + 1) % MODB_EPOCH_SLOTS;
+        }
+
+        /* A reclaimer that looked at the slot before it was taken may have moved the epoch on; pin the new one then. */
+        uint64_t now;
+        while((now = global.load()) != epoch)
+        {
+            slots[slot].pinned.store(now);
+            epoch = now;
+        }
+
+        return slot;
+    }
+
+    void unpin(uint32_t slot) { slots[slot].pinned.store(0, std::memory_order_release); }
+
+    /*
+     * current - the epoch something replaced by the calling thread just now is retired with.
+     *  returns: the epoch
+     *  on error: this function does not error
+     * */
+    uint64_t current()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return global.load();
+    }
+
+    /*
+     * advance - find the oldest pinned epoch, moving the epoch on if every pinned reader is at the current one.
+     *  returns: the oldest pinned epoch; whatever was retired before it can be freed
+     *  on error: this function does not error
+     * */
+    uint64_t advance()
+    {
+        uint64_t epoch = global.load(), oldest = epoch;
+
+        for(_EpochSlot &slot: slots)
+        {
+            uint64_t pinned = slot.pinned.load();
+            if(pinned != 0 && pinned < oldest) oldest = pinned;
+        }
+
+        if(oldest == epoch) global.compare_exchange_strong(epoch, epoch + 1);
+        return oldest;
+    }
+};
+
+/* Keeps an epoch of `ModbEpochs` pinned for as long as it lives. */
+class ModbEpochPin
+{
+private:
+    ModbEpochs &epochs;
+    uint32_t slot;
+
+public:
+    ModbEpochPin(ModbEpochs &pinned_epochs) : epochs(pinned_epochs), slot(pinned_epochs.pin()) {}
+
+    ModbEpochPin(const ModbEpochPin &) = delete;
+    ModbEpochPin &operator=(const ModbEpochPin &) = delete;
+
+    ~ModbEpochPin() { epochs.unpin(slot); }
+};
+
+/* One version of an entry or POD; the value (as `CS_REQUEST_READ_POD` responds with it) follows the struct. */
+typedef struct PodVersion
+{
+    /* Change of the shard that made this version. */
+    uint64_t                            stamp;
+    std::atomic<struct PodVersion *>    older;
+
+    uint32_t                            size;
+    bool                                deleted;
+
+    unsigned char *value() { return (unsigned char *) (this + 1); }
+} _PodVersion;
+
+/* Versions of one POD, or of the entry itself when `name` is empty. */
+typedef struct PodVersionNode
+{
+    uint32_t                            entry_id;
+    std::string                         name;
+    std::atomic<_PodVersion *>          newest{nullptr};
+} _PodVersionNode;
+
+/* Buckets are never changed once published; adding or removing a node publishes a copy. */
+typedef std::vector<_PodVersionNode *> _PodVersionBucket;
+
+typedef struct PodVersionTable
+{
+    uint32_t                                        mask;
+    std::unique_ptr<std::atomic<_PodVersionBucket *>[]> buckets;
+} _PodVersionTable;
+
+class PodVersions
+{
+private:
+    enum class Retired: unsigned char
+    {
+        /* Versions older than `version` in `node`. */
+        OLDER_VERSIONS,
+        /* `node` and its versions. */
+        NODE,
+        BUCKET,
+        TABLE
+    };
+
+    typedef struct RetiredVersion
+    {
+        /* 0 until the change that retired it is published. */
+        uint64_t            epoch;
+        Retired             kind;
+        _PodVersionNode     *node;
+        _PodVersion         *version;
+        void                *memory;
+    } _RetiredVersion;
+
+    ModbEpochs *epochs = nullptr;
+
+    std::atomic<_PodVersionTable *> table{nullptr};
+    size_t node_count = 0;
+
+    /* Change readers see up to; versions of the change being made are stamped one past it. */
+    std::atomic<uint64_t> published{0};
+    bool changed = false;
+
+    /* Oldest first; `retired[retired_head]` is the next to free and `retired[unpublished]` the first waiting for `publish`. */
+    std::vector<_RetiredVersion> retired;
+    size_t retired_head = 0;
+    size_t unpublished = 0;
+
+    /* Free versions of each size class, linked through `older`, and how many bytes each class holds. */
+    _PodVersion *pool[POD_VERSIONS_POOL_CLASSES] = {};
+    size_t pool_bytes[POD_VERSIONS_POOL_CLASSES] = {};
+
+    /* Entries of one shard share their low ID bits, so the high bits of the product are folded down. */
+    static size_t hash_of(uint32_t entry_id, std::string_view name)
+    {
+        uint64_t key = ((uint64_t) entry_id * 0x9E3779B97F4A7C15ull) ^ std::hash<std::string_view>()(name);
+        return (size_t) (key ^ (key >> 32));
+    }
+
+    /* Size class of a version with a value of `size` bytes, `POD_VERSIONS_POOL_CLASSES` if it is too large for one. */
+    static uint32_t class_of(uint32_t size)
+    {
+        size_t bytes = sizeof(_PodVersion) + size;
+        uint32_t size_class = 0;
+
+        while(size_class < POD_VERSIONS_POOL_CLASSES && ((size_t) 1 << (POD_VERSIONS_POOL_MIN_SHIFT + size_class)) < bytes) size_class++;
+        return size_class;
+    }
+
+    /*
+     * new_version - take a version from the pool of its size class, or allocate one if the pool is empty.
+     *  returns: the version
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    _PodVersion *new_version(uint64_t stamp, bool deleted, const unsigned char *value, uint32_t size)
+    {
+        uint32_t size_class = class_of(size);
+        _PodVersion *version = size_class < POD_VERSIONS_POOL_CLASSES ? pool[size_class] : nullptr;
+
+        if(version)
+        {
+            pool[size_class] = version->older.load(std::memory_order_relaxed);
+            pool_bytes[size_class] -= (size_t) 1 << (POD_VERSIONS_POOL_MIN_SHIFT + size_class);
+        }
+        else
+        {
+            /* Pooled classes are allocated whole, so any value of the class fits when the version is reused. */
+            void *memory = malloc(size_class < POD_VERSIONS_POOL_CLASSES ? (size_t) 1 << (POD_VERSIONS_POOL_MIN_SHIFT + size_class) : sizeof(_PodVersion) + size);
+            database_assert(memory, "\nError allocating a POD version of %u bytes.\n", size)
+            version = new (memory) _PodVersion;
+        }
+
+        version->stamp = stamp;
+        version->older.store(nullptr, std::memory_order_relaxed);
+        version->size = size;
+        version->deleted = deleted;
+        if(size > 0) memcpy(version->value(), value, size);
+
+        return version;
+    }
+
+    /*
+     * free_versions - hand `version` and every version older than it back to the pool of its size class, or to
+     *                 the heap once the pool is full.
+     *  returns: nothing
+     *  on error: this function does not error
+     *
+     *  Note: only for versions no reader can reach any more; a pooled version is reused by the next `put`.
+     * */
+    void free_versions(_PodVersion *version)
+    {
+        while(version)
+        {
+            _PodVersion *older = version->older.load(std::memory_order_relaxed);
+            uint32_t size_class = class_of(version->size);
+
+            if(size_class < POD_VERSIONS_POOL_CLASSES && pool_bytes[size_class] < POD_VERSIONS_POOL_BYTES)
+            {
+                version->older.store(pool[size_class], std::memory_order_relaxed);
+                pool[size_class] = version;
+                pool_bytes[size_class] += (size_t) 1 << (POD_VERSIONS_POOL_MIN_SHIFT + size_class);
+            }
+            else
+            {
+                version->~_PodVersion();
+                free(version);
+            }
+            version = older;
+        }
+    }
+
+    static _PodVersionTable *new_table(uint32_t bucket_count)
+    {
+        _PodVersionTable *created = new _PodVersionTable;
+        created->mask = bucket_count - 1;
+        created->buckets.reset(new std::atomic<_PodVersionBucket *>[bucket_count]);
+        for(uint32_t i = 0; i < bucket_count; i++) created->buckets[i].store(nullptr, std::memory_order_relaxed);
+
+        return created;
+    }
+
+    static void free_table(_PodVersionTable *freed)
+    {
+        for(uint32_t i = 0; i <= freed->mask; i++) delete freed->buckets[i].load(std::memory_order_relaxed);
+        delete freed;
+    }
+
+    void retire(Retired kind, uint64_t epoch, _PodVersionNode *node, _PodVersion *version, void *memory)
+    {
+        retired.push_back({epoch, kind, node, version, memory});
+    }
+
+    /*
+     * find - look up the node of POD `name` (the entry itself if empty) in a table; readers must be pinned.
+     *  returns: the node, or nullptr
+     *  on error: this function does not error
+     * */
+    static _PodVersionNode *find(_PodVersionTable *in, uint32_t entry_id, std::string_view name)
+    {
+        if(!in) return nullptr;
+
+        _PodVersionBucket *bucket = in->buckets[hash_of(entry_id, name) & in->mask].load(std::memory_order_acquire);
+        if(!bucket) return nullptr;
+
+        for(_PodVersionNode *node: *bucket)
+            if(node->entry_id == entry_id && node->name == name) return node;
+
+        return nullptr;
+    }
+
+    /*
+     * replace_bucket - publish `bucket` in place of the bucket at `index`, retiring the old one.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void replace_bucket(_PodVersionTable *in, size_t index, _PodVersionBucket *bucket)
+    {
+        _PodVersionBucket *old = in->buckets[index].exchange(bucket, std::memory_order_acq_rel);
+        if(old) retire(Retired::BUCKET, epochs->current(), nullptr, nullptr, old);
+    }
+
+    /*
+     * grow - publish a table twice the size with the same nodes, retiring the old one.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void grow()
+    {
+        _PodVersionTable *old = table.load(std::memory_order_relaxed);
+        _PodVersionTable *grown = new_table((old->mask + 1) * 2);
+
+        for(uint32_t i = 0; i <= old->mask; i++)
+        {
+            _PodVersionBucket *bucket = old->buckets[i].load(std::memory_order_relaxed);
+            if(!bucket) continue;
+
+            for(_PodVersionNode *node: *bucket)
+            {
+                std::atomic<_PodVersionBucket *> &into = grown->buckets[hash_of(node->entry_id, node->name) & grown->mask];
+                if(!into.load(std::memory_order_relaxed)) into.store(new _PodVersionBucket, std::memory_order_relaxed);
+                into.load(std::memory_order_relaxed)->push_back(node);
+            }
+        }
+
+        table.store(grown, std::memory_order_release);
+        retire(Retired::TABLE, epochs->current(), nullptr, nullptr, old);
+    }
+
+    _PodVersionNode *insert(uint32_t entry_id, std::string_view name)
+    {
+        _PodVersionTable *into = table.load(std::memory_order_relaxed);
+        if(!into)
+        {
+            into = new_table(POD_VERSIONS_INITIAL_BUCKETS);
+            table.store(into, std::memory_order_release);
+        }
+
+        _PodVersionNode *node = new _PodVersionNode;
+        node->entry_id = entry_id;
+        node->name.assign(name.data(), name.size());
+
+        size_t index = hash_of(entry_id, name) & into->mask;
+        _PodVersionBucket *old = into->buckets[index].load(std::memory_order_relaxed);
+        _PodVersionBucket *bucket = old ? new _PodVersionBucket(*old) : new _PodVersionBucket;
+        bucket->push_back(node);
+        replace_bucket(into, index, bucket);
+
+        if(++node_count > 2 * ((size_t) into->mask + 1)) grow();
+        return node;
+    }
+
+    void unlink(_PodVersionNode *node)
+    {
+        _PodVersionTable *from = table.load(std::memory_order_relaxed);
+        size_t index = hash_of(node->entry_id, node->name) & from->mask;
+
+        _PodVersionBucket *bucket = new _PodVersionBucket(*from->buckets[index].load(std::memory_order_relaxed));
+        for(auto at = bucket->begin(); at != bucket->end(); ++at)
+            if(*at == node) { bucket->erase(at); break; }
+
+        if(bucket->empty()) { delete bucket; bucket = nullptr; }
+        replace_bucket(from, index, bucket);
+
+        node_count--;
+        retire(Retired::NODE, epochs->current(), node, nullptr, nullptr);
+    }
+
+    /*
+     * free_retired - free what `entry` retired, and `unlink` its node if that leaves nothing but a deleted POD.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void free_retired(_RetiredVersion entry, bool may_unlink)
+    {
+        switch(entry.kind)
+        {
+            case Retired::OLDER_VERSIONS: {
+                free_versions(entry.version->older.exchange(nullptr, std::memory_order_relaxed));
+
+                /* Every reader now sees the POD as deleted, so it can leave the table unless it was made again since. */
+                if(may_unlink && entry.version->deleted && entry.node->newest.load(std::memory_order_relaxed) == entry.version)
+                    unlink(entry.node);
+                break;
+            }
+            case Retired::NODE: {
+                free_versions(entry.node->newest.load(std::memory_order_relaxed));
+                delete entry.node;
+                break;
+            }
+            case Retired::BUCKET: delete (_PodVersionBucket *) entry.memory; break;
+            case Retired::TABLE: free_table((_PodVersionTable *) entry.memory); break;
+        }
+    }
+
+public:
+    PodVersions() {}
+
+    PodVersions(const PodVersions &) = delete;
+    PodVersions &operator=(const PodVersions &) = delete;
+
+    /*
+     * keep - start keeping versions, reclaimed through `with_epochs`; until then every call below does nothing.
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     *
+     *  Note: room is made for twice the retired versions that trigger a reclaim, since a reader pinned at the time
+     *        holds some back; the list then keeps its size once the server is warmed up.
+     * */
+    void keep(ModbEpochs &with_epochs)
+    {
+        epochs = &with_epochs;
+        retired.reserve(2 * POD_VERSIONS_RECLAIM_BATCH);
+    }
+    bool is_kept() { return epochs != nullptr; }
+
+    /*
+     * put - push a version of POD `name` (the entry itself if empty) holding `value`, or marking it deleted.
+     *  returns: nothing
+     *  on error: this function does not error
+     *
+     *  Note: only the thread owning the shard may change its versions; they are seen once `publish`ed.
+     * */
+    void put(uint32_t entry_id, std::string_view name, bool deleted, const unsigned char *value, uint32_t size)
+    {
+        if(!epochs) return;
+
+        /* Before a version comes from the heap, free what readers have moved past; it may refill the pool. */
+        uint32_t size_class = class_of(size);
+        if(size_class < POD_VERSIONS_POOL_CLASSES && !pool[size_class] && retired_head < unpublished) reclaim();
+
+        _PodVersionNode *node = find(table.load(std::memory_order_relaxed), entry_id, name);
+        if(!node)
+        {
+            if(deleted) return;
+            node = insert(entry_id, name);
+        }
+
+        _PodVersion *older = node->newest.load(std::memory_order_relaxed);
+        _PodVersion *version = new_version(published.load(std::memory_order_relaxed) + 1, deleted, value, size);
+        version->older.store(older, std::memory_order_relaxed);
+        node->newest.store(version, std::memory_order_release);
+
+        /* Readers of an older change may still want the versions behind it; they go once those readers are gone. */
+        if(older) retire(Retired::OLDER_VERSIONS, 0, node, version, nullptr);
+        changed = true;
+    }
+
+    /*
+     * publish - let readers see every version put since the last call; call once the change is logged.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void publish()
+    {
+        if(!changed) return;
+        changed = false;
+
+        published.store(published.load(std::memory_order_relaxed) + 1);
+
+        /* Readers pinned from here on see the change, so this is when the versions it replaced are retired. */
+        uint64_t epoch = epochs->current();
+        for(; unpublished < retired.size(); unpublished++)
+            if(retired[unpublished].epoch == 0) retired[unpublished].epoch = epoch;
+
+        if(retired.size() - retired_head >= POD_VERSIONS_RECLAIM_BATCH) reclaim();
+    }
+
+    /*
+     * reclaim - free whatever was retired before the oldest epoch a reader is pinned at.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void reclaim()
+    {
+        if(!epochs || retired_head == retired.size()) return;
+
+        /* Twice, so with no reader in the way what was retired in the current epoch goes too. */
+        for(int pass = 0; pass < 2 && retired_head < unpublished; pass++)
+        {
+            uint64_t oldest = epochs->advance();
+
+            while(retired_head < unpublished && retired[retired_head].epoch < oldest)
+                free_retired(retired[retired_head++], true);
+        }
+
+        /* Drop freed entries in bulk so the vector is reused instead of reallocated. */
+        if(retired_head == retired.size())
+        {
+            retired.clear();
+            retired_head = unpublished = 0;
+        }
+        else if(retired_head >= POD_VERSIONS_RECLAIM_BATCH && retired_head * 2 >= retired.size())
+        {
+            retired.erase(retired.begin(), retired.begin() + retired_head);
+            unpublished -= retired_head;
+            retired_head = 0;
+        }
+    }
+
+    /*
+     * read - append the value of POD `name` in entry `entry_id`, as of the last change published, to `response`.
+     *  returns: `SS_RESPONSE_OK`, `SS_RESPONSE_NO_SUCH_ENTRY`, or `SS_RESPONSE_NO_SUCH_POD`
+     *  on error: this function does not error
+     *
+     *  Note: safe from any thread, but the caller has to keep an epoch pinned (see `ModbEpochPin`) while it runs.
+     * */
+    unsigned char read(uint32_t entry_id, std::string_view name, std::vector<unsigned char> &response)
+    {
+        uint64_t snapshot = published.load();
+        _PodVersionTable *in = table.load(std::memory_order_acquire);
+
+        auto visible = [&](std::string_view node_name) -> _PodVersion * {
+            _PodVersionNode *node = find(in, entry_id, node_name);
+            _PodVersion *version = node ? node->newest.load(std::memory_order_acquire) : nullptr;
+
+            while(version && version->stamp > snapshot) version = version->older.load(std::memory_order_acquire);
+            return version && !version->deleted ? version : nullptr;
+        };
+
+        if(!visible(std::string_view())) return SS_RESPONSE_NO_SUCH_ENTRY;
+
+        _PodVersion *pod = visible(name);
+        if(!pod) return SS_RESPONSE_NO_SUCH_POD;
+
+        response.insert(response.end(), pod->value(), pod->value() + pod->size);
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * retired_count - how many retired versions, nodes and tables are waiting to be freed.
+     *  returns: the count
+     *  on error: this function does not error
+     * */
+    size_t retired_count() { return retired.size() - retired_head; }
+
+    ~PodVersions()
+    {
+        /* In order, so older versions are cut off their chains before the nodes holding them go. */
+        for(size_t at = retired_head; at < retired.size(); at++) free_retired(retired[at], false);
+
+        _PodVersionTable *last = table.load(std::memory_order_relaxed);
+        if(last)
+        {
+            for(uint32_t i = 0; i <= last->mask; i++)
+            {
+                _PodVersionBucket *bucket = last->buckets[i].load(std::memory_order_relaxed);
+                if(!bucket) continue;
+
+                for(_PodVersionNode *node: *bucket)
+                {
+                    free_versions(node->newest.load(std::memory_order_relaxed));
+                    delete node;
+                }
+            }
+            free_table(last);
+        }
+
+        for(_PodVersion *&free_list: pool)
+        {
+            while(free_list)
+            {
+                _PodVersion *next = free_list->older.load(std::memory_order_relaxed);
+                free_list->~_PodVersion();
+                free(free_list);
+                free_list = next;
+            }
+        }
+    }
+};
+
+#endif
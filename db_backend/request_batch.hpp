@@ -0,0 +1,191 @@
+#ifndef request_batch
+#define request_batch
+
+/* `CS_REQUEST_BATCH` carries many storage engine requests in one frame.
+ *
+ * Request payload (all integers little-endian):
+ *      [4: sub-request count] then for each sub-request [1: CS_REQUEST_*][4: payload length][payload]
+ * Response payload:
+ *      [4: sub-request count][1 `SS_RESPONSE_*` per sub-request]
+ *      then for each sub-request that produced a result (e.g. `CS_REQUEST_READ_POD`) [4: sub-request index][4: length][result]
+ *
+ * Sub-requests are applied in order for each DB entry, and the batch is answered once all of them are
+ * performed and durable. Results are added in order while the response stays within `SS_FRAME_MAX_PAYLOAD`;
+ * a sub-request whose result does not fit is answered `SS_RESPONSE_TOO_LARGE` (send it on its own). Only `CS_REQUEST_CREATE_NEW_DB_ENTRY` through `CS_REQUEST_READ_POD`
+ * and `CS_REQUEST_QUERY_POD` can be batched.
+ * */
+#define BATCH_HEADER_SIZE           4
+#define BATCH_OP_HEADER_SIZE        5
+
+#define batch_op_allowed(opcode)    (((opcode) >= CS_REQUEST_CREATE_NEW_DB_ENTRY && (opcode) <= CS_REQUEST_READ_POD) || (opcode) == CS_REQUEST_QUERY_POD)
+
+typedef struct BatchOp
+{
+    unsigned char   opcode;
+    /* Where the sub-request's payload starts in the batch payload. */
+    uint32_t        offset;
+    uint32_t        size;
+} _BatchOp;
+
+/* A decoded batch and the results of its sub-requests. */
+typedef struct RequestBatch
+{
+    std::vector<unsigned char>              payload;
+    std::vector<_BatchOp>                   ops;
+
+    std::vector<unsigned char>              statuses;
+    std::vector<std::vector<unsigned char>> results;
+
+    /* Parts of the batch still being performed; only touched by the event loop. */
+    uint32_t                                parts_left = 0;
+
+    /*
+     * parse - split a `CS_REQUEST_BATCH` payload into its sub-requests.
+     *  returns: true if the payload is well-formed else false
+     *  on error: this function does not error
+     * */
+    bool parse(const unsigned char *data, uint32_t size)
+    {
+        if(size < BATCH_HEADER_SIZE) return false;
+
+        uint32_t count = modb_get_u32(data);
+        if(count > (size - BATCH_HEADER_SIZE) / BATCH_OP_HEADER_SIZE) return false;
+
+        ops.clear();
+        ops.reserve(count);
+
+        uint32_t at = BATCH_HEADER_SIZE;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if(size - at < BATCH_OP_HEADER_SIZE) return false;
+
+            _BatchOp op;
+            op.opcode = data[at];
+            op.size = modb_get_u32(&data[at + 1]);
+            op.offset = at + BATCH_OP_HEADER_SIZE;
+
+            if(size - op.offset < op.size) return false;
+
+            ops.push_back(op);
+            at = op.offset + op.size;
+        }
+        if(at != size) return false;
+
+        payload.assign(data, data + size);
+        statuses.assign(count, SS_RESPONSE_NOT_SUPPORTED);
+        results.assign(count, std::vector<unsigned char>());
+
+        return true;
+    }
+
+    /*
+     * encode_response - append the status vector and results to `response`, as one frame payload.
+     *  returns: nothing
+     *  on error: this function does not error; results past `SS_FRAME_MAX_PAYLOAD` are left out and their
+     *            sub-requests answered `SS_RESPONSE_TOO_LARGE`
+     * */
+    void encode_response(std::vector<unsigned char> &response)
+    {
+        /* The statuses go first, so which results fit is settled before any is written. */
+        size_t room = SS_FRAME_MAX_PAYLOAD - BATCH_HEADER_SIZE - ops.size();
+        for(uint32_t i = 0; i < results.size(); i++)
+        {
+            if(results[i].empty()) continue;
+
+            if(results[i].size() + 8 > room)
+            {
+                statuses[i] = SS_RESPONSE_TOO_LARGE;
+                results[i].clear();
+            }
+            else room -= results[i].size() + 8;
+        }
+
+        size_t at = response.size();
+        response.resize(at + BATCH_HEADER_SIZE);
+        modb_put_u32(&response[at], (uint32_t) ops.size());
+        response.insert(response.end(), statuses.begin(), statuses.end());
+
+        for(uint32_t i = 0; i < results.size(); i++)
+        {
+            if(results[i].empty()) continue;
+
+            unsigned char header[8];
+            modb_put_u32(header, i);
+            modb_put_u32(&header[4], (uint32_t) results[i].size());
+
+            response.insert(response.end(), header, header + 8);
+            response.insert(response.end(), results[i].begin(), results[i].end());
+        }
+    }
+} _RequestBatch;
+
+/* Builds the payload of a `CS_REQUEST_BATCH` on the client-side. */
+class BatchBuilder
+{
+private:
+    std::vector<unsigned char> batch_payload;
+    uint32_t op_count = 0;
+
+public:
+    BatchBuilder() : batch_payload(BATCH_HEADER_SIZE, 0) {}
+
+    /*
+     * add - append a sub-request.
+     *  returns: the sub-request's index in the batch
+     *  on error: this function does not error
+     * */
+    uint32_t add(unsigned char opcode, const unsigned char *payload, uint32_t payload_size)
+    {
+        size_t at = batch_payload.size();
+        batch_payload.resize(at + BATCH_OP_HEADER_SIZE + payload_size);
+
+        batch_payload[at] = opcode;
+        modb_put_u32(&batch_payload[at + 1], payload_size);
+        if(payload_size > 0) memcpy(&batch_payload[at + BATCH_OP_HEADER_SIZE], payload, payload_size);
+
+        modb_put_u32(batch_payload.data(), ++op_count);
+        return op_count - 1;
+    }
+
+    void clear()
+    {
+        batch_payload.assign(BATCH_HEADER_SIZE, 0);
+        op_count = 0;
+    }
+
+    const unsigned char *data() { return batch_payload.data(); }
+    uint32_t size() { return (uint32_t) batch_payload.size(); }
+    uint32_t count() { return op_count; }
+};
+
+/*
+ * batch_decode_response - split a `CS_REQUEST_BATCH` response into per sub-request statuses and results.
+ *  returns: true if the response is well-formed else false
+ *  on error: this function does not error
+ * */
+inline bool batch_decode_response(const std::vector<unsigned char> &response, std::vector<unsigned char> &statuses,
+                                  std::vector<std::vector<unsigned char>> &results)
+{
+    if(response.size() < BATCH_HEADER_SIZE) return false;
+
+    uint32_t count = modb_get_u32(response.data());
+    if(response.size() - BATCH_HEADER_SIZE < count) return false;
+
+    statuses.assign(response.begin() + BATCH_HEADER_SIZE, response.begin() + BATCH_HEADER_SIZE + count);
+    results.assign(count, std::vector<unsigned char>());
+
+    size_t at = BATCH_HEADER_SIZE + count;
+    while(response.size() - at >= 8)
+    {
+        uint32_t index = modb_get_u32(&response[at]);
+        uint32_t size = modb_get_u32(&response[at + 4]);
+        if(index >= count || response.size() - at - 8 < size) return false;
+
+        results[index].assign(response.begin() + at + 8, response.begin() + at + 8 + size);
+        at += 8 + size;
+    }
+
+    return at == response.size();
+}
+
+#endif
@@ -0,0 +1,1546 @@
+#ifndef server_transport
+#define server_transport
+
+/* Socket transport for the server-side.
+ *
+ * Every request and response on a socket is one frame:
+ *      [4 bytes: payload length (little-endian)][1 byte: opcode][payload]
+ * Requests carry a `CS_REQUEST_*` opcode, responses carry a `SS_RESPONSE_*` code in the opcode slot.
+ * */
+#define SS_FRAME_HEADER_SIZE            5
+#define SS_FRAME_MAX_PAYLOAD            (16 * 1024 * 1024)
+
+/* Response buffers kept for reuse, the largest one worth keeping, and the room a new one starts with. */
+#define SS_SPARE_PAYLOADS               4096
+#define SS_SPARE_PAYLOAD_SIZE           65536
+#define SS_PAYLOAD_RESERVE              512
+
+/* Output a socket connection may have waiting before it is no longer read from, until the client reads its responses. */
+#define SS_MAX_BUFFERED_OUTPUT          (SS_FRAME_MAX_PAYLOAD + SS_FRAME_HEADER_SIZE)
+
+#define SS_RESPONSE_OK                  0x00 // request was performed, payload (if any) is the result
+#define SS_RESPONSE_UNKNOWN_REQUEST     0x01 // opcode is not a `CS_REQUEST_*` the server knows about
+#define SS_RESPONSE_BAD_REQUEST         0x02 // payload is malformed for the opcode
+#define SS_RESPONSE_NOT_SUPPORTED       0x03 // opcode is known but the server cannot perform it (yet)
+#define SS_RESPONSE_NO_SUCH_ENTRY       0x04 // DB-entry ID does not exist
+#define SS_RESPONSE_ENTRY_EXISTS        0x05 // DB-entry ID is already in use
+#define SS_RESPONSE_NO_SUCH_POD         0x06 // the entry has no POD with that name
+#define SS_RESPONSE_POD_EXISTS          0x07 // the entry already has a POD with that name
+#define SS_RESPONSE_TYPE_MISMATCH       0x08 // `CS_STORING_*` type does not match the type the POD was created with
+#define SS_RESPONSE_NO_SUCH_INDEX       0x09 // there is no index on that POD name
+#define SS_RESPONSE_INDEX_EXISTS        0x0A // there already is an index on that POD name
+#define SS_RESPONSE_USE_STREAM          0x0B // the value is kept in the blob file, read it with `CS_REQUEST_STREAM_POD`
+#define SS_RESPONSE_IO_ERROR            0x0C // the server could not read or write its blob file
+#define SS_RESPONSE_TOO_LARGE           0x0D // the value is larger than the server takes, or a batched sub-request's result did not fit in the response frame
+
+/* Sent unasked to clients that opened a session, in order with their responses, whenever the server state changes.
+ * Its payload is the new `SS_STATUS`.
+ * */
+#define SS_NOTIFY_STATUS                0x80
+
+/* Flag for `CS_REQUEST_OPEN_SESSION`: serve the session over shared-memory rings (Unix socket clients only). */
+#define CS_SESSION_SHARED_MEMORY        0x01
+
+/* How long the event loop keeps checking shared-memory sessions after the last request before it sleeps. */
+#define SS_SESSION_SPIN_US              50
+
+/* While spinning, passes of the event loop between looks at the sockets. */
+#define SS_SESSION_EPOLL_EVERY          16
+
+/* Checks a shared-memory client makes on an empty response ring before it sleeps on it: busy checks when the
+ * server has a core of its own, otherwise checks that yield the core to it. Then how long it sleeps between checks.
+ * */
+#define SHM_SESSION_CLIENT_SPINS        20000
+#define SHM_SESSION_CLIENT_YIELDS       64
+#define SHM_SESSION_CLIENT_WAIT_MS      100
+
+#define unix_socket_name        UC_PTR "/modb.sock"
+
+/* Handler invoked once per complete request frame.
+ * Gets the opcode and payload, appends any result to the response vector and returns a `SS_RESPONSE_*` code.
+ * */
+typedef std::function<unsigned char (unsigned char, const unsigned char *, uint32_t, std::vector<unsigned char> &)> SS_REQUEST_HANDLER;
+
+/* Dispatcher tried before the handler; gets the opcode, payload and a ticket.
+ * Returning true means the request was handed off (e.g. to a worker thread) and will be answered later
+ * through `ServerTransport::complete` with that ticket; false lets the handler perform it right away.
+ * */
+typedef std::function<bool (unsigned char, const unsigned char *, uint32_t, uint64_t)> SS_REQUEST_DISPATCHER;
+
+#if defined(__linux__)
+
+/*
+ * transport_set_nonblocking - put `fd` in non-blocking mode.
+ *  returns: true on success else false
+ *  on error: this function does not error
+ * */
+inline bool transport_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if(flags == -1) return false;
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+/*
+ * transport_append_frame - append a frame (header + payload) to `dst`.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+inline void transport_append_frame(std::vector<unsigned char> &dst, unsigned char opcode, const unsigned char *payload, uint32_t payload_size)
+{
+    size_t at = dst.size();
+    dst.resize(at + SS_FRAME_HEADER_SIZE + payload_size);
+
+    modb_put_u32(&dst[at], payload_size);
+    dst[at + 4] = opcode;
+
+    if(payload_size > 0)
+        memcpy(&dst[at + SS_FRAME_HEADER_SIZE], payload, payload_size);
+}
+
+/*
+ * transport_read_file - read `size` bytes of `fd` from `offset` into `data`.
+ *  returns: true if every byte was read else false
+ *  on error: this function does not error
+ * */
+inline bool transport_read_file(int fd, uint64_t offset, unsigned char *data, size_t size)
+{
+    while(size > 0)
+    {
+        ssize_t got = pread(fd, data, size, (off_t) offset);
+        if(got == -1 && errno == EINTR) continue;
+        if(got <= 0) return false;
+
+        data += got;
+        offset += got;
+        size -= got;
+    }
+    return true;
+}
+
+/* Response of a request that is still being performed (or is done but queued behind one that is). */
+typedef struct PendingResponse
+{
+    bool                        done = false;
+    unsigned char               response = 0;
+    std::vector<unsigned char>  payload;
+
+    /* Bytes of a file that follow the payload (see `ServerTransport::complete_file`), and what to run once they went out. */
+    int                         file_fd = -1;
+    uint64_t                    file_offset = 0;
+    uint32_t                    file_size = 0;
+    std::function<void()>       on_sent;
+
+    /* Request it answers, and when it was read if its latency is sampled (0 if not); see `modb_stats.hpp`. */
+    unsigned char               opcode = 0;
+    uint64_t                    arrived = 0;
+} _PendingResponse;
+
+/* Bytes of a file to send once the output before `at` is written. */
+typedef struct TransportFileSegment
+{
+    size_t                      at = 0;
+    int                         fd = -1;
+    uint64_t                    offset = 0;
+    uint32_t                    size = 0;
+    std::function<void()>       on_sent;
+} _TransportFileSegment;
+
+typedef struct TransportConnection
+{
+    int                         fd = -1;
+
+    /* Tickets handed to the dispatcher are [32: id][32: request sequence number]. */
+    uint32_t                    id = 0;
+
+    /* Responses go out in request order; `pending[pending_head]` belongs to request `pending_base`.
+     * Answered slots before `pending_head` are dropped in bulk, so the vector is reused instead of reallocated.
+     * */
+    std::vector<_PendingResponse> pending;
+    size_t                      pending_head = 0;
+    uint32_t                    pending_base = 0;
+
+    size_t pending_count() const { return pending.size() - pending_head; }
+
+    /* Bytes read but not yet parsed into a frame. */
+    std::vector<unsigned char>  in;
+
+    /* Response frames waiting to be written, `out_sent` bytes of which already went out. */
+    std::vector<unsigned char>  out;
+    size_t                      out_sent = 0;
+
+    /* File bytes that go out between the frames in `out`, in order, sent straight from the file. */
+    std::vector<_TransportFileSegment> out_files;
+
+    /* Is `EPOLLOUT` registered for this connection? */
+    bool                        want_write = false;
+
+    /* The client closed its end; close ours once the pending responses are written. */
+    bool                        peer_closed = false;
+
+    /* Input is not polled while more than `SS_MAX_BUFFERED_OUTPUT` of responses wait for the client to read them. */
+    bool                        reading_paused = false;
+
+    /* Accepted on the Unix socket, so the client is on this host. */
+    bool                        is_unix = false;
+
+    /* The client opened a session (see `CS_REQUEST_OPEN_SESSION`) and gets `SS_NOTIFY_STATUS` frames. */
+    bool                        session = false;
+
+    /* Shared-memory session this connection is served through instead of `fd`, and the file it is mapped from. */
+    ModbShmSegment              *shm = nullptr;
+    std::string                 shm_path;
+
+    /* Socket connection: the shared-memory connection it opened. Shared-memory connection: the socket that owns it. 0 if none. */
+    uint32_t                    linked_id = 0;
+
+    /* File bytes that never went out are let go of all the same. */
+    ~TransportConnection()
+    {
+        for(size_t i = pending_head; i < pending.size(); i++)
+            if(pending[i].on_sent) pending[i].on_sent();
+
+        for(_TransportFileSegment &segment: out_files) segment.on_sent();
+    }
+} _TransportConnection;
+
+class ServerTransport
+{
+private:
+    int epoll_fd = -1;
+    int tcp_fd = -1;
+    int unix_fd = -1;
+
+    /* Written to by `stop` to wake `run` up; `stop` may run on another thread. */
+    int wake_fd = -1;
+    std::atomic<bool> running{false};
+
+    unsigned char *unix_path = nullptr;
+
+    std::unordered_map<int, _TransportConnection *> connections;
+    std::unordered_map<uint32_t, _TransportConnection *> connections_by_id;
+    uint32_t next_connection_id = 1;
+
+    /* Extra descriptors (e.g. the `client_status` inotify watch) that share the event loop. */
+    std::unordered_map<int, std::function<void()>> watched;
+
+    SS_REQUEST_HANDLER handler;
+    SS_REQUEST_DISPATCHER dispatcher;
+
+    /* Runs on the event loop every time `wake` is called, and on every pass while the loop is busy. */
+    std::function<void()> on_wake;
+
+    /* Set while `run` blocks in `epoll_wait`; `wake` only writes to `wake_fd` then, a busy loop runs `on_wake` by itself. */
+    std::atomic<bool> sleeping{false};
+
+    /* Runs once per pass of the event loop, after requests are handled and before responses are sent. */
+    std::function<void()> before_flush;
+
+    /* Shared-memory connections; they have no descriptor, so the event loop checks their request rings every pass. */
+    std::vector<_TransportConnection *> shm_connections;
+
+    /* Folder session files are created in, empty if shared-memory sessions are not offered. */
+    std::string session_folder;
+
+    /* Last state given to `publish_state`, told to new sessions. */
+    unsigned char server_state = 0;
+
+    /* Microseconds to keep checking sessions before sleeping; 0 on a single core, where spinning only delays the client. */
+    long session_spin_us = 0;
+
+    /* IDs of connections that got new responses during the current pass of the event loop. */
+    std::vector<uint32_t> dirty;
+
+    /* Response buffers of answered requests, handed to new pending responses so they keep their capacity. */
+    std::vector<std::vector<unsigned char>> spare_payloads;
+
+    /* Where the event loop records its phases and requests, nullptr to not record; the ticks pick what gets timed,
+     * one per kind of event so events that come in a fixed pattern do not keep the same ones from being sampled.
+     * */
+    _ModbThreadStats *stats = nullptr;
+    uint32_t request_ticks[MODB_STATS_OPCODES] = {0};
+    uint32_t phase_ticks[MODB_PHASE_COUNT] = {0};
+
+    /*
+     * add_listener - bind and listen on an already created socket, then register it with epoll.
+     *  returns: the listening descriptor, or -1 if it could not be set up
+     *  on error: this function does not error
+     * */
+    int add_listener(int fd, const struct sockaddr *addr, socklen_t addr_size)
+    {
+        if(fd == -1) return -1;
+
+        if(bind(fd, addr, addr_size) == -1 || listen(fd, SOMAXCONN) == -1 || !transport_set_nonblocking(fd))
+        {
+            close(fd);
+            return -1;
+        }
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+
+        return fd;
+    }
+
+    /*
+     * accept_all - accept every pending connection on the listening descriptor `fd`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void accept_all(int fd, bool is_tcp)
+    {
+        while(true)
+        {
+            int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(client_fd == -1) return;
+
+            if(is_tcp)
+            {
+                int one = 1;
+                setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+
+            _TransportConnection *conn = new _TransportConnection;
+            conn->fd = client_fd;
+            conn->id = next_connection_id++;
+            conn->is_unix = !is_tcp;
+
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = client_fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev);
+
+            connections[client_fd] = conn;
+            connections_by_id[conn->id] = conn;
+        }
+    }
+
+    /*
+     * close_connection - close `conn` and whatever is linked to it; a socket takes its shared-memory session with it.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void close_connection(_TransportConnection *conn)
+    {
+        connections_by_id.erase(conn->id);
+
+        auto linked = connections_by_id.find(conn->linked_id);
+        if(conn->linked_id != 0 && linked != connections_by_id.end())
+        {
+            linked->second->linked_id = 0;
+            if(!conn->shm) close_connection(linked->second);
+        }
+
+        if(conn->shm)
+        {
+            /* Tell a client waiting on a response that none is coming. */
+            conn->shm->header()->closed.fetch_or(SHM_SESSION_SERVER_CLOSED);
+            conn->shm->response_ring().ring_bell();
+
+            unlink(conn->shm_path.c_str());
+            delete conn->shm;
+
+            for(size_t i = 0; i < shm_connections.size(); i++)
+                if(shm_connections[i] == conn) { shm_connections.erase(shm_connections.begin() + i); break; }
+        }
+        else
+        {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+            close(conn->fd);
+            connections.erase(conn->fd);
+        }
+
+        delete conn;
+    }
+
+    /*
+     * update_events - register the events `conn` needs: input until the peer closes (unless reading is paused), output
+     *                 while there is some left.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void update_events(_TransportConnection *conn, bool want_write)
+    {
+        /* Shared-memory connections are not in epoll; `want_write` just marks a full response ring to retry. */
+        if(conn->shm) { conn->want_write = want_write; return; }
+
+        struct epoll_event ev = {};
+        ev.events = (conn->peer_closed || conn->reading_paused ? 0u : (uint32_t) (EPOLLIN | EPOLLRDHUP)) | (want_write ? (uint32_t) EPOLLOUT : 0u);
+        ev.data.fd = conn->fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+
+        conn->want_write = want_write;
+    }
+
+    /*
+     * release_ready - move responses that are done, and not waiting behind an unfinished one, to the output.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void release_ready(_TransportConnection *conn)
+    {
+        while(conn->pending_count() > 0 && conn->pending[conn->pending_head].done)
+        {
+            _PendingResponse &ready = conn->pending[conn->pending_head];
+            transport_append_frame(conn->out, ready.response, ready.payload.data(), (uint32_t) ready.payload.size());
+
+            /* The frame goes on with the file bytes, written out by `flush_connection`. */
+            if(ready.file_fd != -1)
+            {
+                modb_put_u32(&conn->out[conn->out.size() - SS_FRAME_HEADER_SIZE - ready.payload.size()], (uint32_t) ready.payload.size() + ready.file_size);
+                conn->out_files.push_back({conn->out.size(), ready.file_fd, ready.file_offset, ready.file_size, std::move(ready.on_sent)});
+
+                ready.file_fd = -1;
+                ready.on_sent = nullptr;
+            }
+
+            if(ready.payload.capacity() > 0 && ready.payload.capacity() <= SS_SPARE_PAYLOAD_SIZE && spare_payloads.size() < SS_SPARE_PAYLOADS)
+            {
+                ready.payload.clear();
+                spare_payloads.push_back(std::move(ready.payload));
+            }
+
+            conn->pending_head++;
+            conn->pending_base++;
+        }
+
+        /* Drop the answered slots once they are all answered, or once they make up most of the vector. */
+        if(conn->pending_head == conn->pending.size())
+        {
+            conn->pending.clear();
+            conn->pending_head = 0;
+        }
+        else if(conn->pending_head >= 64 && conn->pending_head * 2 >= conn->pending.size())
+        {
+            conn->pending.erase(conn->pending.begin(), conn->pending.begin() + conn->pending_head);
+            conn->pending_head = 0;
+        }
+    }
+
+    /*
+     * add_pending - queue a response slot for the next request on `conn`.
+     *  returns: the slot
+     *  on error: this function does not error
+     * */
+    _PendingResponse &add_pending(_TransportConnection *conn)
+    {
+        conn->pending.emplace_back();
+        _PendingResponse &answer = conn->pending.back();
+
+        /* A new buffer only joins the ones in circulation when more requests are in flight than ever before. */
+        if(spare_payloads.empty())
+            answer.payload.reserve(SS_PAYLOAD_RESERVE);
+        else
+        {
+            answer.payload.swap(spare_payloads.back());
+            spare_payloads.pop_back();
+        }
+
+        return answer;
+    }
+
+    /*
+     * flush_connection - write as much of the pending output as the socket takes.
+     *  returns: false if the connection broke and got closed else true
+     *  on error: this function does not error
+     * */
+    bool flush_connection(_TransportConnection *conn)
+    {
+        if(conn->shm && conn->out_sent < conn->out.size())
+        {
+            ModbShmRing &ring = conn->shm->response_ring();
+            size_t wrote = ring.write_some(&conn->out[conn->out_sent], conn->out.size() - conn->out_sent);
+            conn->out_sent += wrote;
+            if(stats) stats->count_written(wrote);
+
+            if(ring.is_broken()) { close_connection(conn); return false; }
+            if(wrote > 0 && ring.consumer_asleep()) ring.ring_bell();
+        }
+
+        while(!conn->shm)
+        {
+            size_t until = conn->out_files.empty() ? conn->out.size() : conn->out_files.front().at;
+            ssize_t sent;
+
+            if(conn->out_sent < until)
+            {
+                /* A header followed by file bytes is held back to go out with them. */
+                sent = send(conn->fd, &conn->out[conn->out_sent], until - conn->out_sent, MSG_NOSIGNAL | (until < conn->out.size() || !conn->out_files.empty() ? MSG_MORE : 0));
+                if(sent > 0) conn->out_sent += sent;
+            }
+            else if(!conn->out_files.empty())
+            {
+                /* Straight from the file to the socket, never through a buffer of ours. */
+                _TransportFileSegment &segment = conn->out_files.front();
+                off_t offset = (off_t) segment.offset;
+
+                sent = segment.size > 0 ? sendfile(conn->fd, segment.fd, &offset, segment.size) : 0;
+
+                /* A file shorter than promised would leave the frame short. */
+                if(sent == 0 && segment.size > 0) { close_connection(conn); return false; }
+
+                if(sent > 0)
+                {
+                    segment.offset += sent;
+                    segment.size -= (uint32_t) sent;
+                }
+
+                if(segment.size == 0)
+                {
+                    segment.on_sent();
+                    conn->out_files.erase(conn->out_files.begin());
+                }
+            }
+            else
+                break;
+
+            if(sent == -1)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if(errno == EINTR) continue;
+
+                close_connection(conn);
+                return false;
+            }
+
+            if(stats) stats->count_written((uint64_t) sent);
+        }
+
+        if(conn->out_sent == conn->out.size() && conn->out_files.empty())
+        {
+            conn->out.clear();
+            conn->out_sent = 0;
+        }
+
+        /* Only ask for `EPOLLOUT` while there is something left to write; read again once the client caught up. */
+        bool want_write = !conn->out.empty();
+        bool resume = conn->reading_paused && conn->out.size() - conn->out_sent <= SS_MAX_BUFFERED_OUTPUT;
+        if(resume) conn->reading_paused = false;
+        if(want_write != conn->want_write || resume) update_events(conn, want_write);
+
+        return true;
+    }
+
+    /*
+     * answer_request - perform a request the dispatcher did not take: sessions are opened here, the rest goes to the handler.
+     *  returns: a `SS_RESPONSE_*` code, any result is appended to `response`
+     *  on error: this function does not error
+     * */
+    unsigned char answer_request(_TransportConnection *conn, unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        if(opcode == CS_REQUEST_OPEN_SESSION) return open_session(conn, payload, payload_size, response);
+
+        return handler ? handler(opcode, payload, payload_size, response) : SS_RESPONSE_NOT_SUPPORTED;
+    }
+
+    /*
+     * handle_frames - handle every complete frame in the input of `conn`.
+     *  returns: false if the connection misbehaved and got closed else true
+     *  on error: this function does not error
+     * */
+    bool handle_frames(_TransportConnection *conn)
+    {
+        size_t at = 0;
+        while(conn->in.size() - at >= SS_FRAME_HEADER_SIZE)
+        {
+            uint32_t payload_size = modb_get_u32(&conn->in[at]);
+
+            /* Refuse to buffer frames larger than the protocol allows. */
+            if(payload_size > SS_FRAME_MAX_PAYLOAD) { close_connection(conn); return false; }
+            if(conn->in.size() - at - SS_FRAME_HEADER_SIZE < payload_size) break;
+
+            unsigned char opcode = conn->in[at + 4];
+            const unsigned char *payload = &conn->in[at + SS_FRAME_HEADER_SIZE];
+            at += SS_FRAME_HEADER_SIZE + payload_size;
+
+            /* Only there to wake the event loop up for the client's shared-memory session; never answered. */
+            if(opcode == CS_REQUEST_SESSION_DOORBELL) continue;
+
+            uint64_t arrived = stats && modb_stats_sampled(request_ticks[modb_stats_opcode_slot(opcode)]) ? modb_stats_now() : 0;
+
+            uint64_t ticket = ((uint64_t) conn->id << 32) | (uint32_t) (conn->pending_base + conn->pending_count());
+            if(opcode != CS_REQUEST_OPEN_SESSION && dispatcher && dispatcher(opcode, payload, payload_size, ticket))
+            {
+                _PendingResponse &answer = add_pending(conn);
+                answer.opcode = opcode;
+                answer.arrived = arrived;
+                continue;
+            }
+
+            /* Answered right away; behind earlier requests that are still being performed if there are any. */
+            unsigned char response;
+            if(conn->pending_count() > 0)
+            {
+                _PendingResponse &answer = add_pending(conn);
+
+                response = answer.response = answer_request(conn, opcode, payload, payload_size, answer.payload);
+                answer.done = true;
+            }
+            else
+            {
+                /* Reserve the response header, let the handler append the result after it. */
+                size_t response_at = conn->out.size();
+                conn->out.resize(response_at + SS_FRAME_HEADER_SIZE);
+
+                response = answer_request(conn, opcode, payload, payload_size, conn->out);
+
+                modb_put_u32(&conn->out[response_at], (uint32_t) (conn->out.size() - response_at - SS_FRAME_HEADER_SIZE));
+                conn->out[response_at + 4] = response;
+            }
+
+            if(!stats) continue;
+            stats->count_request(opcode, response == SS_RESPONSE_OK);
+
+            /* Performed in place, so all of its latency is service time. */
+            if(arrived)
+            {
+                uint64_t took = modb_stats_now() - arrived;
+                stats->phases[MODB_PHASE_PERFORMING].record(took);
+                stats->service[modb_stats_opcode_slot(opcode)].record(took);
+                stats->latency[modb_stats_opcode_slot(opcode)].record(took);
+            }
+        }
+        conn->in.erase(conn->in.begin(), conn->in.begin() + at);
+
+        if(dirty.empty() || dirty.back() != conn->id) dirty.push_back(conn->id);
+        return true;
+    }
+
+    /*
+     * read_connection - read everything available, handling the complete frames after each read.
+     *  returns: nothing
+     *  on error: this function does not error; broken or misbehaving connections are closed
+     *
+     *  Note: responses are not written here, the connection is queued on `dirty` and flushed after `before_flush` runs.
+     *  Note: `in` never holds more than one frame that is not complete yet. Once more than `SS_MAX_BUFFERED_OUTPUT` of
+     *        responses wait for the client, reading stops until `flush_connection` got them out.
+     * */
+    void read_connection(_TransportConnection *conn)
+    {
+        unsigned char buffer[16384];
+        bool closed = false, broken = false;
+        uint64_t read_bytes = 0;
+        uint64_t started = stats && modb_stats_sampled(phase_ticks[MODB_PHASE_READING]) ? modb_stats_now() : 0;
+
+        while(true)
+        {
+            if(conn->out.size() - conn->out_sent > SS_MAX_BUFFERED_OUTPUT)
+            {
+                /* Flushed on this pass either way, so a client that hung up is found out by the write. */
+                conn->reading_paused = true;
+                update_events(conn, conn->want_write);
+                if(dirty.empty() || dirty.back() != conn->id) dirty.push_back(conn->id);
+                break;
+            }
+
+            ssize_t got = recv(conn->fd, buffer, sizeof(buffer), 0);
+
+            if(got > 0)
+            {
+                read_bytes += (uint64_t) got;
+                conn->in.insert(conn->in.end(), buffer, buffer + got);
+                if(!handle_frames(conn)) return;
+                continue;
+            }
+            if(got == 0) { closed = true; break; }
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) closed = broken = true;
+            break;
+        }
+
+        if(stats)
+        {
+            stats->count_read(read_bytes);
+            if(started) stats->phases[MODB_PHASE_READING].record(modb_stats_now() - started);
+        }
+
+        /* After a hard error (e.g. `ECONNRESET`) nothing can be sent back; responses still being performed find the
+         * connection gone by its ID and are dropped.
+         * */
+        if(broken) { close_connection(conn); return; }
+
+        /* Stop polling for input once the peer is gone; the connection stays until its pending responses are out. */
+        if(closed && !conn->peer_closed)
+        {
+            conn->peer_closed = true;
+            update_events(conn, conn->want_write);
+        }
+    }
+
+    /*
+     * open_session - answer `CS_REQUEST_OPEN_SESSION`: mark `conn` as a session, and set up shared-memory rings if asked to.
+     *  returns: `SS_RESPONSE_OK` with [4: session ID][1: `SS_STATUS`] (then [4: ring size][path of the session file] for
+     *           shared memory), `SS_RESPONSE_BAD_REQUEST` if `conn` already has a session, or `SS_RESPONSE_NOT_SUPPORTED`
+     *           if shared memory was asked for over TCP or the session file could not be created
+     *  on error: this function does not error
+     *
+     *  Note: a client that got a shared-memory session but could not map its file asks again without shared memory;
+     *        the shared-memory session is closed and the session stays on the socket.
+     * */
+    unsigned char open_session(_TransportConnection *conn, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        if(payload_size != 1 || conn->shm) return SS_RESPONSE_BAD_REQUEST;
+        if(conn->session)
+        {
+            auto linked = connections_by_id.find(conn->linked_id);
+            if((payload[0] & CS_SESSION_SHARED_MEMORY) || conn->linked_id == 0 || linked == connections_by_id.end())
+                return SS_RESPONSE_BAD_REQUEST;
+
+            close_connection(linked->second);
+        }
+
+        _TransportConnection *shm_conn = nullptr;
+        if(payload[0] & CS_SESSION_SHARED_MEMORY)
+        {
+            if(!conn->is_unix || session_folder.empty()) return SS_RESPONSE_NOT_SUPPORTED;
+
+            shm_conn = new _TransportConnection;
+            shm_conn->id = next_connection_id++;
+            shm_conn->shm_path = session_folder + NCC_PTR shm_session_file_name + std::to_string(shm_conn->id) + ".shm";
+            shm_conn->shm = new ModbShmSegment;
+
+            if(!shm_conn->shm->create(shm_conn->shm_path.c_str(), shm_conn->id, SHM_SESSION_RING_SIZE, server_state))
+            {
+                delete shm_conn->shm;
+                delete shm_conn;
+                return SS_RESPONSE_NOT_SUPPORTED;
+            }
+
+            shm_conn->session = true;
+            shm_conn->linked_id = conn->id;
+            conn->linked_id = shm_conn->id;
+
+            shm_connections.push_back(shm_conn);
+            connections_by_id[shm_conn->id] = shm_conn;
+        }
+        conn->session = true;
+
+        size_t at = response.size();
+        response.resize(at + 5);
+        modb_put_u32(&response[at], shm_conn ? shm_conn->id : conn->id);
+        response[at + 4] = server_state;
+
+        if(shm_conn)
+        {
+            response.resize(at + 9);
+            modb_put_u32(&response[at + 5], SHM_SESSION_RING_SIZE);
+            response.insert(response.end(), shm_conn->shm_path.begin(), shm_conn->shm_path.end());
+        }
+
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * poll_sessions - handle the requests waiting in every shared-memory session, and retry responses that did not fit.
+     *  returns: true if any session had requests else false
+     *  on error: this function does not error; sessions the client closed, or whose ring counters it corrupted, are closed
+     * */
+    bool poll_sessions()
+    {
+        bool busy = false;
+
+        for(size_t i = 0; i < shm_connections.size(); )
+        {
+            _TransportConnection *conn = shm_connections[i];
+            ModbShmRing &ring = conn->shm->request_ring();
+
+            if(conn->shm->header()->closed.load(std::memory_order_acquire) & SHM_SESSION_CLIENT_CLOSED)
+            {
+                close_connection(conn);
+                continue;
+            }
+
+            if(conn->want_write) dirty.push_back(conn->id);
+
+            size_t readable = ring.readable();
+            if(ring.is_broken())
+            {
+                close_connection(conn);
+                continue;
+            }
+
+            if(readable > 0)
+            {
+                size_t at = conn->in.size();
+                uint64_t started = stats && modb_stats_sampled(phase_ticks[MODB_PHASE_READING]) ? modb_stats_now() : 0;
+
+                conn->in.resize(at + readable);
+                conn->in.resize(at + ring.read_some(&conn->in[at], readable));
+
+                if(stats)
+                {
+                    stats->count_read(conn->in.size() - at);
+                    if(started) stats->phases[MODB_PHASE_READING].record(modb_stats_now() - started);
+                }
+
+                busy = true;
+                if(!handle_frames(conn)) continue;
+            }
+            i++;
+        }
+
+        return busy;
+    }
+
+    /*
+     * arm_sessions - tell every shared-memory client the event loop is about to sleep, so it rings the doorbell on its socket.
+     *  returns: true if every request ring is still empty, false if one got a request while arming (none are left armed)
+     *  on error: this function does not error
+     * */
+    bool arm_sessions()
+    {
+        for(size_t i = 0; i < shm_connections.size(); i++)
+        {
+            if(shm_connections[i]->shm->request_ring().arm()) continue;
+
+            while(i-- > 0) shm_connections[i]->shm->request_ring().disarm();
+            return false;
+        }
+
+        return true;
+    }
+
+    void disarm_sessions()
+    {
+        for(_TransportConnection *conn: shm_connections) conn->shm->request_ring().disarm();
+    }
+
+    /*
+     * queue_notify - queue a `SS_NOTIFY_STATUS` frame for `conn`, after the responses it is still owed.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void queue_notify(_TransportConnection *conn, unsigned char state)
+    {
+        if(conn->pending_count() == 0)
+        {
+            transport_append_frame(conn->out, SS_NOTIFY_STATUS, &state, 1);
+            return;
+        }
+
+        _PendingResponse &notify = add_pending(conn);
+        notify.response = SS_NOTIFY_STATUS;
+        notify.payload.push_back(state);
+        notify.done = true;
+    }
+
+    /*
+     * flush_dirty - run `before_flush`, then write out the responses queued during this pass.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void flush_dirty()
+    {
+        if(dirty.empty()) return;
+
+        uint64_t started = stats && modb_stats_sampled(phase_ticks[MODB_PHASE_PUBLISHING]) ? modb_stats_now() : 0;
+        if(before_flush) before_flush();
+
+        for(uint32_t id: dirty)
+        {
+            auto found = connections_by_id.find(id);
+            if(found == connections_by_id.end()) continue;
+
+            _TransportConnection *conn = found->second;
+            if(!flush_connection(conn)) continue;
+            if(conn->peer_closed && conn->pending_count() == 0 && conn->out.empty()) close_connection(conn);
+        }
+        dirty.clear();
+
+        if(started) stats->phases[MODB_PHASE_PUBLISHING].record(modb_stats_now() - started);
+    }
+
+public:
+    ServerTransport()
+    {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if(std::thread::hardware_concurrency() > 1) session_spin_us = SS_SESSION_SPIN_US;
+
+        /* Checked by the server-side through `is_ready` before it listens. */
+        if(!is_ready()) return;
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = wake_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+    }
+
+    /*
+     * is_ready - check if the event loop could be set up.
+     *  returns: true if the epoll and wake descriptors were created else false
+     *  on error: this function does not error
+     * */
+    bool is_ready() { return epoll_fd != -1 && wake_fd != -1; }
+
+    /*
+     * set_handler - set the function every request frame gets passed to.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_handler(SS_REQUEST_HANDLER request_handler) { handler = request_handler; }
+
+    /*
+     * set_dispatcher - set the function every request frame is offered to first (see `SS_REQUEST_DISPATCHER`).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_dispatcher(SS_REQUEST_DISPATCHER request_dispatcher) { dispatcher = request_dispatcher; }
+
+    /*
+     * set_on_wake - set a function the event loop runs each time `wake` is called (e.g. to collect finished requests);
+     *               it also runs on passes of the loop nobody woke it for, so it must be cheap when there is nothing to do.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_on_wake(std::function<void()> woken) { on_wake = woken; }
+
+    /*
+     * wake - make the event loop run `on_wake`; safe to call from another thread.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void wake()
+    {
+        /* Pairs with the fence in `run` before it sleeps: either it sees what the caller finished, or the caller sees it asleep. */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(!sleeping.load(std::memory_order_relaxed)) return;
+
+        uint64_t one = 1;
+        if(write(wake_fd, &one, sizeof(one))) {}
+    }
+
+    /*
+     * complete - answer a request the dispatcher handed off; call from the event loop (e.g. in `on_wake`).
+     *  returns: nothing
+     *  on error: this function does not error; answers for connections that have since closed are dropped
+     * */
+    void complete(uint64_t ticket, unsigned char response, std::vector<unsigned char> &payload)
+    {
+        auto found = connections_by_id.find((uint32_t) (ticket >> 32));
+        if(found == connections_by_id.end()) return;
+
+        _TransportConnection *conn = found->second;
+        uint32_t index = (uint32_t) ticket - conn->pending_base;
+        if(index >= conn->pending_count()) return;
+
+        _PendingResponse &answer = conn->pending[conn->pending_head + index];
+        answer.response = response;
+        answer.payload.swap(payload);
+        answer.done = true;
+
+        if(stats)
+        {
+            stats->count_request(answer.opcode, response == SS_RESPONSE_OK);
+            if(answer.arrived) stats->latency[modb_stats_opcode_slot(answer.opcode)].record(modb_stats_now() - answer.arrived);
+        }
+
+        if(index == 0)
+        {
+            release_ready(conn);
+            dirty.push_back(conn->id);
+        }
+    }
+
+    /*
+     * complete_file - answer a request the dispatcher handed off with `payload` followed by `size` bytes of `fd` from
+     *                 `offset`, which go from the file to the socket with `sendfile`; `on_sent` runs once they are out
+     *                 (or will never be). Shared-memory sessions get the bytes read into the response instead.
+     *  returns: nothing
+     *  on error: this function does not error; a file that cannot be read is answered with `SS_RESPONSE_IO_ERROR`
+     * */
+    void complete_file(uint64_t ticket, unsigned char response, std::vector<unsigned char> &payload, int fd, uint64_t offset, uint32_t size,
+                       std::function<void()> on_sent)
+    {
+        auto found = connections_by_id.find((uint32_t) (ticket >> 32));
+        _TransportConnection *conn = found != connections_by_id.end() ? found->second : nullptr;
+        uint32_t index = conn ? (uint32_t) ticket - conn->pending_base : 0;
+
+        if(!conn || index >= conn->pending_count()) { on_sent(); return; }
+
+        if(conn->shm)
+        {
+            size_t at = payload.size();
+            payload.resize(at + size);
+
+            if(!transport_read_file(fd, offset, &payload[at], size))
+            {
+                payload.clear();
+                response = SS_RESPONSE_IO_ERROR;
+            }
+            on_sent();
+        }
+        else
+        {
+            _PendingResponse &answer = conn->pending[conn->pending_head + index];
+            answer.file_fd = fd;
+            answer.file_offset = offset;
+            answer.file_size = size;
+            answer.on_sent = std::move(on_sent);
+        }
+
+        complete(ticket, response, payload);
+    }
+
+    /*
+     * caught_up - check if every request before the one `ticket` was handed out for has been answered.
+     *  returns: true if nothing earlier on its connection is still being performed else false
+     *  on error: this function does not error
+     * */
+    bool caught_up(uint64_t ticket)
+    {
+        auto found = connections_by_id.find((uint32_t) (ticket >> 32));
+        return found != connections_by_id.end() && found->second->pending_count() == 0;
+    }
+
+    /*
+     * set_before_flush - set a function to run before each batch of responses goes out (e.g. to make changes durable).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_before_flush(std::function<void()> on_flush) { before_flush = on_flush; }
+
+    /*
+     * set_stats - record the phases of the event loop and the requests it answers into `thread_stats`, nullptr to stop;
+     *             call before `run`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_stats(_ModbThreadStats *thread_stats) { stats = thread_stats; }
+
+    /*
+     * set_session_folder - offer shared-memory sessions to Unix socket clients, with their files created in `folder`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_session_folder(std::string_view folder) { session_folder.assign(folder.data(), folder.size()); }
+
+    /*
+     * publish_state - tell every session the server is now in `state` (a `SS_STATUS`); call from the thread running the event loop.
+     *  returns: nothing
+     *  on error: this function does not error
+     *
+     *  Note: outside of `run` the notifications are written out right away.
+     * */
+    void publish_state(unsigned char state)
+    {
+        server_state = state;
+
+        for(auto &found: connections_by_id)
+        {
+            _TransportConnection *conn = found.second;
+            if(!conn->session) continue;
+
+            /* Shared-memory clients read the state straight out of the session header. */
+            if(conn->shm) { conn->shm->header()->server_state.store(state, std::memory_order_release); continue; }
+            if(conn->peer_closed) continue;
+
+            queue_notify(conn, state);
+            dirty.push_back(conn->id);
+        }
+
+        if(!running) flush_dirty();
+    }
+
+    /*
+     * listen_tcp - listen for TCP connections on `ip_address`:`port`.
+     *  returns: true if the socket is listening else false
+     *  on error: this function does not error
+     * */
+    bool listen_tcp(const char *ip_address, const char *port)
+    {
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) atoi(port));
+
+        if(inet_pton(AF_INET, ip_address, &addr.sin_addr) != 1) return false;
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd != -1)
+        {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        }
+
+        tcp_fd = add_listener(fd, (struct sockaddr *) &addr, sizeof(addr));
+        return tcp_fd != -1;
+    }
+
+    /*
+     * listen_unix - listen for Unix-domain connections on the socket file `path`.
+     *  returns: true if the socket is listening else false (`errno` is `EADDRINUSE` if a server already answers on `path`)
+     *  on error: this function does not error
+     * */
+    bool listen_unix(const char *path)
+    {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+
+        if(strlen(path) >= sizeof(addr.sun_path)) return false;
+        memcpy(addr.sun_path, path, strlen(path));
+
+        /* A socket file left over from a previous run would make `bind` fail; one a server still answers on is not taken over. */
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(probe != -1)
+        {
+            bool answered = connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+            close(probe);
+            if(answered) { errno = EADDRINUSE; return false; }
+        }
+        unlink(path);
+
+        unix_fd = add_listener(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), (struct sockaddr *) &addr, sizeof(addr));
+        if(unix_fd == -1) return false;
+
+        unix_path = UC_PTR calloc(strlen(path) + 1, sizeof(*unix_path));
+        database_assert(unix_path, "\nError allocating memory for the Unix socket path.\n")
+        memcpy(unix_path, path, strlen(path));
+
+        return true;
+    }
+
+    /*
+     * watch_fd - run `on_ready` from the event loop whenever `fd` becomes readable.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void watch_fd(int fd, std::function<void()> on_ready)
+    {
+        if(fd == -1) return;
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+
+        watched[fd] = on_ready;
+    }
+
+    /*
+     * run - serve connections until `stop` is called.
+     *  timeout_ms - return after this many milliseconds without any activity; -1 never times out
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void run(int timeout_ms)
+    {
+        struct epoll_event events[256];
+        running = true;
+
+        auto last_activity = std::chrono::steady_clock::now();
+        unsigned spin_passes = 0;
+
+        while(running)
+        {
+            /* Shared-memory sessions have no descriptor to wake epoll up, so their rings are checked on every pass. */
+            if(poll_sessions()) last_activity = std::chrono::steady_clock::now();
+            if(on_wake) on_wake();
+            flush_dirty();
+
+            auto idle = std::chrono::steady_clock::now() - last_activity;
+            long idle_ms = (long) std::chrono::duration_cast<std::chrono::milliseconds>(idle).count();
+            int wait_ms = timeout_ms < 0 ? -1 : (idle_ms >= timeout_ms ? 0 : (int) (timeout_ms - idle_ms));
+            bool armed = false;
+
+            if(!shm_connections.empty())
+            {
+                bool backlog = false;
+                for(_TransportConnection *conn: shm_connections) backlog |= conn->want_write;
+
+                /* Right after a request the next one is usually close behind; keep checking instead of sleeping.
+                 * Otherwise sleep, with clients ringing the doorbell on their socket, and retry full response rings every millisecond.
+                 * */
+                if(idle < std::chrono::microseconds(session_spin_us)) wait_ms = 0;
+                else if(!(armed = arm_sessions())) wait_ms = 0;
+                else if(backlog && (wait_ms < 0 || wait_ms > 1)) wait_ms = 1;
+            }
+
+            /* While spinning, sockets are only looked at every few passes so a session round trip makes no syscall. */
+            if(wait_ms == 0 && ++spin_passes % SS_SESSION_EPOLL_EVERY != 0) continue;
+
+            /* Last look at finished work once `wake` is sure to write to `wake_fd`. */
+            if(wait_ms != 0)
+            {
+                sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if(on_wake) on_wake();
+                if(!dirty.empty()) wait_ms = 0;
+            }
+
+            /* Only waits that may block count as listening; the polls made while spinning are too short to tell anything. */
+            uint64_t started = wait_ms != 0 && stats && modb_stats_sampled(phase_ticks[MODB_PHASE_LISTENING]) ? modb_stats_now() : 0;
+
+            int ready = epoll_wait(epoll_fd, events, 256, wait_ms);
+            sleeping.store(false, std::memory_order_relaxed);
+            if(started) stats->phases[MODB_PHASE_LISTENING].record(modb_stats_now() - started);
+            if(armed) disarm_sessions();
+
+            if(ready == -1 && errno == EINTR) continue;
+            if(ready == -1) break;
+            if(ready == 0)
+            {
+                if(timeout_ms >= 0 && std::chrono::steady_clock::now() - last_activity >= std::chrono::milliseconds(timeout_ms)) break;
+                continue;
+            }
+            last_activity = std::chrono::steady_clock::now();
+
+            for(int i = 0; i < ready; i++)
+            {
+                int fd = events[i].data.fd;
+
+                if(fd == wake_fd)
+                {
+                    uint64_t count;
+                    if(read(wake_fd, &count, sizeof(count))) {}
+                    if(on_wake) on_wake();
+                    continue;
+                }
+                if(fd == tcp_fd) { accept_all(fd, true); continue; }
+                if(fd == unix_fd) { accept_all(fd, false); continue; }
+
+                auto watch = watched.find(fd);
+                if(watch != watched.end()) { watch->second(); continue; }
+
+                auto found = connections.find(fd);
+                if(found == connections.end()) continue;
+
+                _TransportConnection *conn = found->second;
+
+                /* `EPOLLHUP`/`EPOLLERR` are reported whatever the mask; once the peer is gone they would fire every pass. */
+                if(conn->peer_closed && (events[i].events & (EPOLLHUP | EPOLLERR))) { close_connection(conn); continue; }
+
+                if(events[i].events & EPOLLOUT)
+                    if(!flush_connection(conn)) continue;
+
+                if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    read_connection(conn);
+            }
+
+            flush_dirty();
+        }
+
+        running = false;
+    }
+
+    /*
+     * stop - make `run` return; safe to call from another thread.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void stop()
+    {
+        running = false;
+
+        uint64_t one = 1;
+        if(write(wake_fd, &one, sizeof(one))) {}
+    }
+
+    /*
+     * connection_count - how many clients are currently connected.
+     *  returns: number of open client connections
+     *  on error: this function does not error
+     * */
+    size_t connection_count() { return connections.size(); }
+
+    ~ServerTransport()
+    {
+        for(auto &conn: connections)
+        {
+            close(conn.second->fd);
+            delete conn.second;
+        }
+        connections.clear();
+
+        for(_TransportConnection *conn: shm_connections)
+        {
+            conn->shm->header()->closed.fetch_or(SHM_SESSION_SERVER_CLOSED);
+            conn->shm->response_ring().ring_bell();
+            unlink(conn->shm_path.c_str());
+
+            delete conn->shm;
+            delete conn;
+        }
+        shm_connections.clear();
+        connections_by_id.clear();
+
+        if(tcp_fd != -1) close(tcp_fd);
+        if(unix_fd != -1) close(unix_fd);
+        if(wake_fd != -1) close(wake_fd);
+        if(epoll_fd != -1) close(epoll_fd);
+
+        if(unix_path)
+        {
+            unlink(NCC_PTR unix_path);
+            free(unix_path);
+        }
+        unix_path = nullptr;
+    }
+};
+
+/* Blocking client for the socket transport, used by tools and tests talking to a server on the same host. */
+class TransportClient
+{
+private:
+    int fd = -1;
+
+    /* Session opened with `open_session`; with shared memory, frames go through its rings instead of `fd`. */
+    uint32_t session_id = 0;
+    ModbShmSegment *shm = nullptr;
+
+    /* Last `SS_STATUS` the server sent. */
+    unsigned char state = 0;
+
+    bool write_all(const unsigned char *data, size_t size)
+    {
+        while(size > 0)
+        {
+            ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if(sent == -1) { if(errno == EINTR) continue; return false; }
+
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool read_all(unsigned char *data, size_t size)
+    {
+        while(size > 0)
+        {
+            ssize_t got = recv(fd, data, size, 0);
+            if(got == 0) return false;
+            if(got == -1) { if(errno == EINTR) continue; return false; }
+
+            data += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    /*
+     * shm_write_all - write `size` bytes into the request ring, waiting for room while the server catches up.
+     *  returns: true if everything was written else false (the server closed the session)
+     *  on error: this function does not error
+     * */
+    bool shm_write_all(const unsigned char *data, size_t size)
+    {
+        ModbShmRing &ring = shm->request_ring();
+
+        while(size > 0)
+        {
+            size_t wrote = ring.write_some(data, size);
+            data += wrote;
+            size -= wrote;
+
+            if(size == 0) break;
+            if(ring.is_broken() || (shm->header()->closed.load(std::memory_order_acquire) & SHM_SESSION_SERVER_CLOSED)) return false;
+
+            /* Full; make sure the server is awake to drain it. */
+            if(!ring_doorbell()) return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    /*
+     * shm_read_all - read `size` bytes out of the response ring, sleeping on it once the server has nothing for a while.
+     *  returns: true if everything was read else false (the server closed the session)
+     *  on error: this function does not error
+     * */
+    bool shm_read_all(unsigned char *data, size_t size)
+    {
+        static const bool multi_core = std::thread::hardware_concurrency() > 1;
+
+        ModbShmRing &ring = shm->response_ring();
+        unsigned spins = 0;
+
+        while(size > 0)
+        {
+            size_t got = ring.read_some(data, size);
+            if(got > 0) { data += got; size -= got; spins = 0; continue; }
+
+            if(ring.is_broken()) return false;
+            if((shm->header()->closed.load(std::memory_order_acquire) & SHM_SESSION_SERVER_CLOSED) && ring.readable() == 0) return false;
+
+            /* No syscall while the answer is on its way; only a server that went quiet costs a futex wait. */
+            if(multi_core && ++spins < SHM_SESSION_CLIENT_SPINS) { shm_ring_relax(); continue; }
+            if(!multi_core && ++spins < SHM_SESSION_CLIENT_YIELDS) { std::this_thread::yield(); continue; }
+            ring.wait_bell(SHM_SESSION_CLIENT_WAIT_MS);
+        }
+        return true;
+    }
+
+    /*
+     * ring_doorbell - wake the server up through the socket if it went to sleep on the request ring.
+     *  returns: false if the socket broke else true
+     *  on error: this function does not error
+     * */
+    bool ring_doorbell()
+    {
+        if(!shm->request_ring().consumer_asleep()) return true;
+
+        unsigned char doorbell[SS_FRAME_HEADER_SIZE] = {0, 0, 0, 0, CS_REQUEST_SESSION_DOORBELL};
+        return write_all(doorbell, SS_FRAME_HEADER_SIZE);
+    }
+
+    bool read_bytes(unsigned char *data, size_t size) { return shm ? shm_read_all(data, size) : read_all(data, size); }
+
+public:
+    /*
+     * connect_tcp - connect to a server at `ip_address`:`port`.
+     *  returns: true if connected else false
+     *  on error: this function does not error
+     * */
+    bool connect_tcp(const char *ip_address, const char *port)
+    {
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) atoi(port));
+        if(inet_pton(AF_INET, ip_address, &addr.sin_addr) != 1) return false;
+
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd == -1) return false;
+
+        if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) { close(fd); fd = -1; return false; }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    /*
+     * connect_unix - connect to a server through the Unix socket file at `path`.
+     *  returns: true if connected else false
+     *  on error: this function does not error
+     * */
+    bool connect_unix(const char *path)
+    {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if(strlen(path) >= sizeof(addr.sun_path)) return false;
+        memcpy(addr.sun_path, path, strlen(path));
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd == -1) return false;
+
+        if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) { close(fd); fd = -1; return false; }
+        return true;
+    }
+
+    /*
+     * send_request - send a request frame without waiting for the response.
+     *  returns: true if the frame was written else false
+     *  on error: this function does not error
+     * */
+    bool send_request(unsigned char opcode, const unsigned char *payload, uint32_t payload_size)
+    {
+        unsigned char header[SS_FRAME_HEADER_SIZE];
+        modb_put_u32(header, payload_size);
+        header[4] = opcode;
+
+        if(shm) return shm_write_all(header, SS_FRAME_HEADER_SIZE) && shm_write_all(payload, payload_size) && ring_doorbell();
+
+        return write_all(header, SS_FRAME_HEADER_SIZE) && write_all(payload, payload_size);
+    }
+
+    /*
+     * read_response - read the next response frame; `SS_NOTIFY_STATUS` frames on the way are taken in (see `server_state`).
+     *  returns: true if a frame was read else false, `response` gets the `SS_RESPONSE_*` code
+     *  on error: this function does not error
+     * */
+    bool read_response(unsigned char &response, std::vector<unsigned char> &payload)
+    {
+        while(true)
+        {
+            unsigned char header[SS_FRAME_HEADER_SIZE];
+            if(!read_bytes(header, SS_FRAME_HEADER_SIZE)) return false;
+
+            uint32_t payload_size = modb_get_u32(header);
+            if(payload_size > SS_FRAME_MAX_PAYLOAD) return false;
+
+            response = header[4];
+            payload.resize(payload_size);
+
+            if(payload_size > 0 && !read_bytes(payload.data(), payload_size)) return false;
+            if(response != SS_NOTIFY_STATUS) return true;
+
+            if(payload_size == 1) state = payload[0];
+        }
+    }
+
+    /*
+     * request - send a request frame and wait for its response.
+     *  returns: the `SS_RESPONSE_*` code, or `SS_RESPONSE_NOT_SUPPORTED` if the connection broke
+     *  on error: this function does not error
+     * */
+    unsigned char request(unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &result)
+    {
+        unsigned char response = SS_RESPONSE_NOT_SUPPORTED;
+
+        if(!send_request(opcode, payload, payload_size) || !read_response(response, result))
+            return SS_RESPONSE_NOT_SUPPORTED;
+
+        return response;
+    }
+
+    /*
+     * open_session - turn the connection into a session: the server then tells it about every state change, and with
+     *                `shared_memory` (Unix socket only) requests and responses move onto shared-memory rings.
+     *  returns: true if the session was opened else false; a connection that did not get shared memory keeps using the socket
+     *  on error: this function does not error
+     * */
+    bool open_session(bool shared_memory = false)
+    {
+        unsigned char flags = shared_memory ? CS_SESSION_SHARED_MEMORY : 0;
+        std::vector<unsigned char> result;
+
+        if(request(CS_REQUEST_OPEN_SESSION, &flags, 1, result) != SS_RESPONSE_OK || result.size() < 5) return false;
+
+        session_id = modb_get_u32(result.data());
+        state = result[4];
+        if(!shared_memory) return true;
+        if(result.size() <= 9) return false;
+
+        std::string path(result.begin() + 9, result.end());
+        shm = new ModbShmSegment;
+        if(shm->open(path.c_str())) return true;
+
+        delete shm;
+        shm = nullptr;
+        return false;
+    }
+
+    /*
+     * server_state - the `SS_STATUS` the server was last in, as told by the session.
+     *  returns: the state, 0 before a session is opened
+     *  on error: this function does not error
+     * */
+    unsigned char server_state() { return shm ? shm->header()->server_state.load(std::memory_order_acquire) : state; }
+
+    uint32_t session() { return session_id; }
+
+    bool is_shared_memory() { return shm != nullptr; }
+
+    bool is_connected() { return fd != -1; }
+
+    ~TransportClient()
+    {
+        if(shm)
+        {
+            shm->header()->closed.fetch_or(SHM_SESSION_CLIENT_CLOSED);
+            delete shm;
+        }
+        shm = nullptr;
+
+        if(fd != -1) close(fd);
+        fd = -1;
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef shm_ring
+#define shm_ring
+
+/* Shared-memory sessions for clients on the same host as the server.
+ *
+ * A session is one file in the MODB folder, mapped by both processes:
+ *      [_ShmSessionHeader][request ring][response ring]
+ * Each ring is a single-producer single-consumer byte pipe carrying the same frames as the sockets
+ * (see `server_transport.hpp`): the client only writes requests, the server only writes responses.
+ * Positions are free-running 64-bit counters on their own cache lines, so neither side takes a lock
+ * or makes a syscall while the other one is awake.
+ *
+ * The other process can write anything into the mapping, so each side keeps its own position to itself and only
+ * trusts the other side's counter while the two are at most the capacity apart; a ring found otherwise is broken.
+ *
+ * A side that runs out of work says so in the ring it reads (`consumer_waiting`) before sleeping; the
+ * other side only pays for a wake-up when it sees that flag after writing.
+ * */
+#define SHM_SESSION_MAGIC           0x4D53444Du // "MDSM"
+#define SHM_SESSION_VERSION         1
+
+/* Bytes in each ring; a power of two. */
+#define SHM_SESSION_RING_SIZE       (1u << 20)
+
+#define SHM_SESSION_CLIENT_CLOSED   0x1
+#define SHM_SESSION_SERVER_CLOSED   0x2
+
+#define shm_session_file_name       UC_PTR "/modb_session_"
+
+#if defined(__linux__)
+
+/*
+ * shm_ring_relax - tell the core this thread is spinning on a ring, without giving it up.
+ *  returns: nothing
+ *  on error: this function does not error
+ * */
+inline void shm_ring_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+typedef struct ShmRingHeader
+{
+    /* Bytes the producer has written and the consumer has read since the ring was created. */
+    alignas(64) std::atomic<uint64_t>   written;
+    alignas(64) std::atomic<uint64_t>   read;
+
+    /* Set by the consumer before it sleeps; the producer then bumps `bell` and wakes it. */
+    alignas(64) std::atomic<uint32_t>   consumer_waiting;
+    std::atomic<uint32_t>               bell;
+
+    uint32_t                            capacity;
+} _ShmRingHeader;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "shared-memory rings need lock-free atomics");
+
+/* View of one ring inside a mapped session. */
+class ModbShmRing
+{
+private:
+    _ShmRingHeader *header = nullptr;
+    unsigned char *data = nullptr;
+    uint64_t mask = 0;
+
+    /* This side's own position (`written` for the producer, `read` for the consumer); the header only gets copies. */
+    uint64_t written_at = 0;
+    uint64_t read_at = 0;
+    bool broken = false;
+
+public:
+    /*
+     * bytes_for - room a ring of `capacity` bytes takes in a session.
+     *  returns: the size in bytes
+     *  on error: this function does not error
+     * */
+    static size_t bytes_for(uint32_t capacity) { return sizeof(_ShmRingHeader) + capacity; }
+
+    /*
+     * attach - use the ring at `at`; `create` sets it up empty first (only the side that created the session does).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void attach(void *at, uint32_t capacity, bool create)
+    {
+        header = (_ShmRingHeader *) at;
+        data = UC_PTR at + sizeof(_ShmRingHeader);
+        mask = capacity - 1;
+        broken = false;
+
+        if(!create)
+        {
+            written_at = header->written.load(std::memory_order_acquire);
+            read_at = header->read.load(std::memory_order_acquire);
+            return;
+        }
+
+        written_at = read_at = 0;
+
+        new (header) _ShmRingHeader;
+        header->written.store(0);
+        header->read.store(0);
+        header->consumer_waiting.store(0);
+        header->bell.store(0);
+        header->capacity = capacity;
+    }
+
+    /*
+     * readable/writable - bytes the consumer can read, or the producer can write, right now.
+     *  returns: the byte count, 0 once the other side's counter is more than the capacity away from ours
+     *  on error: this function does not error; the ring is marked broken instead (see `is_broken`)
+     * */
+    size_t readable()
+    {
+        uint64_t filled = header->written.load(std::memory_order_acquire) - read_at;
+        if(filled > mask + 1) { broken = true; return 0; }
+        return filled;
+    }
+
+    size_t writable()
+    {
+        uint64_t filled = written_at - header->read.load(std::memory_order_acquire);
+        if(filled > mask + 1) { broken = true; return 0; }
+        return mask + 1 - filled;
+    }
+
+    /* True once the other side was seen writing a counter no ring can have; nothing is read or written after that. */
+    bool is_broken() { return broken; }
+
+    /*
+     * write_some - copy as much of `src` as fits into the ring; producer only.
+     *  returns: bytes written
+     *  on error: this function does not error
+     * */
+    size_t write_some(const unsigned char *src, size_t size)
+    {
+        size_t room = writable();
+        if(size > room) size = room;
+        if(size == 0) return 0;
+
+        uint64_t at = written_at;
+
+        size_t offset = at & mask;
+        size_t first = size < mask + 1 - offset ? size : mask + 1 - offset;
+        memcpy(&data[offset], src, first);
+        memcpy(data, src + first, size - first);
+
+        written_at = at + size;
+        header->written.store(written_at, std::memory_order_release);
+        return size;
+    }
+
+    /*
+     * read_some - copy up to `max` readable bytes into `dst`; consumer only.
+     *  returns: bytes read
+     *  on error: this function does not error
+     * */
+    size_t read_some(unsigned char *dst, size_t max)
+    {
+        size_t size = readable();
+        if(size > max) size = max;
+        if(size == 0) return 0;
+
+        uint64_t at = read_at;
+
+        size_t offset = at & mask;
+        size_t first = size < mask + 1 - offset ? size : mask + 1 - offset;
+        memcpy(dst, &data[offset], first);
+        memcpy(dst + first, data, size - first);
+
+        read_at = at + size;
+        header->read.store(read_at, std::memory_order_release);
+        return size;
+    }
+
+    /*
+     * arm - consumer: announce a sleep, then take a last look.
+     *  returns: true if the ring is still empty and it is safe to sleep, false if data came in (the flag is cleared again)
+     *  on error: this function does not error
+     * */
+    bool arm()
+    {
+        header->consumer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if(readable() == 0) return true;
+
+        header->consumer_waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+
+    void disarm() { header->consumer_waiting.store(0, std::memory_order_relaxed); }
+
+    /*
+     * consumer_asleep - producer: check, after writing, whether the consumer needs waking.
+     *  returns: true if the consumer armed itself for sleep else false
+     *  on error: this function does not error
+     * */
+    bool consumer_asleep()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return header->consumer_waiting.load(std::memory_order_relaxed) != 0;
+    }
+
+    /*
+     * ring_bell - producer: wake a consumer sleeping in `wait_bell`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void ring_bell()
+    {
+        header->bell.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, &header->bell, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+
+    /*
+     * wait_bell - consumer: sleep until the producer rings, data arrives or `timeout_ms` runs out (-1 waits forever).
+     *  returns: nothing
+     *  on error: this function does not error; spurious wake-ups just return early
+     * */
+    void wait_bell(int timeout_ms)
+    {
+        uint32_t rung = header->bell.load(std::memory_order_acquire);
+        if(!arm()) return;
+
+        struct timespec wait = {timeout_ms / 1000, (long) (timeout_ms % 1000) * 1000000};
+        syscall(SYS_futex, &header->bell, FUTEX_WAIT, rung, timeout_ms < 0 ? NULL : &wait, NULL, 0);
+
+        disarm();
+    }
+};
+
+typedef struct ShmSessionHeader
+{
+    uint32_t                            magic;
+    uint32_t                            version;
+    uint32_t                            session_id;
+    uint32_t                            ring_capacity;
+
+    /* Current `SS_STATUS` of the server, updated in place on every change. */
+    std::atomic<unsigned char>          server_state;
+
+    /* `SHM_SESSION_*_CLOSED` bits; either side setting one ends the session. */
+    std::atomic<unsigned char>          closed;
+} _ShmSessionHeader;
+
+/* One mapped session file: its header and the two rings after it. */
+class ModbShmSegment
+{
+private:
+    unsigned char *base = nullptr;
+    size_t size = 0;
+
+    ModbShmRing requests;
+    ModbShmRing responses;
+
+    static size_t ring_offset() { return (sizeof(_ShmSessionHeader) + 63) & ~(size_t) 63; }
+
+    void attach_rings(uint32_t capacity, bool create)
+    {
+        size_t at = ring_offset();
+        requests.attach(base + at, capacity, create);
+        responses.attach(base + at + ((ModbShmRing::bytes_for(capacity) + 63) & ~(size_t) 63), capacity, create);
+    }
+
+    static size_t bytes_for(uint32_t capacity) { return ring_offset() + 2 * ((ModbShmRing::bytes_for(capacity) + 63) & ~(size_t) 63); }
+
+public:
+    ModbShmSegment() {}
+    ModbShmSegment(const ModbShmSegment &) = delete;
+    ModbShmSegment &operator=(const ModbShmSegment &) = delete;
+
+    /*
+     * create - create (replacing any stale one) and map the session file at `path`; server-side.
+     *  returns: true if the session was created else false
+     *  on error: this function does not error
+     * */
+    bool create(const char *path, uint32_t session_id, uint32_t capacity, unsigned char server_state)
+    {
+        unlink(path);
+
+        int fd = ::open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if(fd == -1) return false;
+
+        size_t needed = bytes_for(capacity);
+        void *addr = ftruncate(fd, needed) == 0 ? mmap(NULL, needed, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+
+        if(addr == MAP_FAILED) { unlink(path); return false; }
+
+        base = UC_PTR addr;
+        size = needed;
+
+        _ShmSessionHeader *session = new (base) _ShmSessionHeader;
+        session->version = SHM_SESSION_VERSION;
+        session->session_id = session_id;
+        session->ring_capacity = capacity;
+        session->server_state.store(server_state);
+        session->closed.store(0);
+        attach_rings(capacity, true);
+
+        /* Written last; a client that maps the file early sees no magic and gives up. */
+        std::atomic_thread_fence(std::memory_order_release);
+        session->magic = SHM_SESSION_MAGIC;
+        return true;
+    }
+
+    /*
+     * open - map an existing session file; client-side.
+     *  returns: true if `path` is a session file of this version else false
+     *  on error: this function does not error
+     * */
+    bool open(const char *path)
+    {
+        int fd = ::open(path, O_RDWR | O_CLOEXEC);
+        if(fd == -1) return false;
+
+        struct stat file_info;
+        void *addr = MAP_FAILED;
+        if(fstat(fd, &file_info) == 0 && (size_t) file_info.st_size >= ring_offset())
+            addr = mmap(NULL, file_info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if(addr == MAP_FAILED) return false;
+
+        base = UC_PTR addr;
+        size = file_info.st_size;
+
+        _ShmSessionHeader *session = header();
+        uint32_t capacity = session->ring_capacity;
+        if(session->magic != SHM_SESSION_MAGIC || session->version != SHM_SESSION_VERSION ||
+           capacity < 2 || (capacity & (capacity - 1)) != 0 || bytes_for(capacity) > size)
+        {
+            unmap();
+            return false;
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        attach_rings(capacity, false);
+        return true;
+    }
+
+    void unmap()
+    {
+        if(base) munmap(base, size);
+        base = nullptr;
+        size = 0;
+    }
+
+    bool is_mapped() { return base != nullptr; }
+
+    _ShmSessionHeader *header() { return (_ShmSessionHeader *) base; }
+
+    /* Client to server. */
+    ModbShmRing &request_ring() { return requests; }
+
+    /* Server to client. */
+    ModbShmRing &response_ring() { return responses; }
+
+    ~ModbShmSegment() { unmap(); }
+};
+
+#endif
+
+#endif
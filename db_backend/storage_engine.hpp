@@ -0,0 +1,988 @@
+#ifndef storage_engine
+#define storage_engine
+
+/* In-memory storage for DB entries and their Pieces Of Data (PODs).
+ *
+ * Entries are keyed by their DB-entry ID. Each POD lives in a column specialized for its type,
+ * so a POD is just a (type, slot) pair and a store writes straight into the column.
+ * Requests and POD types both dispatch through tables of handlers (see `pod_types.hpp`), not switches.
+ * Once a worker pool owns the engine, every change is also kept as a version readers on other threads can see
+ * (see `pod_versions.hpp`), so `CS_REQUEST_READ_POD` can be answered without going through the owning worker.
+ *
+ * Request payloads (all integers little-endian):
+ *  CS_REQUEST_CREATE_NEW_DB_ENTRY  [4: entry ID]
+ *  CS_REQUEST_DELETE_DB_ENTRY      [4: entry ID]
+ *  CS_REQUEST_CREATE_NEW_POD       [4: entry ID][1: CS_CREATING_POD_WITH_TYPE_*][1: name length][name]
+ *  CS_REQUEST_DELETE_POD           [4: entry ID][1: name length][name]
+ *  CS_REQUEST_TO_STORE_IN          [4: entry ID][1: name length][name][1: CS_STORING_*][value]
+ *  CS_REQUEST_READ_POD             [4: entry ID][1: name length][name]
+ *  CS_REQUEST_QUERY_POD            [4: entry ID][1: name length][name][1: CS_QUERY_*][4: value or low bound][4: high bound]
+ *  CS_REQUEST_CREATE_INDEX         [1: CS_INDEX_*][1: name length][name]
+ *  CS_REQUEST_DROP_INDEX           [1: name length][name]
+ *  CS_REQUEST_LOOKUP_POD           [1: name length][name][1: CS_QUERY_FILTER_EQUAL or _RANGE][4: value or low bound][4: high bound]
+ *  CS_REQUEST_STREAM_POD           [4: entry ID][1: name length][name][1: CS_STREAM_*][8: offset or size][4: length or bytes]
+ * Single values are 1, 2 or 4 bytes; a stream value is every remaining byte of the payload.
+ * A stream value can also be stored as `CS_STORING_ENCODED` (see `pod_codecs.hpp`), decoded before it is stored;
+ * `encode_store` turns a store into one for the write-ahead log.
+ * `CS_REQUEST_READ_POD` responds with [1: CS_STORING_*][value].
+ * `CS_REQUEST_QUERY_POD` only works on WORD/DWORD streams; the value/bounds are only sent with the filters that need them.
+ * `CS_REQUEST_LOOKUP_POD` responds with [4: count][4: entry ID]..., using the index on the name if there is one
+ * and going over every entry if not; the index requests carry no entry ID (see `cs_request_is_broadcast`).
+ * `CS_REQUEST_STREAM_POD` only works on BYTE_STREAM PODs; what each `CS_STREAM_*` carries is told where they are defined.
+ * A value it commits is kept in the blob file (see `pod_blobs.hpp`), and `CS_REQUEST_READ_POD` answers
+ * `SS_RESPONSE_USE_STREAM` for it until a plain store puts a value back in memory.
+ * */
+
+/* Opcodes `perform` handles, `CS_REQUEST_CREATE_NEW_DB_ENTRY` through `CS_REQUEST_STREAM_POD` (not all in between). */
+#define ENGINE_REQUEST_COUNT        (CS_REQUEST_STREAM_POD - CS_REQUEST_CREATE_NEW_DB_ENTRY + 1)
+
+/* Bytes of the records `snapshot` writes for an entry, and for a POD (created, then stored into) besides twice its name and its value. */
+#define ENGINE_SNAPSHOT_ENTRY_SIZE  (WAL_RECORD_HEADER_SIZE + 5)
+#define ENGINE_SNAPSHOT_POD_SIZE    (2 * (WAL_RECORD_HEADER_SIZE + 7))
+
+/* What the `CS_STREAM_ATTACH` record of a POD kept in the blob file adds over a store of nothing. */
+#define ENGINE_SNAPSHOT_BLOB_SIZE   24
+
+typedef struct DBEntry
+{
+    std::unordered_map<std::string, _PodSlot> pods;
+} _DBEntry;
+
+class StorageEngine
+{
+private:
+    std::unordered_map<uint32_t, _DBEntry> entries;
+
+    /* One column per POD type (see `pod_types.hpp`). */
+    PodColumns                          columns;
+
+    /* Secondary indexes by POD name (see `pod_index.hpp`). */
+    std::unordered_map<std::string, PodIndex> indexes;
+
+    /* POD name being looked up; reused so lookups of long names do not allocate. */
+    std::string                         pod_key;
+
+    /* Scratch space for `CS_REQUEST_QUERY_POD`, kept so repeated queries do not reallocate. */
+    std::vector<uint32_t>               query_matches;
+    std::vector<uint32_t>               query_swapped;
+
+    /* Bytes `snapshot` would write; only the thread owning the engine changes it, compaction reads it from the event loop. */
+    std::atomic<uint64_t>               live_bytes{0};
+
+    /* Payload of the record `snapshot` is writing. */
+    std::vector<unsigned char>          snapshot_payload;
+
+    /* Versions of every entry and POD for readers on other threads, and the value of the one being made. */
+    PodVersions                         versions;
+    std::vector<unsigned char>          version_value;
+
+    /* Blob file BYTE_STREAM values can be kept in (nullptr if there is none), and the extents of the PODs that
+     * keep their value there, or are having a new one streamed in, by BYTE_STREAM slot.
+     * */
+    PodBlobFile                         *blobs = nullptr;
+    std::unordered_map<uint32_t, _PodBlobExtent> blob_values;
+    std::unordered_map<uint32_t, _PodBlobExtent> blob_staged;
+
+    /* Extents the last request detached, retired once it is logged (see `retire_blobs`). */
+    std::vector<_PodBlobExtent>         blob_detached;
+
+    /* Where a `CS_STREAM_READ` of a value in the blob file puts the region to send instead of copying it into the
+     * response (nullptr copies), and the record to log for the last `CS_STREAM_COMMIT` (see `stream_record`).
+     * */
+    _PodBlobRegion                      *send_region = nullptr;
+    std::vector<unsigned char>          blob_record;
+
+    /* Codec each column is persisted with, a decoded `CS_STORING_ENCODED` value, the store `encode_store` made
+     * last and the sample `POD_CODEC_AUTO` tried.
+     * */
+    _PodCodecPolicy                     codecs;
+    std::vector<unsigned char>          codec_value;
+    std::vector<unsigned char>          codec_payload;
+    std::vector<unsigned char>          codec_sample;
+
+    void count_live(int64_t change) { live_bytes.store(live_bytes.load(std::memory_order_relaxed) + change, std::memory_order_relaxed); }
+
+    int64_t pod_live_size(size_t name_size, _PodSlot pod)
+    {
+        return ENGINE_SNAPSHOT_POD_SIZE + 2 * (int64_t) name_size + columns.encoded_size(pod);
+    }
+
+    /*
+     * put_version - push a version of the POD `name` holding what it holds now, if versions are kept.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void put_version(uint32_t entry_id, std::string_view name, _PodSlot pod)
+    {
+        if(!versions.is_kept()) return;
+
+        version_value.clear();
+        if(blob_of(pod)) version_value.push_back(POD_BLOB_VERSION);
+        else columns.read(pod, version_value);
+        versions.put(entry_id, name, false, version_value.data(), (uint32_t) version_value.size());
+    }
+
+    /*
+     * blob_of - the extent of the blob file the value of `pod` is kept in.
+     *  returns: a pointer to the extent, or nullptr if the value is in memory
+     *  on error: this function does not error
+     * */
+    _PodBlobExtent *blob_of(_PodSlot pod)
+    {
+        if(pod.column != POD_COLUMN_BYTE_STREAM || blob_values.empty()) return nullptr;
+
+        auto kept = blob_values.find(pod.slot);
+        return kept != blob_values.end() ? &kept->second : nullptr;
+    }
+
+    /*
+     * detach_blob - stop keeping the value of `pod` in the blob file; its extent is freed once the change is durable.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void detach_blob(_PodSlot pod)
+    {
+        _PodBlobExtent *kept = blob_of(pod);
+        if(!kept) return;
+
+        blob_detached.push_back(*kept);
+        blob_values.erase(pod.slot);
+        count_live(-ENGINE_SNAPSHOT_BLOB_SIZE);
+    }
+
+    /* Drops the value being streamed into `pod`; it was never seen, so its extent is freed right away. */
+    void unstage_blob(_PodSlot pod)
+    {
+        if(pod.column != POD_COLUMN_BYTE_STREAM || blob_staged.empty()) return;
+
+        auto staged = blob_staged.find(pod.slot);
+        if(staged == blob_staged.end()) return;
+
+        blobs->release(staged->second);
+        blob_staged.erase(staged);
+    }
+
+    /*
+     * attach_blob - make `extent` the value of the BYTE_STREAM POD `name`, in place of what it held.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void attach_blob(uint32_t entry_id, std::string_view name, _PodSlot pod, const _PodBlobExtent &extent)
+    {
+        detach_blob(pod);
+
+        /* The value in memory goes, along with its buffer. */
+        PodByteStream::slot_type &value = columns.column<PodByteStream>()[pod.slot];
+        count_live(-(int64_t) value.size() + ENGINE_SNAPSHOT_BLOB_SIZE);
+        PodByteStream::slot_type().swap(value);
+
+        blob_values[pod.slot] = extent;
+        put_version(entry_id, name, pod);
+    }
+
+    /*
+     * find_pod - look up the POD `name` in entry `entry_id`.
+     *  returns: a pointer to the POD slot, or nullptr; `response` is set to why it was not found
+     *  on error: this function does not error
+     * */
+    _PodSlot *find_pod(uint32_t entry_id, const unsigned char *name, unsigned char name_size, unsigned char &response)
+    {
+        auto entry = entries.find(entry_id);
+        if(entry == entries.end()) { response = SS_RESPONSE_NO_SUCH_ENTRY; return nullptr; }
+
+        pod_key.assign(NCC_PTR name, name_size);
+        auto pod = entry->second.pods.find(pod_key);
+        if(pod == entry->second.pods.end()) { response = SS_RESPONSE_NO_SUCH_POD; return nullptr; }
+
+        return &pod->second;
+    }
+
+    /*
+     * reindex - file the value entry `entry_id` now holds in its POD `name` in the index on `name`, if there is one.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void reindex(uint32_t entry_id, const std::string &name, _PodSlot pod)
+    {
+        auto index = indexes.find(name);
+        uint32_t value;
+
+        if(index != indexes.end() && columns.single_value(pod, value)) index->second.put(entry_id, value);
+    }
+
+    void unindex(uint32_t entry_id, const std::string &name)
+    {
+        auto index = indexes.find(name);
+        if(index != indexes.end()) index->second.remove(entry_id);
+    }
+
+    /*
+     * query_stream - run a (validated) `CS_QUERY_*` over one stream using the fastest kernels the CPU has.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    template<typename T>
+    void query_stream(const std::vector<T> &stream, unsigned char query_type, const unsigned char *args, std::vector<unsigned char> &response)
+    {
+        const _StreamKernels &kernels = stream_kernels_best();
+        size_t at = response.size();
+
+        switch(query_type)
+        {
+            case CS_QUERY_SUM: {
+                uint64_t sum = stream_sum(kernels, stream.data(), stream.size());
+                response.resize(at + 8);
+                modb_put_u32(&response[at], (uint32_t) sum);
+                modb_put_u32(&response[at + 4], (uint32_t) (sum >> 32));
+                break;
+            }
+            case CS_QUERY_MIN:
+            case CS_QUERY_MAX: {
+                if(stream.empty()) break;
+
+                T min = stream[0], max = stream[0];
+                stream_min_max(kernels, stream.data(), stream.size(), min, max);
+
+                response.resize(at + 4);
+                modb_put_u32(&response[at], query_type == CS_QUERY_MIN ? min : max);
+                break;
+            }
+            case CS_QUERY_FILTER_EQUAL:
+            case CS_QUERY_FILTER_RANGE: {
+                uint32_t low = modb_get_u32(args);
+                uint32_t high = query_type == CS_QUERY_FILTER_EQUAL ? low : modb_get_u32(&args[4]);
+
+                /* Bounds past what the element type holds are clamped. */
+                const uint32_t type_max = (T) ~0u;
+                size_t found = 0;
+
+                query_matches.resize(stream.size());
+                if(low <= high && low <= type_max)
+                    found = stream_filter_range(kernels, stream.data(), stream.size(), (T) low, (T) (high > type_max ? type_max : high), query_matches.data());
+
+                response.resize(at + 4 + found * 4);
+                modb_put_u32(&response[at], (uint32_t) found);
+                for(size_t i = 0; i < found; i++) modb_put_u32(&response[at + 4 + i * 4], query_matches[i]);
+                break;
+            }
+            default: {
+                response.resize(at + stream.size() * sizeof(T));
+                if(stream.empty()) break;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                memcpy(&response[at], stream.data(), stream.size() * sizeof(T));
+#else
+                query_swapped.resize(stream.size());
+                stream_bswap(kernels, stream.data(), stream.size(), (T *) query_swapped.data());
+                memcpy(&response[at], query_swapped.data(), stream.size() * sizeof(T));
+#endif
+                break;
+            }
+        }
+    }
+
+    /* Request handlers for `perform`; each gets the entry ID plus the whole payload and decodes its own layout. */
+    typedef unsigned char (*RequestHandler)(StorageEngine &, uint32_t, const unsigned char *, uint32_t, std::vector<unsigned char> &);
+
+    static unsigned char request_create_entry(StorageEngine &engine, uint32_t entry_id, const unsigned char *, uint32_t payload_size, std::vector<unsigned char> &)
+    {
+        return payload_size == 4 ? engine.create_entry(entry_id) : SS_RESPONSE_BAD_REQUEST;
+    }
+
+    static unsigned char request_delete_entry(StorageEngine &engine, uint32_t entry_id, const unsigned char *, uint32_t payload_size, std::vector<unsigned char> &)
+    {
+        return payload_size == 4 ? engine.delete_entry(entry_id) : SS_RESPONSE_BAD_REQUEST;
+    }
+
+    static unsigned char request_create_pod(StorageEngine &engine, uint32_t entry_id, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &)
+    {
+        if(payload_size < 6 || payload_size != 6u + payload[5]) return SS_RESPONSE_BAD_REQUEST;
+        return engine.create_pod(entry_id, payload[4], &payload[6], payload[5]);
+    }
+
+    /* The remaining requests all start with [4: entry ID][1: name length][name]; `rest` is what follows the name. */
+    static bool named_payload(const unsigned char *payload, uint32_t payload_size, uint32_t &rest)
+    {
+        if(payload_size < 5 || payload_size < 5u + payload[4]) return false;
+
+        rest = payload_size - 5 - payload[4];
+        return true;
+    }
+
+    static unsigned char request_delete_pod(StorageEngine &engine, uint32_t entry_id, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &)
+    {
+        uint32_t rest;
+        if(!named_payload(payload, payload_size, rest) || rest != 0) return SS_RESPONSE_BAD_REQUEST;
+        return engine.delete_pod(entry_id, &payload[5], payload[4]);
+    }
+
+    static unsigned char request_store(StorageEngine &engine, uint32_t entry_id, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &)
+    {
+        uint32_t rest;
+        if(!named_payload(payload, payload_size, rest) || rest < 1) return SS_RESPONSE_BAD_REQUEST;
+
+        const unsigned char *after = &payload[5 + payload[4]];
+        return engine.store(entry_id, &payload[5], payload[4], after[0], &after[1], rest - 1);
+    }
+
+    static unsigned char request_read(StorageEngine &engine, uint32_t entry_id, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        uint32_t rest;
+        if(!named_payload(payload, payload_size, rest) || rest != 0) return SS_RESPONSE_BAD_REQUEST;
+        return engine.read(entry_id, &payload[5], payload[4], response);
+    }
+
+    static unsigned char request_query(StorageEngine &engine, uint32_t entry_id, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        uint32_t rest;
+        if(!named_payload(payload, payload_size, rest) || rest < 1) return SS_RESPONSE_BAD_REQUEST;
+
+        const unsigned char *after = &payload[5 + payload[4]];
+        return engine.query(entry_id, &payload[5], payload[4], after[0], &after[1], rest - 1, response);
+    }
+
+    /* The index requests start with [1: name length][name] instead; `rest` is again what follows the name. */
+    static bool index_payload(const unsigned char *payload, uint32_t payload_size, uint32_t &rest)
+    {
+        if(payload_size < 1 || payload_size < 1u + payload[0]) return false;
+
+        rest = payload_size - 1 - payload[0];
+        return true;
+    }
+
+    static unsigned char request_create_index(StorageEngine &engine, uint32_t, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &)
+    {
+        uint32_t rest;
+        if(payload_size < 1 || !index_payload(&payload[1], payload_size - 1, rest) || rest != 0) return SS_RESPONSE_BAD_REQUEST;
+        return engine.create_index(payload[0], &payload[2], payload[1]);
+    }
+
+    static unsigned char request_drop_index(StorageEngine &engine, uint32_t, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &)
+    {
+        uint32_t rest;
+        if(!index_payload(payload, payload_size, rest) || rest != 0) return SS_RESPONSE_BAD_REQUEST;
+        return engine.drop_index(&payload[1], payload[0]);
+    }
+
+    static unsigned char request_stream(StorageEngine &engine, uint32_t entry_id, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        uint32_t rest;
+        if(!named_payload(payload, payload_size, rest) || rest < 1) return SS_RESPONSE_BAD_REQUEST;
+
+        const unsigned char *after = &payload[5 + payload[4]];
+        return engine.stream(entry_id, &payload[5], payload[4], after[0], &after[1], rest - 1, response);
+    }
+
+    static unsigned char request_lookup(StorageEngine &engine, uint32_t, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        uint32_t rest;
+        if(!index_payload(payload, payload_size, rest) || rest < 1) return SS_RESPONSE_BAD_REQUEST;
+
+        const unsigned char *after = &payload[1 + payload[0]];
+        return engine.lookup(&payload[1], payload[0], after[0], &after[1], rest - 1, response);
+    }
+
+    /* Handlers indexed by `opcode - CS_REQUEST_CREATE_NEW_DB_ENTRY`; `CS_REQUEST_BATCH` is unpacked before it gets here. */
+    static constexpr RequestHandler request_table[ENGINE_REQUEST_COUNT] = {
+        request_create_entry, request_delete_entry, request_create_pod,
+        request_delete_pod, request_store, request_read,
+        nullptr, request_query, request_create_index,
+        request_drop_index, request_lookup, nullptr,
+        nullptr, nullptr, nullptr,
+        request_stream
+    };
+
+public:
+    /*
+     * create_entry - create a new, empty DB entry.
+     *  returns: `SS_RESPONSE_OK`, or `SS_RESPONSE_ENTRY_EXISTS`
+     *  on error: this function does not error
+     * */
+    unsigned char create_entry(uint32_t entry_id)
+    {
+        if(!entries.emplace(entry_id, _DBEntry()).second) return SS_RESPONSE_ENTRY_EXISTS;
+
+        versions.put(entry_id, std::string_view(), false, nullptr, 0);
+        count_live(ENGINE_SNAPSHOT_ENTRY_SIZE);
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * delete_entry - delete a DB entry along with all of its PODs.
+     *  returns: `SS_RESPONSE_OK`, or `SS_RESPONSE_NO_SUCH_ENTRY`
+     *  on error: this function does not error
+     * */
+    unsigned char delete_entry(uint32_t entry_id)
+    {
+        auto entry = entries.find(entry_id);
+        if(entry == entries.end()) return SS_RESPONSE_NO_SUCH_ENTRY;
+
+        int64_t freed = ENGINE_SNAPSHOT_ENTRY_SIZE;
+        for(auto &pod: entry->second.pods)
+        {
+            if(!indexes.empty()) unindex(entry_id, pod.first);
+
+            freed += pod_live_size(pod.first.size(), pod.second);
+            detach_blob(pod.second);
+            unstage_blob(pod.second);
+            columns.release(pod.second);
+            versions.put(entry_id, pod.first, true, nullptr, 0);
+        }
+
+        entries.erase(entry);
+        versions.put(entry_id, std::string_view(), true, nullptr, 0);
+        count_live(-freed);
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * create_pod - add a POD named `name` of type `pod_type` (`CS_CREATING_POD_WITH_TYPE_*`) to an entry.
+     *  returns: `SS_RESPONSE_OK`, or the `SS_RESPONSE_*` code saying why it could not be created
+     *  on error: this function does not error
+     * */
+    unsigned char create_pod(uint32_t entry_id, unsigned char pod_type, const unsigned char *name, unsigned char name_size)
+    {
+        if(pod_type < CS_CREATING_POD_WITH_TYPE_SBYTE || pod_type > CS_CREATING_POD_WITH_TYPE_DWORD_STREAM || name_size == 0)
+            return SS_RESPONSE_BAD_REQUEST;
+
+        auto entry = entries.find(entry_id);
+        if(entry == entries.end()) return SS_RESPONSE_NO_SUCH_ENTRY;
+
+        auto created = entry->second.pods.emplace(std::string(NCC_PTR name, name_size), _PodSlot());
+        if(!created.second) return SS_RESPONSE_POD_EXISTS;
+
+        unsigned char column = pod_column_from_create(pod_type);
+        created.first->second.column = column;
+        created.first->second.slot = columns.allocate(column);
+        count_live(pod_live_size(name_size, created.first->second));
+        put_version(entry_id, created.first->first, created.first->second);
+
+        /* New PODs hold 0 until stored into, and are found by it like any other value. */
+        if(!indexes.empty()) reindex(entry_id, created.first->first, created.first->second);
+
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * delete_pod - remove the POD `name` from an entry.
+     *  returns: `SS_RESPONSE_OK`, or the `SS_RESPONSE_*` code saying why it could not be removed
+     *  on error: this function does not error
+     * */
+    unsigned char delete_pod(uint32_t entry_id, const unsigned char *name, unsigned char name_size)
+    {
+        auto entry = entries.find(entry_id);
+        if(entry == entries.end()) return SS_RESPONSE_NO_SUCH_ENTRY;
+
+        pod_key.assign(NCC_PTR name, name_size);
+        auto pod = entry->second.pods.find(pod_key);
+        if(pod == entry->second.pods.end()) return SS_RESPONSE_NO_SUCH_POD;
+
+        if(!indexes.empty()) unindex(entry_id, pod_key);
+
+        count_live(-pod_live_size(name_size, pod->second));
+        detach_blob(pod->second);
+        unstage_blob(pod->second);
+        columns.release(pod->second);
+        entry->second.pods.erase(pod);
+        versions.put(entry_id, pod_key, true, nullptr, 0);
+
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * store - assign `value` (encoded as described at the top of this file) to the POD `name`.
+     *  returns: `SS_RESPONSE_OK`, or the `SS_RESPONSE_*` code saying why it could not be stored
+     *  on error: this function does not error
+     * */
+    unsigned char store(uint32_t entry_id, const unsigned char *name, unsigned char name_size,
+                        unsigned char store_type, const unsigned char *value, uint32_t value_size)
+    {
+        if(store_type == CS_STORING_ENCODED)
+        {
+            /* Checked before anything is allocated, so a small frame cannot ask for a value no frame could hold. */
+            if(pod_codec_value_size(value, value_size) > POD_CODEC_MAX_VALUE) return SS_RESPONSE_TOO_LARGE;
+
+            store_type = pod_codec_decode(value, value_size, codec_value);
+            if(store_type == 0) return SS_RESPONSE_BAD_REQUEST;
+
+            value = codec_value.data();
+            value_size = (uint32_t) codec_value.size();
+        }
+
+        if(store_type < CS_STORING_SBYTE || store_type > CS_STORING_DWORD_STREAM)
+            return SS_RESPONSE_BAD_REQUEST;
+
+        unsigned char response;
+        _PodSlot *pod = find_pod(entry_id, name, name_size, response);
+        if(!pod) return response;
+
+        if(pod->column != pod_column_from_store(store_type)) return SS_RESPONSE_TYPE_MISMATCH;
+
+        /* A value in the blob file is replaced by the one stored; one being streamed in can still be committed over it. */
+        if(pod->column == POD_COLUMN_BYTE_STREAM) detach_blob(*pod);
+
+        /* Only streams change size. */
+        uint32_t old_size = columns.encoded_size(*pod);
+
+        response = columns.store(*pod, value, value_size);
+        if(response != SS_RESPONSE_OK) return response;
+
+        if(value_size != old_size) count_live((int64_t) value_size - old_size);
+        if(!indexes.empty()) reindex(entry_id, pod_key, *pod);
+        put_version(entry_id, pod_key, *pod);
+
+        return response;
+    }
+
+    /*
+     * read - append the type (`CS_STORING_*`) and value of the POD `name` to `response`.
+     *  returns: `SS_RESPONSE_OK`, or the `SS_RESPONSE_*` code saying why it could not be read
+     *  on error: this function does not error
+     * */
+    unsigned char read(uint32_t entry_id, const unsigned char *name, unsigned char name_size, std::vector<unsigned char> &response)
+    {
+        unsigned char result;
+        _PodSlot *pod = find_pod(entry_id, name, name_size, result);
+        if(!pod) return result;
+        if(blob_of(*pod)) return SS_RESPONSE_USE_STREAM;
+
+        columns.read(*pod, response);
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * query - run a `CS_QUERY_*` kernel over the WORD/DWORD stream POD `name`, appending its result to `response`.
+     *  returns: `SS_RESPONSE_OK`, or the `SS_RESPONSE_*` code saying why it could not be queried
+     *  on error: this function does not error
+     * */
+    unsigned char query(uint32_t entry_id, const unsigned char *name, unsigned char name_size,
+                        unsigned char query_type, const unsigned char *args, uint32_t args_size, std::vector<unsigned char> &response)
+    {
+        uint32_t args_needed = query_type == CS_QUERY_FILTER_EQUAL ? 4 : query_type == CS_QUERY_FILTER_RANGE ? 8 : 0;
+        if(query_type < CS_QUERY_SUM || query_type > CS_QUERY_BIG_ENDIAN || args_size != args_needed)
+            return SS_RESPONSE_BAD_REQUEST;
+
+        unsigned char result;
+        _PodSlot *pod = find_pod(entry_id, name, name_size, result);
+        if(!pod) return result;
+
+        if(pod->column == POD_COLUMN_WORD_STREAM)
+            query_stream(columns.column<PodWordStream>()[pod->slot], query_type, args, response);
+        else if(pod->column == POD_COLUMN_DWORD_STREAM)
+            query_stream(columns.column<PodDWordStream>()[pod->slot], query_type, args, response);
+        else
+            return SS_RESPONSE_TYPE_MISMATCH;
+
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * stream - perform the `CS_STREAM_*` `stream_type` with `args` on the BYTE_STREAM POD `name` (see `pod_blobs.hpp`).
+     *  returns: `SS_RESPONSE_OK`, or the `SS_RESPONSE_*` code saying why it could not be performed; a chunk read is
+     *           appended to `response`, unless it is in the blob file and a region to send it from was asked for
+     *  on error: this function does not error
+     * */
+    unsigned char stream(uint32_t entry_id, const unsigned char *name, unsigned char name_size,
+                         unsigned char stream_type, const unsigned char *args, uint32_t args_size, std::vector<unsigned char> &response)
+    {
+        blob_record.clear();
+
+        unsigned char result;
+        _PodSlot *pod = find_pod(entry_id, name, name_size, result);
+        if(!pod) return result;
+        if(pod->column != POD_COLUMN_BYTE_STREAM) return SS_RESPONSE_TYPE_MISMATCH;
+
+        _PodBlobExtent *kept = blob_of(*pod);
+        PodByteStream::slot_type &value = columns.column<PodByteStream>()[pod->slot];
+
+        switch(stream_type)
+        {
+            case CS_STREAM_INFO: {
+                if(args_size != 0) return SS_RESPONSE_BAD_REQUEST;
+
+                size_t at = response.size();
+                response.resize(at + 8);
+                modb_put_u64(&response[at], kept ? kept->size : value.size());
+                return SS_RESPONSE_OK;
+            }
+            case CS_STREAM_READ: {
+                if(args_size != 12) return SS_RESPONSE_BAD_REQUEST;
+
+                uint64_t offset = modb_get_u64(args), size = kept ? kept->size : value.size();
+                if(offset > size) return SS_RESPONSE_BAD_REQUEST;
+
+                uint32_t length = (uint32_t) std::min<uint64_t>({modb_get_u32(&args[8]), size - offset, POD_BLOB_CHUNK_MAX});
+                if(!kept)
+                {
+                    response.insert(response.end(), value.begin() + offset, value.begin() + offset + length);
+                    return SS_RESPONSE_OK;
+                }
+
+                /* Sent from the file by the transport; the extent stays put until it is. */
+                if(send_region)
+                {
+                    send_region->fd = blobs->descriptor();
+                    send_region->offset = kept->offset + offset;
+                    send_region->size = length;
+                    send_region->extent = kept->offset;
+                    blobs->pin(kept->offset);
+                    return SS_RESPONSE_OK;
+                }
+
+                size_t at = response.size();
+                response.resize(at + length);
+                if(blobs->read(*kept, offset, &response[at], length)) return SS_RESPONSE_OK;
+
+                response.resize(at);
+                return SS_RESPONSE_IO_ERROR;
+            }
+            case CS_STREAM_BEGIN: {
+                if(args_size != 8) return SS_RESPONSE_BAD_REQUEST;
+                if(!blobs) return SS_RESPONSE_NOT_SUPPORTED;
+
+                /* Starting over drops what was streamed in so far. */
+                unstage_blob(*pod);
+
+                /* The size is the client's; one past the cap would wrap when aligned and stage an extent it cannot hold. */
+                uint64_t size = modb_get_u64(args);
+                if(size > POD_BLOB_MAX_SIZE) return SS_RESPONSE_TOO_LARGE;
+
+                _PodBlobExtent extent;
+                if(!blobs->allocate(size, extent)) return SS_RESPONSE_IO_ERROR;
+
+                blob_staged[pod->slot] = extent;
+                return SS_RESPONSE_OK;
+            }
+            case CS_STREAM_WRITE: {
+                auto staged = blob_staged.find(pod->slot);
+                if(args_size < 8 || staged == blob_staged.end()) return SS_RESPONSE_BAD_REQUEST;
+
+                uint64_t offset = modb_get_u64(args);
+                if(offset > staged->second.size || args_size - 8 > staged->second.size - offset) return SS_RESPONSE_BAD_REQUEST;
+
+                return blobs->write(staged->second, offset, &args[8], args_size - 8) ? SS_RESPONSE_OK : SS_RESPONSE_IO_ERROR;
+            }
+            case CS_STREAM_COMMIT: {
+                auto staged = blob_staged.find(pod->slot);
+                if(args_size != 0 || staged == blob_staged.end()) return SS_RESPONSE_BAD_REQUEST;
+
+                /* The value is durable before the log says it is the POD's. */
+                if(!blobs->sync()) return SS_RESPONSE_IO_ERROR;
+
+                _PodBlobExtent extent = staged->second;
+                blob_staged.erase(staged);
+                attach_blob(entry_id, pod_key, *pod, extent);
+
+                /* [4: entry ID][1: name length][name][1: CS_STREAM_ATTACH][8: offset][8: capacity][8: size] */
+                blob_record.resize(5 + name_size + 25);
+                modb_put_u32(blob_record.data(), entry_id);
+                blob_record[4] = name_size;
+                memcpy(&blob_record[5], name, name_size);
+                blob_record[5 + name_size] = CS_STREAM_ATTACH;
+                modb_put_u64(&blob_record[6 + name_size], extent.offset);
+                modb_put_u64(&blob_record[14 + name_size], extent.capacity);
+                modb_put_u64(&blob_record[22 + name_size], extent.size);
+                return SS_RESPONSE_OK;
+            }
+            case CS_STREAM_ATTACH: {
+                /* Only the write-ahead log names extents, and only while it is replayed. */
+                if(args_size != 24 || !blobs || !blobs->is_recovering()) return SS_RESPONSE_BAD_REQUEST;
+
+                _PodBlobExtent extent;
+                extent.offset = modb_get_u64(args);
+                extent.capacity = modb_get_u64(&args[8]);
+                extent.size = modb_get_u64(&args[16]);
+                if(!blobs->claim(extent)) return SS_RESPONSE_IO_ERROR;
+
+                attach_blob(entry_id, pod_key, *pod, extent);
+                return SS_RESPONSE_OK;
+            }
+            default: break;
+        }
+
+        return SS_RESPONSE_BAD_REQUEST;
+    }
+
+    /*
+     * create_index - index the POD `name` of every entry, with a `CS_INDEX_*` index of kind `index_kind`.
+     *  returns: `SS_RESPONSE_OK`, `SS_RESPONSE_INDEX_EXISTS`, or `SS_RESPONSE_BAD_REQUEST`
+     *  on error: this function does not error
+     * */
+    unsigned char create_index(unsigned char index_kind, const unsigned char *name, unsigned char name_size)
+    {
+        if((index_kind != CS_INDEX_HASH && index_kind != CS_INDEX_SORTED) || name_size == 0) return SS_RESPONSE_BAD_REQUEST;
+
+        auto created = indexes.emplace(std::string(NCC_PTR name, name_size), PodIndex(index_kind));
+        if(!created.second) return SS_RESPONSE_INDEX_EXISTS;
+
+        /* Entries that already hold the POD are filed now; from here on every change keeps the index up to date. */
+        for(auto &entry: entries)
+        {
+            auto pod = entry.second.pods.find(created.first->first);
+            uint32_t value;
+
+            if(pod != entry.second.pods.end() && columns.single_value(pod->second, value))
+                created.first->second.put(entry.first, value);
+        }
+
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * drop_index - remove the index on the POD `name`.
+     *  returns: `SS_RESPONSE_OK`, or `SS_RESPONSE_NO_SUCH_INDEX`
+     *  on error: this function does not error
+     * */
+    unsigned char drop_index(const unsigned char *name, unsigned char name_size)
+    {
+        pod_key.assign(NCC_PTR name, name_size);
+        return indexes.erase(pod_key) ? SS_RESPONSE_OK : SS_RESPONSE_NO_SUCH_INDEX;
+    }
+
+    /*
+     * lookup - append [4: count][4: entry ID]... for every entry whose SBYTE/SWORD/SDWORD POD `name` matches
+     *          `lookup_type` (`CS_QUERY_FILTER_EQUAL` or `CS_QUERY_FILTER_RANGE`) with `args` to `response`.
+     *  returns: `SS_RESPONSE_OK`, or `SS_RESPONSE_BAD_REQUEST`
+     *  on error: this function does not error
+     *
+     *  Note: without an index on `name` every entry is looked at.
+     * */
+    unsigned char lookup(const unsigned char *name, unsigned char name_size, unsigned char lookup_type,
+                         const unsigned char *args, uint32_t args_size, std::vector<unsigned char> &response)
+    {
+        if(!((lookup_type == CS_QUERY_FILTER_EQUAL && args_size == 4) || (lookup_type == CS_QUERY_FILTER_RANGE && args_size == 8)))
+            return SS_RESPONSE_BAD_REQUEST;
+
+        uint32_t low = modb_get_u32(args);
+        uint32_t high = lookup_type == CS_QUERY_FILTER_EQUAL ? low : modb_get_u32(&args[4]);
+
+        size_t at = response.size();
+        response.resize(at + 4);
+
+        pod_key.assign(NCC_PTR name, name_size);
+        uint32_t found = 0;
+
+        auto index = indexes.find(pod_key);
+        if(index != indexes.end())
+            found = index->second.lookup(low, high, response);
+        else if(low <= high)
+        {
+            for(auto &entry: entries)
+            {
+                auto pod = entry.second.pods.find(pod_key);
+                uint32_t value;
+
+                if(pod == entry.second.pods.end() || !columns.single_value(pod->second, value) || value < low || value > high) continue;
+
+                size_t id_at = response.size();
+                response.resize(id_at + 4);
+                modb_put_u32(&response[id_at], entry.first);
+                found++;
+            }
+        }
+
+        modb_put_u32(&response[at], found);
+        return SS_RESPONSE_OK;
+    }
+
+    /*
+     * merge_results - fold the result of a request every shard performs (see `cs_request_is_broadcast`), appended
+     *                 to `response` at `at`, into the result of the shards before it at `first`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    static void merge_results(unsigned char opcode, std::vector<unsigned char> &response, size_t first, size_t at)
+    {
+        if(opcode != CS_REQUEST_LOOKUP_POD || at == first || response.size() < at + 4) return;
+
+        modb_put_u32(&response[first], modb_get_u32(&response[first]) + modb_get_u32(&response[at]));
+        response.erase(response.begin() + at, response.begin() + at + 4);
+    }
+
+    /*
+     * perform - decode a `CS_REQUEST_*` payload and run it against the engine.
+     *  returns: a `SS_RESPONSE_*` code, any result is appended to `response`
+     *  on error: this function does not error; malformed payloads return `SS_RESPONSE_BAD_REQUEST`
+     * */
+    unsigned char perform(unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        unsigned char index = opcode - CS_REQUEST_CREATE_NEW_DB_ENTRY;
+        if(index >= ENGINE_REQUEST_COUNT || !request_table[index]) return SS_RESPONSE_UNKNOWN_REQUEST;
+
+        /* Each handler checks the payload is long enough for its layout. */
+        return request_table[index](*this, payload_size >= 4 ? modb_get_u32(payload) : 0, payload, payload_size, response);
+    }
+
+    /*
+     * snapshot - append `WAL_RECORD_ENGINE_OP` records that recreate every entry and POD of the engine to `out`.
+     *  returns: nothing
+     *  on error: this function does not error
+     *
+     *  Note: indexes are left out, they are declared in the `.idx` file and filled in as the records are replayed.
+     * */
+    void snapshot(std::vector<unsigned char> &out)
+    {
+        out.reserve(out.size() + live_bytes.load(std::memory_order_relaxed));
+
+        unsigned char opcode, entry_id[4];
+        for(auto &entry: entries)
+        {
+            modb_put_u32(entry_id, entry.first);
+
+            opcode = CS_REQUEST_CREATE_NEW_DB_ENTRY;
+            WriteAheadLog::encode_record(out, WAL_RECORD_ENGINE_OP, &opcode, 1, entry_id, 4);
+
+            for(auto &pod: entry.second.pods)
+            {
+                /* [4: entry ID][1: CS_CREATING_POD_WITH_TYPE_*][1: name length][name] */
+                snapshot_payload.assign(entry_id, entry_id + 4);
+                snapshot_payload.push_back(CS_CREATING_POD_WITH_TYPE_SBYTE + pod.second.column);
+                snapshot_payload.push_back((unsigned char) pod.first.size());
+                snapshot_payload.insert(snapshot_payload.end(), pod.first.begin(), pod.first.end());
+
+                opcode = CS_REQUEST_CREATE_NEW_POD;
+                WriteAheadLog::encode_record(out, WAL_RECORD_ENGINE_OP, &opcode, 1, snapshot_payload.data(), (uint32_t) snapshot_payload.size());
+
+                /* [4: entry ID][1: name length][name][1: CS_STORING_*][value], or the extent of a value in the blob file. */
+                snapshot_payload.erase(snapshot_payload.begin() + 4);
+
+                _PodBlobExtent *kept = blob_of(pod.second);
+                if(kept)
+                {
+                    size_t at = snapshot_payload.size();
+                    snapshot_payload.resize(at + 25);
+                    snapshot_payload[at] = CS_STREAM_ATTACH;
+                    modb_put_u64(&snapshot_payload[at + 1], kept->offset);
+                    modb_put_u64(&snapshot_payload[at + 9], kept->capacity);
+                    modb_put_u64(&snapshot_payload[at + 17], kept->size);
+                }
+                else
+                    columns.read(pod.second, snapshot_payload);
+
+                const std::vector<unsigned char> *record = kept ? nullptr : encode_store(snapshot_payload.data(), (uint32_t) snapshot_payload.size());
+                if(!record) record = &snapshot_payload;
+
+                opcode = kept ? CS_REQUEST_STREAM_POD : CS_REQUEST_TO_STORE_IN;
+                WriteAheadLog::encode_record(out, WAL_RECORD_ENGINE_OP, &opcode, 1, record->data(), (uint32_t) record->size());
+            }
+        }
+    }
+
+    /*
+     * set_codecs - persist stream values with the codecs `policy` picks from now on (see `pod_codecs.hpp`).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_codecs(const _PodCodecPolicy &policy) { codecs = policy; }
+
+    /*
+     * encode_store - the `CS_REQUEST_TO_STORE_IN` payload to log in place of `payload`, its stream value encoded.
+     *  returns: the payload, valid until the next call, or nullptr if `payload` is to be logged as it is
+     *  on error: this function does not error; a malformed payload is logged as it is
+     * */
+    const std::vector<unsigned char> *encode_store(const unsigned char *payload, uint32_t payload_size)
+    {
+        uint32_t rest;
+        if(!named_payload(payload, payload_size, rest) || rest < 1 + POD_CODEC_MIN_SIZE) return nullptr;
+
+        uint32_t header = 5 + payload[4];
+        unsigned char store_type = payload[header];
+        unsigned char codec = pod_codec_choose(codecs, store_type, &payload[header + 1], rest - 1, codec_sample);
+        if(codec == POD_CODEC_NONE) return nullptr;
+
+        codec_payload.assign(payload, payload + header);
+        if(!pod_codec_encode(codec, store_type, &payload[header + 1], rest - 1, codec_payload)) return nullptr;
+        return &codec_payload;
+    }
+
+    /*
+     * keep_versions - keep a version of every entry and POD from now on, for `read_published`; call before anything is created.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void keep_versions(ModbEpochs &epochs) { versions.keep(epochs); }
+
+    /*
+     * publish_versions - let `read_published` see the changes made so far; call once they are logged.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void publish_versions() { versions.publish(); }
+
+    void reclaim_versions() { versions.reclaim(); }
+
+    /*
+     * retire_blobs - retire the extents the last request detached (see `PodBlobFile::retire`); call once it is logged,
+     *                so they cannot be freed by a commit the change missed.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void retire_blobs()
+    {
+        if(blob_detached.empty()) return;
+
+        for(const _PodBlobExtent &extent: blob_detached) blobs->retire(extent);
+        blob_detached.clear();
+    }
+
+    /*
+     * keep_blobs - keep values committed through `CS_REQUEST_STREAM_POD` in `file`; call before the log is replayed.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void keep_blobs(PodBlobFile &file) { blobs = &file; }
+
+    /*
+     * send_blobs_to - have `CS_STREAM_READ`s of values in the blob file fill in `region` (pinning its extent) rather
+     *                 than copy the chunk into the response; nullptr copies again.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void send_blobs_to(_PodBlobRegion *region) { send_region = region; }
+
+    /*
+     * stream_record - what to log for the last `CS_REQUEST_STREAM_POD`: the `CS_STREAM_ATTACH` of a commit, empty otherwise.
+     *  returns: the payload of the record
+     *  on error: this function does not error
+     * */
+    const std::vector<unsigned char> &stream_record() { return blob_record; }
+
+    /*
+     * read_published - perform a `CS_REQUEST_READ_POD` against the versions published last, not the engine itself.
+     *  returns: a `SS_RESPONSE_*` code, the type and value are appended to `response`
+     *  on error: this function does not error; malformed payloads return `SS_RESPONSE_BAD_REQUEST`
+     *
+     *  Note: safe from any thread while the owning thread makes changes, as long as an epoch is pinned (see `ModbEpochPin`).
+     * */
+    unsigned char read_published(const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        uint32_t rest;
+        if(!named_payload(payload, payload_size, rest) || rest != 0) return SS_RESPONSE_BAD_REQUEST;
+
+        size_t at = response.size();
+        unsigned char result = versions.read(modb_get_u32(payload), std::string_view(NCC_PTR &payload[5], payload[4]), response);
+
+        if(result == SS_RESPONSE_OK && response.size() == at + 1 && response[at] == POD_BLOB_VERSION)
+        {
+            response.resize(at);
+            return SS_RESPONSE_USE_STREAM;
+        }
+        return result;
+    }
+
+    /*
+     * entry_count - how many DB entries exist.
+     *  returns: number of entries
+     *  on error: this function does not error
+     * */
+    size_t entry_count() { return entries.size(); }
+
+    /*
+     * live_size - how many bytes `snapshot` would write; safe to call from any thread.
+     *  returns: the size
+     *  on error: this function does not error
+     * */
+    uint64_t live_size() { return live_bytes.load(std::memory_order_relaxed); }
+};
+
+#endif
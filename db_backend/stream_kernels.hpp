@@ -0,0 +1,484 @@
+#ifndef stream_kernels
+#define stream_kernels
+
+/* Bulk kernels over WORD/DWORD stream PODs: sum, min/max, range filtering (equality is a range of one value)
+ * and byte swapping.
+ *
+ * Every kernel has a scalar version plus SSE4.1 and AVX2 versions on x86. The widest version the CPU supports
+ * is picked once at runtime, so a binary built for a generic x86-64 target still uses AVX2 where it can.
+ * All values are unsigned.
+ * */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MODB_STREAM_KERNELS_X86
+#endif
+
+#define STREAM_KERNELS_SCALAR       0
+#define STREAM_KERNELS_SSE4         1
+#define STREAM_KERNELS_AVX2         2
+
+typedef struct StreamKernels
+{
+    const char  *name;
+
+    uint64_t    (*sum_u16)(const uint16_t *, size_t);
+    uint64_t    (*sum_u32)(const uint32_t *, size_t);
+
+    /* `min`/`max` are left alone for an empty stream. */
+    void        (*min_max_u16)(const uint16_t *, size_t, uint16_t &, uint16_t &);
+    void        (*min_max_u32)(const uint32_t *, size_t, uint32_t &, uint32_t &);
+
+    /* Writes the index of every value in [low, high] to `matches` (room for `size` indexes), returns how many matched. */
+    size_t      (*filter_range_u16)(const uint16_t *, size_t, uint16_t, uint16_t, uint32_t *);
+    size_t      (*filter_range_u32)(const uint32_t *, size_t, uint32_t, uint32_t, uint32_t *);
+
+    /* Reverses the byte order of every value into `out` (which may be the input). */
+    void        (*bswap_u16)(const uint16_t *, size_t, uint16_t *);
+    void        (*bswap_u32)(const uint32_t *, size_t, uint32_t *);
+} _StreamKernels;
+
+/* Scalar versions; also finish the tail the vector versions leave over. */
+template<typename T>
+inline uint64_t stream_sum_scalar(const T *values, size_t size)
+{
+    uint64_t sum = 0;
+    for(size_t i = 0; i < size; i++) sum += values[i];
+    return sum;
+}
+
+template<typename T>
+inline void stream_min_max_scalar(const T *values, size_t size, T &min, T &max)
+{
+    for(size_t i = 0; i < size; i++)
+    {
+        if(values[i] < min) min = values[i];
+        if(values[i] > max) max = values[i];
+    }
+}
+
+template<typename T>
+inline size_t stream_filter_range_scalar(const T *values, size_t size, T low, T high, uint32_t *matches, size_t base = 0)
+{
+    size_t found = 0;
+    for(size_t i = 0; i < size; i++)
+        if(values[i] >= low && values[i] <= high) matches[found++] = (uint32_t) (base + i);
+    return found;
+}
+
+inline void stream_bswap_scalar_u16(const uint16_t *values, size_t size, uint16_t *out)
+{
+    for(size_t i = 0; i < size; i++) out[i] = (uint16_t) ((values[i] >> 8) | (values[i] << 8));
+}
+
+inline void stream_bswap_scalar_u32(const uint32_t *values, size_t size, uint32_t *out)
+{
+    for(size_t i = 0; i < size; i++)
+        out[i] = (values[i] >> 24) | ((values[i] >> 8) & 0xFF00) | ((values[i] << 8) & 0xFF0000) | (values[i] << 24);
+}
+
+inline uint64_t stream_sum_scalar_u16(const uint16_t *values, size_t size) { return stream_sum_scalar(values, size); }
+inline uint64_t stream_sum_scalar_u32(const uint32_t *values, size_t size) { return stream_sum_scalar(values, size); }
+
+inline void stream_min_max_scalar_u16(const uint16_t *values, size_t size, uint16_t &min, uint16_t &max) { stream_min_max_scalar(values, size, min, max); }
+inline void stream_min_max_scalar_u32(const uint32_t *values, size_t size, uint32_t &min, uint32_t &max) { stream_min_max_scalar(values, size, min, max); }
+
+inline size_t stream_filter_range_scalar_u16(const uint16_t *values, size_t size, uint16_t low, uint16_t high, uint32_t *matches)
+{
+    return stream_filter_range_scalar(values, size, low, high, matches);
+}
+
+inline size_t stream_filter_range_scalar_u32(const uint32_t *values, size_t size, uint32_t low, uint32_t high, uint32_t *matches)
+{
+    return stream_filter_range_scalar(values, size, low, high, matches);
+}
+
+/*
+ * stream_push_matches - append the index of every set bit in `mask` to `matches`, one bit per `lane_bytes` bytes.
+ *  returns: new number of matches
+ *  on error: this function does not error
+ * */
+inline size_t stream_push_matches(uint32_t mask, unsigned lane_bytes, size_t base, uint32_t *matches, size_t found)
+{
+    while(mask)
+    {
+        unsigned bit = __builtin_ctz(mask);
+        matches[found++] = (uint32_t) (base + bit / lane_bytes);
+
+        /* Clear every bit of that lane. */
+        mask &= ~(((1u << lane_bytes) - 1) << (bit - bit % lane_bytes));
+    }
+    return found;
+}
+
+#ifdef MODB_STREAM_KERNELS_X86
+
+/* ---------- SSE4.1 ---------- */
+
+__attribute__((target("sse4.1"))) inline uint64_t stream_sum_sse4_u16(const uint16_t *values, size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+
+    while(size - i >= 8)
+    {
+        /* 32-bit lanes take at most 2 * 65535 per step; flush to 64-bit before they can overflow. */
+        __m128i acc = _mm_setzero_si128();
+        for(size_t steps = 0; steps < 16384 && size - i >= 8; steps++, i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) &values[i]);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+        }
+        total = _mm_add_epi64(total, _mm_add_epi64(_mm_unpacklo_epi32(acc, zero), _mm_unpackhi_epi32(acc, zero)));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, total);
+    return lanes[0] + lanes[1] + stream_sum_scalar(&values[i], size - i);
+}
+
+__attribute__((target("sse4.1"))) inline uint64_t stream_sum_sse4_u32(const uint32_t *values, size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+
+    for(; size - i >= 4; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) &values[i]);
+        total = _mm_add_epi64(total, _mm_add_epi64(_mm_unpacklo_epi32(v, zero), _mm_unpackhi_epi32(v, zero)));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, total);
+    return lanes[0] + lanes[1] + stream_sum_scalar(&values[i], size - i);
+}
+
+__attribute__((target("sse4.1"))) inline void stream_min_max_sse4_u16(const uint16_t *values, size_t size, uint16_t &min, uint16_t &max)
+{
+    size_t i = 0;
+    if(size >= 8)
+    {
+        __m128i low = _mm_set1_epi16((short) min), high = _mm_set1_epi16((short) max);
+        for(; size - i >= 8; i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) &values[i]);
+            low = _mm_min_epu16(low, v);
+            high = _mm_max_epu16(high, v);
+        }
+
+        uint16_t lows[8], highs[8];
+        _mm_storeu_si128((__m128i *) lows, low);
+        _mm_storeu_si128((__m128i *) highs, high);
+        stream_min_max_scalar(lows, 8, min, max);
+        stream_min_max_scalar(highs, 8, min, max);
+    }
+    stream_min_max_scalar(&values[i], size - i, min, max);
+}
+
+__attribute__((target("sse4.1"))) inline void stream_min_max_sse4_u32(const uint32_t *values, size_t size, uint32_t &min, uint32_t &max)
+{
+    size_t i = 0;
+    if(size >= 4)
+    {
+        __m128i low = _mm_set1_epi32((int) min), high = _mm_set1_epi32((int) max);
+        for(; size - i >= 4; i += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) &values[i]);
+            low = _mm_min_epu32(low, v);
+            high = _mm_max_epu32(high, v);
+        }
+
+        uint32_t lows[4], highs[4];
+        _mm_storeu_si128((__m128i *) lows, low);
+        _mm_storeu_si128((__m128i *) highs, high);
+        stream_min_max_scalar(lows, 4, min, max);
+        stream_min_max_scalar(highs, 4, min, max);
+    }
+    stream_min_max_scalar(&values[i], size - i, min, max);
+}
+
+/* x in [low, high] is the same as (x - low) <= (high - low) unsigned, i.e. min(x - low, high - low) == x - low. */
+__attribute__((target("sse4.1"))) inline size_t stream_filter_range_sse4_u16(const uint16_t *values, size_t size, uint16_t low, uint16_t high, uint32_t *matches)
+{
+    if(low > high) return 0;
+
+    const __m128i base = _mm_set1_epi16((short) low), span = _mm_set1_epi16((short) (high - low));
+    size_t found = 0, i = 0;
+
+    for(; size - i >= 8; i += 8)
+    {
+        __m128i shifted = _mm_sub_epi16(_mm_loadu_si128((const __m128i *) &values[i]), base);
+        __m128i inside = _mm_cmpeq_epi16(_mm_min_epu16(shifted, span), shifted);
+        found = stream_push_matches((uint32_t) _mm_movemask_epi8(inside), 2, i, matches, found);
+    }
+
+    return found + stream_filter_range_scalar(&values[i], size - i, low, high, &matches[found], i);
+}
+
+__attribute__((target("sse4.1"))) inline size_t stream_filter_range_sse4_u32(const uint32_t *values, size_t size, uint32_t low, uint32_t high, uint32_t *matches)
+{
+    if(low > high) return 0;
+
+    const __m128i base = _mm_set1_epi32((int) low), span = _mm_set1_epi32((int) (high - low));
+    size_t found = 0, i = 0;
+
+    for(; size - i >= 4; i += 4)
+    {
+        __m128i shifted = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) &values[i]), base);
+        __m128i inside = _mm_cmpeq_epi32(_mm_min_epu32(shifted, span), shifted);
+        found = stream_push_matches((uint32_t) _mm_movemask_epi8(inside), 4, i, matches, found);
+    }
+
+    return found + stream_filter_range_scalar(&values[i], size - i, low, high, &matches[found], i);
+}
+
+__attribute__((target("sse4.1"))) inline void stream_bswap_sse4_u16(const uint16_t *values, size_t size, uint16_t *out)
+{
+    const __m128i order = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+
+    for(; size - i >= 8; i += 8)
+        _mm_storeu_si128((__m128i *) &out[i], _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) &values[i]), order));
+
+    stream_bswap_scalar_u16(&values[i], size - i, &out[i]);
+}
+
+__attribute__((target("sse4.1"))) inline void stream_bswap_sse4_u32(const uint32_t *values, size_t size, uint32_t *out)
+{
+    const __m128i order = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+
+    for(; size - i >= 4; i += 4)
+        _mm_storeu_si128((__m128i *) &out[i], _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) &values[i]), order));
+
+    stream_bswap_scalar_u32(&values[i], size - i, &out[i]);
+}
+
+/* ---------- AVX2 ---------- */
+
+__attribute__((target("avx2"))) inline uint64_t stream_sum_avx2_u16(const uint16_t *values, size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+
+    while(size - i >= 16)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        for(size_t steps = 0; steps < 16384 && size - i >= 16; steps++, i += 16)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *) &values[i]);
+            acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_unpacklo_epi16(v, zero), _mm256_unpackhi_epi16(v, zero)));
+        }
+        total = _mm256_add_epi64(total, _mm256_add_epi64(_mm256_unpacklo_epi32(acc, zero), _mm256_unpackhi_epi32(acc, zero)));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + stream_sum_scalar(&values[i], size - i);
+}
+
+__attribute__((target("avx2"))) inline uint64_t stream_sum_avx2_u32(const uint32_t *values, size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for(; size - i >= 8; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) &values[i]);
+        total = _mm256_add_epi64(total, _mm256_add_epi64(_mm256_unpacklo_epi32(v, zero), _mm256_unpackhi_epi32(v, zero)));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + stream_sum_scalar(&values[i], size - i);
+}
+
+__attribute__((target("avx2"))) inline void stream_min_max_avx2_u16(const uint16_t *values, size_t size, uint16_t &min, uint16_t &max)
+{
+    size_t i = 0;
+    if(size >= 16)
+    {
+        __m256i low = _mm256_set1_epi16((short) min), high = _mm256_set1_epi16((short) max);
+        for(; size - i >= 16; i += 16)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *) &values[i]);
+            low = _mm256_min_epu16(low, v);
+            high = _mm256_max_epu16(high, v);
+        }
+
+        uint16_t lows[16], highs[16];
+        _mm256_storeu_si256((__m256i *) lows, low);
+        _mm256_storeu_si256((__m256i *) highs, high);
+        stream_min_max_scalar(lows, 16, min, max);
+        stream_min_max_scalar(highs, 16, min, max);
+    }
+    stream_min_max_scalar(&values[i], size - i, min, max);
+}
+
+__attribute__((target("avx2"))) inline void stream_min_max_avx2_u32(const uint32_t *values, size_t size, uint32_t &min, uint32_t &max)
+{
+    size_t i = 0;
+    if(size >= 8)
+    {
+        __m256i low = _mm256_set1_epi32((int) min), high = _mm256_set1_epi32((int) max);
+        for(; size - i >= 8; i += 8)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *) &values[i]);
+            low = _mm256_min_epu32(low, v);
+            high = _mm256_max_epu32(high, v);
+        }
+
+        uint32_t lows[8], highs[8];
+        _mm256_storeu_si256((__m256i *) lows, low);
+        _mm256_storeu_si256((__m256i *) highs, high);
+        stream_min_max_scalar(lows, 8, min, max);
+        stream_min_max_scalar(highs, 8, min, max);
+    }
+    stream_min_max_scalar(&values[i], size - i, min, max);
+}
+
+__attribute__((target("avx2"))) inline size_t stream_filter_range_avx2_u16(const uint16_t *values, size_t size, uint16_t low, uint16_t high, uint32_t *matches)
+{
+    if(low > high) return 0;
+
+    const __m256i base = _mm256_set1_epi16((short) low), span = _mm256_set1_epi16((short) (high - low));
+    size_t found = 0, i = 0;
+
+    for(; size - i >= 16; i += 16)
+    {
+        __m256i shifted = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *) &values[i]), base);
+        __m256i inside = _mm256_cmpeq_epi16(_mm256_min_epu16(shifted, span), shifted);
+        found = stream_push_matches((uint32_t) _mm256_movemask_epi8(inside), 2, i, matches, found);
+    }
+
+    return found + stream_filter_range_scalar(&values[i], size - i, low, high, &matches[found], i);
+}
+
+__attribute__((target("avx2"))) inline size_t stream_filter_range_avx2_u32(const uint32_t *values, size_t size, uint32_t low, uint32_t high, uint32_t *matches)
+{
+    if(low > high) return 0;
+
+    const __m256i base = _mm256_set1_epi32((int) low), span = _mm256_set1_epi32((int) (high - low));
+    size_t found = 0, i = 0;
+
+    for(; size - i >= 8; i += 8)
+    {
+        __m256i shifted = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) &values[i]), base);
+        __m256i inside = _mm256_cmpeq_epi32(_mm256_min_epu32(shifted, span), shifted);
+        found = stream_push_matches((uint32_t) _mm256_movemask_epi8(inside), 4, i, matches, found);
+    }
+
+    return found + stream_filter_range_scalar(&values[i], size - i, low, high, &matches[found], i);
+}
+
+__attribute__((target("avx2"))) inline void stream_bswap_avx2_u16(const uint16_t *values, size_t size, uint16_t *out)
+{
+    const __m256i order = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                           1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+
+    for(; size - i >= 16; i += 16)
+        _mm256_storeu_si256((__m256i *) &out[i], _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) &values[i]), order));
+
+    stream_bswap_scalar_u16(&values[i], size - i, &out[i]);
+}
+
+__attribute__((target("avx2"))) inline void stream_bswap_avx2_u32(const uint32_t *values, size_t size, uint32_t *out)
+{
+    const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+
+    for(; size - i >= 8; i += 8)
+        _mm256_storeu_si256((__m256i *) &out[i], _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) &values[i]), order));
+
+    stream_bswap_scalar_u32(&values[i], size - i, &out[i]);
+}
+
+#endif
+
+/*
+ * stream_kernels_for - the kernels of one `STREAM_KERNELS_*` level.
+ *  returns: the kernel table; the scalar one if the level is not built for this target
+ *  on error: this function does not error
+ *
+ *  Note: does not check the CPU supports the level, see `stream_kernels_supported`.
+ * */
+inline const _StreamKernels &stream_kernels_for(int level)
+{
+    static const _StreamKernels scalar = {
+        "scalar", stream_sum_scalar_u16, stream_sum_scalar_u32, stream_min_max_scalar_u16, stream_min_max_scalar_u32,
+        stream_filter_range_scalar_u16, stream_filter_range_scalar_u32, stream_bswap_scalar_u16, stream_bswap_scalar_u32
+    };
+
+#ifdef MODB_STREAM_KERNELS_X86
+    static const _StreamKernels sse4 = {
+        "sse4.1", stream_sum_sse4_u16, stream_sum_sse4_u32, stream_min_max_sse4_u16, stream_min_max_sse4_u32,
+        stream_filter_range_sse4_u16, stream_filter_range_sse4_u32, stream_bswap_sse4_u16, stream_bswap_sse4_u32
+    };
+    static const _StreamKernels avx2 = {
+        "avx2", stream_sum_avx2_u16, stream_sum_avx2_u32, stream_min_max_avx2_u16, stream_min_max_avx2_u32,
+        stream_filter_range_avx2_u16, stream_filter_range_avx2_u32, stream_bswap_avx2_u16, stream_bswap_avx2_u32
+    };
+
+    if(level == STREAM_KERNELS_AVX2) return avx2;
+    if(level == STREAM_KERNELS_SSE4) return sse4;
+#endif
+
+    return scalar;
+}
+
+/*
+ * stream_kernels_supported - check if this CPU can run the kernels of a `STREAM_KERNELS_*` level.
+ *  returns: true if it can else false
+ *  on error: this function does not error
+ * */
+inline bool stream_kernels_supported(int level)
+{
+    if(level == STREAM_KERNELS_SCALAR) return true;
+
+#ifdef MODB_STREAM_KERNELS_X86
+    if(level == STREAM_KERNELS_SSE4) return __builtin_cpu_supports("sse4.1");
+    if(level == STREAM_KERNELS_AVX2) return __builtin_cpu_supports("avx2");
+#endif
+
+    return false;
+}
+
+/*
+ * stream_kernels_best - the fastest kernels this CPU supports, picked on first use.
+ *  returns: the kernel table
+ *  on error: this function does not error
+ * */
+inline const _StreamKernels &stream_kernels_best()
+{
+    static const _StreamKernels &best = stream_kernels_for(
+        stream_kernels_supported(STREAM_KERNELS_AVX2) ? STREAM_KERNELS_AVX2 :
+        stream_kernels_supported(STREAM_KERNELS_SSE4) ? STREAM_KERNELS_SSE4 : STREAM_KERNELS_SCALAR);
+
+    return best;
+}
+
+/* Pick the u16/u32 kernel from the element type, so callers can be written once for both stream types. */
+inline uint64_t stream_sum(const _StreamKernels &k, const uint16_t *values, size_t size) { return k.sum_u16(values, size); }
+inline uint64_t stream_sum(const _StreamKernels &k, const uint32_t *values, size_t size) { return k.sum_u32(values, size); }
+
+inline void stream_min_max(const _StreamKernels &k, const uint16_t *values, size_t size, uint16_t &min, uint16_t &max) { k.min_max_u16(values, size, min, max); }
+inline void stream_min_max(const _StreamKernels &k, const uint32_t *values, size_t size, uint32_t &min, uint32_t &max) { k.min_max_u32(values, size, min, max); }
+
+inline size_t stream_filter_range(const _StreamKernels &k, const uint16_t *values, size_t size, uint16_t low, uint16_t high, uint32_t *matches)
+{
+    return k.filter_range_u16(values, size, low, high, matches);
+}
+
+inline size_t stream_filter_range(const _StreamKernels &k, const uint32_t *values, size_t size, uint32_t low, uint32_t high, uint32_t *matches)
+{
+    return k.filter_range_u32(values, size, low, high, matches);
+}
+
+inline void stream_bswap(const _StreamKernels &k, const uint16_t *values, size_t size, uint16_t *out) { k.bswap_u16(values, size, out); }
+inline void stream_bswap(const _StreamKernels &k, const uint32_t *values, size_t size, uint32_t *out) { k.bswap_u32(values, size, out); }
+
+#endif
@@ -0,0 +1,535 @@
+#ifndef wal_compaction
+#define wal_compaction
+
+/* Background compaction of the write-ahead log and the `.modb` file.
+ *
+ * The server logs every change to `<path>.wal` and `DB_NEW` appends new database entries to it, so the log only
+ * grows while more and more of it goes stale (stores written over, entries and PODs deleted). Once the log is at
+ * least `min_log_size` bytes and at least `garbage_ratio` of it is garbage, the server compacts it:
+ *
+ *  1. the log is switched over to `<path>.wal.compact`, which starts with a `WAL_RECORD_COMPACTION` record holding
+ *     the next generation; changes keep being logged (and acknowledged) there from then on;
+ *  2. every shard writes a snapshot of itself (`StorageEngine::snapshot`) on its own worker, one shard per request,
+ *     so other requests only ever wait for one shard;
+ *  3. a background thread folds the database entries in the old log into the `.modb` file (a later entry with the
+ *     same name replaces an earlier one), then writes `<path>.wal.next`: the generation record, the snapshots, and
+ *     what has been logged to `.compact` so far;
+ *  4. while no flush can run, the rest of `.compact` and any entries `DB_NEW` appended to the old log meanwhile are
+ *     copied over, `.next` is synced and renamed over the log, and `.compact` is removed.
+ *
+ * Changes made while the shards were being snapshot end up in a snapshot and in `.compact`. Logged requests set
+ * what they touch rather than adjust it, so replaying them on top of the snapshot ends in the same state. Files are
+ * only replaced by renames, so whoever mapped the old ones keeps reading them.
+ *
+ * On start-up (`has_unmerged_tail`) a `.compact` of a newer generation than the log is from a compaction that did
+ * not get through step 4; it is replayed after the log and appended to it. One of the same generation did, and is removed.
+ * */
+#define WAL_COMPACTION_MIN_LOG_SIZE     (4ull << 20)
+#define WAL_COMPACTION_GARBAGE_RATIO    0.5
+
+/* The generation record every compacted log and `.compact` starts with. */
+#define WAL_COMPACTION_HEADER_SIZE      (WAL_RECORD_HEADER_SIZE + 8)
+
+/* `.compact` is copied while it keeps growing; once a pass copies less than this (or after this many passes), the rest is copied in step 4. */
+#define WAL_COMPACTION_TAIL_SIZE        (64u << 10)
+#define WAL_COMPACTION_TAIL_PASSES      8
+
+#define wal_compact_extension           UC_PTR ".compact"
+#define wal_next_extension              UC_PTR ".next"
+
+/* What compaction has done since the server started. */
+typedef struct CompactionStats
+{
+    uint64_t    runs = 0;
+    /* Runs that could not write the new log and left the old one in place. */
+    uint64_t    failed_runs = 0;
+
+    /* Bytes the `.modb` file and the log shrank by, in the last run and over every run. */
+    uint64_t    last_bytes_reclaimed = 0;
+    uint64_t    bytes_reclaimed = 0;
+
+    /* From switching the log over to `.compact` to the new log replacing it, in milliseconds. */
+    double      last_duration_ms = 0;
+    double      total_duration_ms = 0;
+
+    /* Share of the log that was garbage when the last run started. */
+    double      last_garbage_ratio = 0;
+} _CompactionStats;
+
+class WalCompactor
+{
+private:
+    std::string modb_path;
+    std::string log_path;
+    std::string compact_path;
+    std::string next_path;
+
+    uint64_t min_log_size = WAL_COMPACTION_MIN_LOG_SIZE;
+    double garbage_ratio = WAL_COMPACTION_GARBAGE_RATIO;
+
+    /* Generation of the log being written to; 0 until the first compaction. */
+    uint64_t generation = 0;
+
+    /* The log could be switched neither to the new log nor back; compaction stays off until a restart recovers it. */
+    bool stuck = false;
+
+    /* Log size `due` last looked at, so the shards are only summed up again once the log changed. */
+    uint64_t checked_log_size = 0;
+
+    /* The run under way, from `begin` until `collect`. */
+    bool running = false;
+    std::vector<std::vector<unsigned char>> snapshots;
+    std::thread compactor;
+    std::atomic<bool> finished{false};
+    std::chrono::steady_clock::time_point started;
+    double started_garbage = 0;
+
+    /* Set by the compactor thread before `finished`. */
+    bool swapped = false;
+    bool switched = false;
+    uint64_t reclaimed = 0;
+    std::chrono::steady_clock::time_point ended;
+
+    std::mutex stats_lock;
+    _CompactionStats stats;
+
+    static uint64_t file_size(const std::string &path)
+    {
+        struct stat file_info;
+        return stat(path.c_str(), &file_info) == 0 ? (uint64_t) file_info.st_size : 0;
+    }
+
+    static uint64_t fd_size(int fd)
+    {
+        struct stat file_info;
+        return fstat(fd, &file_info) == 0 ? (uint64_t) file_info.st_size : 0;
+    }
+
+    static void encode_header(std::vector<unsigned char> &out, uint64_t log_generation)
+    {
+        unsigned char payload[8];
+        modb_put_u32(payload, (uint32_t) log_generation);
+        modb_put_u32(&payload[4], (uint32_t) (log_generation >> 32));
+
+        WriteAheadLog::encode_record(out, WAL_RECORD_COMPACTION, nullptr, 0, payload, 8);
+    }
+
+    /*
+     * file_generation - read the generation from the `WAL_RECORD_COMPACTION` record a log at `path` starts with.
+     *  returns: true if the log starts with one else false
+     *  on error: this function does not error
+     * */
+    static bool file_generation(const std::string &path, uint64_t &log_generation)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd == -1) return false;
+
+        unsigned char header[WAL_COMPACTION_HEADER_SIZE];
+        bool read_all = pread(fd, header, sizeof(header), 0) == (ssize_t) sizeof(header);
+        close(fd);
+
+        if(!read_all || WriteAheadLog::record_at(header, sizeof(header), 0) != sizeof(header) || header[8] != WAL_RECORD_COMPACTION) return false;
+
+        log_generation = modb_get_u32(&header[WAL_RECORD_HEADER_SIZE]) | ((uint64_t) modb_get_u32(&header[WAL_RECORD_HEADER_SIZE + 4]) << 32);
+        return true;
+    }
+
+    /*
+     * copy_from - copy `from`, from `at` through its current end, onto the end of `to`, moving `at` along.
+     *  returns: bytes copied, or -1 if reading or writing failed
+     *  on error: this function does not error
+     * */
+    static int64_t copy_from(int from, uint64_t &at, int to)
+    {
+        unsigned char buffer[65536];
+        int64_t copied = 0;
+
+        while(true)
+        {
+            ssize_t got = pread(from, buffer, sizeof(buffer), (off_t) at);
+            if(got == -1) { if(errno == EINTR) continue; return -1; }
+            if(got == 0) return copied;
+
+            if(!wal_write_all(to, buffer, (size_t) got)) return -1;
+            at += got;
+            copied += got;
+        }
+    }
+
+    /*
+     * copy_records - copy the whole, checksummed records of `from` after `at` onto the end of `to`; a record torn by a crash is left behind.
+     *  returns: true if they were copied else false
+     *  on error: this function does not error
+     * */
+    static bool copy_records(int from, uint64_t at, int to)
+    {
+        uint64_t size = fd_size(from);
+        if(size <= at) return true;
+
+        std::vector<unsigned char> rest(size - at);
+        for(size_t got = 0; got < rest.size(); )
+        {
+            ssize_t read_now = pread(from, &rest[got], rest.size() - got, (off_t) (at + got));
+            if(read_now == -1 && errno == EINTR) continue;
+            if(read_now <= 0) return false;
+            got += read_now;
+        }
+
+        size_t whole = 0, record;
+        while((record = WriteAheadLog::record_at(rest.data(), rest.size(), whole)) > 0) whole += record;
+
+        return wal_write_all(to, rest.data(), whole);
+    }
+
+    /*
+     * fold_entries - write the database entries of the `.modb` file and then the ones logged in `old_log` to a new
+     *                `.modb` file, keeping only the last entry of each name; `scanned` is set to where the records of `old_log` end.
+     *  returns: true if there were none or the new file replaced the old one, false if it could not be written
+     *  on error: this function does not error
+     * */
+    bool fold_entries(const ModbMapping &old_log, size_t &scanned)
+    {
+        const unsigned char *data = old_log.data();
+        std::vector<_ModbEntryView> folded;
+
+        size_t at = 0, record;
+        while((record = WriteAheadLog::record_at(data, old_log.size(), at)) > 0)
+        {
+            const unsigned char *payload = &data[at + WAL_RECORD_HEADER_SIZE];
+            uint32_t payload_size = (uint32_t) (record - WAL_RECORD_HEADER_SIZE);
+            _ModbEntryView entry;
+
+            if(data[at + 8] == WAL_RECORD_DB_ENTRY_V2 && modb_v2_decode_entry(payload, payload_size, entry))
+                folded.push_back(entry);
+            else if(data[at + 8] == WAL_RECORD_DB_ENTRY && payload_size > 0 && payload[payload_size - 1] == static_cast<unsigned char> (modb_sections::MODB_END))
+            {
+                modb_parse_entry(payload, payload_size, 0, entry);
+                folded.push_back(entry);
+            }
+
+            at += record;
+        }
+        scanned = at;
+
+        if(folded.empty()) return true;
+
+        ModbMapping old_modb;
+        std::vector<_ModbEntryView> entries;
+        if(old_modb.map_file(UC_PTR modb_path.c_str()) && old_modb.size() > 0 && !modb_is_v2(old_modb.data(), old_modb.size()))
+        {
+            /* A v1 file is rewritten as v2 here, with the entries folded in. */
+            size_t at = 0;
+            while(at + bytes_to_skip < old_modb.size())
+            {
+                entries.emplace_back();
+                at = modb_parse_entry(old_modb.data(), old_modb.size(), at + bytes_to_skip, entries.back());
+            }
+        }
+        else if(old_modb.size() > 0)
+        {
+            ModbFileV2 modb_file;
+            if(!modb_file.open(old_modb.data(), old_modb.size())) return false;
+
+            entries.resize(modb_file.entry_count());
+            for(size_t i = 0; i < entries.size(); i++) modb_file.entry(i, entries[i]);
+        }
+        entries.insert(entries.end(), folded.begin(), folded.end());
+
+        /* Entries keep their order, so the last one added is still the last one in the file. */
+        std::unordered_map<std::string_view, size_t> newest;
+        for(size_t i = 0; i < entries.size(); i++) newest[entries[i].name] = i;
+
+        ModbWriterV2 writer;
+        for(size_t i = 0; i < entries.size(); i++)
+            if(newest[entries[i].name] == i) writer.add_entry(entries[i]);
+
+        return writer.write_file(UC_PTR modb_path.c_str());
+    }
+
+    /*
+     * run - steps 3 and 4 (see the top of this file), on the compactor thread.
+     *  returns: nothing; `swapped` says if the new log replaced the old one, `switched` if the log left `.compact` at all
+     *  on error: this function does not error; if the new log cannot be written the log switches back to the old file
+     * */
+    void run(WriteAheadLog &wal)
+    {
+        uint64_t old_modb_size = file_size(modb_path);
+        size_t scanned = 0;
+        bool ready;
+
+        {
+            ModbMapping old_log;
+            ready = !old_log.map_file(UC_PTR log_path.c_str()) || fold_entries(old_log, scanned);
+        }
+
+        int next = ready ? open(next_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644) : -1;
+        int tail = open(compact_path.c_str(), O_RDONLY | O_CLOEXEC);
+        ready = ready && next != -1 && tail != -1;
+
+        std::vector<unsigned char> header;
+        encode_header(header, generation + 1);
+        ready = ready && wal_write_all(next, header.data(), header.size());
+
+        for(std::vector<unsigned char> &snapshot: snapshots)
+        {
+            ready = ready && wal_write_all(next, snapshot.data(), snapshot.size());
+            std::vector<unsigned char>().swap(snapshot);
+        }
+
+        /* Catch up with `.compact` without holding anything up, so step 4 only has a little left to copy. */
+        uint64_t tail_at = WAL_COMPACTION_HEADER_SIZE;
+        for(unsigned pass = 0; ready && pass < WAL_COMPACTION_TAIL_PASSES; pass++)
+        {
+            int64_t copied = copy_from(tail, tail_at, next);
+            ready = copied >= 0;
+            if(copied < (int64_t) WAL_COMPACTION_TAIL_SIZE) break;
+        }
+
+        uint64_t old_size = 0, new_size = 0;
+        switched = tail != -1 && wal.switch_file([&](int) -> int {
+            int old_log = open(log_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if(old_log == -1) return -1;
+
+            /* Keeps `DB_NEW` from appending to the old log until it is replaced (see `WriteAheadLog::lock_file`). */
+            flock(old_log, LOCK_EX);
+
+            if(ready && copy_from(tail, tail_at, next) >= 0 && copy_records(old_log, scanned, next) && fsync(next) == 0 &&
+               rename(next_path.c_str(), log_path.c_str()) == 0)
+            {
+                old_size = fd_size(old_log) + tail_at;
+                new_size = fd_size(next);
+
+                unlink(compact_path.c_str());
+                close(old_log);
+
+                swapped = true;
+                int new_log = next;
+                next = -1;
+                return new_log;
+            }
+
+            /* Switch back: `.compact` goes onto the end of the old log, as `has_unmerged_tail` would have it on start-up. */
+            if(next != -1) unlink(next_path.c_str());
+
+            if(copy_records(tail, WAL_COMPACTION_HEADER_SIZE, old_log) && fsync(old_log) == 0)
+            {
+                unlink(compact_path.c_str());
+                flock(old_log, LOCK_UN);
+                return old_log;
+            }
+
+            close(old_log);
+            return -1;
+        });
+
+        if(next != -1) close(next);
+        if(tail != -1) close(tail);
+
+        if(swapped)
+        {
+            uint64_t before = old_modb_size + old_size, after = file_size(modb_path) + new_size;
+            reclaimed = before > after ? before - after : 0;
+        }
+        ended = std::chrono::steady_clock::now();
+    }
+
+public:
+    /*
+     * set_paths - compact the `.modb` file at `path` and the write-ahead log next to it.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_paths(const unsigned char *path)
+    {
+        modb_path = NCC_PTR path;
+        log_path = modb_path + NCC_PTR wal_file_extension;
+        compact_path = log_path + NCC_PTR wal_compact_extension;
+        next_path = log_path + NCC_PTR wal_next_extension;
+    }
+
+    /*
+     * configure - compact once the log is at least `log_size` bytes and at least `ratio` of it is garbage; call before the server starts.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void configure(uint64_t log_size, double ratio)
+    {
+        min_log_size = log_size;
+        garbage_ratio = ratio;
+    }
+
+    /*
+     * has_unmerged_tail - on start-up, before the log is opened: remove what a compaction that stopped in the middle
+     *                     left behind, and check whether `.compact` holds changes the log does not.
+     *  returns: true if it does; replay `.compact` after the log, then call `merge_tail`
+     *  on error: this function does not error
+     * */
+    bool has_unmerged_tail()
+    {
+        unlink(next_path.c_str());
+
+        if(!file_generation(log_path, generation)) generation = 0;
+
+        uint64_t tail_generation;
+        if(!file_generation(compact_path, tail_generation))
+        {
+            /* Created, but the log never switched over to it. */
+            unlink(compact_path.c_str());
+            return false;
+        }
+
+        if(tail_generation == generation) { unlink(compact_path.c_str()); return false; }
+        return true;
+    }
+
+    /*
+     * merge_tail - append the records of `.compact` to the log and remove it.
+     *  returns: true if they were appended and synced else false (`.compact` is kept for the next start-up)
+     *  on error: this function does not error
+     * */
+    bool merge_tail()
+    {
+        int log = open(log_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        int tail = open(compact_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        bool merged = log != -1 && tail != -1 && copy_records(tail, WAL_COMPACTION_HEADER_SIZE, log) && fsync(log) == 0;
+
+        if(log != -1) close(log);
+        if(tail != -1) close(tail);
+
+        if(merged) unlink(compact_path.c_str());
+        return merged;
+    }
+
+    /*
+     * due - check whether the log has grown past `min_log_size` with at least `garbage_ratio` of it garbage.
+     *  log_size - bytes in the log (`WriteAheadLog::log_size`)
+     *  live_size - gets the bytes a snapshot would take; only called once the log is big enough and has changed
+     *  returns: true if a compaction should `begin`
+     *  on error: this function does not error
+     * */
+    bool due(uint64_t log_size, const std::function<uint64_t()> &live_size)
+    {
+        if(running || stuck || log_path.empty() || log_size < min_log_size || log_size == checked_log_size) return false;
+        checked_log_size = log_size;
+
+        uint64_t live = live_size();
+        return live < log_size && 1.0 - (double) live / log_size >= garbage_ratio;
+    }
+
+    /*
+     * begin - step 1: switch `wal` over to `.compact`, and make room for a snapshot of each of `shard_count` shards.
+     *  live_size - bytes a snapshot would take, for the stats
+     *  returns: true if the log switched over; fill in `snapshot_of` each shard, then `run_in_background`
+     *  on error: this function does not error; nothing changes if the log could not switch over
+     * */
+    bool begin(WriteAheadLog &wal, uint32_t shard_count, uint64_t live_size)
+    {
+        if(running || stuck || log_path.empty()) return false;
+
+        uint64_t log_size = wal.log_size();
+        int tail = open(compact_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if(tail == -1) return false;
+
+        std::vector<unsigned char> header;
+        encode_header(header, generation + 1);
+
+        if(!wal_write_all(tail, header.data(), header.size()) || !wal.switch_file([tail](int) { return tail; }))
+        {
+            close(tail);
+            unlink(compact_path.c_str());
+            return false;
+        }
+
+        running = true;
+        finished.store(false);
+        swapped = switched = false;
+        reclaimed = 0;
+        snapshots.assign(shard_count, {});
+        started = std::chrono::steady_clock::now();
+        started_garbage = live_size < log_size ? 1.0 - (double) live_size / log_size : 0;
+        return true;
+    }
+
+    std::vector<unsigned char> &snapshot_of(uint32_t shard) { return snapshots[shard]; }
+
+    /*
+     * run_in_background - once every shard is in `snapshot_of`, start steps 3 and 4 on a thread of their own.
+     *  on_done - called from that thread once it is done, so the owner knows to `collect`
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void run_in_background(WriteAheadLog &wal, std::function<void()> on_done)
+    {
+        compactor = std::thread([this, &wal, on_done]() {
+            run(wal);
+            finished.store(true, std::memory_order_release);
+            if(on_done) on_done();
+        });
+    }
+
+    /*
+     * collect - finish up a run whose thread is done: join it and add it to the stats.
+     *  returns: true if a run was collected
+     *  on error: this function does not error
+     * */
+    bool collect()
+    {
+        if(!running || !finished.load(std::memory_order_acquire)) return false;
+
+        compactor.join();
+        running = false;
+        checked_log_size = 0;
+
+        if(swapped) generation++;
+        if(!switched) stuck = true;
+
+        std::lock_guard<std::mutex> guard(stats_lock);
+        stats.runs++;
+        if(!swapped) stats.failed_runs++;
+
+        stats.last_bytes_reclaimed = reclaimed;
+        stats.bytes_reclaimed += reclaimed;
+        stats.last_duration_ms = std::chrono::duration<double, std::milli>(ended - started).count();
+        stats.total_duration_ms += stats.last_duration_ms;
+        stats.last_garbage_ratio = started_garbage;
+        return true;
+    }
+
+    /*
+     * wait - wait for the thread of a run to be done (when the server stops), then `collect` it.
+     *  returns: true if a run was collected
+     *  on error: this function does not error; a run whose snapshots never came in is left to `has_unmerged_tail`
+     * */
+    bool wait()
+    {
+        if(!running || !compactor.joinable()) return false;
+
+        while(!finished.load(std::memory_order_acquire)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return collect();
+    }
+
+    bool last_run_swapped() { return swapped; }
+    bool is_stuck() { return stuck; }
+    bool is_running() { return running; }
+    uint64_t log_generation() { return generation; }
+    const std::string &path() { return log_path; }
+
+    /*
+     * compaction_stats - what compaction has done so far; safe to call from any thread.
+     *  returns: a copy of the stats
+     *  on error: this function does not error
+     * */
+    _CompactionStats compaction_stats()
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        return stats;
+    }
+
+    ~WalCompactor()
+    {
+        if(compactor.joinable()) compactor.join();
+    }
+};
+
+#endif
@@ -0,0 +1,668 @@
+#ifndef worker_pool
+#define worker_pool
+
+/* Fixed pool of server-side worker threads.
+ *
+ * DB entries are split over `WORKER_POOL_SHARDS` storage engines by entry ID, and every shard is owned
+ * by exactly one worker (shard % worker count). A request is routed to the worker owning its entry, so
+ * stores to different entries never contend on a lock and requests for one entry run in order.
+ *
+ * Requests reach a worker through its own lock-free queue; finished requests go back through one shared
+ * completion queue that the event loop drains. Requests about every entry (see `cs_request_is_broadcast`)
+ * are sent to every worker, which performs them on each shard it owns.
+ *
+ * Reads of a single POD do not have to wait in that queue: `read` answers them on the calling thread from
+ * the versions each worker publishes after every request (see `pod_versions.hpp`).
+ * */
+#define WORKER_POOL_SHARDS              64
+#define WORKER_POOL_QUEUE_SIZE          1024
+
+/* Spins an idle worker does before going to sleep. */
+#define WORKER_POOL_IDLE_SPINS          256
+
+/* Finished requests kept for reuse, the largest buffer a kept request may hold on to,
+ * and the room new requests start with so typical requests never grow their buffers.
+ * */
+#define WORKER_POOL_SPARE_REQUESTS      4096
+#define WORKER_POOL_SPARE_BUFFER_SIZE   65536
+#define WORKER_POOL_REQUEST_RESERVE     512
+
+#define worker_pool_shard_for(entry_id) ((entry_id) % WORKER_POOL_SHARDS)
+
+/* Bounded multi-producer multi-consumer queue (Vyukov's algorithm).
+ *
+ * Each cell carries a sequence number telling producers and consumers whose turn it is, so pushes and
+ * pops only contend on one atomic counter each and never take a lock. `size` must be a power of two.
+ * */
+template<typename T>
+class ModbMPMCQueue
+{
+private:
+    typedef struct Cell
+    {
+        std::atomic<size_t>     sequence;
+        T                       value;
+    } _Cell;
+
+    _Cell *cells;
+    size_t mask;
+
+    /* Kept on separate cache lines so producers and consumers do not false-share. */
+    alignas(64) std::atomic<size_t> enqueue_at;
+    alignas(64) std::atomic<size_t> dequeue_at;
+
+public:
+    ModbMPMCQueue(size_t size)
+    {
+        database_assert(size >= 2 && (size & (size - 1)) == 0, "\nQueue size %zu is not a power of two.\n", size)
+
+        cells = new _Cell[size];
+        mask = size - 1;
+
+        for(size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+
+        enqueue_at.store(0, std::memory_order_relaxed);
+        dequeue_at.store(0, std::memory_order_relaxed);
+    }
+
+    ModbMPMCQueue(const ModbMPMCQueue &) = delete;
+    ModbMPMCQueue &operator=(const ModbMPMCQueue &) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    /*
+     * try_push - add `value` to the queue.
+     *  returns: true if it was added, false if the queue is full
+     *  on error: this function does not error
+     * */
+    bool try_push(const T &value)
+    {
+        size_t at = enqueue_at.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            _Cell *cell = &cells[at & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) at;
+
+            if(diff == 0)
+            {
+                if(enqueue_at.compare_exchange_weak(at, at + 1, std::memory_order_relaxed))
+                {
+                    cell->value = value;
+                    cell->sequence.store(at + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0)
+                return false;
+            else
+                at = enqueue_at.load(std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * try_pop - take the oldest value off the queue.
+     *  returns: true if a value was stored in `value`, false if the queue is empty
+     *  on error: this function does not error
+     * */
+    bool try_pop(T &value)
+    {
+        size_t at = dequeue_at.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            _Cell *cell = &cells[at & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) (at + 1);
+
+            if(diff == 0)
+            {
+                if(dequeue_at.compare_exchange_weak(at, at + 1, std::memory_order_relaxed))
+                {
+                    value = cell->value;
+                    cell->sequence.store(at + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0)
+                return false;
+            else
+                at = dequeue_at.load(std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * looks_empty - check if the queue is empty; may be stale by the time it returns.
+     *  returns: true if nothing was queued at the time of the check else false
+     *  on error: this function does not error
+     * */
+    bool looks_empty()
+    {
+        return enqueue_at.load(std::memory_order_acquire) == dequeue_at.load(std::memory_order_acquire);
+    }
+
+    ~ModbMPMCQueue() { delete[] cells; }
+};
+
+/* A request every shard performs, shared by the parts sent to each worker. */
+typedef struct WorkerBroadcast
+{
+    unsigned char               opcode = 0;
+    std::vector<unsigned char>  payload;
+
+    /* Gathered by the event loop as the parts come back (see `StorageEngine::merge_results`). */
+    uint32_t                    parts_left = 0;
+    unsigned char               result = SS_RESPONSE_OK;
+    std::vector<unsigned char>  response;
+
+    /* Set to run on each shard instead of `opcode` (e.g. to snapshot it); it gets a part of its own per shard. */
+    std::function<void(StorageEngine &, uint32_t)> job;
+} _WorkerBroadcast;
+
+/* One decoded request on its way through the pool. */
+typedef struct WorkerRequest
+{
+    /* Opaque to the pool; the event loop uses it to route the response back to its connection. */
+    uint64_t                    ticket = 0;
+
+    unsigned char               opcode = 0;
+    std::vector<unsigned char>  payload;
+
+    /* Filled in by the worker. */
+    unsigned char               result = 0;
+    std::vector<unsigned char>  response;
+
+    /* Set instead of `response` for a chunk of a value in the blob file, which goes out from the file (see `pod_blobs.hpp`). */
+    _PodBlobRegion              file;
+
+    /* Set for one worker's part of a `CS_REQUEST_BATCH`: the indexes of the sub-requests that worker performs
+     * (in order) and the worker itself; `opcode` and `payload` are unused then.
+     * */
+    std::shared_ptr<_RequestBatch> batch;
+    std::vector<uint32_t>       batch_ops;
+    uint32_t                    batch_worker = 0;
+
+    /* Set instead for one worker's part of a request every shard performs; `batch_worker` is again the worker.
+     * For a job the part is one `shard` rather than every shard the worker owns.
+     * */
+    std::shared_ptr<_WorkerBroadcast> broadcast;
+    uint32_t                    shard = 0;
+} _WorkerRequest;
+
+/* Performs a request against the shard that owns its entry.
+ * Gets the shard, opcode and payload, appends any result to the response vector and returns a `SS_RESPONSE_*` code.
+ * */
+typedef std::function<unsigned char (StorageEngine &, unsigned char, const unsigned char *, uint32_t, std::vector<unsigned char> &)> SS_WORKER_HANDLER;
+
+class WorkerPool
+{
+private:
+    typedef struct Worker
+    {
+        std::thread                         thread;
+        ModbMPMCQueue<_WorkerRequest *>     queue{WORKER_POOL_QUEUE_SIZE};
+
+        /* Only used to put the worker to sleep when its queue stays empty. */
+        std::mutex                          idle_lock;
+        std::condition_variable             idle;
+        std::atomic<bool>                   sleeping{false};
+
+        /* Position in `workers`; the worker owns every `worker_total`th shard from this one. */
+        uint32_t                            index = 0;
+
+        /* Where the worker records how long requests take, nullptr to not record; see `modb_stats.hpp`. */
+        _ModbThreadStats                    *stats = nullptr;
+        uint32_t                            ticks[MODB_STATS_OPCODES] = {0};
+    } _Worker;
+
+    /* Readers pin these while they look at the published versions of a shard. */
+    ModbEpochs epochs;
+
+    std::vector<StorageEngine> shards;
+    std::vector<_Worker *> workers;
+
+    /* Workers `start` runs; set before any of them starts, so they can read it while `workers` fills up. */
+    uint32_t worker_total = 0;
+
+    ModbMPMCQueue<_WorkerRequest *> *completed = nullptr;
+
+    SS_WORKER_HANDLER handler;
+
+    /* Called by a worker when the completion queue goes from drained to non-empty. */
+    std::function<void()> on_complete;
+    std::atomic<bool> complete_signalled{false};
+
+    std::atomic<bool> running{false};
+
+    /* Requests handed back through `recycle`; only touched by the thread that submits and drains. */
+    std::vector<_WorkerRequest *> spare_requests;
+
+    /* Worker `i` records into slot `i + 1`. */
+    ModbStats *stats = nullptr;
+
+    /*
+     * shard_of - shard that owns the entry a request payload is for.
+     *  returns: the shard index
+     *  on error: this function does not error; payloads without an entry ID go to shard 0
+     * */
+    static uint32_t shard_of(const unsigned char *payload, uint32_t payload_size)
+    {
+        return payload_size >= 4 ? worker_pool_shard_for(modb_get_u32(payload)) : 0;
+    }
+
+    /* Versions are published, and blob extents retired, after the handler, so neither gets ahead of the log. */
+    unsigned char perform_in(StorageEngine &shard, unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        unsigned char result = handler ? handler(shard, opcode, payload, payload_size, response) : shard.perform(opcode, payload, payload_size, response);
+
+        shard.retire_blobs();
+        shard.publish_versions();
+        return result;
+    }
+
+    unsigned char perform_on_shard(unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        return perform_in(shards[shard_of(payload, payload_size)], opcode, payload, payload_size, response);
+    }
+
+    /*
+     * perform_broadcast - perform a request on every `stride`th shard from `first_shard` on, merging their results.
+     *  returns: `SS_RESPONSE_OK`, or the last error a shard returned (its result is dropped then)
+     *  on error: this function does not error
+     * */
+    unsigned char perform_broadcast(uint32_t first_shard, uint32_t stride, unsigned char opcode, const unsigned char *payload, uint32_t payload_size,
+                                    std::vector<unsigned char> &response)
+    {
+        unsigned char result = SS_RESPONSE_OK;
+        size_t first = response.size();
+
+        for(uint32_t shard = first_shard; shard < WORKER_POOL_SHARDS; shard += stride)
+        {
+            size_t at = response.size();
+            unsigned char shard_result = perform_in(shards[shard], opcode, payload, payload_size, response);
+
+            if(shard_result != SS_RESPONSE_OK) result = shard_result;
+            StorageEngine::merge_results(opcode, response, first, at);
+        }
+
+        if(result != SS_RESPONSE_OK) response.resize(first);
+        return result;
+    }
+
+    void work(_Worker *worker)
+    {
+        _WorkerRequest *request;
+        unsigned spins = 0;
+
+        while(true)
+        {
+            if(worker->queue.try_pop(request))
+            {
+                spins = 0;
+
+                /* Jobs are the server's own work (e.g. compaction snapshots), not a request anyone waits on. */
+                unsigned char opcode = request->batch ? CS_REQUEST_BATCH : (request->broadcast ? request->broadcast->opcode : request->opcode);
+                uint64_t started = worker->stats && !(request->broadcast && request->broadcast->job) &&
+                                   modb_stats_sampled(worker->ticks[modb_stats_opcode_slot(opcode)]) ? modb_stats_now() : 0;
+
+                if(request->batch)
+                {
+                    _RequestBatch &batch = *request->batch;
+                    for(uint32_t index: request->batch_ops)
+                    {
+                        _BatchOp &op = batch.ops[index];
+                        batch.statuses[index] = perform_on_shard(op.opcode, &batch.payload[op.offset], op.size, batch.results[index]);
+                    }
+                    request->result = SS_RESPONSE_OK;
+                }
+                else if(request->broadcast && request->broadcast->job)
+                {
+                    request->broadcast->job(shards[request->shard], request->shard);
+                    request->result = SS_RESPONSE_OK;
+                }
+                else if(request->broadcast)
+                {
+                    _WorkerBroadcast &broadcast = *request->broadcast;
+                    request->result = perform_broadcast(request->batch_worker, worker_total, broadcast.opcode, broadcast.payload.data(),
+                                                        (uint32_t) broadcast.payload.size(), request->response);
+                }
+                else
+                {
+                    StorageEngine &shard = shards[shard_of(request->payload.data(), (uint32_t) request->payload.size())];
+
+                    shard.send_blobs_to(&request->file);
+                    request->result = perform_in(shard, request->opcode, request->payload.data(), (uint32_t) request->payload.size(), request->response);
+                    shard.send_blobs_to(nullptr);
+                }
+
+                if(started)
+                {
+                    uint64_t took = modb_stats_now() - started;
+                    worker->stats->phases[MODB_PHASE_PERFORMING].record(took);
+                    worker->stats->service[modb_stats_opcode_slot(opcode)].record(took);
+                }
+
+                /* The event loop drains the completion queue while it waits to submit, so this cannot stay full. */
+                while(!completed->try_push(request)) std::this_thread::yield();
+
+                if(!complete_signalled.exchange(true) && on_complete) on_complete();
+                continue;
+            }
+
+            if(!running.load(std::memory_order_acquire)) return;
+            if(++spins < WORKER_POOL_IDLE_SPINS) { std::this_thread::yield(); continue; }
+
+            /* Free what readers were holding on to before going to sleep with it. */
+            for(uint32_t shard = worker->index; shard < WORKER_POOL_SHARDS; shard += worker_total)
+                shards[shard].reclaim_versions();
+
+            /* Announce the nap before the last look, so a `submit` in between either sees us asleep or we see its request. */
+            std::unique_lock<std::mutex> guard(worker->idle_lock);
+            worker->sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(worker->queue.looks_empty() && running.load())
+                worker->idle.wait(guard);
+            worker->sleeping.store(false);
+            spins = 0;
+        }
+    }
+
+public:
+    WorkerPool() : shards(WORKER_POOL_SHARDS)
+    {
+        for(StorageEngine &shard: shards) shard.keep_versions(epochs);
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /*
+     * set_handler - set the function requests are performed with (e.g. to also log them); defaults to `StorageEngine::perform`.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_handler(SS_WORKER_HANDLER worker_handler) { handler = worker_handler; }
+
+    /*
+     * set_on_complete - set a function workers call (from their own thread) when finished requests are waiting.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_on_complete(std::function<void()> completion) { on_complete = completion; }
+
+    /*
+     * set_stats - have the workers record how long they take to perform requests into `server_stats`, nullptr to stop;
+     *             takes effect the next time the pool starts.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_stats(ModbStats *server_stats) { stats = server_stats; }
+
+    /*
+     * set_blobs - have every shard keep values committed through `CS_REQUEST_STREAM_POD` in `file`; call before anything is replayed.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_blobs(PodBlobFile &file)
+    {
+        for(StorageEngine &shard: shards) shard.keep_blobs(file);
+    }
+
+    /*
+     * set_codecs - have every shard persist stream values with the codecs `policy` picks (see `pod_codecs.hpp`).
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void set_codecs(const _PodCodecPolicy &policy)
+    {
+        for(StorageEngine &shard: shards) shard.set_codecs(policy);
+    }
+
+    /*
+     * start - start `count` workers (0 picks one per core).
+     *  returns: nothing
+     *  on error: this function will error if the pool is already running
+     * */
+    void start(unsigned count)
+    {
+        database_assert(!running.load(), "\nThe worker pool is already running.\n")
+
+        if(count == 0) count = std::thread::hardware_concurrency();
+        if(count == 0) count = 1;
+        if(count > WORKER_POOL_SHARDS) count = WORKER_POOL_SHARDS;
+
+        /* Room for every request the workers can hold, so finishing one never waits on the event loop for long.
+         * A queue left by an earlier `stop` is kept if it is big enough, else what it still holds moves to a bigger one.
+         * */
+        size_t completed_size = 2;
+        while(completed_size < (size_t) count * (WORKER_POOL_QUEUE_SIZE + 1)) completed_size <<= 1;
+        if(!completed || completed->capacity() < completed_size)
+        {
+            ModbMPMCQueue<_WorkerRequest *> *grown = new ModbMPMCQueue<_WorkerRequest *>(completed_size);
+            if(completed)
+            {
+                _WorkerRequest *request;
+                while(completed->try_pop(request)) grown->try_push(request);
+                delete completed;
+            }
+            completed = grown;
+        }
+
+        worker_total = count;
+        running.store(true);
+        for(unsigned i = 0; i < count; i++)
+        {
+            _Worker *worker = new _Worker;
+            worker->index = i;
+            worker->stats = stats ? stats->thread(i + 1) : nullptr;
+            workers.push_back(worker);
+            worker->thread = std::thread(&WorkerPool::work, this, worker);
+        }
+    }
+
+    /*
+     * stop - let the workers finish what is queued, then join them.
+     *  returns: nothing
+     *  on error: this function does not error
+     *
+     *  Note: finished requests that were not drained are left in the completion queue until the next `drain`.
+     * */
+    void stop()
+    {
+        if(!running.exchange(false)) return;
+
+        for(_Worker *worker: workers)
+        {
+            {
+                std::lock_guard<std::mutex> guard(worker->idle_lock);
+            }
+            worker->idle.notify_one();
+        }
+
+        for(_Worker *worker: workers)
+        {
+            worker->thread.join();
+            delete worker;
+        }
+        workers.clear();
+    }
+
+    bool is_running() { return running.load(); }
+    size_t worker_count() { return workers.size(); }
+
+    /*
+     * worker_of - index of the worker that owns the entry a request payload is for; the pool must be running.
+     *  returns: the worker index
+     *  on error: this function does not error
+     * */
+    uint32_t worker_of(const unsigned char *payload, uint32_t payload_size)
+    {
+        return shard_of(payload, payload_size) % workers.size();
+    }
+
+    uint32_t worker_of_shard(uint32_t shard) { return shard % workers.size(); }
+
+    /*
+     * submit - queue `request` (from `acquire`, or allocated with `new`) on the worker that owns its entry, or on `batch_worker` for a batch or broadcast part.
+     *  returns: true if it was queued, false if that worker's queue is full (drain and try again)
+     *  on error: this function does not error
+     * */
+    bool submit(_WorkerRequest *request)
+    {
+        _Worker *worker = workers[request->batch || request->broadcast ? request->batch_worker : worker_of(request->payload.data(), (uint32_t) request->payload.size())];
+
+        if(!worker->queue.try_push(request)) return false;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(worker->sleeping.load())
+        {
+            {
+                std::lock_guard<std::mutex> guard(worker->idle_lock);
+            }
+            worker->idle.notify_one();
+        }
+
+        return true;
+    }
+
+    /*
+     * drain - hand every finished request to `on_finished`, which takes ownership of it.
+     *  returns: number of requests drained
+     *  on error: this function does not error
+     * */
+    size_t drain(const std::function<void(_WorkerRequest *)> &on_finished)
+    {
+        if(!completed) return 0;
+
+        /* Cleared first: a worker finishing after this point signals again. */
+        complete_signalled.store(false);
+
+        size_t drained = 0;
+        _WorkerRequest *request;
+        while(completed->try_pop(request))
+        {
+            on_finished(request);
+            drained++;
+        }
+
+        return drained;
+    }
+
+    /*
+     * acquire - get an empty request to fill in and `submit`, reusing one handed back through `recycle` if there is one.
+     *  returns: the request
+     *  on error: this function does not error
+     * */
+    _WorkerRequest *acquire()
+    {
+        if(spare_requests.empty())
+        {
+            _WorkerRequest *request = new _WorkerRequest;
+            request->payload.reserve(WORKER_POOL_REQUEST_RESERVE);
+            request->response.reserve(WORKER_POOL_REQUEST_RESERVE);
+            return request;
+        }
+
+        _WorkerRequest *request = spare_requests.back();
+        spare_requests.pop_back();
+        return request;
+    }
+
+    /*
+     * recycle - take back a drained request; its buffers keep their capacity so steady traffic does not allocate.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void recycle(_WorkerRequest *request)
+    {
+        if(spare_requests.size() >= WORKER_POOL_SPARE_REQUESTS) { delete request; return; }
+
+        /* Do not keep one unusually large request's memory around. */
+        if(request->payload.capacity() > WORKER_POOL_SPARE_BUFFER_SIZE) std::vector<unsigned char>().swap(request->payload);
+        if(request->response.capacity() > WORKER_POOL_SPARE_BUFFER_SIZE) std::vector<unsigned char>().swap(request->response);
+
+        request->ticket = 0;
+        request->opcode = 0;
+        request->result = 0;
+        request->payload.clear();
+        request->response.clear();
+        request->file = _PodBlobRegion();
+        request->batch.reset();
+        request->batch_ops.clear();
+        request->batch_worker = 0;
+        request->broadcast.reset();
+        request->shard = 0;
+
+        spare_requests.push_back(request);
+    }
+
+    /*
+     * perform - run a request on the calling thread (write-ahead log replay, or before the pool is started).
+     *  returns: a `SS_RESPONSE_*` code, any result is appended to `response`
+     *  on error: this function will error if the workers are running, they own the shards then
+     * */
+    unsigned char perform(unsigned char opcode, const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        database_assert(!running.load(), "\nCannot perform requests directly while the worker pool is running.\n")
+
+        if(cs_request_is_broadcast(opcode)) return perform_broadcast(0, 1, opcode, payload, payload_size, response);
+        return perform_on_shard(opcode, payload, payload_size, response);
+    }
+
+    /*
+     * read - perform a `CS_REQUEST_READ_POD` against the versions last published by the worker owning its entry.
+     *  returns: a `SS_RESPONSE_*` code, the type and value are appended to `response`
+     *  on error: this function does not error; malformed payloads return `SS_RESPONSE_BAD_REQUEST`
+     *
+     *  Note: safe from any thread, running or not; it never waits on the workers.
+     * */
+    unsigned char read(const unsigned char *payload, uint32_t payload_size, std::vector<unsigned char> &response)
+    {
+        ModbEpochPin pin(epochs);
+        return shards[shard_of(payload, payload_size)].read_published(payload, payload_size, response);
+    }
+
+    /*
+     * entry_count - how many DB entries exist over every shard.
+     *  returns: number of entries
+     *  on error: this function does not error
+     * */
+    size_t entry_count()
+    {
+        size_t count = 0;
+        for(auto &shard: shards) count += shard.entry_count();
+        return count;
+    }
+
+    /*
+     * live_size - how many bytes a snapshot of every shard would take (see `StorageEngine::snapshot`); safe to call while running.
+     *  returns: the size
+     *  on error: this function does not error
+     * */
+    uint64_t live_size()
+    {
+        uint64_t size = 0;
+        for(auto &shard: shards) size += shard.live_size();
+        return size;
+    }
+
+    ~WorkerPool()
+    {
+        stop();
+
+        if(completed)
+        {
+            _WorkerRequest *request;
+            while(completed->try_pop(request)) delete request;
+            delete completed;
+        }
+        completed = nullptr;
+
+        for(_WorkerRequest *request: spare_requests) delete request;
+        spare_requests.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,489 @@
+#ifndef write_ahead_log
+#define write_ahead_log
+
+/* Append-only write-ahead log kept next to the `.modb` file (`<path>.wal`).
+ *
+ * Each record:
+ *      [4: length of type + payload][4: CRC-32 of type + payload][1: WAL_RECORD_*][payload]
+ * A record is only replayed if it is complete and its checksum matches; the first bad record
+ * marks the end of the log (a write torn by a crash) and everything from there on is cut off.
+ *
+ * Records are buffered by `append` and made durable by `sync`. Callers that `sync` while another
+ * caller is already flushing wait for that flush and are covered by the next one, so concurrent
+ * commits share a single write + fsync (group commit).
+ * */
+#define WAL_RECORD_DB_ENTRY         0x01 // payload is the `modb_sections` of one database entry, ending with `MODB_END`
+#define WAL_RECORD_ENGINE_OP        0x02 // payload is [1: CS_REQUEST_* opcode][request payload] performed on the storage engine
+#define WAL_RECORD_DB_ENTRY_V2      0x03 // payload is one database entry in the v2 section format (see `modb_format.hpp`)
+#define WAL_RECORD_COMPACTION       0x04 // payload is [8: generation]; first record of a log written by compaction (see `wal_compaction.hpp`)
+
+#define WAL_RECORD_HEADER_SIZE      9
+
+/* Room the server's log keeps in each of its buffers, so group commits of a busy server do not keep growing them. */
+#define WAL_SERVER_BUFFER_RESERVE   (1 << 20)
+#define wal_file_extension          UC_PTR ".wal"
+
+/*
+ * wal_path_for - get the write-ahead log path that belongs to the `.modb` file at `modb_path`.
+ *  returns: newly allocated path, the caller frees it
+ *  on error: this function will error if there was a memory allocation error
+ * */
+inline unsigned char *wal_path_for(const unsigned char *modb_path)
+{
+    size_t path_size = strlen(NCC_PTR modb_path);
+
+    unsigned char *path = UC_PTR calloc(path_size + 5, sizeof(*path));
+    database_assert(path, "\nError allocating memory for the write-ahead log path.\n")
+
+    memcpy(path, modb_path, path_size);
+    memcpy(&path[path_size], wal_file_extension, 4);
+
+    return path;
+}
+
+/*
+ * wal_write_all - write all of `data` to `fd`, carrying on after short writes and interrupts; `written`, if given, is
+ *                 set to how many bytes made it.
+ *  returns: true if everything was written else false
+ *  on error: this function does not error
+ * */
+inline bool wal_write_all(int fd, const unsigned char *data, size_t size, size_t *written = nullptr)
+{
+    size_t total = 0;
+    while(total < size)
+    {
+        ssize_t wrote = write(fd, data + total, size - total);
+        if(wrote == -1)
+        {
+            if(errno == EINTR) continue;
+            break;
+        }
+        total += wrote;
+    }
+
+    if(written) *written = total;
+    return total == size;
+}
+
+/*
+ * wal_lock_at - take an exclusive `flock` on `fd`, reopening the log at `path` into `fd` first if compaction renamed a
+ *               new file over it.
+ *  returns: true once the lock is held on the file at `path` else false (`fd` is left unlocked)
+ *  on error: this function does not error
+ * */
+inline bool wal_lock_at(int &fd, const std::string &path)
+{
+    while(fd != -1)
+    {
+        if(flock(fd, LOCK_EX) != 0) return false;
+
+        struct stat opened, at_path;
+        if(fstat(fd, &opened) == 0 && stat(path.c_str(), &at_path) == 0 && opened.st_ino == at_path.st_ino && opened.st_dev == at_path.st_dev)
+            return true;
+
+        /* Records appended after this point belong in the file now at the path; closing drops the lock on the old one. */
+        int reopened = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if(reopened == -1) { flock(fd, LOCK_UN); return false; }
+
+        close(fd);
+        fd = reopened;
+    }
+    return false;
+}
+
+class WriteAheadLog
+{
+private:
+    int fd = -1;
+
+    /* Path the log was opened at, to follow it when compaction renames a new log over it (see `lock_file`). */
+    std::string log_path;
+
+    std::mutex wal_lock;
+    std::condition_variable flushed;
+
+    /* Records appended but not written yet, and the records currently being written by a flush. */
+    std::vector<unsigned char> pending;
+    std::vector<unsigned char> writing;
+
+    /* Sequence number of the last appended record and of the last record known to be on disk. */
+    uint64_t appended_seq = 0;
+    uint64_t durable_seq = 0;
+    bool flushing = false;
+
+    /* How many fsyncs were done, and for how many records (for group commit stats). */
+    uint64_t syncs = 0;
+    uint64_t synced_records = 0;
+
+    /* Bytes in the log file, as opened plus everything written since; read by the event loop to decide when to compact. */
+    std::atomic<uint64_t> log_bytes{0};
+
+    /* Set between `lock_file` and `unlock_file`, so `cut_off_batch` does not take (and drop) the lock itself. */
+    bool file_locked = false;
+
+    /* Set once a failed batch could not be cut off the end of the log; nothing appended after it would replay. */
+    std::atomic<bool> log_failed{false};
+
+    /* Sequence numbers (after first, up to and including last) of batches that failed; their records were dropped. */
+    std::vector<std::pair<uint64_t, uint64_t>> lost_batches;
+
+    /*
+     * finish_batch - account for the batch that just ended at `batch_end`; called with `wal_lock` held.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    void finish_batch(bool ok, uint64_t batch_end, uint64_t batch_records)
+    {
+        writing.clear();
+        flushing = false;
+        if(ok)
+        {
+            durable_seq = batch_end;
+            syncs++;
+            synced_records += batch_records;
+        }
+        else lost_batches.emplace_back(durable_seq, batch_end);
+    }
+
+    /*
+     * was_lost - was the record `seq` in a batch that failed?
+     *  returns: true if so else false
+     *  on error: this function does not error
+     * */
+    bool was_lost(uint64_t seq)
+    {
+        for(auto &lost: lost_batches)
+            if(seq > lost.first && seq <= lost.second) return true;
+        return false;
+    }
+
+    /*
+     * cut_off_batch - truncate the `wrote` bytes of a batch that failed off the end of the log again, so the records of
+     *                 later batches do not land behind a torn one (replay stops at the first bad record).
+     *  returns: true if the log ends where it did before the batch else false
+     *  on error: this function does not error
+     * */
+    bool cut_off_batch(size_t wrote)
+    {
+        /* `O_APPEND` leaves the file offset at the end of the last write that went through. */
+        off_t end = lseek(fd, 0, SEEK_CUR);
+        if(end == -1 || (uint64_t) end < wrote) return false;
+
+        /* `DB_NEW` appends under the lock from another process; if it got in after the batch, its record cannot go too. */
+        if(!file_locked && flock(fd, LOCK_EX) != 0) return false;
+
+        struct stat file_info;
+        bool cut = fstat(fd, &file_info) == 0 && file_info.st_size == end && ftruncate(fd, end - (off_t) wrote) == 0;
+
+        if(!file_locked) flock(fd, LOCK_UN);
+        return cut;
+    }
+
+    /*
+     * write_batch - write `writing` out and sync it; called by whoever set `flushing`, without `wal_lock` held.
+     *  returns: true once it is on disk else false, with whatever it wrote cut off again (or the log marked failed)
+     *  on error: this function does not error
+     * */
+    bool write_batch()
+    {
+        if(log_failed.load()) return false;
+
+        size_t wrote = 0;
+        bool ok = wal_write_all(fd, writing.data(), writing.size(), &wrote);
+#if defined(__linux__)
+        ok = ok && fdatasync(fd) == 0;
+#else
+        ok = ok && fsync(fd) == 0;
+#endif
+        if(ok) log_bytes.fetch_add(writing.size(), std::memory_order_relaxed);
+        else if(wrote > 0 && !cut_off_batch(wrote))
+        {
+            log_failed.store(true);
+            std::cout << "MODB Notice:\n\tA write to " << log_path << " failed and could not be undone; nothing more is logged to it." << std::endl;
+        }
+        return ok;
+    }
+
+    /*
+     * append_record - encode a record (`prefix` followed by `payload`) onto the pending buffer.
+     *  returns: the record's sequence number
+     *  on error: this function does not error
+     * */
+    uint64_t append_record(unsigned char record_type, const unsigned char *prefix, uint32_t prefix_size,
+                           const unsigned char *payload, uint32_t payload_size)
+    {
+        std::lock_guard<std::mutex> guard(wal_lock);
+
+        encode_record(pending, record_type, prefix, prefix_size, payload, payload_size);
+        return ++appended_seq;
+    }
+
+public:
+    /*
+     * encode_record - append a whole record (`prefix` followed by `payload`) to `out`, as `append` would log it.
+     *  returns: nothing
+     *  on error: this function does not error
+     * */
+    static void encode_record(std::vector<unsigned char> &out, unsigned char record_type, const unsigned char *prefix, uint32_t prefix_size,
+                              const unsigned char *payload, uint32_t payload_size)
+    {
+        uint32_t record_size = 1 + prefix_size + payload_size;
+
+        size_t at = out.size();
+        out.resize(at + 8 + record_size);
+
+        unsigned char *record = &out[at];
+        modb_put_u32(record, record_size);
+        record[8] = record_type;
+        if(prefix_size > 0) memcpy(&record[WAL_RECORD_HEADER_SIZE], prefix, prefix_size);
+        if(payload_size > 0) memcpy(&record[WAL_RECORD_HEADER_SIZE + prefix_size], payload, payload_size);
+
+        modb_put_u32(&record[4], modb_crc32(&record[8], record_size));
+    }
+
+    /*
+     * open_log - open (or create) the log at `path` for appending.
+     *  returns: true if the log is open else false
+     *  on error: this function does not error
+     * */
+    bool open_log(const unsigned char *path)
+    {
+        fd = open(NCC_PTR path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if(fd == -1) return false;
+
+        struct stat file_info;
+        log_bytes.store(fstat(fd, &file_info) == 0 ? (uint64_t) file_info.st_size : 0);
+        log_path = NCC_PTR path;
+        return true;
+    }
+
+    bool is_open() { return fd != -1; }
+
+    /*
+     * reserve - make room for `bytes` of records in the pending buffer and the one being written.
+     *  returns: nothing
+     *  on error: this function will error if there was a memory allocation error
+     * */
+    void reserve(size_t bytes)
+    {
+        std::lock_guard<std::mutex> guard(wal_lock);
+        pending.reserve(bytes);
+        writing.reserve(bytes);
+    }
+
+    /*
+     * log_size - how many bytes the log file holds, counting every record synced so far.
+     *  returns: the size
+     *  on error: this function does not error
+     * */
+    uint64_t log_size() { return log_bytes.load(std::memory_order_relaxed); }
+
+    /*
+     * lock_file - take an exclusive `flock` on the log file, reopening the log first if compaction renamed a new file over it.
+     *  returns: true once the lock is held on the file at the log's path else false
+     *  on error: this function does not error
+     *
+     *  Note: for logs shared with another process (`DB_NEW` appending to a server's log); release it with `unlock_file`.
+     * */
+    bool lock_file() { return file_locked = wal_lock_at(fd, log_path); }
+
+    void unlock_file()
+    {
+        if(fd != -1) flock(fd, LOCK_UN);
+        file_locked = false;
+    }
+
+    /*
+     * append - buffer a record; it is not durable until `sync` returns for its sequence number.
+     *  returns: the record's sequence number
+     *  on error: this function does not error
+     * */
+    uint64_t append(unsigned char record_type, const unsigned char *payload, uint32_t payload_size)
+    {
+        return append_record(record_type, nullptr, 0, payload, payload_size);
+    }
+
+    /*
+     * append_engine_op - buffer a `WAL_RECORD_ENGINE_OP` record for a request the storage engine performed.
+     *  returns: the record's sequence number
+     *  on error: this function does not error
+     * */
+    uint64_t append_engine_op(unsigned char opcode, const unsigned char *payload, uint32_t payload_size)
+    {
+        return append_record(WAL_RECORD_ENGINE_OP, &opcode, 1, payload, payload_size);
+    }
+
+    /*
+     * sync - make every record up to and including `seq` durable.
+     *  returns: true once they are on disk, false if writing failed
+     *  on error: this function does not error
+     * */
+    bool sync(uint64_t seq)
+    {
+        std::unique_lock<std::mutex> guard(wal_lock);
+
+        /* A later batch moving `durable_seq` past a failed one does not bring its records back. */
+        while(!was_lost(seq) && durable_seq < seq)
+        {
+            /* Someone else is flushing; their batch may already include `seq`, if not we lead the next one. */
+            if(flushing) { flushed.wait(guard); continue; }
+
+            flushing = true;
+            writing.swap(pending);
+            uint64_t batch_end = appended_seq;
+            uint64_t batch_records = appended_seq - durable_seq;
+
+            guard.unlock();
+            bool ok = write_batch();
+            guard.lock();
+
+            finish_batch(ok, batch_end, batch_records);
+            flushed.notify_all();
+        }
+
+        return !was_lost(seq);
+    }
+
+    /*
+     * commit - make every appended record durable.
+     *  returns: true once they are on disk, false if writing failed
+     *  on error: this function does not error
+     * */
+    bool commit()
+    {
+        uint64_t seq;
+        {
+            std::lock_guard<std::mutex> guard(wal_lock);
+            seq = appended_seq;
+        }
+        return sync(seq);
+    }
+
+    /*
+     * switch_file - make every appended record durable in the current file, then let `step` hand over another file to
+     *               log to while no flush can run; records appended in the meantime are written to the new file.
+     *  returns: true if `step` returned a descriptor the log now writes to, false if the log stayed on the current file
+     *  on error: this function does not error
+     *
+     *  Note: `step` gets the current descriptor and must not close it; the log closes it once the new one is in place.
+     * */
+    bool switch_file(const std::function<int(int)> &step)
+    {
+        std::unique_lock<std::mutex> guard(wal_lock);
+        while(flushing) flushed.wait(guard);
+
+        flushing = true;
+        writing.swap(pending);
+        uint64_t batch_end = appended_seq;
+        uint64_t batch_records = appended_seq - durable_seq;
+
+        guard.unlock();
+        bool ok = write_batch();
+        int next_fd = ok ? step(fd) : -1;
+        guard.lock();
+
+        finish_batch(ok, batch_end, batch_records);
+        if(next_fd != -1)
+        {
+            close(fd);
+            fd = next_fd;
+
+            struct stat file_info;
+            log_bytes.store(fstat(fd, &file_info) == 0 ? (uint64_t) file_info.st_size : 0);
+        }
+        flushed.notify_all();
+
+        return next_fd != -1;
+    }
+
+    /*
+     * has_pending - are there appended records that have not been synced yet?
+     *  returns: true if so else false
+     *  on error: this function does not error
+     * */
+    bool has_pending()
+    {
+        std::lock_guard<std::mutex> guard(wal_lock);
+        return appended_seq != durable_seq;
+    }
+
+    uint64_t sync_count() { return syncs; }
+    uint64_t synced_record_count() { return synced_records; }
+
+    /*
+     * record_at - check for a complete record with a matching checksum at `at` in the `size` bytes of a log at `data`.
+     *  returns: the size of the record, header included, or 0 if there is none (the end of the log)
+     *  on error: this function does not error
+     * */
+    static size_t record_at(const unsigned char *data, size_t size, size_t at)
+    {
+        if(at > size || size - at < WAL_RECORD_HEADER_SIZE) return 0;
+
+        uint32_t record_size = modb_get_u32(&data[at]);
+        if(record_size == 0 || size - at - 8 < record_size) return 0;
+        if(modb_get_u32(&data[at + 4]) != modb_crc32(&data[at + 8], record_size)) return 0;
+
+        return 8 + (size_t) record_size;
+    }
+
+    /*
+     * replay - map the log at `path` into `log` and hand every complete, checksummed record to `apply`; with `cut_tail`,
+     *          also cut off a torn tail.
+     *  returns: number of records replayed
+     *  on error: this function does not error; a missing log replays nothing
+     *
+     *  Note: payloads point into `log`, so whatever `apply` keeps from them stays valid while `log` is mapped.
+     *  Note: only the server passes `cut_tail`, when it opens its own log. The log is read under the `flock` writers
+     *        append under, so a tail that does not check out is torn and not a group commit still being written.
+     * */
+    static size_t replay(const unsigned char *path, ModbMapping &log, std::function<void(unsigned char, const unsigned char *, uint32_t)> apply,
+                         bool cut_tail = false)
+    {
+        int lock_fd = cut_tail ? open(NCC_PTR path, O_WRONLY | O_CLOEXEC) : -1;
+        if(lock_fd != -1 && flock(lock_fd, LOCK_EX) != 0)
+        {
+            close(lock_fd);
+            lock_fd = -1;
+        }
+
+        if(!log.map_file(path))
+        {
+            if(lock_fd != -1) close(lock_fd);
+            return 0;
+        }
+
+        const unsigned char *data = log.data();
+        size_t log_size = log.size();
+
+        size_t at = 0, replayed = 0, record;
+        while((record = record_at(data, log_size, at)) > 0)
+        {
+            apply(data[at + 8], &data[at + WAL_RECORD_HEADER_SIZE], (uint32_t) (record - WAL_RECORD_HEADER_SIZE));
+
+            at += record;
+            replayed++;
+        }
+
+        /* Drop a partially written or corrupt tail so new records are not appended after garbage; closing drops the lock. */
+        if(lock_fd != -1)
+        {
+            if(at < log_size && ftruncate(lock_fd, (off_t) at) != 0)
+                std::cout << "MODB Notice:\n\tCould not cut off the damaged tail of " << path << "." << std::endl;
+            close(lock_fd);
+        }
+
+        return replayed;
+    }
+
+    ~WriteAheadLog()
+    {
+        if(fd != -1)
+        {
+            commit();
+            close(fd);
+        }
+        fd = -1;
+    }
+};
+
+#endif
@@ -2,7 +2,7 @@
 //#define something
 #include "db_backend/database.hpp"
 
-int main(int args, char *argv[])
+int main()
 {
     Database db(database_method::DB_CREATE_AND_AUTO_COMMIT, UC_PTR "../MY_MODB/my_modb.modb");
 
@@ -0,0 +1,34 @@
+#include <iostream>
+#define CLIENT_SIDE
+#include "db_backend/database.hpp"
+
+int main()
+{
+    DatabaseConnect db_con(UC_PTR "../MY_MODB/my_modb.modb");
+    if(db_con.status() != modb_status::MODB_OK) return 1;
+
+    /* Shared memory when the server is on this host, else a socket. */
+    if(db_con.CS_connect() != modb_status::MODB_OK)
+    {
+        std::cout << "Could not connect to the server." << std::endl;
+        return 1;
+    }
+
+    _DatabaseClientSide &client = db_con.CS_client();
+    std::cout << "Server status: 0x" << std::hex << (int) client.server_state()
+              << (client.CS_TRANSPORT.is_shared_memory() ? " (shared memory)" : " (socket)") << std::endl;
+
+    /* Create entry 1 with a SDWORD POD named "count", store into it and read it back. */
+    uint32_t count = 0;
+
+    std::cout << "Create entry: 0x" << (int) client.create_entry(1) << std::endl;
+    std::cout << "Create POD:   0x" << (int) client.create_pod<PodSDWord>(1, "count") << std::endl;
+    std::cout << "Store in POD: 0x" << (int) client.store<PodSDWord>(1, "count", 42) << std::endl;
+
+    unsigned char response = client.read<PodSDWord>(1, "count", count);
+    std::cout << "Read POD:     0x" << (int) response;
+    if(response == SS_RESPONSE_OK) std::cout << " value " << std::dec << count;
+    std::cout << std::endl;
+
+    return 0;
+}
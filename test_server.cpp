@@ -2,10 +2,10 @@
 #define SERVER_SIDE
 #include "db_backend/database.hpp"
 
-int main(int args, char *argv[])
+int main()
 {
     DatabaseConnect db_con(UC_PTR "../MY_MODB/my_modb.modb");
-    db_con.SS_start(true);
+    if(db_con.status() != modb_status::MODB_OK) return 1;
 
-    return 0;
+    return db_con.SS_start(true) == modb_status::MODB_OK ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include <iostream>
+#define SERVER_SIDE
+#define BENCH_COUNT_HEAP
+#include "../db_backend/database.hpp"
+#include "../bench/bench.hpp"
+#include "../bench/bench_engine.hpp"
+#include "../bench/bench_batch.hpp"
+#include "../bench/bench_arena.hpp"
+
+/* Allocation test: a commit image built in a warmed-up arena, and a warmed-up server answering pipelined requests,
+ * make no heap allocations at all, `malloc` and `operator new` included.
+ *  Run: ./arena_allocations [scratch folder, defaults to /tmp]
+ * */
+int main(int args, char *argv[])
+{
+    const char *folder = args > 1 ? argv[1] : "/tmp";
+    int failures = 0;
+    double took;
+
+    ModbArena arena;
+    uint64_t allocations = bench_commit_allocations(&arena, 10000, took);
+    printf("commit images in an arena: %llu allocations\n", (unsigned long long) allocations);
+    if(allocations != 0) failures++;
+
+    uint32_t failed;
+    allocations = bench_server_allocations(folder, 10000, took, failed);
+    printf("server requests in steady state: %llu allocations, %u failed\n", (unsigned long long) allocations, failed);
+    if(allocations != 0 || failed != 0) failures++;
+
+    return failures ? 1 : 0;
+}
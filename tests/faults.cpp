@@ -0,0 +1,18 @@
+#include <iostream>
+#define SERVER_SIDE
+#include "../db_backend/database.hpp"
+#include "../bench/bench.hpp"
+#include "../bench/bench_engine.hpp"
+#include "../bench/bench_batch.hpp"
+#include "../bench/bench_faults.hpp"
+
+/* Fault-injection test: setup mistakes come back as a `modb_status`, a server answers every bad request with an
+ * error, survives broken connections and keeps answering good requests (see `run_faults_bench`).
+ *  Run: ./faults [scratch folder, defaults to /tmp]
+ * */
+int main(int args, char *argv[])
+{
+    const char *folder = args > 1 ? argv[1] : "/tmp";
+
+    return run_faults_bench(folder, 100000, 10000) ? 0 : 1;
+}